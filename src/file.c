@@ -39,6 +39,18 @@ int file_is_regular_file(char *path)
     }
 }
 
+int file_is_directory(char *path)
+{
+    if (path == NULL) return -1;
+
+    struct stat s;
+    if (stat(path, &s)) {
+        return -2;
+    }
+
+    return S_ISDIR(s.st_mode) ? true : false;
+}
+
 bool file_is_directory_separator(char c)
 {
 #ifdef _WIN32
@@ -144,7 +156,7 @@ void file_free_list(char *list[])
     vector_free(list);
 }
 
-char **file_list_directory_files(char *path)
+static char **list_directory(char *path, bool dirs)
 {
     DIR* dir = opendir(path);
     if (dir == NULL) {
@@ -164,7 +176,12 @@ char **file_list_directory_files(char *path)
             file_free_list(files);
             return NULL;
         }
-        if (!file_is_regular_file(buf)) {
+        if (dirs) {
+            if (file_is_directory(buf) != true || strcmp(e->d_name, ".") == 0
+                || strcmp(e->d_name, "..") == 0) {
+                continue;
+            }
+        } else if (!file_is_regular_file(buf)) {
             continue;
         }
 
@@ -185,6 +202,16 @@ char **file_list_directory_files(char *path)
     return files;
 }
 
+char **file_list_directory_files(char *path)
+{
+    return list_directory(path, false);
+}
+
+char **file_list_directory_dirs(char *path)
+{
+    return list_directory(path, true);
+}
+
 enum FileType file_detect_type(char *path)
 {
     char *ext = file_get_extension(path);
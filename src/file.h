@@ -14,10 +14,13 @@ enum FileType {
 
 int64_t file_get_size(const char *path);
 char *file_get_extension(char *path);
+bool file_is_directory_separator(char c);
 const char *file_get_basedir();
 int file_path_append(char *dst, const char *a, const char *b, size_t len);
 void file_free_list(char *list[]);
 char **file_list_directory_files(char *path);
+// subdirectories, without "." and ".."
+char **file_list_directory_dirs(char *path);
 enum FileType file_detect_type(char *path);
 char *file_read_line(FILE *f);
 
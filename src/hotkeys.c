@@ -3,18 +3,18 @@
 #include "input_sdl.h"
 #include "video_sdl.h"
 
-void hotkeys_process()
+void hotkeys_process(struct Machine *m)
 {
     if (input_sdl_get_key_pressed(SDL_SCANCODE_INSERT)) {
-        machine_toggle_tape_playback();
+        machine_toggle_tape_playback(m);
     }
 
     if (input_sdl_get_key_pressed(SDL_SCANCODE_F5)) {
-        machine_save_quick();
+        machine_save_quick(m);
     }
 
     if (input_sdl_get_key_pressed(SDL_SCANCODE_F7)) {
-        machine_load_quick();
+        machine_load_quick(m);
     }
 
     if (input_sdl_get_key_pressed(SDL_SCANCODE_F11)) {
@@ -22,7 +22,7 @@ void hotkeys_process()
     }
 
     if (input_sdl_get_key_pressed(SDL_SCANCODE_F1)) {
-        machine_reset();
+        machine_reset(m);
     }
 
     if (input_sdl_get_key_pressed(SDL_SCANCODE_F4)) {
@@ -1,3 +1,5 @@
 #pragma once
 
-void hotkeys_process();
+struct Machine;
+
+void hotkeys_process(struct Machine *m);
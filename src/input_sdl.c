@@ -15,7 +15,7 @@ void input_sdl_init()
         keyboard_state_old = malloc(keyboard_state_size * sizeof(*keyboard_state));
     }
 
-    input_sdl_update();
+    input_sdl_update(NULL);
     input_sdl_copy_old_state();
 }
 
@@ -27,7 +27,8 @@ void input_sdl_deinit()
     }
 }
 
-int input_sdl_update()
+/* Dropped files get opened in the given machine, if any. */
+int input_sdl_update(struct Machine *m)
 {
     int quit = 0;
 
@@ -39,7 +40,9 @@ int input_sdl_update()
             quit = 1;
             break;
         case SDL_EVENT_DROP_FILE:
-            machine_open_file(e.drop.data);
+            if (m != NULL) {
+                machine_open_file(m, e.drop.data);
+            }
             break;
         }
     }
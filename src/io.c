@@ -3,10 +3,7 @@
 #include "keyboard.h"
 #include "machine.h"
 
-uint64_t last_tape_read = 0;
-uint64_t last_tape_read_frame = 0;
-
-uint8_t io_handle_contention(uint16_t addr, uint64_t cycle)
+static uint8_t io_handle_contention(struct Machine *ctx, uint16_t addr, uint64_t cycle)
 {
     // i/o contention on 48/128k is quite funny, as the pattern depends on:
     // - whether high byte is between 0x40 and 0x7F (it "looks" like
@@ -15,41 +12,23 @@ uint8_t io_handle_contention(uint16_t addr, uint64_t cycle)
     // this works out to a total of four combinations which need to be handled.
     // see https://sinclair.wiki.zxnet.co.uk/wiki/Contended_I/O for details
 
-    uint8_t pattern = ((addr >= 0x4000 && addr < 0x8000) << 1) | (addr & 1);
-    uint8_t contention = 0;
-    switch (pattern) 
-    {
-    case 0: // bit reset and no "contended memory"
-        cycle += 1;
-        contention = ula_get_contention_cycles(cycle);
-        break;
-    case 1: // bit set and no "contended memory"
-        break;
-    case 2: // bit reset and "contended memory"
-        contention = ula_get_contention_cycles(cycle);
-        cycle += 1;
-        contention += ula_get_contention_cycles(cycle+contention);
-        break;
-    case 3: // bit set and "contended memory"
-        // LMAO
-        contention = ula_get_contention_cycles(cycle);
-        cycle += 1;
-        contention += ula_get_contention_cycles(cycle+contention);
-        cycle += 1;
-        contention += ula_get_contention_cycles(cycle+contention);
-        cycle += 1;
-        contention += ula_get_contention_cycles(cycle+contention);
-        break;
+    // the ULA precomputes each of them for the whole frame
+    enum UlaIoContention pattern = ((addr >= 0x4000 && addr < 0x8000) << 1) | (addr & 1);
+    // only set while looking for idle loops, like side_effect
+    if (ctx->ula.contention_trace != NULL) {
+        return ula_trace_io_contention_cycles(&ctx->ula, pattern, cycle);
     }
-    return contention;
+    return ula_get_io_contention_cycles(&ctx->ula, pattern, cycle);
 }
 
 /* Performs a port write.
  * Returns the amount of extra cycles stalled due to ULA contention. */
 uint8_t io_port_write(struct Machine *ctx, uint16_t addr, uint8_t value)
 {
+    ctx->idle.side_effect = true;
+
     if (!(addr & 1)) {
-        ula_set_border(value, ctx->cpu.cycles);
+        ula_set_border(&ctx->ula, value, ctx->cpu.cycles);
         beeper_write(&ctx->beeper, !(!(value & (1<<4))), ctx->cpu.cycles);
     }
 
@@ -61,7 +40,11 @@ uint8_t io_port_write(struct Machine *ctx, uint16_t addr, uint8_t value)
         ay_write_data(ctx->ay, value);
     }
 
-    return io_handle_contention(addr, ctx->cpu.cycles);
+    if (machine_breakpoint_test(ctx->breakpoints.out, addr)) {
+        machine_breakpoints_io(ctx, addr, value, true);
+    }
+
+    return io_handle_contention(ctx, addr, ctx->cpu.cycles);
 }
 
 /* Performs a port read. 
@@ -69,17 +52,18 @@ uint8_t io_port_write(struct Machine *ctx, uint16_t addr, uint8_t value)
 uint8_t io_port_read(struct Machine *ctx, uint16_t addr, uint8_t *dest)
 {
     if (!(addr & 1)) {
-        *dest = keyboard_read(addr) & ~(1<<6);
+        *dest = keyboard_read(ctx, addr) & ~(1<<6);
 
         if (ctx->player != NULL) {
+            ctx->idle.side_effect = true;
             uint64_t delta;
 
-            delta = (ctx->frames - last_tape_read_frame) * ctx->timing.t_frame;
+            delta = (ctx->frames - ctx->last_tape_read_frame) * ctx->timing.t_frame;
             delta += ctx->cpu.cycles;
-            delta -= last_tape_read;
+            delta -= ctx->last_tape_read;
 
-            last_tape_read = ctx->cpu.cycles;
-            last_tape_read_frame = ctx->frames;
+            ctx->last_tape_read = ctx->cpu.cycles;
+            ctx->last_tape_read_frame = ctx->frames;
 
             uint8_t tape = tape_player_get_next_sample(ctx->player, delta);
             if (tape) {
@@ -94,5 +78,9 @@ uint8_t io_port_read(struct Machine *ctx, uint16_t addr, uint8_t *dest)
         *dest = ay_read_data(ctx->ay); 
     }
 
-    return io_handle_contention(addr, ctx->cpu.cycles);
+    if (machine_breakpoint_test(ctx->breakpoints.in, addr)) {
+        machine_breakpoints_io(ctx, addr, *dest, false);
+    }
+
+    return io_handle_contention(ctx, addr, ctx->cpu.cycles);
 }
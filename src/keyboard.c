@@ -1,6 +1,7 @@
 #include "keyboard.h"
 #include "keyboard_macro.h"
 #include "input_sdl.h"
+#include "machine.h"
 
 // speccy -> sdl scancode key map
 const int keyboard_scancode_map[8][5] = {
@@ -62,7 +63,7 @@ const int keyboard_scancode_map[8][5] = {
     },
 };
 
-uint8_t keyboard_read(uint16_t addr)
+uint8_t keyboard_read(const struct Machine *m, uint16_t addr)
 {
     uint8_t h = ~(addr >> 8);
     uint8_t result = 0xFF;
@@ -71,14 +72,14 @@ uint8_t keyboard_read(uint16_t addr)
         uint8_t mask = (1<<a_bit);
 
         if (h & mask) {
-            for (uint8_t k_bit = 0; k_bit < 5; k_bit++) {
+            for (uint8_t k_bit = 0; k_bit < 5 && m->frontend; k_bit++) {
                 mask = ~(1<<k_bit);
                 int scancode = keyboard_scancode_map[a_bit][k_bit];
                 if (input_sdl_get_key(scancode))
                     result &= mask;
             }
 
-            result &= keyboard_macro_get(a_bit);
+            result &= keyboard_macro_get(&m->macro, a_bit);
         }
     }
 
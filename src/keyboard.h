@@ -1,4 +1,6 @@
 #pragma once
 #include <stdint.h>
 
-uint8_t keyboard_read(uint16_t addr);
+struct Machine;
+
+uint8_t keyboard_read(const struct Machine *m, uint16_t addr);
@@ -1,68 +1,59 @@
 #include "keyboard_macro.h"
+#include <string.h>
 
-static const KeyboardMacro_t *current = NULL;
-static int frame = 0;
-static int index = 0;
-static int macro_len = 0;
-static uint8_t state[8] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
-
-void keyboard_macro_play(const KeyboardMacro_t *macro, size_t len)
+void keyboard_macro_play(struct KeyboardMacroPlayer *p, const KeyboardMacro_t *macro, size_t len)
 {
-    current = macro;
-    frame = 0;
-    index = 0;
-    macro_len = len;
-    for (int i = 0; i < 8; i++) {
-        state[i] = 0xFF;
-    }
+    p->current = macro;
+    p->frame = 0;
+    p->index = 0;
+    p->len = len;
+    memset(p->pressed, 0, sizeof(p->pressed));
 }
 
-void keyboard_macro_process()
+void keyboard_macro_process(struct KeyboardMacroPlayer *p)
 {
-    if (current == NULL) {
+    if (p->current == NULL) {
         return;
     }
 
-    for (int i = 0; i < 8; i++) {
-        state[i] = 0xFF;
-    }
+    memset(p->pressed, 0, sizeof(p->pressed));
 
-    if (index >= macro_len) {
-        current = NULL;
+    if (p->index >= p->len) {
+        p->current = NULL;
         return;
     }
 
-    frame++;
+    p->frame++;
 
-    while (current[index].frame < frame) {
-        index++;
-        if (index >= macro_len) {
+    while (p->current[p->index].frame < p->frame) {
+        p->index++;
+        if (p->index >= p->len) {
             return;
         }
     }
 
-    while (current[index].frame == frame) {
-        switch (current[index].cmd)
+    while (p->current[p->index].frame == p->frame) {
+        switch (p->current[p->index].cmd)
         {
         case KBMACRO_GOTO:
-            frame = current[index].value - 1;
-            index = 0;
+            p->frame = p->current[p->index].value - 1;
+            p->index = 0;
             return;
         case KBMACRO_KEY: ;
-            int addr = (current[index].value / 5) & 7;
-            int bit = current[index].value % 5;
-            state[addr] &= ~(1<<bit);
+            int addr = (p->current[p->index].value / 5) & 7;
+            int bit = p->current[p->index].value % 5;
+            p->pressed[addr] |= 1<<bit;
             break;
         }
 
-        index++;
-        if (index >= macro_len) {
+        p->index++;
+        if (p->index >= p->len) {
             return;
         }
     }
 }
 
-uint8_t keyboard_macro_get(int address)
+uint8_t keyboard_macro_get(const struct KeyboardMacroPlayer *p, int address)
 {
-    return state[address];
+    return ~p->pressed[address];
 }
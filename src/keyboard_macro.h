@@ -16,6 +16,15 @@ typedef struct KeyboardMacro
     int value;
 } KeyboardMacro_t;
 
-void keyboard_macro_play(const KeyboardMacro_t *macro, size_t len);
-void keyboard_macro_process();
-uint8_t keyboard_macro_get(int address);
+struct KeyboardMacroPlayer
+{
+    const KeyboardMacro_t *current;
+    int frame;
+    int index;
+    int len;
+    uint8_t pressed[8];     // by address line, zeroed is nothing pressed
+};
+
+void keyboard_macro_play(struct KeyboardMacroPlayer *p, const KeyboardMacro_t *macro, size_t len);
+void keyboard_macro_process(struct KeyboardMacroPlayer *p);
+uint8_t keyboard_macro_get(const struct KeyboardMacroPlayer *p, int address);
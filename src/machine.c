@@ -13,12 +13,6 @@
 #include "dsp.h"
 #include "hotkeys.h"
 
-static Machine_t *m_cur = NULL;
-static bool file_open;
-static bool file_save;
-static char file_open_path[2048];
-static char file_save_path[2048];
-
 const struct MachineTiming machine_timing_zx48k = {
     .clock_hz = 3500000,
 
@@ -30,10 +24,7 @@ const struct MachineTiming machine_timing_zx48k = {
     .t_int_hold = 32,
 };
 
-void machine_set_current(Machine_t *machine)
-{
-    m_cur = machine;
-}
+static void machine_sync_events(Machine_t *m);
 
 int machine_init(Machine_t *machine, enum MachineType type)
 {
@@ -48,11 +39,18 @@ int machine_init(Machine_t *machine, enum MachineType type)
     machine->type = type;
     machine->timing = machine_timing_zx48k;
 
-    memory_init(&machine->memory);
+    if (machine->memory == NULL) {
+        machine->memory = memory_alloc();
+        if (machine->memory == NULL) {
+            return -1;
+        }
+    }
+    memory_init(machine->memory);
+    machine_breakpoints_attach(machine);
 
     char path[2048];
     file_path_append(path, file_get_basedir(), "rom/48.rom", sizeof(path));
-    memory_load_rom_16k(&machine->memory, path);
+    memory_load_rom_16k(machine->memory, path);
 
     machine->cpu.ctx = machine;
     cpu_init(&machine->cpu);
@@ -62,14 +60,28 @@ int machine_init(Machine_t *machine, enum MachineType type)
     machine->frames = 0;
     machine->reset_pending = false;
 
-    // FIXME: hack
-    ula_init(machine);
+    if (ula_init(&machine->ula, machine)) {
+        return -1;
+    }
+
+    machine_hooks_register(machine);
+
+    // snapshot loading reinitializes the machine,
+    // events scheduled by others are kept
+    machine_sync_events(machine);
 
     return 0;
 }
 
 void machine_deinit(Machine_t *machine)
 {
+    cpu_deinit(&machine->cpu);
+
+    memory_free(machine->memory);
+    machine->memory = NULL;
+
+    ula_deinit(&machine->ula);
+
     if (machine->player) {
         tape_player_close(machine->player);
         machine->player = NULL;
@@ -81,156 +93,330 @@ void machine_deinit(Machine_t *machine)
     }
 }
 
-void machine_reset() 
+void machine_reset(Machine_t *m) 
 {
-    if (m_cur == NULL) return;
-    m_cur->reset_pending = true;
+    m->reset_pending = true;
 }
 
-void machine_process_events()
+void machine_process_events(Machine_t *m)
 {
-    if (m_cur == NULL) return;
+    struct MachineFileRequests *files = &m->files;
 
-    if (file_open) {
-        file_open = false;
-        enum FileType ft = file_detect_type(file_open_path);
+    if (files->open) {
+        files->open = false;
+        enum FileType ft = file_detect_type(files->open_path);
 
         switch (ft)
         {
         case FTYPE_TAP:
-            if (m_cur->tape != NULL) {
-                tape_free(m_cur->tape);
+            if (m->tape != NULL) {
+                tape_free(m->tape);
             }
-            if (m_cur->player != NULL) {
-                tape_player_close(m_cur->player);
+            if (m->player != NULL) {
+                tape_player_close(m->player);
             }
 
-            m_cur->tape = tape_load_from_tap(file_open_path);
-            m_cur->player = tape_player_from_tape(m_cur->tape);
-            tape_player_pause(m_cur->player, true);
+            m->tape = tape_load_from_tap(files->open_path);
+            m->player = tape_player_from_tape(m->tape);
+            tape_player_pause(m->player, true);
+            machine_hooks_register(m);
             break;
         case FTYPE_SZX: ;
-            SZX_t *szx = szx_load_file(file_open_path);
+            SZX_t *szx = szx_load_file(files->open_path);
             if (szx != NULL) {
-                szx_state_load(szx, m_cur);
+                szx_state_load(szx, m);
                 szx_free(szx);
+                machine_sync_events(m);
             }
             break;
         case FTYPE_SNA:
-            if (sna_state_load(file_open_path, m_cur)) {
-                dlog(LOG_ERR, "Failed to open .sna file \"%s\"", file_open_path);
+            if (sna_state_load(files->open_path, m)) {
+                dlog(LOG_ERR, "Failed to open .sna file \"%s\"", files->open_path);
             }
             break;
         default:
-            dlog(LOG_ERR, "Unrecognized input file \"%s\"", file_open_path);
+            dlog(LOG_ERR, "Unrecognized input file \"%s\"", files->open_path);
         }
     }
 
-    if (file_save) {
-        SZX_t *szx = szx_state_save(m_cur);
+    if (files->save) {
+        SZX_t *szx = szx_state_save(m);
         if (szx != NULL) {
-            szx_save_file(szx, file_save_path);
+            szx_save_file(szx, files->save_path);
             szx_free(szx);
         }
-        file_save = false;
+        files->save = false;
     }
 
-    if (m_cur->reset_pending) {
-        cpu_init(&m_cur->cpu);
-        ay_reset(m_cur->ay);
-        m_cur->reset_pending = false;
+    if (m->reset_pending) {
+        cpu_init(&m->cpu);
+        ay_reset(m->ay);
+        m->reset_pending = false;
+        machine_sync_events(m);
     }
 
-    if (palette_has_changed()) {
+    if (m->frontend && palette_has_changed()) {
         Palette_t *pal = palette_load_current();
         if (pal) {
-            ula_set_palette(pal);
+            ula_set_palette(&m->ula, pal);
             palette_free(pal);
         }
     }
 }
 
-void machine_open_file(const char *path)
+void machine_open_file(Machine_t *m, const char *path)
 {
     if (path == NULL) return;
     
-    strncpy(file_open_path, path, sizeof(file_open_path)-1);
-    file_open_path[sizeof(file_open_path)-1] = 0;
-    file_open = true;
+    strncpy(m->files.open_path, path, sizeof(m->files.open_path)-1);
+    m->files.open_path[sizeof(m->files.open_path)-1] = 0;
+    m->files.open = true;
 }
 
-void machine_save_file(const char *path)
+void machine_save_file(Machine_t *m, const char *path)
 {
     if (path == NULL) return;
     
-    strncpy(file_save_path, path, sizeof(file_save_path)-1);
-    file_save_path[sizeof(file_save_path)-1] = 0;
-    file_save = true;
+    strncpy(m->files.save_path, path, sizeof(m->files.save_path)-1);
+    m->files.save_path[sizeof(m->files.save_path)-1] = 0;
+    m->files.save = true;
 }
 
-static char *get_quicksave_path()
+void machine_save_quick(Machine_t *m)
 {
-    static char buf[2048] = { 0 };
-    if (buf[0] == 0) {
-        file_path_append(buf, file_get_basedir(), "quicksave.szx", sizeof(buf));
+    char path[2048];
+    file_path_append(path, file_get_basedir(), "quicksave.szx", sizeof(path));
+    machine_save_file(m, path);
+}
+
+void machine_load_quick(Machine_t *m)
+{
+    char path[2048];
+    file_path_append(path, file_get_basedir(), "quicksave.szx", sizeof(path));
+    machine_open_file(m, path);
+}
+
+void machine_toggle_tape_playback(Machine_t *m)
+{
+    if (m->player == NULL) return;
+
+    tape_player_pause(m->player, !m->player->paused);
+}
+
+/* event scheduler */
+
+/* Returns the amount of T-states since the machine was started. */
+uint64_t machine_get_time(Machine_t *m)
+{
+    return m->frames * m->timing.t_frame + m->cpu.cycles;
+}
+
+static inline bool event_before(const struct MachineEvent *a, const struct MachineEvent *b)
+{
+    return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+static void event_swap(struct MachineScheduler *s, size_t a, size_t b)
+{
+    struct MachineEvent tmp = s->heap[a];
+    s->heap[a] = s->heap[b];
+    s->heap[b] = tmp;
+}
+
+static void event_sift_up(struct MachineScheduler *s, size_t i)
+{
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!event_before(&s->heap[i], &s->heap[parent])) break;
+        event_swap(s, i, parent);
+        i = parent;
     }
-    return buf;
 }
 
-void machine_save_quick()
+static void event_sift_down(struct MachineScheduler *s, size_t i)
 {
-    machine_save_file(get_quicksave_path());
+    for (;;) {
+        size_t min = i;
+        size_t l = 2 * i + 1;
+        size_t r = 2 * i + 2;
+        if (l < s->len && event_before(&s->heap[l], &s->heap[min])) min = l;
+        if (r < s->len && event_before(&s->heap[r], &s->heap[min])) min = r;
+        if (min == i) break;
+        event_swap(s, i, min);
+        i = min;
+    }
 }
 
-void machine_load_quick()
+static void event_remove(struct MachineScheduler *s, size_t i)
 {
-    machine_open_file(get_quicksave_path());
+    s->len--;
+    if (i == s->len) return;
+    s->heap[i] = s->heap[s->len];
+    event_sift_down(s, i);
+    event_sift_up(s, i);
 }
 
-void machine_toggle_tape_playback()
+/* Calls func(m, data) once the machine reaches the given absolute T-state.
+ * Events due at the same time run in the order they were scheduled in.
+ * Returns zero on success, non-zero if the queue is full. */
+int machine_schedule(Machine_t *m, uint64_t time, MachineEventFunc func, void *data)
 {
-    if (m_cur == NULL) return;
-    if (m_cur->player == NULL) return;
+    struct MachineScheduler *s = &m->events;
+    if (s->len >= MACHINE_MAX_EVENTS) {
+        dlog(LOG_ERR, "%s: event queue full", __func__);
+        return -1;
+    }
 
-    tape_player_pause(m_cur->player, !m_cur->player->paused);
+    s->heap[s->len] = (struct MachineEvent) {
+        .time = time,
+        .seq = s->seq++,
+        .func = func,
+        .data = data,
+    };
+    s->len++;
+    event_sift_up(s, s->len - 1);
+    return 0;
 }
 
-int machine_do_cycles()
+/* Removes all scheduled events matching func and data. */
+void machine_cancel(Machine_t *m, MachineEventFunc func, void *data)
 {
-    while (!m_cur->cpu.error) {
-        if (m_cur->cpu.cycles < m_cur->timing.t_int_hold) {
-            cpu_fire_interrupt(&m_cur->cpu);
+    struct MachineScheduler *s = &m->events;
+    size_t i = 0;
+    while (i < s->len) {
+        if (s->heap[i].func == func && s->heap[i].data == data) {
+            event_remove(s, i);
+            i = 0;
+        } else {
+            i++;
         }
+    }
+}
+
+static void machine_run_events(Machine_t *m)
+{
+    struct MachineScheduler *s = &m->events;
+    while (s->len > 0 && s->heap[0].time <= machine_get_time(m)) {
+        struct MachineEvent e = s->heap[0];
+        event_remove(s, 0);
+        e.func(m, e.data);
+    }
+}
+
+/* Returns the time of the next event relative to the current frame. */
+static uint64_t machine_next_deadline(Machine_t *m)
+{
+    uint64_t frame_start = m->frames * m->timing.t_frame;
+    if (m->events.len == 0) {
+        return frame_start + m->timing.t_frame;
+    }
+    return m->events.heap[0].time - frame_start;
+}
+
+static void event_int_release(Machine_t *m, void *data)
+{
+    (void)data;
+    m->int_line = false;
+}
+
+static void event_int_assert(Machine_t *m, void *data)
+{
+    (void)data;
+    uint64_t frame_start = m->frames * m->timing.t_frame;
+    m->int_line = true;
+    machine_schedule(m, frame_start + m->timing.t_int_hold, event_int_release, NULL);
+    machine_schedule(m, frame_start + m->timing.t_frame, event_int_assert, NULL);
+}
 
-        machine_process_hooks(m_cur);
-        machine_test_iterate(m_cur);
+static void event_frame_end(Machine_t *m, void *data)
+{
+    (void)data;
+    m->cpu.cycles -= m->timing.t_frame;
+    m->frames++;
 
-        cpu_do_cycles(&m_cur->cpu);
+    ay_process_frame(m->ay);
+    beeper_process_frame(&m->beeper);
+    dsp_mix_buffers_mono_to_stereo(m->ay->buf, m->beeper.buf, m->ay->buf_len);
 
-        if (m_cur->cpu.cycles >= m_cur->timing.t_frame) {
-            m_cur->cpu.cycles -= m_cur->timing.t_frame;
-            m_cur->frames++;
+    ula_draw_frame(&m->ula);
 
-            ay_process_frame(m_cur->ay);
-            beeper_process_frame(&m_cur->beeper);
-            dsp_mix_buffers_mono_to_stereo(m_cur->ay->buf, m_cur->beeper.buf, m_cur->ay->buf_len);
+    if (m->frontend) {
+        audio_sdl_queue(m->ay->buf, m->ay->buf_len * sizeof(float));
+        video_sdl_draw_indexed_buffer(m->ula.buffer, BUFFER_LEN,
+                                      (const uint8_t *)m->ula.colors);
+    }
 
-            audio_sdl_queue(m_cur->ay->buf, m_cur->ay->buf_len * sizeof(float));
+    keyboard_macro_process(&m->macro);
 
-            ula_draw_frame();
+    m->frame_done = true;
+    machine_schedule(m, (m->frames + 1) * m->timing.t_frame, event_frame_end, NULL);
+}
 
-            video_sdl_draw_rgb24_buffer(ula_buffer, sizeof(ula_buffer));
+/* (Re)schedules the frame's own events relative to the current frame,
+ * needed whenever the cpu's cycle counter gets set from outside. */
+static void machine_sync_events(Machine_t *m)
+{
+    machine_cancel(m, event_int_assert, NULL);
+    machine_cancel(m, event_int_release, NULL);
+    machine_cancel(m, event_frame_end, NULL);
+
+    uint64_t frame_start = m->frames * m->timing.t_frame;
+    m->int_line = false;
+    machine_schedule(m, frame_start, event_int_assert, NULL);
+    machine_schedule(m, frame_start + m->timing.t_frame, event_frame_end, NULL);
+}
+
+int machine_do_cycles(Machine_t *m)
+{
+    while (!m->cpu.error) {
+        machine_run_events(m);
 
-            keyboard_macro_process();
+        if (m->frame_done) {
+            m->frame_done = false;
 
-            input_sdl_copy_old_state();
-            int quit = input_sdl_update();
-            if (quit) return -2;
+            if (m->frontend) {
+                input_sdl_copy_old_state();
+                int quit = input_sdl_update(m);
+                if (quit) return -2;
 
-            hotkeys_process();
-            machine_process_events();
+                hotkeys_process(m);
+            }
+            machine_process_events(m);
             return 0;
         }
+
+        // the cpu runs until the next event or a hooked PC,
+        // stepping single instructions only where something has to be
+        // checked in between them
+        uint64_t deadline = machine_next_deadline(m);
+        bool step = false;
+
+        if (m->int_line) {
+            cpu_fire_interrupt(&m->cpu);
+            step = true;
+        } else if (machine_test_need_step(m) || machine_hooks_need_step(m)) {
+            step = true;
+        }
+
+        machine_breakpoints_process(m);
+        machine_process_hooks(m);
+        machine_test_iterate(m);
+        if (machine_test_done(m, NULL)) {
+            return 1;
+        }
+
+        if (step) {
+            cpu_run_until(&m->cpu, m->cpu.cycles + 1);
+        } else if (m->idle.enabled) {
+            // stop every now and then to look for idle loops
+            uint64_t probe = m->cpu.cycles + MACHINE_IDLE_PROBE_INTERVAL;
+            cpu_run_until(&m->cpu, probe < deadline ? probe : deadline);
+            if (m->cpu.cycles < deadline) {
+                machine_idle_skip(m, deadline);
+            }
+        } else {
+            cpu_run_until(&m->cpu, deadline);
+        }
     }
 
     return -1;
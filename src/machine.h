@@ -6,6 +6,10 @@
 #include "ula.h"
 #include "ay.h"
 #include "beeper.h"
+#include "machine_idle.h"
+#include "machine_breakpoints.h"
+#include "machine_hooks.h"
+#include "keyboard_macro.h"
 
 enum MachineType
 {
@@ -24,30 +28,86 @@ struct MachineTiming
     unsigned int t_int_hold;
 };
 
+#define MACHINE_MAX_EVENTS 32
+
+struct Machine;
+typedef void (*MachineEventFunc)(struct Machine *m, void *data);
+
+struct MachineEvent
+{
+    uint64_t time;      // absolute T-state, see machine_get_time()
+    uint64_t seq;       // keeps events due at the same time in order
+    MachineEventFunc func;
+    void *data;
+};
+
+// binary min-heap ordered by time
+struct MachineScheduler
+{
+    struct MachineEvent heap[MACHINE_MAX_EVENTS];
+    size_t len;
+    uint64_t seq;
+};
+
+// requested from outside of the emulation, carried out between frames
+struct MachineFileRequests
+{
+    bool open;
+    bool save;
+    char open_path[2048];
+    char save_path[2048];
+};
+
 typedef struct Machine {
+    // hot state first, the rest is only touched every now and then
+    Z80_t cpu;
+    Memory_t *memory;
+
     enum MachineType type;
     struct MachineTiming timing;
 
-    Z80_t cpu;
-    Memory_t memory;
-
     Tape_t *tape;
     TapePlayer_t *player;
+    uint64_t last_tape_read;
+    uint64_t last_tape_read_frame;
     AY_t *ay;
     Beeper_t beeper;
 
     uint64_t frames;
     bool reset_pending;
+
+    struct MachineScheduler events;
+    bool int_line;      // INT is held low
+    bool frame_done;
+
+    // shown in the window, heard through the audio device and
+    // fed the host's keyboard, everything else runs on its own
+    bool frontend;
+
+    struct MachineIdle idle;
+    struct MachineHooks hooks;
+    struct KeyboardMacroPlayer macro;
+    struct MachineTest *test;   // NULL unless running a test
+    Ula_t ula;
+
+    // the biggest parts, past everything else as they're rarely touched:
+    // breakpoints are only looked up on watched accesses and I/O,
+    // files are only opened or saved between frames
+    struct MachineBreakpoints breakpoints;
+    struct MachineFileRequests files;
 } Machine_t;
 
-void machine_set_current(Machine_t *machine);
 int machine_init(Machine_t *machine, enum MachineType type);
 void machine_deinit(Machine_t *machine);
-void machine_reset();
-void machine_process_events();
-void machine_open_file(const char *path);
-void machine_save_file(const char *path);
-void machine_load_quick();
-void machine_save_quick();
-void machine_toggle_tape_playback();
-int machine_do_cycles();
+void machine_reset(Machine_t *m);
+void machine_process_events(Machine_t *m);
+void machine_open_file(Machine_t *m, const char *path);
+void machine_save_file(Machine_t *m, const char *path);
+void machine_load_quick(Machine_t *m);
+void machine_save_quick(Machine_t *m);
+void machine_toggle_tape_playback(Machine_t *m);
+uint64_t machine_get_time(Machine_t *m);
+int machine_schedule(Machine_t *m, uint64_t time, MachineEventFunc func, void *data);
+void machine_cancel(Machine_t *m, MachineEventFunc func, void *data);
+// 0 after each frame, 1 once a test is done, negative to stop on quit or error
+int machine_do_cycles(Machine_t *m);
@@ -0,0 +1,182 @@
+#include "machine_bench.h"
+#include <inttypes.h>
+#include <SDL3/SDL_timer.h>
+#include "machine.h"
+#include "z80_jit.h"
+#include "video_sdl.h"
+#include "log.h"
+
+#ifdef __linux__
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+static bool bench_running = false;
+static uint64_t bench_frames;
+static uint64_t frames_start;
+static uint64_t ticks_start;
+static uint64_t idle_start;
+static uint64_t prefix_start;
+static uint64_t ula_ns_start;
+static uint64_t ula_calls_start;
+static uint64_t ula_cells_start;
+
+/* Hardware counters, perf stat style. Only available on Linux,
+ * and only if the kernel lets us read them. */
+
+enum BenchCounter {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_L1D_LOADS,
+    COUNTER_L1D_MISSES,
+    COUNTER_COUNT,
+};
+
+static int counter_fd[COUNTER_COUNT];
+static bool counters_open = false;
+
+#ifdef __linux__
+static int counter_open(uint32_t type, uint64_t config)
+{
+    struct perf_event_attr attr = {
+        .type = type,
+        .size = sizeof(attr),
+        .config = config,
+        .disabled = 1,
+        .exclude_kernel = 1,
+        .exclude_hv = 1,
+    };
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void counters_start()
+{
+    const uint64_t l1d_read = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8);
+
+    counter_fd[COUNTER_CYCLES] = counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    counter_fd[COUNTER_INSTRUCTIONS] = counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    counter_fd[COUNTER_L1D_LOADS] = counter_open(PERF_TYPE_HW_CACHE, 
+                                        l1d_read | (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16));
+    counter_fd[COUNTER_L1D_MISSES] = counter_open(PERF_TYPE_HW_CACHE, 
+                                        l1d_read | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+
+    counters_open = true;
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        counters_open &= counter_fd[i] >= 0;
+    }
+    if (!counters_open) {
+        dlog(LOG_INFO, "benchmark: hardware counters unavailable");
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            if (counter_fd[i] >= 0) close(counter_fd[i]);
+        }
+        return;
+    }
+
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        ioctl(counter_fd[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter_fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+/* Stops the counters and reads them into values. 
+ * Returns false if there's nothing to report. */
+static bool counters_stop(uint64_t values[COUNTER_COUNT])
+{
+    if (!counters_open) return false;
+
+    bool ok = true;
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        ioctl(counter_fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        ok &= read(counter_fd[i], &values[i], sizeof(values[i])) == sizeof(values[i]);
+        close(counter_fd[i]);
+    }
+    counters_open = false;
+    return ok;
+}
+#else
+static void counters_start() {}
+static bool counters_stop(uint64_t values[COUNTER_COUNT]) { (void)values; return false; }
+#endif
+
+/* Starts measuring host time spent emulating the given amount of frames. */
+void machine_bench_open(uint64_t frames)
+{
+    bench_frames = frames;
+    bench_running = true;
+    frames_start = 0;
+    ticks_start = 0;
+    video_sdl_set_fps_limit(false);
+}
+
+static void bench_report(struct Machine *m, uint64_t frames, uint64_t ns)
+{
+    double secs = ns / 1e9;
+    double fps = frames / secs;
+    double realtime = (double)m->timing.clock_hz / (double)m->timing.t_frame;
+    double mhz = fps * m->timing.t_frame / 1e6;
+
+    dlog(LOG_INFO, "benchmark: %"PRIu64" frames in %.3f s", frames, secs);
+    dlog(LOG_INFO, "  %.1f FPS, %.2fx realtime, %.1f MHz effective", 
+                   fps, fps / realtime, mhz);
+    dlog(LOG_INFO, "  %.1f ns per frame, dispatch: %s%s, recompiler: %s", 
+                   (double)ns / frames, cpu_get_dispatch_name(&m->cpu),
+                   m->cpu.lazy_flags ? ", lazy flags" : "", jit_get_mode_name(&m->cpu));
+    dlog(LOG_INFO, "  %.1f DD/FD prefixed instructions per frame",
+                   (double)(m->cpu.prefix_runs - prefix_start) / frames);
+    uint64_t ula_ns = m->ula.draw_ns - ula_ns_start;
+    dlog(LOG_INFO, "  ULA: %.1f us per frame (%.1f%% of frame time), drawn in %.1f parts",
+                   ula_ns / 1e3 / frames, 100.0 * ula_ns / ns,
+                   (double)(m->ula.draw_calls - ula_calls_start) / frames);
+    dlog(LOG_INFO, "  ULA: %.1f%% of screen cells redrawn per frame",
+                   100.0 * (m->ula.cells_drawn - ula_cells_start) / (frames * 32 * 192));
+    if (m->idle.enabled) {
+        uint64_t skipped = m->idle.skipped_cycles - idle_start;
+        dlog(LOG_INFO, "  idle skip: %"PRIu64" T-states skipped (%.1f%%), %"PRIu64" loops found",
+                       skipped, 100.0 * skipped / ((double)frames * m->timing.t_frame),
+                       m->idle.loops_found);
+    }
+
+    uint64_t c[COUNTER_COUNT];
+    if (counters_stop(c)) {
+        dlog(LOG_INFO, "  %.0f host cycles, %.0f instructions per frame, %.2f IPC",
+                       (double)c[COUNTER_CYCLES] / frames, 
+                       (double)c[COUNTER_INSTRUCTIONS] / frames,
+                       (double)c[COUNTER_INSTRUCTIONS] / c[COUNTER_CYCLES]);
+        dlog(LOG_INFO, "  %.0f L1d loads, %.0f L1d misses per frame (%.2f%% of loads)",
+                       (double)c[COUNTER_L1D_LOADS] / frames,
+                       (double)c[COUNTER_L1D_MISSES] / frames,
+                       100.0 * c[COUNTER_L1D_MISSES] / c[COUNTER_L1D_LOADS]);
+    }
+}
+
+/* Should be called after each frame.
+ * Returns non-zero once the benchmark is done. */
+int machine_bench_iterate(struct Machine *m)
+{
+    if (!bench_running) return 0;
+
+    // first frame only gets the loaded file into a defined state, don't count it
+    if (ticks_start == 0) {
+        ticks_start = SDL_GetTicksNS();
+        frames_start = m->frames;
+        idle_start = m->idle.skipped_cycles;
+        prefix_start = m->cpu.prefix_runs;
+        m->ula.timed = true;
+        ula_ns_start = m->ula.draw_ns;
+        ula_calls_start = m->ula.draw_calls;
+        ula_cells_start = m->ula.cells_drawn;
+        counters_start();
+        return 0;
+    }
+
+    uint64_t frames = m->frames - frames_start;
+    if (frames < bench_frames) return 0;
+
+    bench_report(m, frames, SDL_GetTicksNS() - ticks_start);
+    bench_running = false;
+    m->ula.timed = false;
+
+    return 1;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdint.h>
+
+struct Machine;
+
+void machine_bench_open(uint64_t frames);
+int machine_bench_iterate(struct Machine *m);
@@ -0,0 +1,209 @@
+#include "machine_breakpoints.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "machine.h"
+#include "z80_trace.h"
+#include "log.h"
+
+/* Breakpoint engine.
+ *
+ * Execute breakpoints set PC hooks, so the cpu stops right before them and
+ * machine_breakpoints_process() gets to run their actions. Memory breakpoints
+ * watch the pages they're on, accesses to every other page keep going through
+ * the fast paths. I/O breakpoints are a bit test per port access.
+ * Actions of memory and I/O breakpoints run in the middle of the instruction
+ * doing the access. */
+
+static const char *kind_name[BREAK_KIND_COUNT] = {
+    "exec", "read", "write", "in", "out",
+};
+
+static void hit_log(struct Machine *m, const struct BreakpointHit *hit, void *data)
+{
+    (void)data;
+    dlog(LOG_INFO, "break: %s %04X, value %02X, pc %04X, frame %"PRIu64", cycle %"PRIu64,
+                   kind_name[hit->kind], hit->addr, hit->value, m->cpu.regs.pc,
+                   m->frames, m->cpu.cycles);
+}
+
+static void hit(struct Machine *m, enum BreakpointKind kind, uint16_t addr, uint8_t value)
+{
+    struct BreakpointHit h = { .kind = kind, .addr = addr, .value = value };
+
+    for (int i = 0; i < MACHINE_MAX_BREAKPOINTS; i++) {
+        struct Breakpoint *b = &m->breakpoints.list[i];
+        if (!b->used || !b->enabled || b->kind != kind
+            || addr < b->first || addr > b->last) {
+            continue;
+        }
+        if (b->cond != NULL && !b->cond(m, &h, b->data)) continue;
+
+        BreakpointFunc action = b->action != NULL ? b->action : hit_log;
+        action(m, &h, b->data);
+    }
+}
+
+static void memory_watch(struct Machine *m, uint16_t addr, uint8_t value, bool write)
+{
+    if (m->cpu.trace != NULL) {
+        trace_memory_access(&m->cpu, addr, value, write);
+    }
+
+    const uint8_t *map = write ? m->breakpoints.write : m->breakpoints.read;
+    if (machine_breakpoint_test(map, addr)) {
+        hit(m, write ? BREAK_WRITE : BREAK_READ, addr, value);
+    }
+}
+
+static bool page_watched(const uint8_t *map, unsigned int page)
+{
+    const uint8_t *p = &map[(page << MEMORY_PAGE_SHIFT) / 8];
+    for (unsigned int i = 0; i < MEMORY_PAGE_SIZE / 8; i++) {
+        if (p[i]) return true;
+    }
+    return false;
+}
+
+/* Hooks the breakpoints into the machine's memory,
+ * needs to be called again whenever it gets replaced. */
+void machine_breakpoints_attach(struct Machine *m)
+{
+    Memory_t *mem = m->memory;
+    if (mem == NULL) return;
+
+    memory_set_watch_func(mem, memory_watch);
+    for (unsigned int i = 0; i < MEMORY_PAGES; i++) {
+        uint8_t watch = (page_watched(m->breakpoints.read, i) ? MEMORY_WATCH_READ : 0)
+                      | (page_watched(m->breakpoints.write, i) ? MEMORY_WATCH_WRITE : 0);
+        memory_set_watch(mem, i << MEMORY_PAGE_SHIFT, watch);
+    }
+}
+
+static void map_set(uint8_t *map, uint16_t first, uint16_t last)
+{
+    for (uint32_t a = first; a <= last; a++) {
+        map[a >> 3] |= 1 << (a & 7);
+    }
+}
+
+/* Rebuilds the bitmaps and PC hooks from the list. */
+static void rebuild(struct Machine *m)
+{
+    struct MachineBreakpoints *bp = &m->breakpoints;
+    uint8_t exec[0x10000 / 8] = { 0 };
+    uint8_t *maps[BREAK_KIND_COUNT] = { exec, bp->read, bp->write, bp->in, bp->out };
+
+    for (int k = BREAK_READ; k < BREAK_KIND_COUNT; k++) {
+        memset(maps[k], 0, 0x10000 / 8);
+    }
+    bp->watching = false;
+
+    for (int i = 0; i < MACHINE_MAX_BREAKPOINTS; i++) {
+        const struct Breakpoint *b = &bp->list[i];
+        if (!b->used || !b->enabled) continue;
+        map_set(maps[b->kind], b->first, b->last);
+        if (b->kind != BREAK_EXEC) bp->watching = true;
+    }
+
+    cpu_set_pc_hooks(&m->cpu, exec);
+    machine_breakpoints_attach(m);
+}
+
+/* Adds an enabled breakpoint for the given address range.
+ * Returns its id on success, negative otherwise. */
+int machine_breakpoint_add(struct Machine *m, enum BreakpointKind kind,
+                           uint16_t first, uint16_t last,
+                           BreakpointCondFunc cond, BreakpointFunc action, void *data)
+{
+    if (kind >= BREAK_KIND_COUNT || first > last) return -1;
+
+    for (int i = 0; i < MACHINE_MAX_BREAKPOINTS; i++) {
+        struct Breakpoint *b = &m->breakpoints.list[i];
+        if (b->used) continue;
+
+        *b = (struct Breakpoint){
+            .used = true,
+            .enabled = true,
+            .kind = kind,
+            .first = first,
+            .last = last,
+            .cond = cond,
+            .action = action,
+            .data = data,
+        };
+        rebuild(m);
+        return i;
+    }
+
+    dlog(LOG_ERR, "Out of breakpoints");
+    return -2;
+}
+
+void machine_breakpoint_remove(struct Machine *m, int id)
+{
+    if (id < 0 || id >= MACHINE_MAX_BREAKPOINTS) return;
+    m->breakpoints.list[id].used = false;
+    rebuild(m);
+}
+
+void machine_breakpoint_enable(struct Machine *m, int id, bool enable)
+{
+    if (id < 0 || id >= MACHINE_MAX_BREAKPOINTS) return;
+
+    struct Breakpoint *b = &m->breakpoints.list[id];
+    if (b->enabled == enable) return;
+    b->enabled = enable;
+    rebuild(m);
+}
+
+/* Adds a breakpoint which logs its hits from a "kind:first[-last]" string,
+ * kind being one of x, r, w, i or o.
+ * Returns its id on success, negative otherwise. */
+int machine_breakpoint_parse(struct Machine *m, const char *spec)
+{
+    static const char kinds[] = "xrwio";
+
+    const char *k = strchr(kinds, spec[0]);
+    if (spec[0] == 0 || k == NULL || spec[1] != ':') {
+        dlog(LOG_ERR, "Unknown breakpoint \"%s\"", spec);
+        return -1;
+    }
+
+    char *end;
+    long first = strtol(spec + 2, &end, 0);
+    long last = first;
+    if (*end == '-') {
+        last = strtol(end + 1, &end, 0);
+    }
+    if (end == spec + 2 || *end != 0 || first < 0 || last > 0xFFFF || first > last) {
+        dlog(LOG_ERR, "Bad breakpoint address range in \"%s\"", spec);
+        return -1;
+    }
+
+    return machine_breakpoint_add(m, k - kinds, first, last, NULL, NULL, NULL);
+}
+
+/* Runs the execute breakpoints at PC. Called whenever the cpu stops,
+ * they only run if the instruction there is up next. */
+void machine_breakpoints_process(struct Machine *m)
+{
+    struct MachineBreakpoints *bp = &m->breakpoints;
+    Z80_t *cpu = &m->cpu;
+    uint16_t pc = cpu->regs.pc;
+
+    // an interrupt taken first means the instruction isn't up next
+    if (!cpu_has_pc_hook(cpu, pc)
+        || (cpu->interrupt_pending && cpu_can_process_interrupts(cpu))) return;
+    if (bp->exec_frame == m->frames && bp->exec_cycles == cpu->cycles + 1) return;
+
+    bp->exec_frame = m->frames;
+    bp->exec_cycles = cpu->cycles + 1;
+    hit(m, BREAK_EXEC, pc, 0);
+}
+
+/* Slow path of I/O, for ports set in the in or out bitmap. */
+void machine_breakpoints_io(struct Machine *m, uint16_t port, uint8_t value, bool write)
+{
+    hit(m, write ? BREAK_OUT : BREAK_IN, port, value);
+}
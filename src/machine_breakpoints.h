@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MACHINE_MAX_BREAKPOINTS 64
+
+struct Machine;
+
+enum BreakpointKind
+{
+    BREAK_EXEC,     // before the instruction at the address runs
+    BREAK_READ,
+    BREAK_WRITE,
+    BREAK_IN,
+    BREAK_OUT,
+    BREAK_KIND_COUNT,
+};
+
+struct BreakpointHit
+{
+    enum BreakpointKind kind;
+    uint16_t addr;      // PC, memory address or port
+    uint8_t value;      // read or written, zero for BREAK_EXEC
+};
+
+// the action only runs if this returns true
+typedef bool (*BreakpointCondFunc)(struct Machine *m, const struct BreakpointHit *hit, void *data);
+typedef void (*BreakpointFunc)(struct Machine *m, const struct BreakpointHit *hit, void *data);
+
+struct Breakpoint
+{
+    bool used;
+    bool enabled;
+    enum BreakpointKind kind;
+    uint16_t first;
+    uint16_t last;
+    BreakpointCondFunc cond;    // NULL to always run the action
+    BreakpointFunc action;      // NULL to log the hit
+    void *data;
+};
+
+/* Kept across snapshot loads. Execute breakpoints live in the cpu's PC hook
+ * bitmap, the rest in bitmaps of their own, and pages of memory only get
+ * watched if an address on them is. */
+struct MachineBreakpoints
+{
+    struct Breakpoint list[MACHINE_MAX_BREAKPOINTS];
+    uint8_t read[0x10000 / 8];
+    uint8_t write[0x10000 / 8];
+    uint8_t in[0x10000 / 8];
+    uint8_t out[0x10000 / 8];
+    bool watching;          // some memory or I/O breakpoint is enabled
+    // where execute breakpoints were last processed, cycles plus one,
+    // so stopping at the same spot twice doesn't run them twice
+    uint64_t exec_frame;
+    uint64_t exec_cycles;
+};
+
+int machine_breakpoint_add(struct Machine *m, enum BreakpointKind kind,
+                           uint16_t first, uint16_t last,
+                           BreakpointCondFunc cond, BreakpointFunc action, void *data);
+void machine_breakpoint_remove(struct Machine *m, int id);
+void machine_breakpoint_enable(struct Machine *m, int id, bool enable);
+int machine_breakpoint_parse(struct Machine *m, const char *spec);
+void machine_breakpoints_attach(struct Machine *m);
+void machine_breakpoints_process(struct Machine *m);
+void machine_breakpoints_io(struct Machine *m, uint16_t port, uint8_t value, bool write);
+
+static inline bool machine_breakpoint_test(const uint8_t *map, uint16_t addr)
+{
+    return map[addr >> 3] & (1 << (addr & 7));
+}
@@ -0,0 +1,722 @@
+#include "machine_expr.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "machine.h"
+#include "log.h"
+
+/* Breakpoint condition expressions.
+ *
+ * Something like "pc==0x8000 && a>0x10 && (hl)==0" gets parsed once into
+ * bytecode for a small stack machine, which only runs when the breakpoint
+ * it's the condition of gets hit. Operators and their precedence are those
+ * of C, values are integers and comparisons give 0 or 1. Names stand for
+ * registers (a, hl, ix, af', ...), "addr" and "value" of the hit, "frame"
+ * and "cycle". Memory is read with the Z80's own syntax, (nn), (rr) or
+ * (ix+d), or with peek(x) and peek16(x), neither of which touches the
+ * machine's state.
+ *
+ * The pc==n, pc<n, etc. terms of the top level && chain limit which
+ * addresses the expression can be true at, the breakpoint only needs
+ * to cover those. */
+
+#define EXPR_MAX_OPS    256
+#define EXPR_STACK      32
+#define EXPR_MAX_NEST   64
+#define EXPR_MAX_NAME   16
+
+enum ExprOpcode
+{
+    EXPR_PUSH,
+    EXPR_REG8,      // arg is the offset of the register in struct Z80Regs
+    EXPR_REG16,
+    EXPR_BOOL_REG,
+    EXPR_ADDR,
+    EXPR_VALUE,
+    EXPR_FRAME,
+    EXPR_CYCLE,
+    EXPR_PEEK,
+    EXPR_PEEK16,
+    EXPR_NEG,
+    EXPR_NOT,
+    EXPR_CPL,
+    EXPR_MUL,
+    EXPR_DIV,
+    EXPR_MOD,
+    EXPR_ADD,
+    EXPR_SUB,
+    EXPR_SHL,
+    EXPR_SHR,
+    EXPR_LT,
+    EXPR_LE,
+    EXPR_GT,
+    EXPR_GE,
+    EXPR_EQ,
+    EXPR_NE,
+    EXPR_AND,
+    EXPR_XOR,
+    EXPR_OR,
+    EXPR_JZ,        // &&, jumps to arg if the top is 0, pops it otherwise
+    EXPR_JNZ,       // ||, jumps to arg with the top set to 1, pops it otherwise
+    EXPR_BOOL,
+};
+
+struct ExprOp
+{
+    uint8_t code;
+    int32_t arg;
+};
+
+struct MachineExpr
+{
+    bool sync_flags;
+    uint16_t pc_first;
+    uint16_t pc_last;
+    int len;
+    struct ExprOp code[];
+};
+
+#define REG(field) offsetof(struct Z80Regs, field)
+
+static const struct ExprName
+{
+    const char *name;
+    uint8_t code;
+    int32_t arg;
+} names[] = {
+    { "a",      EXPR_REG8,      REG(main.a) },
+    { "f",      EXPR_REG8,      REG(main.f) },
+    { "b",      EXPR_REG8,      REG(main.b) },
+    { "c",      EXPR_REG8,      REG(main.c) },
+    { "d",      EXPR_REG8,      REG(main.d) },
+    { "e",      EXPR_REG8,      REG(main.e) },
+    { "h",      EXPR_REG8,      REG(main.h) },
+    { "l",      EXPR_REG8,      REG(main.l) },
+    { "af",     EXPR_REG16,     REG(main.af) },
+    { "bc",     EXPR_REG16,     REG(main.bc) },
+    { "de",     EXPR_REG16,     REG(main.de) },
+    { "hl",     EXPR_REG16,     REG(main.hl) },
+    { "a'",     EXPR_REG8,      REG(alt.a) },
+    { "f'",     EXPR_REG8,      REG(alt.f) },
+    { "b'",     EXPR_REG8,      REG(alt.b) },
+    { "c'",     EXPR_REG8,      REG(alt.c) },
+    { "d'",     EXPR_REG8,      REG(alt.d) },
+    { "e'",     EXPR_REG8,      REG(alt.e) },
+    { "h'",     EXPR_REG8,      REG(alt.h) },
+    { "l'",     EXPR_REG8,      REG(alt.l) },
+    { "af'",    EXPR_REG16,     REG(alt.af) },
+    { "bc'",    EXPR_REG16,     REG(alt.bc) },
+    { "de'",    EXPR_REG16,     REG(alt.de) },
+    { "hl'",    EXPR_REG16,     REG(alt.hl) },
+    { "ix",     EXPR_REG16,     REG(ix) },
+    { "iy",     EXPR_REG16,     REG(iy) },
+    { "ixh",    EXPR_REG8,      REG(ixh) },
+    { "ixl",    EXPR_REG8,      REG(ixl) },
+    { "iyh",    EXPR_REG8,      REG(iyh) },
+    { "iyl",    EXPR_REG8,      REG(iyl) },
+    { "i",      EXPR_REG8,      REG(i) },
+    { "r",      EXPR_REG8,      REG(r) },
+    { "sp",     EXPR_REG16,     REG(sp) },
+    { "pc",     EXPR_REG16,     REG(pc) },
+    { "memptr", EXPR_REG16,     REG(memptr) },
+    { "im",     EXPR_REG8,      REG(im) },
+    { "iff1",   EXPR_BOOL_REG,  REG(iff1) },
+    { "iff2",   EXPR_BOOL_REG,  REG(iff2) },
+    { "addr",   EXPR_ADDR,      0 },
+    { "value",  EXPR_VALUE,     0 },
+    { "frame",  EXPR_FRAME,     0 },
+    { "cycle",  EXPR_CYCLE,     0 },
+};
+
+// registers which (rr) and (rr+d) read memory through
+static const char *indirect_names[] = { "bc", "de", "hl", "sp", "ix", "iy" };
+
+struct ExprBinary
+{
+    const char *op;
+    uint8_t code;
+};
+
+// from the lowest precedence up, || and && are handled separately
+static const struct ExprBinary binary_levels[][4] = {
+    { { "|", EXPR_OR } },
+    { { "^", EXPR_XOR } },
+    { { "&", EXPR_AND } },
+    { { "==", EXPR_EQ }, { "!=", EXPR_NE } },
+    { { "<", EXPR_LT }, { "<=", EXPR_LE }, { ">", EXPR_GT }, { ">=", EXPR_GE } },
+    { { "<<", EXPR_SHL }, { ">>", EXPR_SHR } },
+    { { "+", EXPR_ADD }, { "-", EXPR_SUB } },
+    { { "*", EXPR_MUL }, { "/", EXPR_DIV }, { "%", EXPR_MOD } },
+};
+
+#define BINARY_LEVELS (int)(sizeof(binary_levels) / sizeof(binary_levels[0]))
+
+enum ExprToken
+{
+    TOK_END,
+    TOK_NUM,
+    TOK_NAME,
+    TOK_OP,
+};
+
+struct ExprLexer
+{
+    const char *p;          // right past the current token
+    const char *start;
+    int len;
+    enum ExprToken tok;
+    int64_t value;
+    char name[EXPR_MAX_NAME];
+};
+
+struct ExprParser
+{
+    const char *src;
+    struct ExprLexer lex;
+    struct ExprOp code[EXPR_MAX_OPS];
+    int len;
+    int depth;
+    int nest;
+    bool error;
+    bool sync_flags;
+    bool any_pc;            // the top level is an || of terms
+    int64_t pc_first;
+    int64_t pc_last;
+};
+
+static void error(struct ExprParser *p, const char *msg)
+{
+    if (!p->error) {
+        dlog(LOG_ERRSILENT, "Expression \"%s\", column %d: %s",
+                            p->src, (int)(p->lex.start - p->src) + 1, msg);
+    }
+    p->error = true;
+    p->lex.tok = TOK_END;
+}
+
+static void next(struct ExprParser *p)
+{
+    struct ExprLexer *lex = &p->lex;
+    const char *s = lex->p;
+    while (*s == ' ' || *s == '\t') s++;
+    lex->start = s;
+
+    if (*s == 0) {
+        lex->tok = TOK_END;
+        lex->len = 0;
+        lex->p = s;
+        return;
+    }
+
+    if (isdigit((unsigned char)*s) || *s == '$') {
+        int base = 10;
+        const char *digits = s;
+        if (*s == '$') {
+            base = 16;
+            digits++;
+        } else if (s[0] == '0' && tolower((unsigned char)s[1]) == 'x') {
+            base = 16;
+            digits += 2;
+        }
+
+        char *end = (char *)digits;
+        unsigned long long value = 0;
+        if (isxdigit((unsigned char)*digits)) {
+            value = strtoull(digits, &end, base);
+        }
+        if (end == digits || isalnum((unsigned char)*end) || *end == '_') {
+            error(p, "bad number");
+            return;
+        }
+        if (value > INT32_MAX) {
+            error(p, "number out of range");
+            return;
+        }
+
+        lex->tok = TOK_NUM;
+        lex->value = value;
+        lex->len = end - s;
+        lex->p = end;
+        return;
+    }
+
+    if (isalpha((unsigned char)*s) || *s == '_') {
+        const char *e = s;
+        while (isalnum((unsigned char)*e) || *e == '_') e++;
+        if (*e == '\'') e++;
+        if (e - s >= EXPR_MAX_NAME) {
+            error(p, "name too long");
+            return;
+        }
+
+        for (int i = 0; i < e - s; i++) {
+            lex->name[i] = tolower((unsigned char)s[i]);
+        }
+        lex->name[e - s] = 0;
+        lex->tok = TOK_NAME;
+        lex->len = e - s;
+        lex->p = e;
+        return;
+    }
+
+    static const char *ops2[] = { "||", "&&", "==", "!=", "<=", ">=", "<<", ">>" };
+    lex->tok = TOK_OP;
+    lex->p = s + 1;
+    lex->len = 1;
+    for (size_t i = 0; i < sizeof(ops2) / sizeof(ops2[0]); i++) {
+        if (strncmp(s, ops2[i], 2) == 0) {
+            lex->p = s + 2;
+            lex->len = 2;
+            return;
+        }
+    }
+    if (strchr("|^&<>+-*/%!~()", *s) == NULL) {
+        error(p, "unexpected character");
+    }
+}
+
+static bool is_op(const struct ExprParser *p, const char *op)
+{
+    return p->lex.tok == TOK_OP && p->lex.len == (int)strlen(op)
+           && strncmp(p->lex.start, op, p->lex.len) == 0;
+}
+
+static bool accept(struct ExprParser *p, const char *op)
+{
+    if (!is_op(p, op)) return false;
+    next(p);
+    return true;
+}
+
+static void expect(struct ExprParser *p, const char *op)
+{
+    if (!accept(p, op)) {
+        error(p, op[0] == ')' ? "missing )" : "syntax error");
+    }
+}
+
+static int emit(struct ExprParser *p, uint8_t code, int32_t arg)
+{
+    if (p->error) return -1;
+    if (p->len >= EXPR_MAX_OPS) {
+        error(p, "expression too long");
+        return -1;
+    }
+
+    switch (code) {
+    case EXPR_PUSH:
+    case EXPR_REG8:
+    case EXPR_REG16:
+    case EXPR_BOOL_REG:
+    case EXPR_ADDR:
+    case EXPR_VALUE:
+    case EXPR_FRAME:
+    case EXPR_CYCLE:
+        if (++p->depth > EXPR_STACK) {
+            error(p, "expression too complex");
+            return -1;
+        }
+        break;
+    case EXPR_PEEK:
+    case EXPR_PEEK16:
+    case EXPR_NEG:
+    case EXPR_NOT:
+    case EXPR_CPL:
+    case EXPR_BOOL:
+        break;
+    default:
+        // binary operators, and the jumps pop on the path that falls through
+        p->depth--;
+        break;
+    }
+
+    if ((code == EXPR_REG8 || code == EXPR_REG16) && arg == REG(main.f)) {
+        p->sync_flags = true;
+    }
+
+    p->code[p->len] = (struct ExprOp){ .code = code, .arg = arg };
+    return p->len++;
+}
+
+static void parse_or(struct ExprParser *p, bool top);
+
+static const struct ExprName *find_name(const char *name)
+{
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(names[i].name, name) == 0) return &names[i];
+    }
+    return NULL;
+}
+
+/* Tries to parse the inside of (nn), (rr) or (rr+d), right after the
+ * opening parenthesis. Leaves the lexer alone if it's anything else. */
+static bool parse_indirect(struct ExprParser *p)
+{
+    struct ExprLexer save = p->lex;
+    const struct ExprName *reg = NULL;
+    int64_t value = 0;
+
+    if (p->lex.tok == TOK_NUM) {
+        value = p->lex.value;
+    } else if (p->lex.tok == TOK_NAME) {
+        for (size_t i = 0; i < sizeof(indirect_names) / sizeof(indirect_names[0]); i++) {
+            if (strcmp(p->lex.name, indirect_names[i]) == 0) {
+                reg = find_name(p->lex.name);
+            }
+        }
+    }
+    if (reg == NULL && p->lex.tok != TOK_NUM) return false;
+    next(p);
+
+    uint8_t offset_op = EXPR_ADD;
+    int64_t offset = 0;
+    if (reg != NULL && (is_op(p, "+") || is_op(p, "-"))) {
+        offset_op = is_op(p, "+") ? EXPR_ADD : EXPR_SUB;
+        next(p);
+        if (p->lex.tok != TOK_NUM) goto not_indirect;
+        offset = p->lex.value;
+        next(p);
+    }
+    if (!is_op(p, ")")) goto not_indirect;
+    next(p);
+
+    if (reg != NULL) {
+        emit(p, reg->code, reg->arg);
+        if (offset != 0) {
+            emit(p, EXPR_PUSH, offset);
+            emit(p, offset_op, 0);
+        }
+    } else {
+        emit(p, EXPR_PUSH, value);
+    }
+    emit(p, EXPR_PEEK, 0);
+    return true;
+
+not_indirect:
+    if (p->error) return true;
+    p->lex = save;
+    return false;
+}
+
+static void parse_primary(struct ExprParser *p)
+{
+    if (p->lex.tok == TOK_NUM) {
+        emit(p, EXPR_PUSH, p->lex.value);
+        next(p);
+        return;
+    }
+
+    if (p->lex.tok == TOK_NAME) {
+        bool peek = strcmp(p->lex.name, "peek") == 0;
+        bool peek16 = strcmp(p->lex.name, "peek16") == 0;
+        if (peek || peek16) {
+            next(p);
+            expect(p, "(");
+            parse_or(p, false);
+            expect(p, ")");
+            emit(p, peek ? EXPR_PEEK : EXPR_PEEK16, 0);
+            return;
+        }
+
+        const struct ExprName *n = find_name(p->lex.name);
+        if (n == NULL) {
+            error(p, "unknown name");
+            return;
+        }
+        emit(p, n->code, n->arg);
+        next(p);
+        return;
+    }
+
+    if (accept(p, "(")) {
+        if (parse_indirect(p)) return;
+        if (++p->nest > EXPR_MAX_NEST) {
+            error(p, "too many parentheses");
+            return;
+        }
+        parse_or(p, false);
+        p->nest--;
+        expect(p, ")");
+        return;
+    }
+
+    error(p, p->lex.tok == TOK_END ? "unexpected end" : "expected a value");
+}
+
+static void parse_unary(struct ExprParser *p)
+{
+    uint8_t code;
+    if (is_op(p, "-")) {
+        code = EXPR_NEG;
+    } else if (is_op(p, "!")) {
+        code = EXPR_NOT;
+    } else if (is_op(p, "~")) {
+        code = EXPR_CPL;
+    } else {
+        parse_primary(p);
+        return;
+    }
+
+    if (++p->nest > EXPR_MAX_NEST) {
+        error(p, "too many unary operators");
+        return;
+    }
+    next(p);
+    parse_unary(p);
+    p->nest--;
+    emit(p, code, 0);
+}
+
+static void parse_binary(struct ExprParser *p, int level)
+{
+    if (level == BINARY_LEVELS) {
+        parse_unary(p);
+        return;
+    }
+
+    parse_binary(p, level + 1);
+    for (;;) {
+        const struct ExprBinary *b = NULL;
+        for (int i = 0; i < 4 && binary_levels[level][i].op != NULL; i++) {
+            if (is_op(p, binary_levels[level][i].op)) b = &binary_levels[level][i];
+        }
+        if (b == NULL) return;
+
+        next(p);
+        parse_binary(p, level + 1);
+        emit(p, b->code, 0);
+    }
+}
+
+/* Narrows the addresses the expression can be true at,
+ * if the code from start on compares pc with a number. */
+static void narrow_pc(struct ExprParser *p, int start)
+{
+    if (p->error || p->len - start != 3) return;
+
+    const struct ExprOp *c = &p->code[start];
+    uint8_t cmp = c[2].code;
+    int64_t n;
+    if (c[0].code == EXPR_REG16 && c[0].arg == REG(pc) && c[1].code == EXPR_PUSH) {
+        n = c[1].arg;
+    } else if (c[0].code == EXPR_PUSH && c[1].code == EXPR_REG16 && c[1].arg == REG(pc)) {
+        n = c[0].arg;
+        // n < pc is pc > n, and so on
+        switch (cmp) {
+        case EXPR_LT: cmp = EXPR_GT; break;
+        case EXPR_LE: cmp = EXPR_GE; break;
+        case EXPR_GT: cmp = EXPR_LT; break;
+        case EXPR_GE: cmp = EXPR_LE; break;
+        }
+    } else {
+        return;
+    }
+
+    int64_t first = 0, last = 0xFFFF;
+    switch (cmp) {
+    case EXPR_EQ: first = last = n; break;
+    case EXPR_LT: last = n - 1; break;
+    case EXPR_LE: last = n; break;
+    case EXPR_GT: first = n + 1; break;
+    case EXPR_GE: first = n; break;
+    default: return;
+    }
+
+    if (first > p->pc_first) p->pc_first = first;
+    if (last < p->pc_last) p->pc_last = last;
+}
+
+static void parse_and(struct ExprParser *p, bool top)
+{
+    int start = p->len;
+    parse_binary(p, 0);
+    if (top) narrow_pc(p, start);
+    if (!is_op(p, "&&")) return;
+
+    // the jumps are chained through their args until the end is known
+    int chain = -1;
+    while (accept(p, "&&")) {
+        chain = emit(p, EXPR_JZ, chain);
+        start = p->len;
+        parse_binary(p, 0);
+        if (top) narrow_pc(p, start);
+    }
+    emit(p, EXPR_BOOL, 0);
+
+    while (!p->error && chain >= 0) {
+        int prev = p->code[chain].arg;
+        p->code[chain].arg = p->len;
+        chain = prev;
+    }
+}
+
+static void parse_or(struct ExprParser *p, bool top)
+{
+    parse_and(p, top);
+    if (!is_op(p, "||")) return;
+
+    if (top) p->any_pc = true;
+    int chain = -1;
+    while (accept(p, "||")) {
+        chain = emit(p, EXPR_JNZ, chain);
+        parse_and(p, false);
+    }
+    emit(p, EXPR_BOOL, 0);
+
+    while (!p->error && chain >= 0) {
+        int prev = p->code[chain].arg;
+        p->code[chain].arg = p->len;
+        chain = prev;
+    }
+}
+
+/* Returns the compiled expression on success, NULL otherwise.
+ * Needs to be freed with machine_expr_free(). */
+struct MachineExpr *machine_expr_compile(const char *src)
+{
+    struct ExprParser p = {
+        .src = src,
+        .lex = { .p = src, .start = src },
+        .pc_first = 0,
+        .pc_last = 0xFFFF,
+    };
+
+    next(&p);
+    parse_or(&p, true);
+    if (p.lex.tok != TOK_END) {
+        error(&p, "unexpected input");
+    }
+    if (p.error) return NULL;
+
+    if (p.any_pc) {
+        p.pc_first = 0;
+        p.pc_last = 0xFFFF;
+    }
+    if (p.pc_first > p.pc_last || p.pc_first > 0xFFFF || p.pc_last < 0) {
+        dlog(LOG_ERRSILENT, "Expression \"%s\" can't be true at any pc", src);
+        return NULL;
+    }
+
+    struct MachineExpr *e = malloc(sizeof(*e) + p.len * sizeof(struct ExprOp));
+    if (e == NULL) {
+        dlog(LOG_ERRSILENT, "%s: malloc fail", __func__);
+        return NULL;
+    }
+    e->sync_flags = p.sync_flags;
+    e->pc_first = p.pc_first;
+    e->pc_last = p.pc_last;
+    e->len = p.len;
+    memcpy(e->code, p.code, p.len * sizeof(struct ExprOp));
+    return e;
+}
+
+void machine_expr_free(struct MachineExpr *e)
+{
+    free(e);
+}
+
+/* Gets the range of pc the expression can be true at.
+ * Returns 0 if it's narrower than all of memory, negative otherwise. */
+int machine_expr_pc_range(const struct MachineExpr *e, uint16_t *first, uint16_t *last)
+{
+    *first = e->pc_first;
+    *last = e->pc_last;
+    return (e->pc_first == 0 && e->pc_last == 0xFFFF) ? -1 : 0;
+}
+
+/* The hit may be NULL, addr and value are 0 then. */
+int64_t machine_expr_eval(struct Machine *m, const struct MachineExpr *e,
+                          const struct BreakpointHit *hit)
+{
+    const uint8_t *regs = (const uint8_t *)&m->cpu.regs;
+    int64_t stack[EXPR_STACK];
+    int sp = 0;
+
+    if (e->sync_flags) {
+        cpu_sync_flags(&m->cpu);
+    }
+
+    for (int i = 0; i < e->len; i++) {
+        const struct ExprOp *op = &e->code[i];
+        int64_t *top = &stack[sp > 0 ? sp - 1 : 0];
+        int64_t b;
+        uint16_t v16;
+
+        switch (op->code) {
+        case EXPR_PUSH:     stack[sp++] = op->arg; break;
+        case EXPR_REG8:     stack[sp++] = regs[op->arg]; break;
+        case EXPR_REG16:
+            memcpy(&v16, regs + op->arg, sizeof(v16));
+            stack[sp++] = v16;
+            break;
+        case EXPR_BOOL_REG: stack[sp++] = *(const bool *)(regs + op->arg); break;
+        case EXPR_ADDR:     stack[sp++] = hit != NULL ? hit->addr : 0; break;
+        case EXPR_VALUE:    stack[sp++] = hit != NULL ? hit->value : 0; break;
+        case EXPR_FRAME:    stack[sp++] = m->frames; break;
+        case EXPR_CYCLE:    stack[sp++] = m->cpu.cycles; break;
+
+        case EXPR_PEEK:
+            *top = memory_bus_peek(m->memory, *top);
+            break;
+        case EXPR_PEEK16:
+            *top = memory_bus_peek(m->memory, *top)
+                   | memory_bus_peek(m->memory, *top + 1) << 8;
+            break;
+        case EXPR_NEG:      *top = -(uint64_t)*top; break;
+        case EXPR_NOT:      *top = !*top; break;
+        case EXPR_CPL:      *top = ~*top; break;
+        case EXPR_BOOL:     *top = *top != 0; break;
+
+        case EXPR_JZ:
+            if (*top == 0) {
+                i = op->arg - 1;
+            } else {
+                sp--;
+            }
+            break;
+        case EXPR_JNZ:
+            if (*top != 0) {
+                *top = 1;
+                i = op->arg - 1;
+            } else {
+                sp--;
+            }
+            break;
+
+        default:
+            // binary operators, b is the right hand side
+            b = stack[--sp];
+            top = &stack[sp - 1];
+            switch (op->code) {
+            case EXPR_MUL:  *top = (uint64_t)*top * (uint64_t)b; break;
+            case EXPR_DIV:
+                // x / 0 is 0, and x / -1 spelled out to not trap on the minimum
+                *top = b == 0 ? 0 : b == -1 ? (int64_t)-(uint64_t)*top : *top / b;
+                break;
+            case EXPR_MOD:  *top = (b == 0 || b == -1) ? 0 : *top % b; break;
+            case EXPR_ADD:  *top = (uint64_t)*top + (uint64_t)b; break;
+            case EXPR_SUB:  *top = (uint64_t)*top - (uint64_t)b; break;
+            case EXPR_SHL:  *top = (uint64_t)*top << (b & 63); break;
+            case EXPR_SHR:  *top = *top >> (b & 63); break;
+            case EXPR_LT:   *top = *top < b; break;
+            case EXPR_LE:   *top = *top <= b; break;
+            case EXPR_GT:   *top = *top > b; break;
+            case EXPR_GE:   *top = *top >= b; break;
+            case EXPR_EQ:   *top = *top == b; break;
+            case EXPR_NE:   *top = *top != b; break;
+            case EXPR_AND:  *top &= b; break;
+            case EXPR_XOR:  *top ^= b; break;
+            case EXPR_OR:   *top |= b; break;
+            }
+            break;
+        }
+    }
+
+    return stack[0];
+}
+
+bool machine_expr_cond(struct Machine *m, const struct BreakpointHit *hit, void *data)
+{
+    return machine_expr_eval(m, data, hit) != 0;
+}
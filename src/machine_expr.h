@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "machine_breakpoints.h"
+
+struct Machine;
+struct MachineExpr;
+
+struct MachineExpr *machine_expr_compile(const char *src);
+void machine_expr_free(struct MachineExpr *e);
+int64_t machine_expr_eval(struct Machine *m, const struct MachineExpr *e,
+                          const struct BreakpointHit *hit);
+int machine_expr_pc_range(const struct MachineExpr *e, uint16_t *first, uint16_t *last);
+
+// BreakpointCondFunc taking the compiled expression as its data
+bool machine_expr_cond(struct Machine *m, const struct BreakpointHit *hit, void *data);
@@ -13,8 +13,6 @@ const KeyboardMacro_t macro_tapeload[6] = {
     { 25, KBMACRO_KEY, 30 }, // ENTER
 };
 
-static FILE *out_stream = NULL;
-
 static void putc_zx(uint8_t ch, FILE *f)
 {
     if (!f) return;
@@ -52,49 +50,95 @@ static void putc_zx(uint8_t ch, FILE *f)
     fputs(s, f);
 }
 
-void machine_set_print_stream(FILE *f)
+void machine_set_print_stream(struct Machine *m, FILE *f)
 {
-    out_stream = f;
+    m->hooks.print_stream = f;
 }
 
-void machine_process_hooks(struct Machine *m)
+// waiting for a key in the editor with a tape inserted, type LOAD ""
+static bool key_wait_cond(struct Machine *m, const struct BreakpointHit *hit, void *data)
 {
-    static bool inside_tape_routine = false;
-    static bool tape_macro_handled = false;
+    (void)hit;
+    (void)data;
+    return m->player != NULL && m->player->position == 0;
+}
 
-    if (m->cpu.interrupt_pending) {
-        return;
+static void key_wait_hit(struct Machine *m, const struct BreakpointHit *hit, void *data)
+{
+    (void)hit;
+    (void)data;
+    if (!m->hooks.tape_macro_handled) {
+        keyboard_macro_play(&m->macro, macro_tapeload,
+                            sizeof(macro_tapeload) / sizeof(KeyboardMacro_t));
+        m->hooks.tape_macro_handled = true;
     }
+}
 
-    uint16_t pc = m->cpu.regs.pc;
+// LD-BYTES, play the tape while the ROM is loading from it
+static void ld_bytes_hit(struct Machine *m, const struct BreakpointHit *hit, void *data)
+{
+    (void)hit;
+    (void)data;
+    m->hooks.tape_macro_handled = false;
+    m->hooks.inside_tape_routine = true;
+    if (m->frontend) {
+        video_sdl_set_fps_limit(false);
+    }
+    tape_player_pause(m->player, false);
+}
 
-    if (pc == 0x15DE && m->player != NULL && m->player->position == 0) {
-        if (!tape_macro_handled) {
-            keyboard_macro_play(
-                macro_tapeload, sizeof(macro_tapeload) / sizeof(KeyboardMacro_t));
-            tape_macro_handled = true;
-        }
+// PRINT-OUT, unless it's printing into the lower screen
+static void print_hit(struct Machine *m, const struct BreakpointHit *hit, void *data)
+{
+    (void)hit;
+    (void)data;
+    uint8_t tv_flag, flags2;
+    memory_read(m, m->cpu.regs.iy + 0x02, &tv_flag);
+    memory_read(m, m->cpu.regs.iy + 0x30, &flags2);
+    if (!(flags2 & (1<<4)) && !(tv_flag & 1)) {
+        putc_zx(m->cpu.regs.main.a, m->hooks.print_stream);
     }
+}
 
-    if (pc == 0x0556) {
-        tape_macro_handled = false;
-        inside_tape_routine = true;
-        video_sdl_set_fps_limit(false);
-        tape_player_pause(m->player, false);
+/* Registers the ROM routines as execute breakpoints,
+ * needs to be called again whenever a tape gets inserted. */
+void machine_hooks_register(struct Machine *m)
+{
+    struct MachineHooks *h = &m->hooks;
+    if (!h->registered) {
+        h->key_wait = machine_breakpoint_add(m, BREAK_EXEC, 0x15DE, 0x15DE,
+                                             key_wait_cond, key_wait_hit, NULL);
+        h->ld_bytes = machine_breakpoint_add(m, BREAK_EXEC, 0x0556, 0x0556,
+                                             NULL, ld_bytes_hit, NULL);
+        h->print = machine_breakpoint_add(m, BREAK_EXEC, 0x09F4, 0x09F4,
+                                          NULL, print_hit, NULL);
+        h->registered = true;
     }
 
-    if (inside_tape_routine && (pc < 0x0556 || pc >= 0x0605)) {
-        inside_tape_routine = false;
-        video_sdl_set_fps_limit(true);
-        tape_player_pause(m->player, true);
+    // the key wait loop only needs to be seen with a tape to load,
+    // and would otherwise keep it from being skipped as idle
+    machine_breakpoint_enable(m, h->key_wait, m->player != NULL);
+}
+
+/* Leaving the tape routine can happen anywhere,
+ * so it needs to be checked after every instruction. */
+bool machine_hooks_need_step(const struct Machine *m)
+{
+    return m->hooks.inside_tape_routine;
+}
+
+void machine_process_hooks(struct Machine *m)
+{
+    if (!m->hooks.inside_tape_routine || m->cpu.interrupt_pending) {
+        return;
     }
 
-    if (pc == 0x09F4) {
-        uint8_t tv_flag, flags2;
-        memory_read(m, m->cpu.regs.iy + 0x02, &tv_flag);
-        memory_read(m, m->cpu.regs.iy + 0x30, &flags2);
-        if (!(flags2 & (1<<4)) && !(tv_flag & 1)) {
-            putc_zx(m->cpu.regs.main.a, out_stream);
+    uint16_t pc = m->cpu.regs.pc;
+    if (pc < 0x0556 || pc >= 0x0605) {
+        m->hooks.inside_tape_routine = false;
+        if (m->frontend) {
+            video_sdl_set_fps_limit(true);
         }
+        tape_player_pause(m->player, true);
     }
 }
@@ -1,8 +1,22 @@
 #pragma once
 
 #include <stdio.h>
+#include <stdbool.h>
 
 struct Machine;
 
-void machine_set_print_stream(FILE *f);
+struct MachineHooks
+{
+    bool registered;
+    int key_wait;           // breakpoint ids
+    int ld_bytes;
+    int print;
+    FILE *print_stream;
+    bool inside_tape_routine;
+    bool tape_macro_handled;
+};
+
+void machine_set_print_stream(struct Machine *m, FILE *f);
+void machine_hooks_register(struct Machine *m);
+bool machine_hooks_need_step(const struct Machine *m);
 void machine_process_hooks(struct Machine *m);
@@ -0,0 +1,143 @@
+#include "machine_idle.h"
+#include <string.h>
+#include "machine.h"
+#include "ula.h"
+
+#define IDLE_MAX_OPS    32
+#define IDLE_MAX_PAGES  4
+
+/* Idle loop detection.
+ *
+ * Every now and then the machine lets machine_idle_skip() run two
+ * iterations of whatever loop the cpu may be spinning in. If the second
+ * one ends with the same registers (other than R) and the same memory
+ * contents as the first, without any I/O but reading the keyboard, the
+ * machine is at a fixed point: nothing a further iteration reads can change
+ * before the next event, so each one is bound to do exactly the same.
+ * These get skipped in bulk. The contention lookups recorded during the
+ * second iteration are replayed at the start time of each skipped one,
+ * which gives the exact amount of cycles it would have taken, and R
+ * advances by the same amount every iteration. */
+
+struct IdleIteration {
+    struct Z80Regs regs;
+    uint32_t page_gen[0x100];
+};
+
+static void idle_save(struct Machine *m, struct IdleIteration *it)
+{
+    cpu_sync_flags(&m->cpu);
+    memcpy(&it->regs, &m->cpu.regs, sizeof(it->regs));
+    memcpy(it->page_gen, m->memory->page_gen, sizeof(it->page_gen));
+}
+
+/* Runs the cpu until PC returns to head.
+ * Returns zero if it did so without doing anything that can't be skipped. */
+static int idle_iterate(struct Machine *m, uint16_t head, uint64_t deadline)
+{
+    Z80_t *cpu = &m->cpu;
+    bool last_ei = cpu->last_ei;
+    bool reads_r = false;
+
+    m->idle.side_effect = false;
+
+    int ops = 0;
+    do {
+        // ld a, r is the only way for R to leak into anything else
+        uint16_t pc = cpu->regs.pc;
+        reads_r |= memory_bus_peek(m->memory, pc) == 0xED
+                   && memory_bus_peek(m->memory, pc + 1) == 0x5F;
+
+        cpu_do_cycles(cpu);
+        ops++;
+    } while (cpu->regs.pc != head && ops < IDLE_MAX_OPS
+             && !cpu->error && !cpu->halted && !m->idle.side_effect
+             && cpu->cycles < deadline && !cpu_has_pc_hook(cpu, cpu->regs.pc));
+
+    if (cpu->regs.pc != head || cpu->error || cpu->halted || m->idle.side_effect
+        || reads_r || cpu->last_ei != last_ei || cpu->cycles >= deadline) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Tries to fast-forward the cpu through an idle loop, up to the deadline.
+ * Executes up to two iterations of the loop as usual first. */
+void machine_idle_skip(struct Machine *m, uint64_t deadline)
+{
+    Z80_t *cpu = &m->cpu;
+    uint16_t head = cpu->regs.pc;
+
+    if (cpu->error || cpu->halted || cpu->interrupt_pending
+        || cpu->prefix_state != STATE_NOPREFIX || cpu_has_pc_hook(cpu, head)
+        || m->breakpoints.watching) {
+        return;
+    }
+
+    struct IdleIteration first, second;
+
+    // the first iteration finds the pages the loop writes to
+    idle_save(m, &first);
+    if (idle_iterate(m, head, deadline)) return;
+
+    uint8_t pages[IDLE_MAX_PAGES];
+    uint8_t contents[IDLE_MAX_PAGES][0x100];
+    int page_count = 0;
+
+    for (int i = 0; i < 0x100; i++) {
+        if (m->memory->page_gen[i] == first.page_gen[i]) continue;
+        if (page_count == IDLE_MAX_PAGES) return;
+        pages[page_count] = i;
+        memcpy(contents[page_count], memory_host_ptr(m->memory, i << 8), 0x100);
+        page_count++;
+    }
+
+    // the second one has to leave everything as it was after the first
+    idle_save(m, &first);
+    uint64_t start = cpu->cycles;
+    struct UlaContentionTrace trace = { .base = start };
+
+    ula_trace_contention(&m->ula, &trace);
+    memory_trace_contention(m->memory, true);
+    int err = idle_iterate(m, head, deadline);
+    memory_trace_contention(m->memory, false);
+    ula_trace_contention(&m->ula, NULL);
+
+    if (err || trace.overflow) return;
+
+    idle_save(m, &second);
+    uint8_t r_step = (second.regs.r - first.regs.r) & 127;
+    first.regs.r = second.regs.r;
+    if (memcmp(&first.regs, &second.regs, sizeof(first.regs)) != 0) return;
+
+    int written = 0;
+    for (int i = 0; i < 0x100; i++) {
+        written += second.page_gen[i] != first.page_gen[i];
+    }
+    for (int i = 0; i < page_count; i++) {
+        written -= second.page_gen[pages[i]] != first.page_gen[pages[i]];
+        if (memcmp(contents[i], memory_host_ptr(m->memory, pages[i] << 8), 0x100) != 0) return;
+    }
+    if (written != 0) return;
+
+    m->idle.loops_found++;
+
+    uint64_t length = cpu->cycles - start - trace.total;
+    uint64_t t = cpu->cycles;
+    uint64_t iterations = 0;
+
+    for (;;) {
+        uint64_t contention = ula_trace_replay(&m->ula, &trace, t);
+        if (t + length + contention > deadline) break;
+        t += length + contention;
+        iterations++;
+    }
+
+    if (iterations == 0) return;
+
+    m->idle.skipped_iterations += iterations;
+    m->idle.skipped_cycles += t - cpu->cycles;
+
+    cpu->cycles = t;
+    cpu->regs.r = (cpu->regs.r & (1<<7)) | ((cpu->regs.r + iterations * r_step) & 127);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// how often the cpu gets stopped to look for idle loops, in T-states
+#define MACHINE_IDLE_PROBE_INTERVAL 2048
+
+struct Machine;
+
+struct MachineIdle
+{
+    bool enabled;
+    bool side_effect;   // set by I/O that can't be skipped over
+    uint64_t loops_found;
+    uint64_t skipped_iterations;
+    uint64_t skipped_cycles;
+};
+
+void machine_idle_skip(struct Machine *m, uint64_t deadline);
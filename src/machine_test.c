@@ -2,8 +2,14 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_cpuinfo.h>
+#include <SDL3/SDL_error.h>
+#include <SDL3/SDL_thread.h>
+#include <SDL3/SDL_timer.h>
 #include "machine.h"
 #include "machine_hooks.h"
+#include "machine_expr.h"
 #include "file.h"
 #include "config_parser.h"
 #include "log.h"
@@ -12,6 +18,10 @@
 #include "vector.h"
 #include "video_sdl.h"
 
+#ifdef _WIN32
+    #include <malloc.h>
+#endif
+
 #define XXH_INLINE_ALL
 #include <xxhash.h>
 
@@ -19,47 +29,156 @@ enum StopCondition
 {
     STOP_BREAKPOINT,
     STOP_FRAME,
+    STOP_EXPR,
 };
 
 const char *condition_str[] = {
     "breakpoint",
     "frame",
+    "expr",
 };
 
 struct MachineTest
 {
     char *dir;
+    char *variant;      // "x" for sleepdart-test-x.ini, NULL for sleepdart-test.ini
     enum StopCondition stop_condition;
     int stop_value;
+    struct MachineExpr *stop_expr;
+    int stop_breakpoint;
     bool test_docflags;
     bool test_allflags;
     bool test_registers;
     bool test_cycles;
     bool test_print;
+    bool test_prefixes;
+    uint64_t prefix_start;
     XXH64_state_t *docflags;
     XXH64_state_t *allflags;
     XXH64_state_t *registers;
     XXH64_state_t *cycles;
     FILE *print;
     KeyboardMacro_t *macro;
+    bool stop_reached;
+    bool running;
+    bool finished;
+    bool passed;
+    char results[256];  // hashes and print outcome, for --test-all
 };
 
-static struct CfgField test_fields[] = {
+// copied for every test, the parser keeps the values in the fields
+static const struct CfgField test_fields[] = {
     { "file",           CFG_STR, NULL },
     { "stop-condition", CFG_STR, NULL },
-    { "stop-value",     CFG_INT, NULL },
+    { "stop-value",     CFG_STR, NULL },
     { "scope",          CFG_STR, NULL },
     { "macro",          CFG_STR, NULL },
+    { "duration",       CFG_INT, NULL },
+    { "split-prefixes", CFG_INT, NULL },
 };
 
-static CfgData_t testcfg = {
-    .data = test_fields,
-    .len = sizeof(test_fields) / sizeof(struct CfgField)
-};
+#define TEST_FIELDS_LEN (sizeof(test_fields) / sizeof(struct CfgField))
+
+static int test_config_load(CfgData_t *cfg, struct CfgField *fields, char *ini)
+{
+    memcpy(fields, test_fields, sizeof(test_fields));
+    cfg->data = fields;
+    cfg->len = TEST_FIELDS_LEN;
+
+    int err = config_load_file(cfg, ini);
+    if (err) {
+        dlog(LOG_ERRSILENT, "Failed to open test file \"%s\"", ini);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* The name of a sleepdart-test-<name>.ini variant, or NULL if file isn't one.
+ * Variants share the directory, and with it the files, of the default test. */
+static char *test_variant_name(const char *file)
+{
+    static const char prefix[] = "sleepdart-test-";
+    static const char suffix[] = ".ini";
+    size_t len = strlen(file);
+    size_t prefix_len = sizeof(prefix) - 1;
+    size_t suffix_len = sizeof(suffix) - 1;
+    if (len <= prefix_len + suffix_len || strncmp(file, prefix, prefix_len)
+        || strcmp(&file[len - suffix_len], suffix)) {
+        return NULL;
+    }
 
-static bool test_running = false;
-static bool test_passed = true;
-static struct MachineTest test = { 0 };
+    size_t name_len = len - prefix_len - suffix_len;
+    char *name = malloc(name_len + 1);
+    if (name) {
+        memcpy(name, &file[prefix_len], name_len);
+        name[name_len] = 0;
+    }
+    return name;
+}
+
+/* Splits a test path, either a directory or a variant .ini in one, into
+ * the directory and the .ini to load. Returns the variant, NULL if none. */
+static int test_split_path(const char *path, char *dir, char *ini, size_t len,
+                           char **variant)
+{
+    *variant = NULL;
+    char *ext = file_get_extension((char *)path);
+    if (ext == NULL || strcmp(ext, "ini")) {
+        snprintf(dir, len, "%s", path);
+        file_path_append(ini, path, "sleepdart-test.ini", len);
+        return 0;
+    }
+
+    const char *file = path + strlen(path);
+    while (file > path && !file_is_directory_separator(file[-1])) {
+        file--;
+    }
+    snprintf(dir, len, "%.*s", (int)(file - path), path);
+    if (dir[0] == 0) {
+        snprintf(dir, len, ".");
+    }
+    snprintf(ini, len, "%s", path);
+
+    if (strcmp(file, "sleepdart-test.ini") == 0) {
+        return 0;
+    }
+    *variant = test_variant_name(file);
+    if (*variant == NULL) {
+        dlog(LOG_ERRSILENT, "Test file \"%s\" isn't named sleepdart-test[-<name>].ini", path);
+        return -1;
+    }
+    return 0;
+}
+
+/* Reference results of a variant get its name appended, unless they are
+ * shared, as with results which don't depend on how the test was run. */
+static void test_reference_path(const struct MachineTest *test, char *buf,
+                                const char *name, bool shared, size_t len)
+{
+    char file[256];
+    if (test->variant && !shared) {
+        snprintf(file, sizeof(file), "%s.%s", name, test->variant);
+    } else {
+        snprintf(file, sizeof(file), "%s", name);
+    }
+    file_path_append(buf, test->dir, file, len);
+}
+
+static void test_config_free(CfgData_t *cfg)
+{
+    for (size_t i = 0; i < cfg->len; i++) {
+        free(cfg->data[i].value);
+        cfg->data[i].value = NULL;
+    }
+}
+
+static void test_add_result(struct MachineTest *test, const char *result)
+{
+    size_t len = strlen(test->results);
+    snprintf(&test->results[len], sizeof(test->results) - len,
+             len ? " %s" : "%s", result);
+}
 
 static KeyboardMacro_t *parse_macro(const char *path)
 {
@@ -136,22 +255,27 @@ static KeyboardMacro_t *parse_macro(const char *path)
     return macro;
 }
 
-int machine_test_open(const char *path)
+static void event_stop_frame(struct Machine *m, void *data)
 {
-    if (path == NULL) {
-        return -1;
+    (void)data;
+    if (m->test) {
+        m->test->stop_reached = true;
     }
+}
 
-    machine_test_close();
-
-    char buf[2048];
-    file_path_append(buf, path, "sleepdart-test.ini", sizeof(buf));
-    int err = config_load_file(&testcfg, buf);
-    if (err) {
-        dlog(LOG_ERRSILENT, "Failed to open test file \"%s\"", buf);
-        return -2;
+static void breakpoint_stop(struct Machine *m, const struct BreakpointHit *hit, void *data)
+{
+    (void)hit;
+    (void)data;
+    if (m->test) {
+        m->test->stop_reached = true;
     }
+}
 
+static int test_setup(struct MachineTest *test, struct Machine *m, CfgData_t *testcfg,
+                      const char *path)
+{
+    char buf[2048];
     size_t dir_len = strlen(path) + 1;
     char *dir = malloc(dir_len);
     if (dir == NULL) {
@@ -160,26 +284,26 @@ int machine_test_open(const char *path)
     }
     strncpy(dir, path, dir_len-1);
     dir[dir_len-1] = 0;
-    test.dir = dir;
+    test->dir = dir;
 
-    char *file = config_get_str(&testcfg, "file");
+    char *file = config_get_str(testcfg, "file");
     if (file) {
         file_path_append(buf, path, file, sizeof(buf));
-        machine_open_file(buf);
+        machine_open_file(m, buf);
         free(file);
     }
 
-    char *condition = config_get_str(&testcfg, "stop-condition");
+    char *condition = config_get_str(testcfg, "stop-condition");
 
     if (condition == NULL) {
-        dlog(LOG_ERRSILENT, "Missing stop-condition parameter in \"%s\"", buf);
+        dlog(LOG_ERRSILENT, "Missing stop-condition parameter in \"%s\"", path);
         return -4;
     }
 
     bool match = 0;
     for (size_t i = 0; i < sizeof(condition_str) / sizeof(char *); i++) {
         if (strcmp(condition, condition_str[i]) == 0) {
-            test.stop_condition = i;
+            test->stop_condition = i;
             match = true;
         }
     }
@@ -191,31 +315,52 @@ int machine_test_open(const char *path)
     }
     free(condition);
 
-    if (config_get_int(&testcfg, "stop-value", &test.stop_value) != 0) {
+    // a number, or the expression itself for "expr"
+    char *value = config_get_str(testcfg, "stop-value");
+    if (value == NULL) {
         dlog(LOG_ERRSILENT, "Missing stop-value parameter");
         return -6;
     }
 
-    char *scope = config_get_str(&testcfg, "scope");
+    if (test->stop_condition == STOP_EXPR) {
+        test->stop_expr = machine_expr_compile(value);
+        free(value);
+        if (test->stop_expr == NULL) {
+            return -7;
+        }
+    } else {
+        int *stop_value = parse_int(value);
+        free(value);
+        if (stop_value == NULL) {
+            dlog(LOG_ERRSILENT, "Missing stop-value parameter");
+            return -6;
+        }
+        test->stop_value = *stop_value;
+        free(stop_value);
+    }
+
+    char *scope = config_get_str(testcfg, "scope");
     if (scope == NULL) {
-        test.test_docflags = true;
-        test.test_registers = true;
-        test.test_cycles = true;
+        test->test_docflags = true;
+        test->test_registers = true;
+        test->test_cycles = true;
     } else {
         char *last;
         char *token;
         char *str = scope;
         while ((token = strtok_r(str, " ", &last)) != NULL) {
             if (strcmp("docflags", token) == 0) {
-                test.test_docflags = true;
+                test->test_docflags = true;
             } else if (strcmp("allflags", token) == 0) {
-                test.test_allflags = true;
+                test->test_allflags = true;
             } else if (strcmp("registers", token) == 0) {
-                test.test_registers = true;
+                test->test_registers = true;
             } else if (strcmp("cycles", token) == 0) {
-                test.test_cycles = true;
+                test->test_cycles = true;
             } else if (strcmp("print", token) == 0) {
-                test.test_print = true;
+                test->test_print = true;
+            } else if (strcmp("prefixes", token) == 0) {
+                test->test_prefixes = true;
             } else {
                 dlog(LOG_WARN, "Unknown test scope \"%s\"", token);
             }
@@ -224,112 +369,208 @@ int machine_test_open(const char *path)
         free(scope);
     }
 
-    if (test.test_allflags) {
-        test.allflags = XXH64_createState();
-        XXH64_reset(test.allflags, 0);
+    if (test->test_allflags) {
+        test->allflags = XXH64_createState();
+        XXH64_reset(test->allflags, 0);
     }
-    if (test.test_docflags) {
-        test.docflags  = XXH64_createState();
-        XXH64_reset(test.docflags, 0);
+    if (test->test_docflags) {
+        test->docflags  = XXH64_createState();
+        XXH64_reset(test->docflags, 0);
     }
-    if (test.test_registers) { 
-        test.registers = XXH64_createState();
-        XXH64_reset(test.registers, 0);
+    if (test->test_registers) { 
+        test->registers = XXH64_createState();
+        XXH64_reset(test->registers, 0);
     }
-    if (test.test_cycles) {
-        test.cycles = XXH64_createState();
-        XXH64_reset(test.cycles, 0);
+    if (test->test_cycles) {
+        test->cycles = XXH64_createState();
+        XXH64_reset(test->cycles, 0);
     }
-    if (test.test_print) {
-        file_path_append(buf, path, "print.txt.tmp", sizeof(buf));
-        test.print = fopen_utf8(buf, "wb+");
-        if (test.print == NULL) {
+
+    // hashes have always been taken between a prefix and its instruction too,
+    // split-prefixes=0 runs them fused like everything else does
+    int split_prefixes = test->docflags || test->allflags || test->registers || test->cycles;
+    config_get_int(testcfg, "split-prefixes", &split_prefixes);
+    m->cpu.split_prefixes = split_prefixes != 0;
+    test->prefix_start = m->cpu.prefix_runs;
+
+    if (test->test_print) {
+        test_reference_path(test, buf, "print.txt.tmp", false, sizeof(buf));
+        test->print = fopen_utf8(buf, "wb+");
+        if (test->print == NULL) {
             dlog(LOG_ERR, "Failed to open file \"%s\" for write", buf);
             return -8;
         }
-        machine_set_print_stream(test.print);
+        machine_set_print_stream(m, test->print);
     }
 
-    char *macro = config_get_str(&testcfg, "macro");
+    char *macro = config_get_str(testcfg, "macro");
     if (macro) {
         file_path_append(buf, path, macro, sizeof(buf));
         free(macro);
-        test.macro = parse_macro(buf);
-        if (test.macro == NULL) {
+        test->macro = parse_macro(buf);
+        if (test->macro == NULL) {
             dlog(LOG_WARN, "Failed to parse macro file \"%s\"", buf);
             return -8;
         } else {
-            keyboard_macro_play(test.macro, vector_len(test.macro));
+            keyboard_macro_play(&m->macro, test->macro, vector_len(test->macro));
         }
     }
 
-    test_running = true;
-    video_sdl_set_fps_limit(false);
+    uint16_t first, last;
+    switch (test->stop_condition) {
+    case STOP_BREAKPOINT:
+        test->stop_reached = false;
+        test->stop_breakpoint = machine_breakpoint_add(m, BREAK_EXEC, test->stop_value,
+                                                      test->stop_value, NULL,
+                                                      breakpoint_stop, NULL);
+        break;
+    case STOP_FRAME:
+        test->stop_reached = false;
+        machine_schedule(m, (uint64_t)test->stop_value * m->timing.t_frame,
+                         event_stop_frame, NULL);
+        break;
+    case STOP_EXPR:
+        // only evaluated at the addresses its pc terms allow,
+        // checking it before every instruction is what this avoids
+        if (machine_expr_pc_range(test->stop_expr, &first, &last) != 0) {
+            dlog(LOG_ERRSILENT, "stop-value expression needs a pc==address term");
+            return -7;
+        }
+        test->stop_reached = false;
+        test->stop_breakpoint = machine_breakpoint_add(m, BREAK_EXEC, first, last,
+                                                      machine_expr_cond,
+                                                      breakpoint_stop, test->stop_expr);
+        break;
+    }
+
+    test->running = true;
+    if (m->frontend) {
+        video_sdl_set_fps_limit(false);
+    }
 
     return 0;
 }
 
-static int test_condition(struct Machine *m)
+int machine_test_open(struct Machine *m, const char *path)
+{
+    if (path == NULL) {
+        return -1;
+    }
+
+    machine_test_close(m);
+
+    char dir[2048];
+    char ini[2048];
+    char *variant;
+    if (test_split_path(path, dir, ini, sizeof(dir), &variant)) {
+        return -2;
+    }
+
+    struct CfgField fields[TEST_FIELDS_LEN];
+    CfgData_t testcfg;
+    if (test_config_load(&testcfg, fields, ini)) {
+        free(variant);
+        return -2;
+    }
+
+    struct MachineTest *test = calloc(1, sizeof(struct MachineTest));
+    if (test == NULL) {
+        dlog(LOG_ERRSILENT, "%s: malloc fail", __func__);
+        test_config_free(&testcfg);
+        free(variant);
+        return -3;
+    }
+    test->stop_breakpoint = -1;
+    test->passed = true;
+    test->variant = variant;
+    m->test = test;
+
+    int err = test_setup(test, m, &testcfg, dir);
+    test_config_free(&testcfg);
+    if (err) {
+        machine_test_close(m);
+    }
+
+    return err;
+}
+
+static int test_condition(const struct MachineTest *test)
 {
-    switch (test.stop_condition) {
+    switch (test->stop_condition) {
     case STOP_BREAKPOINT:
-        if (m->cpu.regs.pc == test.stop_value) return 1;
-        break;
     case STOP_FRAME:
-        if (m->frames == test.stop_value) return 1;
+    case STOP_EXPR:
+        if (test->stop_reached) return 1;
         break;
     }
 
     return 0;
 }
 
-static void finish_hash(XXH64_state_t *s, const char *name)
+/* Compares value with the reference stored in the test directory,
+ * or stores it as the reference if there is none yet. */
+static void finish_reference(struct MachineTest *test, const char *name, bool shared,
+                             uint64_t value, const char *format)
 {
-    if (s == NULL) return;
-
-    XXH64_hash_t hash = XXH64_digest(s);
-    dlog(LOG_INFO, "%s hash: %016llx", name, hash);
+    char str[32];
+    snprintf(str, sizeof(str), format, (unsigned long long)value);
+    dlog(LOG_INFO, "%s: %s", name, str);
+    char result[64];
+    snprintf(result, sizeof(result), "%s=%s", name, str);
+    test_add_result(test, result);
     uint64_t expected;
     char buf[2048];
-    file_path_append(buf, test.dir, name, sizeof(buf));
+    test_reference_path(test, buf, name, shared, sizeof(buf));
     FILE *f = fopen_utf8(buf, "rb");
     if (f == NULL) {
-        dlog(LOG_WARN, "Failed to open hash file \"%s\", attempting to create", name);
+        dlog(LOG_WARN, "Failed to open reference file \"%s\", attempting to create", buf);
         f = fopen_utf8(buf, "wb");
         if (f == NULL) {
-            dlog(LOG_ERRSILENT, "Failed to open hash file \"%s\" for write!", name);
+            dlog(LOG_ERRSILENT, "Failed to open reference file \"%s\" for write!", buf);
             return;
         }
 
-        fwrite(&hash, sizeof(hash), 1, f);
+        fwrite(&value, sizeof(value), 1, f);
         fclose(f);
         return;
     }
 
     size_t size = fread(&expected, sizeof(expected), 1, f);
+    fclose(f);
     if (!size) {
-        dlog(LOG_ERRSILENT, "Failed to read hash file \"%s\"!", name);
-        fclose(f);
+        dlog(LOG_ERRSILENT, "Failed to read reference file \"%s\"!", buf);
         return;
     }
 
-    if (hash != expected) {
-        dlog(LOG_INFO, "FAIL, expected: %016llx", expected);
-        test_passed = false;
+    if (value != expected) {
+        snprintf(str, sizeof(str), format, (unsigned long long)expected);
+        dlog(LOG_INFO, "FAIL, expected: %s", str);
+        snprintf(result, sizeof(result), "(expected %s)", str);
+        test_add_result(test, result);
+        test->passed = false;
     }
 }
 
-static void finish_print()
+static void finish_hash(struct MachineTest *test, XXH64_state_t *s, const char *name)
+{
+    if (s == NULL) return;
+
+    finish_reference(test, name, false, XXH64_digest(s), "%016llx");
+}
+
+static void finish_print(struct MachineTest *test)
 {
     char exp[2048];
     char tmp[2048];
-    file_path_append(exp, test.dir, "print.txt", sizeof(exp));
-    file_path_append(tmp, test.dir, "print.txt.tmp", sizeof(tmp));
+    // the output doesn't depend on the variant, so they all compare with one
+    test_reference_path(test, exp, "print.txt", true, sizeof(exp));
+    test_reference_path(test, tmp, "print.txt.tmp", false, sizeof(tmp));
 
     FILE *expected = fopen_utf8(exp, "rb");
     if (expected == NULL) {
         dlog(LOG_WARN, "Failed to open print file \"%s\", attempting to create", exp);
-        fclose(test.print);
+        fclose(test->print);
+        test->print = NULL;
         int err = rename(tmp, exp);
         if (err) {
             dlog(LOG_ERRSILENT, "Failed to rename print file!");
@@ -337,13 +578,13 @@ static void finish_print()
         return;
     }
 
-    fseek(test.print, 0, SEEK_SET);
+    fseek(test->print, 0, SEEK_SET);
 
     int line_no = 0;
     bool parsing = true;
     bool mismatch = false;
     while (parsing) {
-        char *line1 = file_read_line(test.print);
+        char *line1 = file_read_line(test->print);
         char *line2 = file_read_line(expected);
         line_no++;
 
@@ -357,7 +598,7 @@ static void finish_print()
             dlog(LOG_INFO, "  %s", line1);
             dlog(LOG_INFO, "  %s", line2);
             mismatch = true;
-            test_passed = false;
+            test->passed = false;
             parsing = false;
         }
 
@@ -369,89 +610,367 @@ static void finish_print()
     if (!mismatch) {
         dlog(LOG_INFO, "print OK");
     }
+    test_add_result(test, mismatch ? "print FAIL" : "print OK");
 
-    fclose(test.print);
+    fclose(test->print);
+    test->print = NULL;
     fclose(expected);
 
     remove(tmp);
 }
 
-static void test_finish(struct Machine *m) {
-    if (test.docflags) {
-        finish_hash(test.docflags, "docflags");
+static void test_finish(struct Machine *m, struct MachineTest *test)
+{
+    if (test->docflags) {
+        finish_hash(test, test->docflags, "docflags");
+    }
+    if (test->allflags) {
+        finish_hash(test, test->allflags, "allflags");
     }
-    if (test.allflags) {
-        finish_hash(test.allflags, "allflags");
+    if (test->cycles) {
+        finish_hash(test, test->cycles, "cycles");
     }
-    if (test.cycles) {
-        finish_hash(test.cycles, "cycles");
+    if (test->registers) {
+        finish_hash(test, test->registers, "registers");
     }
-    if (test.registers) {
-        finish_hash(test.registers, "registers");
+    if (test->print) {
+        finish_print(test);
     }
-    if (test.print) {
-        finish_print();
+    // counted the same whether prefixes are split off or not
+    if (test->test_prefixes) {
+        finish_reference(test, "prefixes", true, m->cpu.prefix_runs - test->prefix_start, "%llu");
     }
 
-    machine_set_print_stream(NULL);
+    machine_set_print_stream(m, NULL);
 
-    machine_test_close();
+    test->running = false;
+    test->finished = true;
 
-    // FIXME: exit() kinda really hacky.. 
-    // considering there's a bunch of stuff that doesnt really get deinit'd
-    // and the fact cpu errors aren't handled at all...
-    if (test_passed) {
+    if (test->passed) {
         dlog(LOG_INFO, "test PASSED!\n");
-        exit(0);
     } else {
         dlog(LOG_INFO, "test FAILED!\n");
-        exit(-1);
     }
 }
 
+/* Hashes are taken before every instruction. */
+bool machine_test_need_step(const struct Machine *m)
+{
+    const struct MachineTest *test = m->test;
+    return test && test->running
+           && (test->docflags || test->allflags || test->registers || test->cycles);
+}
+
 void machine_test_iterate(struct Machine *m)
 {
-    if (!test_running) return;
+    struct MachineTest *test = m->test;
+    if (test == NULL || !test->running) return;
 
-    if (test.cycles) {
-        XXH64_update(test.cycles, &m->cpu.cycles, sizeof(m->cpu.cycles));
+    if (test->cycles) {
+        XXH64_update(test->cycles, &m->cpu.cycles, sizeof(m->cpu.cycles));
+    }
+    if (test->docflags || test->allflags) {
+        cpu_sync_flags(&m->cpu);
     }
-    if (test.docflags) {
+    if (test->docflags) {
         uint8_t f = ~((1<<3) | (1<<5)) & m->cpu.regs.main.f;
-        XXH64_update(test.docflags, &f, 1);
+        XXH64_update(test->docflags, &f, 1);
     }
-    if (test.allflags) {
+    if (test->allflags) {
         uint8_t f = m->cpu.regs.main.f;
-        XXH64_update(test.allflags, &f, 1);
+        XXH64_update(test->allflags, &f, 1);
     }
-    if (test.registers) {
-        XXH64_update(test.registers, &m->cpu.regs.main.a, 1);
-        XXH64_update(test.registers, &m->cpu.regs.main.bc, 6);
+    if (test->registers) {
+        XXH64_update(test->registers, &m->cpu.regs.main.a, 1);
+        XXH64_update(test->registers, &m->cpu.regs.main.bc, 6);
 
-        XXH64_update(test.registers, &m->cpu.regs.alt.a, 1);
-        XXH64_update(test.registers, &m->cpu.regs.alt.bc, 6);
+        XXH64_update(test->registers, &m->cpu.regs.alt.a, 1);
+        XXH64_update(test->registers, &m->cpu.regs.alt.bc, 6);
 
-        XXH64_update(test.registers, &m->cpu.regs.ix, 10);
+        XXH64_update(test->registers, &m->cpu.regs.ix, 10);
 
-        XXH64_update(test.registers, &m->cpu.regs.im, 1);
+        XXH64_update(test->registers, &m->cpu.regs.im, 1);
     }
 
-    if (test_condition(m)) {
-        test_finish(m);
+    if (test_condition(test)) {
+        test_finish(m, test);
     }
 }
 
-void machine_test_close()
+bool machine_test_done(const struct Machine *m, bool *passed)
 {
-    if (test.dir) {
-        free(test.dir);
-        test.dir = NULL;
+    const struct MachineTest *test = m->test;
+    if (test == NULL || !test->finished) {
+        return false;
+    }
+
+    if (passed) {
+        *passed = test->passed;
+    }
+    return true;
+}
+
+void machine_test_close(struct Machine *m)
+{
+    struct MachineTest *test = m->test;
+    if (test == NULL) {
+        return;
     }
 
-    if (test.macro) {
-        vector_free(test.macro);
-        test.macro = NULL;
+    free(test->dir);
+    free(test->variant);
+    if (test->macro) {
+        vector_free(test->macro);
+    }
+
+    if (test->stop_breakpoint >= 0) {
+        machine_breakpoint_remove(m, test->stop_breakpoint);
+    }
+    machine_expr_free(test->stop_expr);
+
+    if (test->print) {
+        machine_set_print_stream(m, NULL);
+        fclose(test->print);
+    }
+
+    XXH64_freeState(test->docflags);
+    XXH64_freeState(test->allflags);
+    XXH64_freeState(test->registers);
+    XXH64_freeState(test->cycles);
+
+    free(test);
+    m->test = NULL;
+}
+
+enum TestJobStatus
+{
+    JOB_ERROR,      // the test couldn't be started
+    JOB_PASSED,
+    JOB_FAILED,
+};
+
+struct TestJob
+{
+    char *path;     // directory, or the .ini of a variant
+    int duration;
+    enum TestJobStatus status;
+    uint64_t ms;
+    char results[256];
+};
+
+struct TestRunner
+{
+    struct TestJob *jobs;
+    int len;
+    SDL_AtomicInt next;
+};
+
+static void add_test(const char *path, char *ini, struct TestJob **jobs)
+{
+    struct CfgField fields[TEST_FIELDS_LEN];
+    CfgData_t cfg;
+    if (test_config_load(&cfg, fields, ini)) {
+        return;
+    }
+
+    struct TestJob job = { 0 };
+    job.path = strdup(path);
+    config_get_int(&cfg, "duration", &job.duration);
+    test_config_free(&cfg);
+    if (job.path) {
+        struct TestJob *list = *jobs;
+        vector_add(list, job);
+        *jobs = list;
+    }
+}
+
+static void find_tests(const char *dir, struct TestJob **jobs)
+{
+    char buf[2048];
+    file_path_append(buf, dir, "sleepdart-test.ini", sizeof(buf));
+    if (file_get_size(buf) >= 0) {
+        add_test(dir, buf, jobs);
+    }
+
+    // variants are run by their .ini, which the directory alone would not select
+    snprintf(buf, sizeof(buf), "%s", dir);
+    char **files = file_list_directory_files(buf);
+    if (files) {
+        for (size_t i = 0; files[i] != NULL; i++) {
+            char *variant = test_variant_name(files[i]);
+            if (variant) {
+                file_path_append(buf, dir, files[i], sizeof(buf));
+                add_test(buf, buf, jobs);
+                free(variant);
+            }
+        }
+        file_free_list(files);
+    }
+
+    snprintf(buf, sizeof(buf), "%s", dir);
+    char **dirs = file_list_directory_dirs(buf);
+    if (dirs == NULL) {
+        return;
+    }
+    for (size_t i = 0; dirs[i] != NULL; i++) {
+        file_path_append(buf, dir, dirs[i], sizeof(buf));
+        find_tests(buf, jobs);
+    }
+    file_free_list(dirs);
+}
+
+// longest first, so the slowest test doesn't start last and hold up the rest
+static int compare_jobs(const void *a, const void *b)
+{
+    const struct TestJob *ja = a;
+    const struct TestJob *jb = b;
+    if (ja->duration != jb->duration) {
+        return ja->duration < jb->duration ? 1 : -1;
+    }
+    return strcmp(ja->path, jb->path);
+}
+
+// aligned like memory_alloc(), calloc() doesn't go as far as Machine_t needs
+static Machine_t *job_machine_alloc()
+{
+#ifdef _WIN32
+    Machine_t *m = _aligned_malloc(sizeof(Machine_t), _Alignof(Machine_t));
+#else
+    Machine_t *m = aligned_alloc(_Alignof(Machine_t), sizeof(Machine_t));
+#endif
+    if (m != NULL) {
+        memset(m, 0, sizeof(*m));
+    }
+    return m;
+}
+
+static void job_machine_free(Machine_t *m)
+{
+#ifdef _WIN32
+    _aligned_free(m);
+#else
+    free(m);
+#endif
+}
+
+static void run_job(struct TestJob *job)
+{
+    uint64_t start = SDL_GetTicks();
+    job->status = JOB_ERROR;
+
+    // the breakpoint bitmaps make it big for a thread's stack
+    Machine_t *m = job_machine_alloc();
+    if (m == NULL) {
+        dlog(LOG_ERRSILENT, "%s: malloc fail", __func__);
+        return;
+    }
+
+    if (machine_init(m, MACHINE_ZX48K)) {
+        dlog(LOG_ERRSILENT, "Failed to initialize machine for test \"%s\"", job->path);
+        job_machine_free(m);
+        return;
+    }
+    m->ay = ay_init(m, 44100, 1750000);
+    beeper_init(&m->beeper, m, 44100);
+
+    if (machine_test_open(m, job->path) == 0) {
+        machine_process_events(m);
+        while (machine_do_cycles(m) == 0) {}
+
+        bool passed;
+        if (machine_test_done(m, &passed)) {
+            job->status = passed ? JOB_PASSED : JOB_FAILED;
+            strcpy(job->results, m->test->results);
+        }
+    }
+
+    machine_test_close(m);
+    beeper_deinit(&m->beeper);
+    ay_deinit(m->ay);
+    machine_deinit(m);
+    job_machine_free(m);
+
+    job->ms = SDL_GetTicks() - start;
+}
+
+static int test_worker(void *data)
+{
+    struct TestRunner *runner = data;
+    for (;;) {
+        int i = SDL_AddAtomicInt(&runner->next, 1);
+        if (i >= runner->len) {
+            break;
+        }
+        run_job(&runner->jobs[i]);
+    }
+    return 0;
+}
+
+int machine_test_run_all(const char *dir)
+{
+    struct TestJob *jobs = vector_create();
+    if (jobs == NULL) {
+        return -1;
+    }
+
+    find_tests(dir, &jobs);
+    int len = vector_len(jobs);
+    if (len == 0) {
+        dlog(LOG_ERRSILENT, "No tests found in \"%s\"", dir);
+        vector_free(jobs);
+        return -1;
+    }
+    qsort(jobs, len, sizeof(struct TestJob), compare_jobs);
+
+    struct TestRunner runner = { .jobs = jobs, .len = len };
+    SDL_SetAtomicInt(&runner.next, 0);
+
+    int threads = SDL_GetNumLogicalCPUCores();
+    if (threads > len) threads = len;
+    if (threads < 1) threads = 1;
+
+    dlog(LOG_INFO, "Running %d tests on %d threads", len, threads);
+    uint64_t start = SDL_GetTicks();
+
+    SDL_Thread *workers[threads];
+    int started = 0;
+    for (int i = 0; i < threads; i++) {
+        workers[i] = SDL_CreateThread(test_worker, "test", &runner);
+        if (workers[i] == NULL) {
+            dlog(LOG_WARN, "Failed to create test thread: %s", SDL_GetError());
+            break;
+        }
+        started++;
+    }
+    // with no threads to run them on, run the tests here
+    if (started == 0) {
+        test_worker(&runner);
+    }
+    for (int i = 0; i < started; i++) {
+        SDL_WaitThread(workers[i], NULL);
+    }
+
+    uint64_t total_ms = SDL_GetTicks() - start;
+
+    static const char *status_str[] = { "ERROR", "PASS", "FAIL" };
+    int failed = 0;
+    dlog(LOG_INFO, "\nTest summary:");
+    for (int i = 0; i < len; i++) {
+        struct TestJob *job = &jobs[i];
+        dlog(LOG_INFO, "  %-5s %7.2fs  %s  %s", status_str[job->status],
+             job->ms / 1000.0, job->path, job->results);
+        if (job->status != JOB_PASSED) {
+            failed++;
+        }
+        free(job->path);
+    }
+
+    if (failed == 0) {
+        dlog(LOG_INFO, "Passed all %d tests in %.2fs!", len, total_ms / 1000.0);
+    } else {
+        dlog(LOG_INFO, "Failed %d out of %d tests in %.2fs.", failed, len, total_ms / 1000.0);
     }
 
-    test_running = false;
+    vector_free(jobs);
+    return failed;
 }
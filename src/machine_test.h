@@ -1,7 +1,18 @@
 #pragma once
 
+#include <stdbool.h>
+
 struct Machine;
+struct MachineTest;
 
-int machine_test_open(const char *path);
+int machine_test_open(struct Machine *m, const char *path);
+bool machine_test_need_step(const struct Machine *m);
 void machine_test_iterate(struct Machine *m);
-void machine_test_close();
+// true once the stop condition was reached, with the outcome in passed
+bool machine_test_done(const struct Machine *m, bool *passed);
+void machine_test_close(struct Machine *m);
+
+/* Runs every test found in dir and its subdirectories on a thread pool,
+ * one machine each, then logs a summary. Returns the number of tests
+ * that failed or couldn't be run, negative if there were none. */
+int machine_test_run_all(const char *dir);
@@ -2,6 +2,10 @@
 #include "log.h"
 #include "machine.h"
 #include "machine_test.h"
+#include "machine_bench.h"
+#include "z80_jit.h"
+#include "z80_profile.h"
+#include "z80_trace.h"
 #include "ula.h"
 #include "video_sdl.h"
 #include "input_sdl.h"
@@ -23,7 +27,17 @@ int main(int argc, char *argv[])
     argparser_add_arg(parser, "--scale", 's', ARG_INT, 0, "integer window scale");
     argparser_add_arg(parser, "--fullscreen", 'f', ARG_STORE_TRUE, 0, "run in fullscreen mode");
     argparser_add_arg(parser, "--test", 0, ARG_STRING, 0, "perform an automated regression test");
+    argparser_add_arg(parser, "--test-all", 0, ARG_STRING, 0, "run every test found in given directory in parallel, then summarize");
     argparser_add_arg(parser, "--headless", 0, ARG_STORE_TRUE, 0, "run without a graphics backend");
+    argparser_add_arg(parser, "--benchmark", 0, ARG_INT, 0, "emulate given amount of frames uncapped, then report timings");
+    argparser_add_arg(parser, "--dispatch", 0, ARG_STRING, 0, "cpu dispatch engine: auto, switch, table, goto or block");
+    argparser_add_arg(parser, "--lazy-flags", 0, ARG_STORE_TRUE, 0, "compute cpu flags only when they're read");
+    argparser_add_arg(parser, "--jit", 0, ARG_STRING, 0, "x86-64 recompiler: off, on or verify");
+    argparser_add_arg(parser, "--idle-skip", 0, ARG_STORE_TRUE, 0, "fast-forward through idle loops");
+    argparser_add_arg(parser, "--profile", 0, ARG_STRING, 0, "profile guest code, write collapsed stacks to given file on exit");
+    argparser_add_arg(parser, "--break", 0, ARG_STRING, 0, "log hits of a breakpoint, given as x, r, w, i or o for execute, read, write, in or out, then :first[-last] address");
+    argparser_add_arg(parser, "--trace", 0, ARG_STRING, 0, "record every executed instruction into given file");
+    argparser_add_arg(parser, "--trace-ring", 0, ARG_INT, 0, "only keep the last given millions of traced instructions, written on exit");
 
     dlog(LOG_INFO, 
         SLEEPDART_NAME " version " SLEEPDART_VERSION ", built on " __DATE__ "\n");
@@ -44,6 +58,14 @@ int main(int argc, char *argv[])
         palette_set_default();
     }
 
+    // headless, each test gets a machine of its own
+    char *testall = argparser_get(parser, "test-all");
+    if (testall) {
+        int failed = machine_test_run_all(testall);
+        argparser_free(parser);
+        return failed < 0 ? 2 : failed;
+    }
+
     int *p_scale = argparser_get(parser, "scale");
     int scale = 2;
     if (p_scale) {
@@ -75,19 +97,61 @@ int main(int argc, char *argv[])
 
     input_sdl_init();
 
-    Machine_t m = { 0 };
+    // too big for the stack with the ULA's buffers in it
+    static Machine_t m = { 0 };
+    m.frontend = true;
 
     machine_init(&m, MACHINE_ZX48K);
-    machine_set_current(&m);
+
+    char *dispatch = argparser_get(parser, "dispatch");
+    if (dispatch && cpu_set_dispatch(&m.cpu, dispatch)) {
+        dlog(LOG_ERR, "Unknown dispatch engine \"%s\"", dispatch);
+        return 1;
+    }
+    m.cpu.lazy_flags = argparser_get(parser, "lazy-flags") != NULL;
+    m.idle.enabled = argparser_get(parser, "idle-skip") != NULL;
+
+    char *jit = argparser_get(parser, "jit");
+    if (jit && jit_set_mode(&m.cpu, jit)) {
+        dlog(LOG_ERR, "Unknown recompiler mode \"%s\"", jit);
+        return 1;
+    }
+
+    char *profile = argparser_get(parser, "profile");
+    if (profile) {
+        if (profile_start(&m.cpu)) {
+            return 1;
+        }
+        if (m.idle.enabled) {
+            dlog(LOG_WARN, "Idle loop skipping is disabled while profiling");
+            m.idle.enabled = false;
+        }
+    }
+
+    char *breakpoint = argparser_get(parser, "break");
+    if (breakpoint && machine_breakpoint_parse(&m, breakpoint) < 0) {
+        return 1;
+    }
+
+    char *trace = argparser_get(parser, "trace");
+    int *trace_ring = argparser_get(parser, "trace-ring");
+    if (trace) {
+        if (trace_start(&m.cpu, trace, trace_ring && *trace_ring > 0 ? *trace_ring : 0)) {
+            return 1;
+        }
+        if (m.idle.enabled) {
+            dlog(LOG_WARN, "Idle loop skipping is disabled while tracing");
+            m.idle.enabled = false;
+        }
+    }
 
     video_sdl_set_fps((double)m.timing.clock_hz / (double)m.timing.t_frame);
 
     char *testpath = argparser_get(parser, "test");
     if (testpath) {
-        int err = machine_test_open(testpath);
+        int err = machine_test_open(&m, testpath);
         if (err) {
             dlog(LOG_ERRSILENT, "Failed to run test!");
-            machine_test_close();
             return 2;
         }
     }
@@ -95,7 +159,7 @@ int main(int argc, char *argv[])
     char *file = argparser_get(parser, "file");
 
     if (file) {
-        machine_open_file(file);
+        machine_open_file(&m, file);
     }
 
     int sample_rate = 44100;
@@ -117,22 +181,45 @@ int main(int argc, char *argv[])
     beeper_init(&m.beeper, &m, sample_rate);
     audio_sdl_init(sample_rate);
 
-    machine_process_events();
+    machine_process_events(&m);
+
+    int *bench_frames = argparser_get(parser, "benchmark");
+    if (bench_frames) {
+        machine_bench_open(*bench_frames);
+    }
 
     for (;;) {
-        int err = machine_do_cycles();
+        int err = machine_do_cycles(&m);
         if (err) break;
+        if (machine_bench_iterate(&m)) break;
+    }
+
+    int exit_code = 0;
+    bool passed;
+    if (machine_test_done(&m, &passed)) {
+        exit_code = passed ? 0 : -1;
     }
+    machine_test_close(&m);
+
+    if (profile) {
+        profile_report(&m.cpu, PROFILE_TOP_N);
+        profile_write(&m.cpu, profile);
+        profile_free(&m.cpu);
+    }
+    trace_stop(&m.cpu);
 
     ay_deinit(m.ay);
 
-    config_set_int(&g_config, "window-scale", video_sdl_get_scale());
-    config_set_int(&g_config, "limit-fps", video_sdl_get_fps_limit());
-    config_set_str(&g_config, "palette", palette_get_name());
+    // tests used to end the process right away, leave the config be
+    if (!testpath) {
+        config_set_int(&g_config, "window-scale", video_sdl_get_scale());
+        config_set_int(&g_config, "limit-fps", video_sdl_get_fps_limit());
+        config_set_str(&g_config, "palette", palette_get_name());
 
-    config_save();
+        config_save();
+    }
 
     argparser_free(parser);
 
-    machine_test_close();
+    return exit_code;
 }
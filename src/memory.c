@@ -8,6 +8,36 @@
 #include "machine.h"
 #include "file.h"
 
+#ifdef _WIN32
+    #include <malloc.h>
+#endif
+
+/* Allocates zeroed, cache-line aligned memory state. 
+ * Returns NULL on failure. */
+Memory_t *memory_alloc()
+{
+#ifdef _WIN32
+    Memory_t *mem = _aligned_malloc(sizeof(Memory_t), _Alignof(Memory_t));
+#else
+    Memory_t *mem = aligned_alloc(_Alignof(Memory_t), sizeof(Memory_t));
+#endif
+    if (mem == NULL) {
+        dlog(LOG_ERR, "%s: malloc fail", __func__);
+        return NULL;
+    }
+    memset(mem, 0, sizeof(*mem));
+    return mem;
+}
+
+void memory_free(Memory_t *mem)
+{
+#ifdef _WIN32
+    _aligned_free(mem);
+#else
+    free(mem);
+#endif
+}
+
 /* Initializes the DRAM to a pseudo-random state it would have on initial power-on. */
 void memory_init(Memory_t *mem)
 {
@@ -22,6 +52,11 @@ void memory_init(Memory_t *mem)
         *p = rand();
         p++;
     }
+
+    memory_map(mem, 0x0000, 0x4000, &mem->bus[0x0000], MEMORY_UNCONTENDED, MEMORY_WRITE_ROM);
+    memory_map(mem, 0x4000, 0x1B00, &mem->bus[0x4000], MEMORY_CONTENDED, MEMORY_WRITE_SCREEN);
+    memory_map(mem, 0x5B00, 0x2500, &mem->bus[0x5B00], MEMORY_CONTENDED, MEMORY_WRITE_PLAIN);
+    memory_map(mem, 0x8000, 0x8000, &mem->bus[0x8000], MEMORY_UNCONTENDED, MEMORY_WRITE_PLAIN);
 }
 
 /* Loads a 16K ROM into the beginning of memory space. 
@@ -39,45 +74,158 @@ int memory_load_rom_16k(Memory_t *mem, char path[])
     return 0;
 }
 
+static void page_update(Memory_t *mem, unsigned int index)
+{
+    struct MemoryPage *page = &mem->pages[index];
+    uint8_t watch = page->watch | mem->watch_all;
+
+    bool slow_read = page->contention != MEMORY_UNCONTENDED 
+                  || (watch & MEMORY_WATCH_READ);
+    bool slow_write = page->contention != MEMORY_UNCONTENDED 
+                   || page->write != MEMORY_WRITE_PLAIN 
+                   || (watch & MEMORY_WATCH_WRITE);
+
+    mem->read_fast[index] = slow_read ? NULL : page->host;
+    mem->write_fast[index] = slow_write ? NULL : page->host;
+}
+
+/* Maps host memory into the given page-aligned range of the address space.
+ * Banked models call this whenever their paging changes. Watches on the 
+ * affected pages are kept. */
+void memory_map(Memory_t *mem, uint16_t addr, uint32_t size, uint8_t *host,
+                enum MemoryContention contention, enum MemoryWritePolicy write)
+{
+    unsigned int first = addr >> MEMORY_PAGE_SHIFT;
+    unsigned int count = size >> MEMORY_PAGE_SHIFT;
+
+    for (unsigned int i = 0; i < count && first + i < MEMORY_PAGES; i++) {
+        struct MemoryPage *page = &mem->pages[first + i];
+        page->host = host + i * MEMORY_PAGE_SIZE;
+        page->contention = contention;
+        page->write = write;
+        page_update(mem, first + i);
+    }
+
+    // whatever the cpu has decoded from there is gone now
+    for (unsigned int i = addr >> 8; i < ((addr + size) >> 8) && i < 0x100; i++) {
+        mem->page_gen[i]++;
+    }
+}
+
+/* Sets which accesses to the page containing the given address 
+ * are reported to the watch function. */
+void memory_set_watch(Memory_t *mem, uint16_t addr, uint8_t watch)
+{
+    mem->pages[addr >> MEMORY_PAGE_SHIFT].watch = watch;
+    page_update(mem, addr >> MEMORY_PAGE_SHIFT);
+}
+
+/* Sets which accesses to any page are reported to the watch function,
+ * in addition to those set per page. */
+void memory_set_watch_all(Memory_t *mem, uint8_t watch)
+{
+    mem->watch_all = watch;
+    for (unsigned int i = 0; i < MEMORY_PAGES; i++) {
+        page_update(mem, i);
+    }
+}
+
+void memory_set_watch_func(Memory_t *mem, MemoryWatchFunc func)
+{
+    mem->watch_func = func;
+}
+
+/* Switches contended pages between plain contention lookups and ones
+ * which also get recorded into the ULA's contention trace. The lookups
+ * only need to be traced while looking for idle loops, this keeps the
+ * rest of the time from checking whether they are. */
+void memory_trace_contention(Memory_t *mem, bool trace)
+{
+    for (unsigned int i = 0; i < MEMORY_PAGES; i++) {
+        struct MemoryPage *page = &mem->pages[i];
+        if (page->contention != MEMORY_UNCONTENDED) {
+            page->contention = trace ? MEMORY_CONTENDED_TRACED : MEMORY_CONTENDED;
+        }
+    }
+}
+
+static inline uint8_t page_contention(struct Machine *ctx, const struct MemoryPage *page)
+{
+    switch (page->contention)
+    {
+    case MEMORY_CONTENDED:
+        return ula_get_contention_cycles(&ctx->ula, ctx->cpu.cycles);
+    case MEMORY_CONTENDED_TRACED:
+        return ula_trace_contention_cycles(&ctx->ula, ctx->cpu.cycles);
+    default:
+        return 0;
+    }
+}
+
+static uint8_t write_slow(struct Machine *ctx, uint16_t addr, uint8_t value)
+{
+    struct MemoryPage *page = &ctx->memory->pages[addr >> MEMORY_PAGE_SHIFT];
+    uint8_t contention = page_contention(ctx, page);
+
+    switch (page->write)
+    {
+    case MEMORY_WRITE_ROM:
+        break;
+    case MEMORY_WRITE_SCREEN:
+        // the ULA draws what's before the beam from the old contents first,
+        // writes that change nothing don't concern it
+        if (page->host[addr & MEMORY_PAGE_MASK] != value) {
+            ula_write_screen(&ctx->ula, addr, ctx->cpu.cycles + contention);
+        }
+        page->host[addr & MEMORY_PAGE_MASK] = value;
+        ctx->memory->page_gen[addr >> 8]++;
+        break;
+    default:
+        page->host[addr & MEMORY_PAGE_MASK] = value;
+        ctx->memory->page_gen[addr >> 8]++;
+        break;
+    }
+
+    if (((page->watch | ctx->memory->watch_all) & MEMORY_WATCH_WRITE)
+        && ctx->memory->watch_func != NULL) {
+        ctx->memory->watch_func(ctx, addr, value, true);
+    }
+
+    return contention;
+}
+
 /* Performs a memory bus write. 
  * Returns the amount of extra cycles stalled due to ULA memory contention. */
 uint8_t memory_write(struct Machine *ctx, uint16_t addr, uint8_t value)
 {
-    if (addr < 0x4000) { 
-        // 0x0000 - 0x3FFF -> ROM 
-        // no-op for now
-    } else if (addr < 0x5B00) {
-        ctx->memory.bus[addr] = value;
-        int contention = ula_get_contention_cycles(ctx->cpu.cycles);
-        ula_write_screen(ctx->cpu.cycles + contention, value, addr);
-        return contention;
-    } else if (addr < 0x8000) {
-        // 0x4000 - 0x7FFF -> RAM (contended memory)
-        ctx->memory.bus[addr] = value; // ostrożnie!
-        return ula_get_contention_cycles(ctx->cpu.cycles);
-    } else {
-        // 0x8000 - 0xFFFF -> RAM
-        ctx->memory.bus[addr] = value;
+    if (memory_write_fast(ctx->memory, addr, value)) {
+        return 0;
     }
-
-    return 0;
+    return write_slow(ctx, addr, value);
 }
 
 /* Performs a memory bus read. 
  * Returns the amount of extra cycles stalled due to ULA memory contention. */
 uint8_t memory_read(struct Machine *ctx, uint16_t addr, uint8_t *dest)
 {
-    *dest = ctx->memory.bus[addr];
-    if (addr >= 0x4000 && addr < 0x8000) {
-        return ula_get_contention_cycles(ctx->cpu.cycles);
+    if (memory_read_fast(ctx->memory, addr, dest)) {
+        return 0;
+    }
+
+    struct MemoryPage *page = &ctx->memory->pages[addr >> MEMORY_PAGE_SHIFT];
+    *dest = page->host[addr & MEMORY_PAGE_MASK];
+
+    uint8_t contention = page_contention(ctx, page);
+    if (((page->watch | ctx->memory->watch_all) & MEMORY_WATCH_READ)
+        && ctx->memory->watch_func != NULL) {
+        ctx->memory->watch_func(ctx, addr, *dest, false);
     }
-    return 0; 
+    return contention;
 }
 
-/* Returns a byte on the memory bus from a given address.
- * Mostly meant for debug purposes. For hardware interaction,
- * use memory_read(). */
-uint8_t memory_bus_peek(uint8_t *bus, uint16_t addr)
+/* Returns whether accesses to the given address are subject to ULA contention. */
+bool memory_is_contended(struct Machine *ctx, uint16_t addr)
 {
-    return bus[addr];
+    return ctx->memory->pages[addr >> MEMORY_PAGE_SHIFT].contention != MEMORY_UNCONTENDED;
 }
+
@@ -1,15 +1,102 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 
-typedef struct Memory {
-    uint8_t bus[0x10000];
-} Memory_t;
+#define MEMORY_PAGE_SHIFT 8
+#define MEMORY_PAGE_SIZE (1 << MEMORY_PAGE_SHIFT)
+#define MEMORY_PAGE_MASK (MEMORY_PAGE_SIZE - 1)
+#define MEMORY_PAGES (0x10000 >> MEMORY_PAGE_SHIFT)
+
+enum MemoryContention {
+    MEMORY_UNCONTENDED,
+    MEMORY_CONTENDED,       // shared with the ULA
+    MEMORY_CONTENDED_TRACED,    // the same, see memory_trace_contention()
+};
+
+enum MemoryWritePolicy {
+    MEMORY_WRITE_PLAIN,
+    MEMORY_WRITE_ROM,       // writes are ignored
+    MEMORY_WRITE_SCREEN,    // writes are passed on to the ULA
+};
+
+enum MemoryWatch {
+    MEMORY_WATCH_READ = 1 << 0,
+    MEMORY_WATCH_WRITE = 1 << 1,
+};
 
 struct Machine;
 
+// called after an access to a watched page
+typedef void (*MemoryWatchFunc)(struct Machine *ctx, uint16_t addr, uint8_t value, bool write);
+
+struct MemoryPage {
+    uint8_t *host;          // where the page currently lives
+    uint8_t contention;     // enum MemoryContention
+    uint8_t write;          // enum MemoryWritePolicy
+    uint8_t watch;          // enum MemoryWatch flags
+};
+
+// allocated on its own through memory_alloc(), away from the cpu state
+typedef struct Memory {
+    // backing storage of the 48K map, 16K of ROM followed by 48K of RAM
+    _Alignas(64) uint8_t bus[0x10000];
+    struct MemoryPage pages[MEMORY_PAGES];
+    // host pointers of pages which accesses can go straight to, NULL otherwise
+    uint8_t *read_fast[MEMORY_PAGES];
+    uint8_t *write_fast[MEMORY_PAGES];
+    MemoryWatchFunc watch_func;
+    uint8_t watch_all;      // enum MemoryWatch flags for every page on top of their own
+    // bumped on every write to the given 256-byte page, 
+    // lets the cpu tell if code it has decoded earlier is still intact
+    uint32_t page_gen[0x100];
+} Memory_t;
+
+Memory_t *memory_alloc();
+void memory_free(Memory_t *mem);
 void memory_init(Memory_t *mem);
 int memory_load_rom_16k(Memory_t *mem, char path[]);
+void memory_map(Memory_t *mem, uint16_t addr, uint32_t size, uint8_t *host,
+                enum MemoryContention contention, enum MemoryWritePolicy write);
+void memory_set_watch(Memory_t *mem, uint16_t addr, uint8_t watch);
+void memory_set_watch_all(Memory_t *mem, uint8_t watch);
+void memory_set_watch_func(Memory_t *mem, MemoryWatchFunc func);
+void memory_trace_contention(Memory_t *mem, bool trace);
 uint8_t memory_write(struct Machine *ctx, uint16_t addr, uint8_t value);
 uint8_t memory_read(struct Machine *ctx, uint16_t addr, uint8_t *dest);
-uint8_t memory_bus_peek(uint8_t *bus, uint16_t addr);
+bool memory_is_contended(struct Machine *ctx, uint16_t addr);
+
+/* Fast paths of memory_read() and memory_write() for pages which need
+ * no special handling. Return false if the access has to go through those. */
+static inline bool memory_read_fast(const Memory_t *mem, uint16_t addr, uint8_t *dest)
+{
+    uint8_t *host = mem->read_fast[addr >> MEMORY_PAGE_SHIFT];
+    if (host == NULL) return false;
+    *dest = host[addr & MEMORY_PAGE_MASK];
+    return true;
+}
+
+static inline bool memory_write_fast(Memory_t *mem, uint16_t addr, uint8_t value)
+{
+    uint8_t *host = mem->write_fast[addr >> MEMORY_PAGE_SHIFT];
+    if (host == NULL) return false;
+    host[addr & MEMORY_PAGE_MASK] = value;
+    mem->page_gen[addr >> 8]++;
+    return true;
+}
+
+/* Returns where the byte at the given address currently lives. What follows
+ * it is only contiguous up to the end of its page, at least 256 bytes. */
+static inline uint8_t *memory_host_ptr(const Memory_t *mem, uint16_t addr)
+{
+    return &mem->pages[addr >> MEMORY_PAGE_SHIFT].host[addr & MEMORY_PAGE_MASK];
+}
+
+/* Returns a byte on the memory bus from a given address, as currently
+ * mapped, without any side effects. For hardware interaction,
+ * use memory_read(). */
+static inline uint8_t memory_bus_peek(const Memory_t *mem, uint16_t addr)
+{
+    return *memory_host_ptr(mem, addr);
+}
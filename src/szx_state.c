@@ -19,13 +19,13 @@ int szx_load_block_rampage(struct SZXBlock *b, Machine_t *m)
     switch (page->page_no)
     {
     case 5:
-        dest = &m->memory.bus[0x4000];
+        dest = &m->memory->bus[0x4000];
         break;
     case 2:
-        dest = &m->memory.bus[0x8000];
+        dest = &m->memory->bus[0x8000];
         break;
     case 0:
-        dest = &m->memory.bus[0xC000];
+        dest = &m->memory->bus[0xC000];
         break;
     default:
         return 0;
@@ -62,13 +62,13 @@ int szx_save_block_rampage(struct SZXBlock *b, Machine_t *m, int page_no)
     switch (page_no)
     {
     case 5:
-        src = &m->memory.bus[0x4000];
+        src = &m->memory->bus[0x4000];
         break;
     case 2:
-        src = &m->memory.bus[0x8000];
+        src = &m->memory->bus[0x8000];
         break;
     case 0:
-        src = &m->memory.bus[0xC000];
+        src = &m->memory->bus[0xC000];
         break;
     default:
         return -2;
@@ -123,6 +123,7 @@ int szx_save_block_z80regs(struct SZXBlock *b, Machine_t *m)
     }
 
     SZXZ80Regs_t *r = (SZXZ80Regs_t *)b->data;
+    cpu_sync_flags(&m->cpu);
     r->af = m->cpu.regs.main.af;
     r->bc = m->cpu.regs.main.bc;
     r->de = m->cpu.regs.main.de;
@@ -197,7 +198,7 @@ int szx_load_block_specregs(struct SZXBlock *b, Machine_t *m)
     SZXSpecRegs_t *r = (SZXSpecRegs_t *)b->data;
 
     io_port_write(m, 0xfe, r->fe);
-    ula_set_border(r->border, 0);
+    ula_set_border(&m->ula, r->border, 0);
 
     return 0;
 }
@@ -214,7 +215,7 @@ int szx_save_block_specregs(struct SZXBlock *b, Machine_t *m)
 
     SZXSpecRegs_t *r = (SZXSpecRegs_t *)b->data;
 
-    r->border = ula_get_border();
+    r->border = ula_get_border(&m->ula);
     // FIXME: cant get last fe val :(
 
     return 0;
@@ -255,8 +256,6 @@ int szx_state_load(SZX_t *szx, struct Machine *m)
         }
     }
 
-    ula_reset_screen_dirty();
-
     return 0;
 }
 
@@ -0,0 +1,486 @@
+#include "trace_file.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+/* Binary instruction trace files.
+ *
+ * A gzip stream holding an 8-byte magic followed by one record per
+ * instruction. Most of what a record holds can be predicted from the record
+ * before it and from what was seen the last time around the same code, so
+ * records only store where the prediction was wrong. The writer and the
+ * reader keep the same history to predict from:
+ *
+ *   pc         the pc that followed the previous pc last time
+ *   op         the bytes seen at pc last time
+ *   time       previous time, plus what the previous pc took last time
+ *   registers  unchanged, except R which advances as much as it did after
+ *              the previous pc last time, and Q which is set the same way
+ *   accesses   the same addresses as at pc last time, with reads from
+ *              within the opcode bytes returning those
+ *
+ * Record layout, multi-byte values are little endian:
+ *
+ *   u8         TRACE_REC_* flags, which fields follow
+ *   u16        pc
+ *   u8[4]      opcode bytes
+ *   varint     T-states since the previous record
+ *   u8         mask of registers not matching the prediction, bit n for
+ *              enum TraceReg n
+ *   u8         the same for enum TraceReg 8 and up
+ *   u16...     those registers
+ *   accesses   if predicted, a u8 value for each of them not implied by the
+ *              opcode bytes. Otherwise a u8 count, bit 7 set if accesses
+ *              were dropped, then per access a u8 TRACE_ACC_* tag, then
+ *              a u16 address and a u8 value if the tag says so
+ *
+ * Records are encoded into a buffer which is handed to zlib in large chunks,
+ * at its fastest level. */
+
+#define TRACE_MAGIC "SDTRACE\x02"
+#define TRACE_MAGIC_LEN 8
+#define TRACE_BUF_SIZE (256 * 1024)
+// no record gets longer than this
+#define TRACE_RECORD_MAX (1 + 2 + 4 + 10 + 2 + TRACE_REG_COUNT * 2 + 1 + TRACE_MAX_ACCESSES * 4)
+
+enum TraceRecordFlags {
+    TRACE_REC_PC = 1 << 0,
+    TRACE_REC_OP = 1 << 1,
+    TRACE_REC_TIME = 1 << 2,
+    TRACE_REC_REGS = 1 << 3,
+    TRACE_REC_REGS_HIGH = 1 << 4,
+    TRACE_REC_ACCESS = 1 << 5,
+};
+
+enum TraceAccessTag {
+    TRACE_ACC_ADDR_PC = 0,          // pc plus the offset in bits 2-3
+    TRACE_ACC_ADDR_EXPLICIT = 1,
+    TRACE_ACC_ADDR_NEXT = 2,        // one past the previous access
+    TRACE_ACC_ADDR_SAME = 3,        // same as the previous access
+    TRACE_ACC_ADDR_MASK = 3,
+    TRACE_ACC_WRITE = 1 << 4,
+    TRACE_ACC_VALUE = 1 << 5,       // explicit, otherwise from the opcode bytes
+};
+
+struct TraceAccessShape {
+    uint8_t count;
+    uint16_t write;     // bit per access
+    uint16_t addr[TRACE_MAX_ACCESSES];
+};
+
+// what both ends predict records from
+struct TraceHistory {
+    struct TraceEntry prev;
+    uint16_t next_pc[0x10000];
+    uint8_t op[0x10000][4];
+    uint32_t duration[0x10000];
+    uint8_t r_step[0x10000];
+    bool q[0x10000];
+    struct TraceAccessShape shape[0x10000];
+};
+
+struct TraceWriter {
+    gzFile gz;
+    struct TraceHistory h;
+    uint8_t buf[TRACE_BUF_SIZE];
+    size_t len;
+};
+
+struct TraceReader {
+    gzFile gz;
+    struct TraceHistory h;
+    uint8_t buf[TRACE_BUF_SIZE];
+    size_t pos;
+    size_t len;
+};
+
+static inline uint16_t predict_reg(const struct TraceHistory *h, int reg)
+{
+    uint16_t v = h->prev.regs[reg];
+    if (reg == TRACE_IR) {
+        return (v & 0xFF80) | ((v + h->r_step[h->prev.pc]) & 0x7F);
+    }
+    if (reg == TRACE_STATE) {
+        return (v & ~TRACE_STATE_Q) | (h->q[h->prev.pc] ? TRACE_STATE_Q : 0);
+    }
+    return v;
+}
+
+/* Whether the access reads from within the opcode bytes,
+ * in which case its value doesn't need storing. */
+static inline bool access_implied(const struct TraceEntry *e, uint16_t addr, bool write)
+{
+    return !write && (uint16_t)(addr - e->pc) < 4;
+}
+
+/* Learns from the entry just encoded or decoded, for predicting the next one. */
+static void history_update(struct TraceHistory *h, const struct TraceEntry *e)
+{
+    struct TraceEntry *prev = &h->prev;
+
+    h->next_pc[prev->pc] = e->pc;
+    h->duration[prev->pc] = e->time - prev->time;
+    h->r_step[prev->pc] = (e->regs[TRACE_IR] - prev->regs[TRACE_IR]) & 0x7F;
+    h->q[prev->pc] = e->regs[TRACE_STATE] & TRACE_STATE_Q;
+    memcpy(h->op[e->pc], e->op, 4);
+
+    struct TraceAccessShape *s = &h->shape[e->pc];
+    s->count = e->access_count;
+    s->write = 0;
+    for (int i = 0; i < e->access_count; i++) {
+        s->addr[i] = e->access[i].addr;
+        s->write |= e->access[i].write << i;
+    }
+
+    prev->time = e->time;
+    prev->pc = e->pc;
+    memcpy(prev->regs, e->regs, sizeof(e->regs));
+}
+
+static bool shape_matches(const struct TraceAccessShape *s, const struct TraceEntry *e)
+{
+    if (e->access_count != s->count || e->access_overflow) return false;
+    for (int i = 0; i < e->access_count; i++) {
+        const struct TraceAccess *a = &e->access[i];
+        if (a->addr != s->addr[i] || a->write != ((s->write >> i) & 1)) return false;
+    }
+    return true;
+}
+
+static int writer_flush(TraceWriter_t *w)
+{
+    if (w->len == 0) return 0;
+    int written = gzwrite(w->gz, w->buf, w->len);
+    if (written != (int)w->len) return -1;
+    w->len = 0;
+    return 0;
+}
+
+/* Returns NULL on failure. */
+TraceWriter_t *trace_writer_open(const char *path)
+{
+    TraceWriter_t *w = calloc(1, sizeof(*w));
+    if (w == NULL) return NULL;
+
+    w->gz = gzopen(path, "wb1");
+    if (w->gz == NULL) {
+        free(w);
+        return NULL;
+    }
+    gzbuffer(w->gz, TRACE_BUF_SIZE);
+
+    memcpy(w->buf, TRACE_MAGIC, TRACE_MAGIC_LEN);
+    w->len = TRACE_MAGIC_LEN;
+    return w;
+}
+
+static inline uint8_t *put16(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+/* Returns zero on success, non-zero otherwise. */
+int trace_writer_add(TraceWriter_t *w, const struct TraceEntry *e)
+{
+    if (w->len + TRACE_RECORD_MAX > TRACE_BUF_SIZE && writer_flush(w)) {
+        return -1;
+    }
+
+    struct TraceHistory *h = &w->h;
+    uint8_t *flags = w->buf + w->len;
+    uint8_t *p = flags + 1;
+    *flags = 0;
+
+    if (e->pc != h->next_pc[h->prev.pc]) {
+        *flags |= TRACE_REC_PC;
+        p = put16(p, e->pc);
+    }
+    if (memcmp(e->op, h->op[e->pc], 4) != 0) {
+        *flags |= TRACE_REC_OP;
+        memcpy(p, e->op, 4);
+        p += 4;
+    }
+
+    uint64_t dt = e->time - h->prev.time;
+    if (dt != h->duration[h->prev.pc]) {
+        *flags |= TRACE_REC_TIME;
+        do {
+            *p++ = (dt & 0x7F) | (dt > 0x7F ? 0x80 : 0);
+            dt >>= 7;
+        } while (dt);
+    }
+
+    uint16_t mask = 0;
+    for (int i = 0; i < TRACE_REG_COUNT; i++) {
+        if (e->regs[i] != predict_reg(h, i)) mask |= 1 << i;
+    }
+    if (mask & 0xFF) {
+        *flags |= TRACE_REC_REGS;
+        *p++ = mask;
+    }
+    if (mask >> 8) {
+        *flags |= TRACE_REC_REGS_HIGH;
+        *p++ = mask >> 8;
+    }
+    for (int i = 0; i < TRACE_REG_COUNT; i++) {
+        if (mask & (1 << i)) p = put16(p, e->regs[i]);
+    }
+
+    // reads from within the opcode bytes can only be left out
+    // if they did return those, which self-modifying code may break
+    bool implied_ok = true;
+    for (int i = 0; i < e->access_count; i++) {
+        const struct TraceAccess *a = &e->access[i];
+        if (access_implied(e, a->addr, a->write)
+            && a->value != e->op[(uint16_t)(a->addr - e->pc)]) {
+            implied_ok = false;
+        }
+    }
+
+    if (implied_ok && shape_matches(&h->shape[e->pc], e)) {
+        for (int i = 0; i < e->access_count; i++) {
+            const struct TraceAccess *a = &e->access[i];
+            if (!access_implied(e, a->addr, a->write)) *p++ = a->value;
+        }
+    } else {
+        *flags |= TRACE_REC_ACCESS;
+        *p++ = e->access_count | (e->access_overflow ? 0x80 : 0);
+        for (int i = 0; i < e->access_count; i++) {
+            const struct TraceAccess *a = &e->access[i];
+            uint16_t offset = a->addr - e->pc;
+            uint8_t *tag = p++;
+
+            if (i > 0 && a->addr == e->access[i-1].addr) {
+                *tag = TRACE_ACC_ADDR_SAME;
+            } else if (i > 0 && a->addr == (uint16_t)(e->access[i-1].addr + 1)) {
+                *tag = TRACE_ACC_ADDR_NEXT;
+            } else if (offset < 4) {
+                *tag = TRACE_ACC_ADDR_PC | (offset << 2);
+            } else {
+                *tag = TRACE_ACC_ADDR_EXPLICIT;
+                p = put16(p, a->addr);
+            }
+            if (a->write) *tag |= TRACE_ACC_WRITE;
+            if (!implied_ok || !access_implied(e, a->addr, a->write)) {
+                *tag |= TRACE_ACC_VALUE;
+                *p++ = a->value;
+            }
+        }
+    }
+
+    w->len = p - w->buf;
+    history_update(h, e);
+    return 0;
+}
+
+/* Flushes and closes the trace.
+ * Returns zero on success, non-zero otherwise. */
+int trace_writer_close(TraceWriter_t *w)
+{
+    if (w == NULL) return 0;
+
+    int err = writer_flush(w);
+    if (gzclose(w->gz) != Z_OK) err = -1;
+    free(w);
+    return err;
+}
+
+static inline int get8(TraceReader_t *r, uint8_t *v)
+{
+    if (r->pos == r->len) {
+        int len = gzread(r->gz, r->buf, TRACE_BUF_SIZE);
+        if (len <= 0) return -1;
+        r->pos = 0;
+        r->len = len;
+    }
+    *v = r->buf[r->pos++];
+    return 0;
+}
+
+static inline int get16(TraceReader_t *r, uint16_t *v)
+{
+    uint8_t l, h;
+    if (get8(r, &l) || get8(r, &h)) return -1;
+    *v = l | (h << 8);
+    return 0;
+}
+
+/* Returns NULL if the file can't be opened or isn't a trace. */
+TraceReader_t *trace_reader_open(const char *path)
+{
+    TraceReader_t *r = calloc(1, sizeof(*r));
+    if (r == NULL) return NULL;
+
+    r->gz = gzopen(path, "rb");
+    if (r->gz == NULL) {
+        free(r);
+        return NULL;
+    }
+    gzbuffer(r->gz, TRACE_BUF_SIZE);
+
+    uint8_t magic[TRACE_MAGIC_LEN] = { 0 };
+    for (int i = 0; i < TRACE_MAGIC_LEN; i++) {
+        if (get8(r, &magic[i])) break;
+    }
+    if (memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_LEN) != 0) {
+        trace_reader_close(r);
+        return NULL;
+    }
+    return r;
+}
+
+/* Reads the next record.
+ * Returns zero on success, 1 at the end of the trace, -1 if it's broken. */
+int trace_reader_next(TraceReader_t *r, struct TraceEntry *e)
+{
+    struct TraceHistory *h = &r->h;
+    uint8_t flags, b;
+
+    if (get8(r, &flags)) return gzeof(r->gz) ? 1 : -1;
+
+    e->pc = h->next_pc[h->prev.pc];
+    if ((flags & TRACE_REC_PC) && get16(r, &e->pc)) return -1;
+
+    memcpy(e->op, h->op[e->pc], 4);
+    if (flags & TRACE_REC_OP) {
+        for (int i = 0; i < 4; i++) {
+            if (get8(r, &e->op[i])) return -1;
+        }
+    }
+
+    uint64_t dt = h->duration[h->prev.pc];
+    if (flags & TRACE_REC_TIME) {
+        int shift = 0;
+        dt = 0;
+        do {
+            if (get8(r, &b) || shift > 63) return -1;
+            dt |= (uint64_t)(b & 0x7F) << shift;
+            shift += 7;
+        } while (b & 0x80);
+    }
+    e->time = h->prev.time + dt;
+
+    uint8_t low = 0, high = 0;
+    if ((flags & TRACE_REC_REGS) && get8(r, &low)) return -1;
+    if ((flags & TRACE_REC_REGS_HIGH) && get8(r, &high)) return -1;
+    uint16_t mask = low | (high << 8);
+    for (int i = 0; i < TRACE_REG_COUNT; i++) {
+        if (mask & (1 << i)) {
+            if (get16(r, &e->regs[i])) return -1;
+        } else {
+            e->regs[i] = predict_reg(h, i);
+        }
+    }
+
+    if (!(flags & TRACE_REC_ACCESS)) {
+        const struct TraceAccessShape *s = &h->shape[e->pc];
+        e->access_count = s->count;
+        e->access_overflow = false;
+        for (int i = 0; i < s->count; i++) {
+            struct TraceAccess *a = &e->access[i];
+            a->addr = s->addr[i];
+            a->write = (s->write >> i) & 1;
+            if (access_implied(e, a->addr, a->write)) {
+                a->value = e->op[(uint16_t)(a->addr - e->pc)];
+            } else if (get8(r, &a->value)) {
+                return -1;
+            }
+        }
+    } else {
+        if (get8(r, &b)) return -1;
+        e->access_count = b & 0x7F;
+        e->access_overflow = b & 0x80;
+        if (e->access_count > TRACE_MAX_ACCESSES) return -1;
+
+        for (int i = 0; i < e->access_count; i++) {
+            struct TraceAccess *a = &e->access[i];
+            uint8_t tag;
+            if (get8(r, &tag)) return -1;
+
+            switch (tag & TRACE_ACC_ADDR_MASK) {
+            case TRACE_ACC_ADDR_PC:
+                a->addr = e->pc + ((tag >> 2) & 3);
+                break;
+            case TRACE_ACC_ADDR_EXPLICIT:
+                if (get16(r, &a->addr)) return -1;
+                break;
+            case TRACE_ACC_ADDR_NEXT:
+                if (i == 0) return -1;
+                a->addr = e->access[i-1].addr + 1;
+                break;
+            case TRACE_ACC_ADDR_SAME:
+                if (i == 0) return -1;
+                a->addr = e->access[i-1].addr;
+                break;
+            }
+
+            a->write = tag & TRACE_ACC_WRITE;
+            if (tag & TRACE_ACC_VALUE) {
+                if (get8(r, &a->value)) return -1;
+            } else if (access_implied(e, a->addr, a->write)) {
+                a->value = e->op[(uint16_t)(a->addr - e->pc)];
+            } else {
+                return -1;
+            }
+        }
+    }
+
+    history_update(h, e);
+    return 0;
+}
+
+void trace_reader_close(TraceReader_t *r)
+{
+    if (r == NULL) return;
+    gzclose(r->gz);
+    free(r);
+}
+
+/* Formats the entry as a single line of text. */
+void trace_entry_format(const struct TraceEntry *e, char *buf, size_t size)
+{
+    const uint16_t *rg = e->regs;
+    int len = snprintf(buf, size,
+        "%12llu %04X %02X %02X %02X %02X  "
+        "AF=%04X BC=%04X DE=%04X HL=%04X AF'=%04X BC'=%04X DE'=%04X HL'=%04X "
+        "IX=%04X IY=%04X SP=%04X IR=%04X WZ=%04X IFF=%d%d IM=%d%s%s ",
+        (unsigned long long)e->time, e->pc, e->op[0], e->op[1], e->op[2], e->op[3],
+        rg[TRACE_AF], rg[TRACE_BC], rg[TRACE_DE], rg[TRACE_HL],
+        rg[TRACE_AF_], rg[TRACE_BC_], rg[TRACE_DE_], rg[TRACE_HL_],
+        rg[TRACE_IX], rg[TRACE_IY], rg[TRACE_SP], rg[TRACE_IR], rg[TRACE_MEMPTR],
+        !!(rg[TRACE_STATE] & TRACE_STATE_IFF1), !!(rg[TRACE_STATE] & TRACE_STATE_IFF2),
+        (rg[TRACE_STATE] >> 2) & 3,
+        rg[TRACE_STATE] & TRACE_STATE_HALTED ? " HALT" : "",
+        rg[TRACE_STATE] & TRACE_STATE_Q ? " Q" : "");
+
+    for (int i = 0; i < e->access_count && len > 0 && (size_t)len < size; i++) {
+        len += snprintf(buf + len, size - len, " %c%04X=%02X",
+                        e->access[i].write ? 'W' : 'R',
+                        e->access[i].addr, e->access[i].value);
+    }
+    if (e->access_overflow && len > 0 && (size_t)len < size) {
+        snprintf(buf + len, size - len, " ...");
+    }
+}
+
+bool trace_entry_equal(const struct TraceEntry *a, const struct TraceEntry *b)
+{
+    if (a->time != b->time || a->pc != b->pc
+        || memcmp(a->op, b->op, sizeof(a->op)) != 0
+        || memcmp(a->regs, b->regs, sizeof(a->regs)) != 0
+        || a->access_count != b->access_count
+        || a->access_overflow != b->access_overflow) {
+        return false;
+    }
+    for (int i = 0; i < a->access_count; i++) {
+        if (a->access[i].addr != b->access[i].addr
+            || a->access[i].value != b->access[i].value
+            || a->access[i].write != b->access[i].write) {
+            return false;
+        }
+    }
+    return true;
+}
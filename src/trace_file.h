@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define TRACE_MAX_ACCESSES 16
+
+// in order of how often they change, as that's how the file stores them
+enum TraceReg {
+    TRACE_AF,
+    TRACE_BC,
+    TRACE_DE,
+    TRACE_HL,
+    TRACE_IX,
+    TRACE_IY,
+    TRACE_SP,
+    TRACE_MEMPTR,
+    TRACE_AF_,
+    TRACE_BC_,
+    TRACE_DE_,
+    TRACE_HL_,
+    TRACE_IR,
+    TRACE_STATE,    // see TRACE_STATE_* bits
+    TRACE_REG_COUNT,
+};
+
+#define TRACE_STATE_IFF1    (1 << 0)
+#define TRACE_STATE_IFF2    (1 << 1)
+#define TRACE_STATE_IM(im)  ((im) << 2)
+#define TRACE_STATE_HALTED  (1 << 4)
+#define TRACE_STATE_Q       (1 << 5)
+
+struct TraceAccess {
+    uint16_t addr;
+    uint8_t value;
+    bool write;
+};
+
+/* One executed instruction, with the cpu state from before it and
+ * every memory bus access it did, opcode fetches included. */
+struct TraceEntry {
+    uint64_t time;          // cpu cycle count it started at
+    uint16_t pc;
+    uint8_t op[4];          // bytes at pc
+    uint16_t regs[TRACE_REG_COUNT];
+    uint8_t access_count;
+    bool access_overflow;   // there were more than TRACE_MAX_ACCESSES
+    struct TraceAccess access[TRACE_MAX_ACCESSES];
+};
+
+typedef struct TraceWriter TraceWriter_t;
+typedef struct TraceReader TraceReader_t;
+
+TraceWriter_t *trace_writer_open(const char *path);
+int trace_writer_add(TraceWriter_t *w, const struct TraceEntry *e);
+int trace_writer_close(TraceWriter_t *w);
+
+TraceReader_t *trace_reader_open(const char *path);
+int trace_reader_next(TraceReader_t *r, struct TraceEntry *e);
+void trace_reader_close(TraceReader_t *r);
+
+void trace_entry_format(const struct TraceEntry *e, char *buf, size_t size);
+bool trace_entry_equal(const struct TraceEntry *a, const struct TraceEntry *b);
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace_file.h"
+
+/* sleepdart-trace, dumps or compares instruction traces written
+ * with sleepdart --trace. */
+
+#define LINE_LEN 512
+#define DIFF_CONTEXT 8
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "usage: sleepdart-trace dump <trace> [first] [count]\n"
+        "       sleepdart-trace diff <trace a> <trace b>\n");
+}
+
+static TraceReader_t *open_trace(const char *path)
+{
+    TraceReader_t *r = trace_reader_open(path);
+    if (r == NULL) fprintf(stderr, "Failed to open trace \"%s\"\n", path);
+    return r;
+}
+
+static void print_entry(const char *prefix, const struct TraceEntry *e)
+{
+    char line[LINE_LEN];
+    trace_entry_format(e, line, sizeof(line));
+    printf("%s%s\n", prefix, line);
+}
+
+static int dump(const char *path, unsigned long long first, unsigned long long count)
+{
+    TraceReader_t *r = open_trace(path);
+    if (r == NULL) return 1;
+
+    struct TraceEntry e;
+    unsigned long long i = 0;
+    int err = 0;
+    while (count && (err = trace_reader_next(r, &e)) == 0) {
+        if (i++ < first) continue;
+        print_entry("", &e);
+        count--;
+    }
+    trace_reader_close(r);
+
+    if (err < 0) {
+        fprintf(stderr, "Trace \"%s\" is broken after %llu records\n", path, i);
+        return 1;
+    }
+    return 0;
+}
+
+/* Reports the first record where the traces differ,
+ * with the records leading up to it. */
+static int diff(const char *path_a, const char *path_b)
+{
+    TraceReader_t *a = open_trace(path_a);
+    TraceReader_t *b = open_trace(path_b);
+    if (a == NULL || b == NULL) {
+        trace_reader_close(a);
+        trace_reader_close(b);
+        return 2;
+    }
+
+    struct TraceEntry history[DIFF_CONTEXT];
+    struct TraceEntry ea, eb;
+    unsigned long long i = 0;
+    int ret = 0;
+
+    for (;; i++) {
+        int ra = trace_reader_next(a, &ea);
+        int rb = trace_reader_next(b, &eb);
+        if (ra < 0 || rb < 0) {
+            fprintf(stderr, "Trace \"%s\" is broken after %llu records\n",
+                    ra < 0 ? path_a : path_b, i);
+            ret = 2;
+            break;
+        }
+        if (ra == 1 && rb == 1) {
+            printf("Traces match, %llu records\n", i);
+            break;
+        }
+        if (ra == 1 || rb == 1) {
+            printf("Trace \"%s\" ends after %llu records\n", ra == 1 ? path_a : path_b, i);
+            ret = 1;
+            break;
+        }
+        if (!trace_entry_equal(&ea, &eb)) {
+            printf("Traces differ at record %llu:\n", i);
+            unsigned long long n = i < DIFF_CONTEXT ? i : DIFF_CONTEXT;
+            for (unsigned long long j = i - n; j < i; j++) {
+                print_entry("  ", &history[j % DIFF_CONTEXT]);
+            }
+            print_entry("a ", &ea);
+            print_entry("b ", &eb);
+            ret = 1;
+            break;
+        }
+        history[i % DIFF_CONTEXT] = ea;
+    }
+
+    trace_reader_close(a);
+    trace_reader_close(b);
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc >= 3 && argc <= 5 && strcmp(argv[1], "dump") == 0) {
+        unsigned long long first = argc > 3 ? strtoull(argv[3], NULL, 0) : 0;
+        unsigned long long count = argc > 4 ? strtoull(argv[4], NULL, 0) : ~0ULL;
+        return dump(argv[2], first, count);
+    }
+    if (argc == 4 && strcmp(argv[1], "diff") == 0) {
+        return diff(argv[2], argv[3]);
+    }
+
+    usage();
+    return 2;
+}
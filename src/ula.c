@@ -1,23 +1,21 @@
 #include "ula.h"
 #include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL3/SDL_timer.h>
 #include "machine.h"
+#include "log.h"
 
-struct WriteBorder
-{
-    int cycle;
-    int value;
-};
-
-struct WriteScreen
-{
-    int cycle;
-    int value;
-    int address;
-};
+#ifdef _WIN32
+    #include <malloc.h>
+#endif
 
-RGB24_t ula_buffer[BUFFER_LEN];
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define ULA_SSE2
+#endif
 
-RGB24_t colors[] = {
+static const RGB24_t default_colors[16] = {
     {.r = 0x00, .g = 0x00, .b = 0x00}, // black
     {.r = 0x00, .g = 0x00, .b = 0xD8}, // blue
     {.r = 0xD8, .g = 0x00, .b = 0x00}, // red
@@ -37,240 +35,486 @@ RGB24_t colors[] = {
     {.r = 0xFF, .g = 0xFF, .b = 0xFF}, // white
 };
 
-uint8_t border = 0;
-uint8_t frame = 0;
+static const uint8_t contention_pattern[] = {6, 5, 4, 3, 2, 1, 0, 0};
 
-#define ULA_WRITES_SIZE 20000
-struct WriteBorder writes_border[ULA_WRITES_SIZE];
-size_t border_write_index = 0;
-struct WriteScreen writes_screen[ULA_WRITES_SIZE];
-size_t screen_write_index = 0;
+static void build_contention_tables(Ula_t *ula);
 
-uint8_t screen_dirty[0x1B00];
-
-uint8_t contention_pattern[] = {6, 5, 4, 3, 2, 1, 0, 0};
-
-struct MachineTiming timing;
-Memory_t *mem;
-uint64_t first_border_cycle;
-
-void ula_reset_screen_dirty()
+static void build_cell_tables(Ula_t *ula)
 {
-    for (size_t i = 0; i < ULA_WRITES_SIZE; i++) {
-        writes_screen[i].cycle = -1;
-    }
+    for (int phase = 0; phase < 2; phase++) {
+        for (int attrib = 0; attrib < 256; attrib++) {
+            int bright = (attrib >> 6) & 1;
+            uint8_t paper = bright*8 + ((attrib >> 3) & 7);
+            uint8_t ink = bright*8 + (attrib & 7);
+            if (phase && (attrib & (1<<7))) {
+                uint8_t tmp = paper;
+                paper = ink;
+                ink = tmp;
+            }
 
-    screen_write_index = 0;
+            uint8_t p[8], d[8];
+            memset(p, paper, sizeof(p));
+            memset(d, paper ^ ink, sizeof(d));
+            memcpy(&ula->cell_paper[phase][attrib], p, sizeof(p));
+            memcpy(&ula->cell_diff[phase][attrib], d, sizeof(d));
+        }
+    }
 
-    for (size_t i = 0; i < sizeof(screen_dirty); i++) {
-        screen_dirty[i] = mem->bus[0x4000 + i];
+    for (int pixel = 0; pixel < 256; pixel++) {
+        uint8_t m[8];
+        for (int i = 0; i < 8; i++) {
+            m[i] = (pixel & (0x80 >> i)) ? 0xFF : 0x00;
+        }
+        memcpy(&ula->pixel_mask[pixel], m, sizeof(m));
     }
 }
 
-void ula_init(struct Machine *ctx)
+/* Returns zero on success, non-zero if the buffer couldn't be allocated. */
+int ula_init(Ula_t *ula, struct Machine *ctx)
 {
-    timing = ctx->timing;
-    mem = &ctx->memory;
-
-    first_border_cycle = timing.t_firstpx 
-                       - timing.t_scanline * (BUFFER_HEIGHT - 192) / 2 
-                       - timing.t_eightpx * (BUFFER_WIDTH - 256) / 8 / 2; 
-
-    for (size_t i = 0; i < ULA_WRITES_SIZE; i++) {
-        writes_border[i] = (struct WriteBorder){ .cycle = -1 };
+    // the palette is kept when a snapshot load reinitializes the machine
+    if (ula->ctx == NULL) {
+        memcpy(ula->colors, default_colors, sizeof(ula->colors));
     }
-
-    for (size_t i = 0; i < BUFFER_LEN; i++) {
-        ula_buffer[i] = (RGB24_t){ .r = 0, .g = 0, .b = 0 };
+    ula->ctx = ctx;
+
+    const struct MachineTiming *timing = &ctx->timing;
+    ula->first_border_cycle = timing->t_firstpx 
+                            - timing->t_scanline * (BUFFER_HEIGHT - 192) / 2 
+                            - timing->t_eightpx * (BUFFER_WIDTH - 256) / 8 / 2; 
+
+    ula->border_pos = 0;
+    ula->screen_cell = 0;
+
+    // kept when a snapshot load reinitializes the machine, like the memory
+    if (ula->buffer == NULL) {
+#ifdef _WIN32
+        ula->buffer = _aligned_malloc(BUFFER_LEN, 64);
+#else
+        ula->buffer = aligned_alloc(64, BUFFER_LEN);
+#endif
+        if (ula->buffer == NULL) {
+            dlog(LOG_ERR, "%s: malloc fail", __func__);
+            return -1;
+        }
     }
 
-    ula_reset_screen_dirty();
+    // screen memory filled in before the first frame is drawn,
+    // like by snapshot loads, still shows up this way
+    memset(ula->buffer, 0, BUFFER_LEN);
+    memset(ula->line_dirty, 0xFF, sizeof(ula->line_dirty));
+    ula->border_clean = false;
+    ula->border_changed = false;
+
+    build_contention_tables(ula);
+    build_cell_tables(ula);
+    return 0;
+}
+
+void ula_deinit(Ula_t *ula)
+{
+    free(ula->contention_table);
+    ula->contention_table = NULL;
+    ula->contention_table_len = 0;
+
+#ifdef _WIN32
+    _aligned_free(ula->buffer);
+#else
+    free(ula->buffer);
+#endif
+    ula->buffer = NULL;
 }
 
-void ula_set_palette(Palette_t *palette)
+void ula_set_palette(Ula_t *ula, Palette_t *palette)
 {
     if (palette->colors != 16) {
         return;
     }
 
     for (size_t i = 0; i < 16; i++) {
-        colors[i].r = palette->color[i].r;
-        colors[i].g = palette->color[i].g;
-        colors[i].b = palette->color[i].b;
+        ula->colors[i].r = palette->color[i].r;
+        ula->colors[i].g = palette->color[i].g;
+        ula->colors[i].b = palette->color[i].b;
     }
 }
 
-uint8_t ula_get_contention_cycles(uint64_t cycle)
+static inline uint8_t contention_at(const struct MachineTiming *timing, uint64_t cycle)
 {
-    if (cycle < timing.t_firstpx) return 0;
-    cycle -= timing.t_firstpx;
+    if (cycle < timing->t_firstpx) return 0;
+    cycle -= timing->t_firstpx;
 
-    uint16_t line = cycle / timing.t_scanline;
+    uint16_t line = cycle / timing->t_scanline;
     if (line >= 192) return 0;
 
-    uint16_t linecyc = cycle % timing.t_scanline;
-    if (linecyc >= timing.t_screen) return 0;
+    uint16_t linecyc = cycle % timing->t_scanline;
+    if (linecyc >= timing->t_screen) return 0;
 
     return contention_pattern[linecyc % 8];
 }
 
-void ula_set_border(uint8_t color, uint64_t cycle)
+/* see https://sinclair.wiki.zxnet.co.uk/wiki/Contended_I/O for details */
+static uint8_t io_contention_at(const struct MachineTiming *timing,
+                                enum UlaIoContention pattern, uint64_t cycle)
 {
-    struct WriteBorder w = {.cycle = cycle, .value = color & 7};
-    writes_border[border_write_index] = w;
-    if (border_write_index < ULA_WRITES_SIZE-2) border_write_index++;
+    uint8_t contention = 0;
+    switch (pattern) 
+    {
+    case ULA_IO_EVEN:
+        cycle += 1;
+        contention = contention_at(timing, cycle);
+        break;
+    case ULA_IO_ODD:
+        break;
+    case ULA_IO_CONTENDED_EVEN:
+        contention = contention_at(timing, cycle);
+        cycle += 1;
+        contention += contention_at(timing, cycle+contention);
+        break;
+    case ULA_IO_CONTENDED_ODD:
+        contention = contention_at(timing, cycle);
+        cycle += 1;
+        contention += contention_at(timing, cycle+contention);
+        cycle += 1;
+        contention += contention_at(timing, cycle+contention);
+        cycle += 1;
+        contention += contention_at(timing, cycle+contention);
+        break;
+    }
+    return contention;
 }
 
-uint8_t ula_get_border()
+static void build_contention_tables(Ula_t *ula)
 {
-    return border;
+    const struct MachineTiming *timing = &ula->ctx->timing;
+
+    free(ula->contention_table);
+    ula->contention_table_len = 0;
+
+    // one table for memory, one for each I/O pattern
+    ula->contention_table = malloc(5 * timing->t_frame);
+    if (ula->contention_table == NULL) {
+        dlog(LOG_ERR, "%s: malloc fail", __func__);
+        return;
+    }
+
+    for (size_t i = 0; i < timing->t_frame; i++) {
+        ula->contention_table[i] = contention_at(timing, i);
+    }
+
+    for (int p = 0; p < 4; p++) {
+        ula->io_contention_table[p] = ula->contention_table + (p + 1) * timing->t_frame;
+        for (size_t i = 0; i < timing->t_frame; i++) {
+            ula->io_contention_table[p][i] = io_contention_at(timing, p, i);
+        }
+    }
+
+    ula->contention_table_len = timing->t_frame;
 }
 
-void ula_write_screen(uint64_t cycle, uint8_t value, uint64_t addr)
+static inline void trace_record(Ula_t *ula, uint64_t cycle, uint8_t kind, uint8_t contention)
 {
-    struct WriteScreen w = {.cycle = cycle, .value = value, .address = addr-0x4000};
-    writes_screen[screen_write_index] = w;
-    if (screen_write_index < ULA_WRITES_SIZE-2) screen_write_index++;
+    struct UlaContentionTrace *t = ula->contention_trace;
+    if (t->len < ULA_TRACE_LEN) {
+        t->ofs[t->len] = cycle - t->base - t->total;
+        t->kind[t->len] = kind;
+        t->len++;
+    } else {
+        t->overflow = true;
+    }
+    t->total += contention;
 }
 
-static inline uint8_t ula_get_screen_byte(uint16_t offset)
+/* Returns the amount of cycles a memory access to 0x4000-0x7FFF
+ * starting at the given cycle is delayed by. */
+uint8_t ula_get_contention_cycles(Ula_t *ula, uint64_t cycle)
 {
-    return screen_dirty[offset];
+    // nothing past the frame is contended
+    return cycle < ula->contention_table_len ? ula->contention_table[cycle] : 0;
 }
 
-static inline void ula_process_screen_8x1(uint8_t x, uint8_t y, RGB24_t *buf)
+/* Returns the amount of cycles a port access starting at the given cycle
+ * is delayed by in total. */
+uint8_t ula_get_io_contention_cycles(Ula_t *ula, enum UlaIoContention pattern, uint64_t cycle)
 {
-    int cycle = timing.t_firstpx + y * timing.t_scanline + x * timing.t_eightpx;
-    struct WriteScreen w = writes_screen[screen_write_index];
+    return cycle < ula->contention_table_len ? ula->io_contention_table[pattern][cycle] : 0;
+}
 
-    while (w.cycle >= 0) {
-        if (cycle < w.cycle) {
-            break;
-        }
-        screen_dirty[w.address] = w.value;
-        screen_write_index++;
-        w = writes_screen[screen_write_index];
-    }
+/* The lookups above, also recorded into the trace set by ula_trace_contention(). */
+uint8_t ula_trace_contention_cycles(Ula_t *ula, uint64_t cycle)
+{
+    uint8_t contention = ula_get_contention_cycles(ula, cycle);
+    trace_record(ula, cycle, 0, contention);
+    return contention;
+}
 
-    uint16_t pix_offset = x;
-    pix_offset |= (y & 7) << 8;    // bits 0-2
-    pix_offset |= (y & 0x38) << 2; // bits 3-5
-    pix_offset |= (y & 0xC0) << 5; // bits 6-7
+uint8_t ula_trace_io_contention_cycles(Ula_t *ula, enum UlaIoContention pattern, uint64_t cycle)
+{
+    uint8_t contention = ula_get_io_contention_cycles(ula, pattern, cycle);
+    trace_record(ula, cycle, 1 + pattern, contention);
+    return contention;
+}
 
-    uint16_t attrib_offset = 0x1800 + (((y >> 3) << 5) | x);
+/* Sets the trace the ula_trace_*() lookups record into, NULL if none.
+ * Contended memory pages only use them while memory_trace_contention()
+ * is on. */
+void ula_trace_contention(Ula_t *ula, struct UlaContentionTrace *trace)
+{
+    ula->contention_trace = trace;
+}
 
-    uint8_t attrib = ula_get_screen_byte(attrib_offset);
-    uint8_t pixel = ula_get_screen_byte(pix_offset);
+/* Returns the total contention the traced accesses
+ * would run into if they started at the given cycle. */
+uint64_t ula_trace_replay(Ula_t *ula, const struct UlaContentionTrace *trace, uint64_t start)
+{
+    uint64_t total = 0;
+    for (unsigned int i = 0; i < trace->len; i++) {
+        uint64_t cycle = start + trace->ofs[i] + total;
+        if (trace->kind[i] == 0) {
+            total += ula_get_contention_cycles(ula, cycle);
+        } else {
+            total += ula_get_io_contention_cycles(ula, trace->kind[i] - 1, cycle);
+        }
+    }
+    return total;
+}
 
-    int bright = (attrib>>6) & 1;
+/* The frame gets drawn as the CPU advances: any write the ULA would see
+ * first draws everything the beam has passed before it, using the state
+ * from before the write. What's left is drawn once the frame ends. */
 
-    int flash = attrib & (1<<7);
-    RGB24_t ink_paper[2];
-    ink_paper[0] = colors[bright*8 + ((attrib >> 3) & 7)];
-    ink_paper[1] = colors[bright*8 + (attrib & 7)];
-    bool flip = flash && ((frame % 32) > 16);
+#define SCREEN_X ((BUFFER_WIDTH - 256) / 2)
+#define SCREEN_Y ((BUFFER_HEIGHT - 192) / 2)
+#define SCREEN_CELLS (32 * 192)
 
-    buf += 7;
-    for (int i = 0; i < 8; i++) {
-        uint8_t p = (pixel >> i) & 1;
-        *buf = ink_paper[p ^ flip];
-        buf--;
-    }
+// where the 32 bytes of a pixel line are, in one piece as they share a page
+static inline uint16_t ula_pixel_line_addr(uint8_t y)
+{
+    uint16_t addr = 0x4000;
+    addr |= (y & 7) << 8;    // bits 0-2
+    addr |= (y & 0x38) << 2; // bits 3-5
+    addr |= (y & 0xC0) << 5; // bits 6-7
+    return addr;
 }
 
-static inline void ula_fill_border_8x1(RGB24_t *buf)
+static inline void ula_process_screen_8x1(const Ula_t *ula, uint8_t pixel, uint8_t attrib,
+                                          int flash_phase, uint8_t *buf)
 {
-    RGB24_t color = colors[border];
+    uint64_t out = ula->cell_paper[flash_phase][attrib]
+                 ^ (ula->cell_diff[flash_phase][attrib] & ula->pixel_mask[pixel]);
+    memcpy(buf, &out, sizeof(out));
+}
 
-    for (uint8_t i = 0; i < 8; i++) {
-        *buf = color;
-        buf++;
+/* All 32 cells of a pixel line, as when the whole screen gets redrawn. */
+static inline void ula_process_screen_line(const Ula_t *ula, const uint8_t *pixels,
+                                           const uint8_t *attribs, int flash_phase,
+                                           uint8_t *buf)
+{
+#ifdef ULA_SSE2
+    // two cells at a time, each pixel byte copied to all 8 bytes of a cell
+    // and compared against its bits to make the mask
+    const __m128i bits = _mm_set1_epi64x(0x0102040810204080ll);
+    const uint64_t *paper = ula->cell_paper[flash_phase];
+    const uint64_t *diff = ula->cell_diff[flash_phase];
+    for (int x = 0; x < 32; x += 2) {
+        __m128i p = _mm_set_epi64x(pixels[x + 1] * 0x0101010101010101ull,
+                                   pixels[x] * 0x0101010101010101ull);
+        __m128i mask = _mm_cmpeq_epi8(_mm_and_si128(p, bits), bits);
+        __m128i out = _mm_xor_si128(_mm_set_epi64x(paper[attribs[x + 1]], paper[attribs[x]]),
+                                    _mm_and_si128(mask, _mm_set_epi64x(diff[attribs[x + 1]],
+                                                                       diff[attribs[x]])));
+        _mm_storeu_si128((__m128i *)&buf[x * 8], out);
     }
+#else
+    for (int x = 0; x < 32; x++) {
+        ula_process_screen_8x1(ula, pixels[x], attribs[x], flash_phase, &buf[x * 8]);
+    }
+#endif
 }
 
-static inline int get_cycle_buf_pos(uint64_t cycle)
+/* Buffer position the border has been drawn up to at a cycle,
+ * in whole groups of 8 pixels. */
+static int border_pos_at(const Ula_t *ula, uint64_t cycle)
 {
-    if (cycle < first_border_cycle) 
-        return -1;
+    if (cycle < ula->first_border_cycle) 
+        return 0;
 
-    cycle -= first_border_cycle;
+    cycle -= ula->first_border_cycle;
 
-    int x = (cycle % timing.t_scanline) * 2;
-    int y = cycle / timing.t_scanline;
+    uint64_t t_scanline = ula->ctx->timing.t_scanline;
+    uint64_t y = cycle / t_scanline;
+    if (y >= BUFFER_HEIGHT)
+        return BUFFER_LEN;
 
+    int x = (cycle % t_scanline) * 2;
     if (x > BUFFER_WIDTH) 
         x = BUFFER_WIDTH;
 
-    int result = y * BUFFER_WIDTH + x;
-
-    if (result < BUFFER_LEN)
-        return result;
-
-    return -2;
+    return ((y * BUFFER_WIDTH + x) >> 3) << 3;
 }
 
-static inline void ula_process_border(RGB24_t *buf)
+// the screen area is left alone, it gets drawn over by the cells
+static void ula_draw_border(Ula_t *ula, int to)
 {
-    int last_buf_pos = 0;
-    size_t write_i;
-    struct WriteBorder w = {.cycle = -1};
-    for (write_i = 0; write_i < ULA_WRITES_SIZE-1; write_i++) {
-        w = writes_border[write_i];
-        if (w.cycle < 0) break;
-        int pos = get_cycle_buf_pos(w.cycle);
-        switch (pos)
-        {
-        case -1:
-            border = w.value;
-            break;
-        case -2:
-            for (int i = (last_buf_pos>>3)<<3; i < BUFFER_LEN; i+=8) {
-                ula_fill_border_8x1(&buf[i]);
+    int from = ula->border_pos;
+    if (from >= to) return;
+    ula->border_pos = to;
+    if (ula->border_clean) return;
+    uint64_t start = ula->timed ? SDL_GetTicksNS() : 0;
+
+    uint8_t color = ula->border;
+    uint8_t *buf = ula->buffer;
+
+    while (from < to) {
+        int y = from / BUFFER_WIDTH;
+        int line = y * BUFFER_WIDTH;
+        int end = line + BUFFER_WIDTH < to ? line + BUFFER_WIDTH : to;
+
+        if (y >= SCREEN_Y && y < SCREEN_Y + 192) {
+            int left = line + SCREEN_X;
+            int right = left + 256;
+            if (from < left) {
+                memset(&buf[from], color, (end < left ? end : left) - from);
             }
-            border = w.value;
-            last_buf_pos = BUFFER_LEN;
-            break;
-        default:
-            for (int i = (last_buf_pos>>3)<<3; i < (pos>>3)<<3; i+=8) {
-                ula_fill_border_8x1(&buf[i]);
-            }
-            last_buf_pos = pos;
-            border = w.value;
+            if (from < right) from = right;
+        }
+        if (from < end) {
+            memset(&buf[from], color, end - from);
         }
+        from = line + BUFFER_WIDTH;
+    }
+
+    if (ula->timed) {
+        ula->draw_ns += SDL_GetTicksNS() - start;
+        ula->draw_calls++;
+    }
+}
+
+/* Number of screen cells the beam has reached by a cycle. A cell shows
+ * writes made at its own cycle or earlier. */
+static int screen_cell_at(const Ula_t *ula, uint64_t cycle)
+{
+    const struct MachineTiming *timing = &ula->ctx->timing;
+    if (cycle <= timing->t_firstpx) {
+        return 0;
     }
 
-    for (int i = (last_buf_pos>>3)<<3; i < BUFFER_LEN; i+=8) {
-        ula_fill_border_8x1(&buf[i]);
+    uint64_t t = cycle - timing->t_firstpx;
+    uint64_t y = t / timing->t_scanline;
+    if (y >= 192) {
+        return SCREEN_CELLS;
     }
 
-    for (size_t i = 0; i < write_i+1; i++) {
-        writes_border[i].cycle = -1;
+    uint64_t x = (t % timing->t_scanline + timing->t_eightpx - 1) / timing->t_eightpx;
+    if (x > 32) x = 32;
+
+    return y * 32 + x;
+}
+
+static void ula_draw_screen(Ula_t *ula, int to)
+{
+    int from = ula->screen_cell;
+    if (from >= to) return;
+    ula->screen_cell = to;
+    uint64_t start = ula->timed ? SDL_GetTicksNS() : 0;
+
+    const Memory_t *mem = ula->ctx->memory;
+    int flash_phase = (ula->frame % 32) > 16;
+    int drawn = 0;
+
+    while (from < to) {
+        int y = from >> 5;
+        int end = (y + 1) * 32 < to ? (y + 1) * 32 : to;
+
+        // the cells in [from, end) on this line
+        uint32_t range = (uint32_t)((1ull << (end - y * 32)) - (1ull << (from & 31)));
+        uint32_t dirty = ula->line_dirty[y] & range;
+        ula->line_dirty[y] &= ~dirty;
+
+        const uint8_t *pixels = memory_host_ptr(mem, ula_pixel_line_addr(y));
+        const uint8_t *attribs = memory_host_ptr(mem, 0x5800 + (y >> 3) * 32);
+        uint8_t *buf = &ula->buffer[(SCREEN_Y + y) * BUFFER_WIDTH + SCREEN_X];
+        if (dirty == 0xFFFFFFFF) {
+            ula_process_screen_line(ula, pixels, attribs, flash_phase, buf);
+            drawn += 32;
+            dirty = 0;
+        }
+        for (int x = 0; dirty; x++, dirty >>= 1) {
+            if (dirty & 1) {
+                ula_process_screen_8x1(ula, pixels[x], attribs[x], flash_phase, &buf[x * 8]);
+                drawn++;
+            }
+        }
+        from = end;
     }
 
-    border_write_index = 0;
+    if (ula->timed) {
+        ula->draw_ns += SDL_GetTicksNS() - start;
+        ula->draw_calls++;
+        ula->cells_drawn += drawn;
+    }
 }
 
-void ula_draw_frame()
+void ula_set_border(Ula_t *ula, uint8_t color, uint64_t cycle)
 {
-    RGB24_t *bufptr = ula_buffer;
-    ula_process_border(bufptr);
+    color &= 7;
+    if (color == ula->border) return;
 
-    int screen_startx = (BUFFER_WIDTH - 256) / 2;
-    int screen_starty = (BUFFER_HEIGHT - 192) / 2;
-    int buf_borderwidth = BUFFER_WIDTH - 256;
+    ula_draw_border(ula, border_pos_at(ula, cycle));
+    ula->border = color;
+    ula->border_clean = false;
+    ula->border_changed = true;
+}
 
-    bufptr = &ula_buffer[BUFFER_WIDTH * screen_starty + screen_startx];
-    screen_write_index = 0;
+uint8_t ula_get_border(const Ula_t *ula)
+{
+    return ula->border;
+}
 
-    for (int y = 0; y < 192; y++) {
-        for (int x = 0; x < 32; x++) {
-            ula_process_screen_8x1(x, y, bufptr);
-            bufptr += 8;
+/* Marks the cells showing the screen memory address as dirty,
+ * an attribute covers all 8 lines of its cell. */
+void ula_write_screen(Ula_t *ula, uint16_t addr, uint64_t cycle)
+{
+    ula_draw_screen(ula, screen_cell_at(ula, cycle));
+
+    uint16_t offset = addr - 0x4000;
+    uint32_t cell = 1u << (offset & 31);
+    if (offset < 0x1800) {
+        uint8_t y = ((offset >> 8) & 7) | ((offset >> 2) & 0x38) | ((offset >> 5) & 0xC0);
+        ula->line_dirty[y] |= cell;
+    } else if (offset < 0x1B00) {
+        uint32_t *lines = &ula->line_dirty[((offset - 0x1800) >> 5) * 8];
+        for (int i = 0; i < 8; i++) {
+            lines[i] |= cell;
         }
-        bufptr += buf_borderwidth;
     }
+}
 
-    ula_reset_screen_dirty();
-
-    frame++;
+void ula_draw_frame(Ula_t *ula)
+{
+    ula_draw_border(ula, BUFFER_LEN);
+    ula_draw_screen(ula, SCREEN_CELLS);
+
+    ula->border_pos = 0;
+    ula->screen_cell = 0;
+    ula->border_clean = !ula->border_changed;
+    ula->border_changed = false;
+
+    bool flash_phase = (ula->frame % 32) > 16;
+    ula->frame++;
+
+    // flashing cells swap ink and paper
+    if (flash_phase != ((ula->frame % 32) > 16)) {
+        for (int row = 0; row < 24; row++) {
+            const uint8_t *attribs = memory_host_ptr(ula->ctx->memory, 0x5800 + row * 32);
+            uint32_t cells = 0;
+            for (int x = 0; x < 32; x++) {
+                if (attribs[x] & (1<<7)) {
+                    cells |= 1u << x;
+                }
+            }
+            for (int i = 0; i < 8; i++) {
+                ula->line_dirty[row * 8 + i] |= cells;
+            }
+        }
+    }
 }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include "palette.h"
 
 #define BUFFER_WIDTH 352
@@ -14,15 +16,85 @@ typedef struct RGB24
     uint8_t b;
 } RGB24_t;
 
-extern RGB24_t ula_buffer[BUFFER_WIDTH*BUFFER_HEIGHT];
+_Static_assert(sizeof(RGB24_t) == 3, "RGB24_t gets handed out as packed bytes");
+
+// port access contention patterns, depending on whether the high byte
+// "looks" like contended memory to the ULA and on bit 0 of the port
+enum UlaIoContention
+{
+    ULA_IO_EVEN,            // N:1, C:3
+    ULA_IO_ODD,             // N:4
+    ULA_IO_CONTENDED_EVEN,  // C:1, C:3
+    ULA_IO_CONTENDED_ODD,   // C:1, C:1, C:1, C:1
+};
+
+#define ULA_TRACE_LEN 64
+
+// records when contention got looked up, relative to an uncontended
+// timeline, so the same accesses can be replayed at a different time
+struct UlaContentionTrace
+{
+    uint64_t base;      // cycle the offsets are relative to
+    uint64_t total;     // contention added so far
+    unsigned int len;
+    bool overflow;
+    uint32_t ofs[ULA_TRACE_LEN];
+    uint8_t kind[ULA_TRACE_LEN];    // 0 for memory, 1 + pattern for I/O
+};
 
 struct Machine;
 
-void ula_init(struct Machine *ctx);
-void ula_reset_screen_dirty();
-uint8_t ula_get_contention_cycles(uint64_t cycle);
-void ula_set_border(uint8_t color, uint64_t cycle);
-uint8_t ula_get_border();
-void ula_write_screen(uint64_t cycle, uint8_t value, uint64_t addr);
-void ula_draw_frame();
-void ula_set_palette(Palette_t *palette);
+typedef struct Ula
+{
+    // looked up on every contended access
+    uint8_t *contention_table;          // contention by T-state for a whole frame
+    uint8_t *io_contention_table[4];
+    size_t contention_table_len;
+    struct UlaContentionTrace *contention_trace;
+
+    struct Machine *ctx;
+    uint64_t first_border_cycle;
+    uint8_t border;
+    uint8_t frame;
+    RGB24_t colors[16];
+
+    // a cell's 8 pixels are paper ^ (ink ^ paper & mask),
+    // with the color indices by flash phase and attribute
+    uint64_t cell_paper[2][256];
+    uint64_t cell_diff[2][256];
+    uint64_t pixel_mask[256];   // all ones for set bits
+
+    // how far the current frame has been drawn
+    int border_pos;     // buffer position, multiple of 8
+    int screen_cell;    // 32 per pixel line
+
+    // what the buffer doesn't show yet, a bit per cell on each pixel line
+    uint32_t line_dirty[192];
+    bool border_clean;      // the whole border is in the current color
+    bool border_changed;    // during this frame
+
+    // host time spent drawing, only measured for the benchmark
+    bool timed;
+    uint64_t draw_ns;
+    uint64_t draw_calls;
+    uint64_t cells_drawn;   // 8 pixel wide screen cells
+
+    // BUFFER_LEN indices into colors, only turned into RGB when it gets shown,
+    // allocated on its own as most of it is only touched once a frame
+    uint8_t *buffer;
+} Ula_t;
+
+int ula_init(Ula_t *ula, struct Machine *ctx);
+void ula_deinit(Ula_t *ula);
+uint8_t ula_get_contention_cycles(Ula_t *ula, uint64_t cycle);
+uint8_t ula_get_io_contention_cycles(Ula_t *ula, enum UlaIoContention pattern, uint64_t cycle);
+uint8_t ula_trace_contention_cycles(Ula_t *ula, uint64_t cycle);
+uint8_t ula_trace_io_contention_cycles(Ula_t *ula, enum UlaIoContention pattern, uint64_t cycle);
+void ula_trace_contention(Ula_t *ula, struct UlaContentionTrace *trace);
+uint64_t ula_trace_replay(Ula_t *ula, const struct UlaContentionTrace *trace, uint64_t start);
+void ula_set_border(Ula_t *ula, uint8_t color, uint64_t cycle);
+uint8_t ula_get_border(const Ula_t *ula);
+// call before a write changing screen memory lands
+void ula_write_screen(Ula_t *ula, uint16_t addr, uint64_t cycle);
+void ula_draw_frame(Ula_t *ula);
+void ula_set_palette(Ula_t *ula, Palette_t *palette);
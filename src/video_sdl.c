@@ -229,7 +229,35 @@ int video_sdl_init(const char *title, int width, int height, int scale)
     return 0;
 }
 
-int video_sdl_draw_rgb24_buffer(void *pixeldata, size_t bytes)
+/* Expands color indices to RGB24 two pixels at a time. The 8-byte stores
+ * spill into the next pair, so the last one on a row is done per pixel. */
+static void expand_indexed(uint8_t *dst, int pitch, const uint8_t *src, const uint8_t *palette)
+{
+    uint64_t pairs[256];
+    for (int i = 0; i < 256; i++) {
+        const uint8_t *a = &palette[(i & 15) * 3];
+        const uint8_t *b = &palette[(i >> 4) * 3];
+        uint8_t px[8] = { a[0], a[1], a[2], b[0], b[1], b[2], 0, 0 };
+        memcpy(&pairs[i], px, sizeof(px));
+    }
+
+    for (int y = 0; y < buffer_height; y++) {
+        const uint8_t *s = &src[y * buffer_width];
+        uint8_t *d = &dst[y * pitch];
+        int x = 0;
+        for (; x < buffer_width - 2; x += 2) {
+            uint64_t v = pairs[(s[x] & 15) | (s[x+1] & 15) << 4];
+            memcpy(&d[x * 3], &v, sizeof(v));
+        }
+        for (; x < buffer_width; x++) {
+            memcpy(&d[x * 3], &palette[(s[x] & 15) * 3], 3);
+        }
+    }
+}
+
+/* Takes one byte per pixel indexing a palette of 16 RGB24 colors,
+ * which only gets expanded for frames that end up being shown. */
+int video_sdl_draw_indexed_buffer(const uint8_t *pixeldata, size_t len, const uint8_t *palette)
 {
     if (!window) return 0;
 
@@ -248,17 +276,17 @@ int video_sdl_draw_rgb24_buffer(void *pixeldata, size_t bytes)
         // with uncapped fps lol
         ticks_last = ticks;
 
-        if (!SDL_LockTexture(texture, NULL, &pixels, &pitch)) {
-            sdl_log_error("SDL_LockTexture");
+        if ((size_t)buffer_height*buffer_width != len) {
+            dlog(LOG_ERR, "%s: buffer size mismatch", __func__);
+            return -1;
         }
 
-        size_t dstbytes = 3*buffer_height*buffer_width;
-        if (dstbytes != bytes) {
-            dlog(LOG_ERR, "%s: dstbytes != bytes", __func__);
+        if (!SDL_LockTexture(texture, NULL, &pixels, &pitch)) {
+            sdl_log_error("SDL_LockTexture");
             return -1;
         }
 
-        memcpy(pixels, pixeldata, dstbytes);
+        expand_indexed(pixels, pitch, pixeldata, palette);
         SDL_UnlockTexture(texture);
 
         if (!SDL_RenderTexture(renderer, texture, NULL, NULL)) {
@@ -13,4 +13,4 @@ void video_sdl_toggle_window_mode();
 bool video_sdl_is_fullscreen();
 void video_sdl_toggle_menubar();
 int video_sdl_init(const char *title, int width, int height, int scale);
-int video_sdl_draw_rgb24_buffer(void *pixeldata, size_t bytes);
+int video_sdl_draw_indexed_buffer(const uint8_t *pixeldata, size_t len, const uint8_t *palette);
@@ -1,8 +1,15 @@
 #include "z80.h"
+#include "z80_ops.h"
+#include "z80_jit.h"
+#include "z80_profile.h"
+#include "z80_trace.h"
 #include "machine.h"
 #include "io.h"
 #include "log.h"
 #include <assert.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <stdio.h>
 
@@ -17,6 +24,10 @@
 #define NF  (1<<1)
 #define CF  (1<<0)
 
+#if defined(__GNUC__)
+    #define Z80_COMPUTED_GOTO
+#endif
+
 #define MASK_FLAG_XY    (XF | YF)
 #define MAKE16(L, H)    (L | (H << 8))
 #define LOW8(HL)        (HL & 255)
@@ -24,15 +35,16 @@
 
 static void print_regs(Z80_t *cpu)
 {
-    uint8_t *bus = cpu->ctx->memory.bus;
+    const Memory_t *mem = cpu->ctx->memory;
+    cpu_sync_flags(cpu);
 
     dlog(LOG_INFO, "cycles: %d", cpu->cycles);
     dlog(LOG_INFO, "  %02X %02X %02X %02X %02X",
-                   memory_bus_peek(bus, cpu->regs.pc-2),
-                   memory_bus_peek(bus, cpu->regs.pc-1),
-                   memory_bus_peek(bus, cpu->regs.pc),
-                   memory_bus_peek(bus, cpu->regs.pc+1),
-                   memory_bus_peek(bus, cpu->regs.pc+2));
+                   memory_bus_peek(mem, cpu->regs.pc-2),
+                   memory_bus_peek(mem, cpu->regs.pc-1),
+                   memory_bus_peek(mem, cpu->regs.pc),
+                   memory_bus_peek(mem, cpu->regs.pc+1),
+                   memory_bus_peek(mem, cpu->regs.pc+2));
     dlog(LOG_INFO, "        ^ PC");
     dlog(LOG_INFO, "  PC  %04X, SP  %04X, IX  %04X, IY  %04X",
                    cpu->regs.pc, cpu->regs.sp, cpu->regs.ix, cpu->regs.iy);
@@ -47,13 +59,17 @@ static void print_regs(Z80_t *cpu)
 static inline uint8_t cpu_read(Z80_t *cpu, uint16_t addr)
 {
     uint8_t value;
-    cpu->cycles += memory_read(cpu->ctx, addr, &value);
+    if (!memory_read_fast(cpu->ctx->memory, addr, &value)) {
+        cpu->cycles += memory_read(cpu->ctx, addr, &value);
+    }
     return value;
 }
 
 static inline void cpu_write(Z80_t *cpu, uint16_t addr, uint8_t value)
 {
-    cpu->cycles += memory_write(cpu->ctx, addr, value);
+    if (!memory_write_fast(cpu->ctx->memory, addr, value)) {
+        cpu->cycles += memory_write(cpu->ctx, addr, value);
+    }
 }
 
 static inline uint8_t cpu_in(Z80_t *cpu, uint16_t addr)
@@ -76,29 +92,171 @@ static inline void cpu_memory_stall(Z80_t *cpu, uint16_t addr, uint8_t count)
     }
 }
 
-static inline bool get_parity(uint8_t value)
+/* flag tables */
+
+/* indexed with bit 3 and 7 of both operands and the result, see FLAG_LOOKUP */
+static const uint8_t halfcarry_add[8] = { 0, HF, HF, HF, 0, 0, 0, HF };
+static const uint8_t halfcarry_sub[8] = { 0, 0, HF, 0, HF, 0, HF, HF };
+static const uint8_t overflow_add[8]  = { 0, 0, 0, PF, PF, 0, 0, 0 };
+static const uint8_t overflow_sub[8]  = { 0, PF, 0, 0, 0, 0, PF, 0 };
+
+#define FLAG_LOOKUP(a, b, result) \
+    ((((a) & 0x88) >> 3) | (((b) & 0x88) >> 2) | (((result) & 0x88) >> 1))
+
+static uint8_t sz53[256];       // S, Z and the undocumented bits 5 and 3
+static uint8_t sz53p[256];      // same as above plus parity
+static uint8_t flags_inc[256];  // all but C after an INC resulting in the index
+static uint8_t flags_dec[256];  // all but C after a DEC resulting in the index
+static uint16_t daa_af[2048];   // A | C<<8 | H<<9 | N<<10 -> AF after DAA
+
+static void build_flag_tables(void)
+{
+    for (int i = 0; i < 256; i++) {
+        uint8_t p = i ^ (i >> 4);
+        p ^= p >> 2;
+        p ^= p >> 1;
+
+        sz53[i] = (i & (SF | XF | YF)) | (i ? 0 : ZF);
+        sz53p[i] = sz53[i] | ((p & 1) ? 0 : PF);
+        flags_inc[i] = sz53[i] | ((i & 0x0F) ? 0 : HF) | ((i == 0x80) ? PF : 0);
+        flags_dec[i] = sz53[i] | (((i & 0x0F) == 0x0F) ? HF : 0) 
+                       | ((i == 0x7F) ? PF : 0) | NF;
+    }
+
+    for (int i = 0; i < 2048; i++) {
+        uint8_t a = i & 0xFF;
+        bool c = i & (1<<8);
+        bool h = i & (1<<9);
+        bool neg = i & (1<<10);
+
+        uint8_t ah = a >> 4;
+        uint8_t al = a & 0xF;
+        uint8_t diff_lo = h || (al > 9);
+        uint8_t diff_hi = c || (ah > 9) || (ah > 8 && al > 9);
+        uint8_t diff = (diff_lo * 0x6) | (diff_hi * 0x60);
+
+        bool c_new = c || (ah > (9 - (al > 9)));
+        bool h_new = (!neg && (al > 9)) || (neg && h && (al < 6));
+
+        uint8_t result = neg ? (a - diff) : (a + diff);
+        uint8_t f = sz53p[result] | (c_new ? CF : 0) | (h_new ? HF : 0) 
+                    | (neg ? NF : 0);
+        daa_af[i] = (result << 8) | f;
+    }
+}
+
+/* Builds the tables once, machines may be getting initialized
+ * on several threads at the same time. */
+static void init_flag_tables(void)
+{
+    enum { TABLES_NONE, TABLES_BUILDING, TABLES_DONE };
+    static atomic_int state = TABLES_NONE;
+
+    int expected = TABLES_NONE;
+    if (atomic_compare_exchange_strong(&state, &expected, TABLES_BUILDING)) {
+        build_flag_tables();
+        atomic_store(&state, TABLES_DONE);
+        return;
+    }
+    while (atomic_load(&state) != TABLES_DONE) {}
+}
+
+static inline uint8_t flags_add8(uint8_t a, uint8_t value, uint8_t carry)
+{
+    uint16_t result = a + value + carry;
+    uint8_t lookup = FLAG_LOOKUP(a, value, result);
+    return sz53[result & 0xFF] | ((result >> 8) ? CF : 0)
+           | halfcarry_add[lookup & 7] | overflow_add[lookup >> 4];
+}
+
+static inline uint8_t flags_sub8(uint8_t a, uint8_t value, uint8_t carry)
+{
+    uint16_t result = a - value - carry;
+    uint8_t lookup = FLAG_LOOKUP(a, value, result);
+    return sz53[result & 0xFF] | ((result >> 8) ? CF : 0) | NF
+           | halfcarry_sub[lookup & 7] | overflow_sub[lookup >> 4];
+}
+
+/* same as SUB, except the undocumented flags come from the operand */
+static inline uint8_t flags_cp8(uint8_t a, uint8_t value)
+{
+    return (flags_sub8(a, value, 0) & ~MASK_FLAG_XY) | (value & MASK_FLAG_XY);
+}
+
+static inline uint8_t flags_compute(enum LazyFlagsOp op, uint8_t a, uint8_t b, uint8_t c)
+{
+    switch (op)
+    {
+    case LAZY_ADD: return flags_add8(a, b, c);
+    case LAZY_SUB: return flags_sub8(a, b, c);
+    case LAZY_CP:  return flags_cp8(a, b);
+    case LAZY_AND: return sz53p[a] | HF;
+    case LAZY_OR:  return sz53p[a];
+    case LAZY_INC: return flags_inc[a] | c;
+    case LAZY_DEC: return flags_dec[a] | c;
+    default:       return 0;
+    }
+}
+
+/* lazy flags
+ * With cpu->lazy_flags set, the ALU and INC/DEC only record their operands
+ * and F gets computed once something actually reads it. Everything reading
+ * F has to go through get_f(), and anything storing a whole new F without
+ * reading it first through set_f(), so that a stale operation is dropped.
+ * The carry alone can be had through get_c() without computing the rest. */
+
+static void flags_materialize(Z80_t *cpu)
+{
+    struct Z80LazyFlags *l = &cpu->lazy;
+    cpu->regs.main.f = flags_compute(l->op, l->a, l->b, l->c);
+    l->op = LAZY_NONE;
+}
+
+static inline uint8_t get_f(Z80_t *cpu)
+{
+    if (cpu->lazy.op != LAZY_NONE) flags_materialize(cpu);
+    return cpu->regs.main.f;
+}
+
+static inline uint16_t get_af(Z80_t *cpu)
+{
+    get_f(cpu);
+    return cpu->regs.main.af;
+}
+
+static inline void set_f(Z80_t *cpu, uint8_t f)
+{
+    cpu->regs.main.f = f;
+    cpu->lazy.op = LAZY_NONE;
+}
+
+/* carry only, without materializing the rest of F */
+static inline uint8_t get_c(Z80_t *cpu)
 {
-    // FIXME: untested HACK
-    value = value ^ (value >> 4);
-    value = value ^ (value >> 2);
-    value = value ^ (value >> 1);
-    return !(value & 1);
+    struct Z80LazyFlags *l = &cpu->lazy;
+    switch (l->op)
+    {
+    case LAZY_NONE: return cpu->regs.main.f & CF;
+    case LAZY_ADD:  return (l->a + l->b + l->c) >> 8;
+    case LAZY_SUB:  return ((l->a - l->b - l->c) >> 8) & 1;
+    case LAZY_CP:   return l->a < l->b;
+    case LAZY_INC:
+    case LAZY_DEC:  return l->c;
+    default:        return 0;
+    }
 }
 
-static inline bool flag_overflow_8(uint8_t a, uint8_t b, bool c, bool sub)
+static inline void flags_record(Z80_t *cpu, enum LazyFlagsOp op, uint8_t a, uint8_t b, uint8_t c)
 {
-    int16_t as = (int8_t)a;
-    int16_t bs = (int8_t)b;
-    int16_t result = sub ? (as - bs - c) : (as + bs + c);
-    return result > 127 || result < -128;
+    cpu->lazy.op = op;
+    cpu->lazy.a = a;
+    cpu->lazy.b = b;
+    cpu->lazy.c = c;
 }
 
-static inline bool flag_overflow_16(uint16_t a, uint16_t b, bool c, bool sub)
+void cpu_sync_flags(Z80_t *cpu)
 {
-    int32_t as = (int16_t)a;
-    int32_t bs = (int16_t)b;
-    int32_t result = sub ? (as - bs - c) : (as + bs + c);
-    return result > 32767 || result < -32768;
+    get_f(cpu);
 }
 
 static inline void inc_refresh(Z80_t *cpu)
@@ -107,9 +265,8 @@ static inline void inc_refresh(Z80_t *cpu)
     cpu->regs.r = (cpu->regs.r & (1<<7)) | r;
 }
 
-static inline void alo(Z80_t *cpu, uint8_t value, const uint8_t op);
-static inline uint8_t sub8(Z80_t *cpu, uint8_t a, uint8_t value);
 static inline uint8_t dec8(Z80_t *cpu, uint8_t value);
+static void block_cache_flush(Z80_t *cpu);
 
 /* instruction implementations */
 
@@ -197,13 +354,8 @@ static void ld_a_i(Z80_t *cpu, uint8_t value)
     cpu_read(cpu, MAKE16(cpu->regs.r, cpu->regs.i)); // ir:1
     cpu->cycles += 1;
 
-    cpu->regs.main.f &= ~MASK_FLAG_XY;
-    cpu->regs.main.f |= (value & MASK_FLAG_XY);
-    cpu->regs.main.flags.s = value & (1<<7);
-    cpu->regs.main.flags.z = !value;
-    cpu->regs.main.flags.h = 0;
-    cpu->regs.main.flags.pv = cpu->regs.iff2;
-    cpu->regs.main.flags.n = 0;
+    cpu->regs.main.f = (get_f(cpu) & CF) | sz53[value] 
+                       | (cpu->regs.iff2 ? PF : 0);
     cpu->regs.q = true;
 
     cpu->regs.main.a = value;
@@ -399,6 +551,12 @@ static void reti(Z80_t *cpu)
     pop(cpu, &cpu->regs.pc);
 }
 
+static void pop_af(Z80_t *cpu)
+{
+    cpu->lazy.op = LAZY_NONE;
+    pop(cpu, &cpu->regs.main.af);
+}
+
 static void push(Z80_t *cpu, uint16_t value)
 {
     cpu->cycles += 4;
@@ -448,7 +606,7 @@ static void ex_de_hl(Z80_t *cpu)
 static void ex_af(Z80_t *cpu)
 {
     uint16_t tmp;
-    tmp = cpu->regs.main.af;
+    tmp = get_af(cpu);
     cpu->regs.main.af = cpu->regs.alt.af;
     cpu->regs.alt.af = tmp;
 
@@ -493,26 +651,55 @@ static void ldx(Z80_t *cpu, int8_t increment)
     cpu->regs.main.de += increment;
     cpu->regs.main.bc--;
 
+    // bit 1 of n goes to bit 5 of F, bit 3 stays in place
     uint8_t n = value + cpu->regs.main.a;
-    cpu->regs.main.flags.y = n & (1<<1);
-    cpu->regs.main.flags.x = n & (1<<3);
-    cpu->regs.main.flags.pv = !(!cpu->regs.main.bc);
-    cpu->regs.main.flags.h = 0;
-    cpu->regs.main.flags.n = 0;
+    cpu->regs.main.f = (get_f(cpu) & (SF | ZF | CF)) 
+                       | ((n & (1<<1)) << 4) | (n & (1<<3))
+                       | (cpu->regs.main.bc ? PF : 0);
     cpu->regs.q = true;
 }
 
+/* Lets a repeating block instruction go on with its next iteration right
+ * away, doing the bookkeeping and opcode fetches cpu_do_cycles() would do.
+ * Only happens within cpu_run_until() while no event is due, and not on a
+ * hooked PC or if the instruction itself got overwritten.
+ * All memory and I/O accesses still take the usual path, so the results
+ * are the same as stepping through every iteration. */
+static bool block_repeat_next(Z80_t *cpu, uint8_t op)
+{
+    uint16_t pc = cpu->regs.pc;
+    const Memory_t *mem = cpu->ctx->memory;
+
+    if (cpu->cycles >= cpu->deadline || cpu_has_pc_hook(cpu, pc)
+        || memory_bus_peek(mem, pc) != 0xED || memory_bus_peek(mem, pc + 1) != op) {
+        return false;
+    }
+
+    cpu->regs.q_old = cpu->regs.q;
+    cpu->regs.q = false;
+
+    cpu_read(cpu, pc);
+    inc_refresh(cpu);
+    cpu->cycles += 4;
+    cpu->regs.pc++;
+    cpu_read(cpu, cpu->regs.pc);
+    inc_refresh(cpu);
+    return true;
+}
+
 /* LDIR/LDDR */
 static void ldxr(Z80_t *cpu, int8_t increment)
 {
-    ldx(cpu, increment);
+    do {
+        ldx(cpu, increment);
+
+        if (cpu->regs.main.bc == 0) break;
 
-    if (cpu->regs.main.bc != 0) {
         cpu->regs.pc -= 2;
         cpu->regs.memptr = cpu->regs.pc;
         // de:1 x5
         cpu_memory_stall(cpu, cpu->regs.main.de, 5);
-    }
+    } while (block_repeat_next(cpu, increment > 0 ? 0xB0 : 0xB8));
 }
 
 /* CPI/CPD */
@@ -529,27 +716,29 @@ static void cpx(Z80_t *cpu, int8_t increment)
     // hl:1 x5
     cpu_memory_stall(cpu, cpu->regs.main.hl, 5);
 
-    bool c = cpu->regs.main.flags.c;
-    alo(cpu, value, 7);
-    uint8_t n = cpu->regs.main.a - value - cpu->regs.main.flags.h;
-    cpu->regs.main.flags.y = n & (1<<1);
-    cpu->regs.main.flags.x = n & (1<<3); 
-    cpu->regs.main.flags.pv = !(!cpu->regs.main.bc);
-    cpu->regs.main.flags.c = c;
+    uint8_t a = cpu->regs.main.a;
+    uint8_t result = a - value;
+    uint8_t h = halfcarry_sub[FLAG_LOOKUP(a, value, result) & 7];
+    uint8_t n = result - (h ? 1 : 0);
+    cpu->regs.main.f = (get_f(cpu) & CF) | (sz53[result] & (SF | ZF)) | h 
+                       | ((n & (1<<1)) << 4) | (n & (1<<3))
+                       | (cpu->regs.main.bc ? PF : 0) | NF;
     cpu->regs.q = true;
 }
 
 /* CPIR/CPDR */
 static void cpxr(Z80_t *cpu, int8_t increment)
 {
-    cpx(cpu, increment);
+    do {
+        cpx(cpu, increment);
+
+        if (cpu->regs.main.bc == 0 || (cpu->regs.main.f & ZF)) break;
 
-    if (cpu->regs.main.bc != 0 && !cpu->regs.main.flags.z) {
         cpu->regs.pc -= 2;
         cpu->regs.memptr = cpu->regs.pc + 1;
         // hl:1 x5
         cpu_memory_stall(cpu, cpu->regs.main.hl, 5);
-    }
+    } while (block_repeat_next(cpu, increment > 0 ? 0xB1 : 0xB9));
 }
 
 /* OUTI/OUTD */
@@ -570,23 +759,24 @@ static void outx(Z80_t *cpu, int8_t increment)
     cpu->regs.memptr = cpu->regs.main.bc + increment;
 
     uint16_t k = cpu->regs.main.l + value;
-    cpu->regs.main.flags.h = k > 255;
-    cpu->regs.main.flags.c = k > 255;
-    cpu->regs.main.flags.pv = get_parity((k & 7) ^ cpu->regs.main.b);
-    cpu->regs.main.flags.n = value & (1<<7);
+    set_f(cpu, sz53[cpu->regs.main.b] | ((k > 255) ? (HF | CF) : 0)
+                       | (sz53p[(k & 7) ^ cpu->regs.main.b] & PF)
+                       | ((value & (1<<7)) ? NF : 0));
     cpu->regs.q = true;
 }
 
 /* OTIR/OTDR */
 static void otxr(Z80_t *cpu, int8_t increment)
 {
-    outx(cpu, increment);
+    do {
+        outx(cpu, increment);
+
+        if (cpu->regs.main.b == 0) break;
 
-    if (cpu->regs.main.b != 0) {
         cpu->regs.pc -= 2;
         // bc:1 x5
         cpu_memory_stall(cpu, cpu->regs.main.bc, 5);
-    }
+    } while (block_repeat_next(cpu, increment > 0 ? 0xB3 : 0xBB));
 }
 
 /* INI/IND */
@@ -608,23 +798,24 @@ static void inx(Z80_t *cpu, int8_t increment)
     cpu->regs.main.hl += increment;
 
     uint16_t k = ((cpu->regs.main.c + increment) & 255) + value;
-    cpu->regs.main.flags.h = k > 255;
-    cpu->regs.main.flags.c = k > 255;
-    cpu->regs.main.flags.pv = get_parity((k & 7) ^ cpu->regs.main.b);
-    cpu->regs.main.flags.n = value & (1<<7);
+    set_f(cpu, sz53[cpu->regs.main.b] | ((k > 255) ? (HF | CF) : 0)
+                       | (sz53p[(k & 7) ^ cpu->regs.main.b] & PF)
+                       | ((value & (1<<7)) ? NF : 0));
     cpu->regs.q = true;
 }
 
 /* INIR/INDR */
 static void inxr(Z80_t *cpu, int8_t increment)
 {
-    inx(cpu, increment);
+    do {
+        inx(cpu, increment);
+
+        if (cpu->regs.main.b == 0) break;
 
-    if (cpu->regs.main.b != 0) {
         cpu->regs.pc -= 2;
         // hl:1 x5
         cpu_memory_stall(cpu, cpu->regs.main.hl, 5);
-    }
+    } while (block_repeat_next(cpu, increment > 0 ? 0xB2 : 0xBA));
 }
 
 /* 8-Bit Arithmetic Group */
@@ -633,13 +824,11 @@ static void inxr(Z80_t *cpu, int8_t increment)
 static inline uint8_t inc8(Z80_t *cpu, uint8_t value)
 {
     value++;
-    cpu->regs.main.f &= ~MASK_FLAG_XY;
-    cpu->regs.main.f |= (value & MASK_FLAG_XY);
-    cpu->regs.main.flags.s = value & (1<<7);
-    cpu->regs.main.flags.z = !value;
-    cpu->regs.main.flags.h = !(value & 0x0F);
-    cpu->regs.main.flags.pv = value == 0x80;
-    cpu->regs.main.flags.n = 0;
+    if (cpu->lazy_flags) {
+        flags_record(cpu, LAZY_INC, value, 0, get_c(cpu));
+    } else {
+        cpu->regs.main.f = (cpu->regs.main.f & CF) | flags_inc[value];
+    }
     cpu->regs.q = true;
     return value;
 }
@@ -693,13 +882,11 @@ static void inc_iid(Z80_t *cpu, uint16_t addr)
 static inline uint8_t dec8(Z80_t *cpu, uint8_t value)
 {
     value--;
-    cpu->regs.main.f &= ~MASK_FLAG_XY;
-    cpu->regs.main.f |= (value & MASK_FLAG_XY);
-    cpu->regs.main.flags.s = value & (1<<7);
-    cpu->regs.main.flags.z = !value;
-    cpu->regs.main.flags.h = (value & 0x0F) == 0x0F;
-    cpu->regs.main.flags.pv = value == 0x7F;
-    cpu->regs.main.flags.n = 1;
+    if (cpu->lazy_flags) {
+        flags_record(cpu, LAZY_DEC, value, 0, get_c(cpu));
+    } else {
+        cpu->regs.main.f = (cpu->regs.main.f & CF) | flags_dec[value];
+    }
     cpu->regs.q = true;
     return value;
 }
@@ -749,126 +936,52 @@ static void dec_iid(Z80_t *cpu, uint16_t addr)
     cpu->cycles += 3;
 }
 
-/* ADD helper */
-static inline uint8_t add8(Z80_t *cpu, uint8_t value)
-{
-    uint8_t a = cpu->regs.main.a;
-    uint8_t result = a + value;
-    cpu->regs.main.flags.pv = flag_overflow_8(a, value, 0, false);
-    cpu->regs.main.flags.h = (a ^ result ^ value) & 0x10;
-    cpu->regs.main.flags.c = ((uint16_t)a + (uint16_t)value) > 255;
-    cpu->regs.main.flags.n = 0;
-    return result;
-}
-
-/* ADC helper */
-static inline uint8_t adc8(Z80_t *cpu, uint8_t value)
-{
-    uint8_t a = cpu->regs.main.a;
-    uint8_t result = a + value + cpu->regs.main.flags.c;
-    cpu->regs.main.flags.pv = flag_overflow_8(a, value, cpu->regs.main.flags.c, false);
-    cpu->regs.main.flags.h = (a ^ result ^ value) & 0x10;
-    cpu->regs.main.flags.c = ((uint16_t)a + (uint16_t)value + 
-                              cpu->regs.main.flags.c) > 255;
-    cpu->regs.main.flags.n = 0;
-    return result;
-}
-
-/* SUB helper */
-static inline uint8_t sub8(Z80_t *cpu, uint8_t a, uint8_t value)
-{
-    uint8_t result = a - value;
-    cpu->regs.main.flags.pv = flag_overflow_8(a, value, 0, true);
-    cpu->regs.main.flags.h = (a ^ result ^ value) & 0x10;
-    cpu->regs.main.flags.c = (a < value);
-    cpu->regs.main.flags.n = 1;
-    return result;
-}
-
-/* SBC helper */
-static inline uint8_t sbc8(Z80_t *cpu, uint8_t value)
-{
-    uint8_t a = cpu->regs.main.a;
-    uint8_t result = a - value - cpu->regs.main.flags.c;
-    cpu->regs.main.flags.pv = flag_overflow_8(a, value, cpu->regs.main.flags.c, true);
-    cpu->regs.main.flags.h = (a ^ result ^ value) & 0x10;
-    cpu->regs.main.flags.c = a < ((uint16_t)value + cpu->regs.main.flags.c);
-    cpu->regs.main.flags.n = 1;
-    return result;
-}
-
-/* AND helper */
-static inline uint8_t and(Z80_t *cpu, uint8_t value)
-{
-    value &= cpu->regs.main.a;
-    cpu->regs.main.flags.h = 1;
-    cpu->regs.main.flags.pv = get_parity(value);
-    cpu->regs.main.flags.c = 0;
-    cpu->regs.main.flags.n = 0;
-    return value;
-}
-
-/* XOR helper */
-static inline uint8_t xor(Z80_t *cpu, uint8_t value)
-{
-    value ^= cpu->regs.main.a;
-    cpu->regs.main.flags.h = 0;
-    cpu->regs.main.flags.pv = get_parity(value);
-    cpu->regs.main.flags.c = 0;
-    cpu->regs.main.flags.n = 0;
-    return value;
-}
-
-/* OR helper */
-static inline uint8_t or(Z80_t *cpu, uint8_t value)
-{
-    value |= cpu->regs.main.a;
-    cpu->regs.main.flags.h = 0;
-    cpu->regs.main.flags.pv = get_parity(value);
-    cpu->regs.main.flags.c = 0;
-    cpu->regs.main.flags.n = 0;
-    return value;
-}
-
 static inline void alo(Z80_t *cpu, uint8_t value, const uint8_t op)
 {
+    uint8_t a = cpu->regs.main.a;
+    uint8_t c = (op == 1 || op == 3) ? get_c(cpu) : 0;
+    enum LazyFlagsOp lazy_op;
     uint8_t result;
+
     switch (op)
     {
     case 0: // add
-        result = cpu->regs.main.a = add8(cpu, value);
-        break;
     case 1: // adc
-        result = cpu->regs.main.a = adc8(cpu, value);
+        result = a + value + c;
+        lazy_op = LAZY_ADD;
         break;
     case 2: // sub
-        result = cpu->regs.main.a = sub8(cpu, cpu->regs.main.a, value);
-        break;
     case 3: // sbc
-        result = cpu->regs.main.a = sbc8(cpu, value);
+        result = a - value - c;
+        lazy_op = LAZY_SUB;
         break;
     case 4: // and
-        result = cpu->regs.main.a = and(cpu, value);
+        result = a & value;
+        lazy_op = LAZY_AND;
         break;
     case 5: // xor
-        result = cpu->regs.main.a = xor(cpu, value);
+        result = a ^ value;
+        lazy_op = LAZY_OR;
         break;
     case 6: // or
-        result = cpu->regs.main.a = or(cpu, value);
+        result = a | value;
+        lazy_op = LAZY_OR;
         break;
-    case 7: // cp
-        result = sub8(cpu, cpu->regs.main.a, value);
+    default: // cp
+        result = a;
+        lazy_op = LAZY_CP;
         break;
-    default:
-        result = 0;
-        cpu->error = true;
     }
 
-    uint8_t xy = (op == 7) ? value : result;
-    cpu->regs.main.f &= ~MASK_FLAG_XY;
-    cpu->regs.main.f |= (xy & MASK_FLAG_XY);
-    cpu->regs.main.flags.s = result & (1<<7);
-    cpu->regs.main.flags.z = !result;
+    // logic operations only need the result
+    if (lazy_op == LAZY_AND || lazy_op == LAZY_OR) a = result;
+
+    if (cpu->lazy_flags) {
+        flags_record(cpu, lazy_op, a, value, c);
+    } else {
+        cpu->regs.main.f = flags_compute(lazy_op, a, value, c);
+    }
+    cpu->regs.main.a = result;
     cpu->regs.q = true;
 }
 
@@ -924,33 +1037,10 @@ static void daa(Z80_t *cpu)
     cpu->cycles += 4;
     cpu->regs.pc++;
 
-    uint8_t a = cpu->regs.main.a;
-    bool neg = cpu->regs.main.flags.n;
-    uint8_t ah = a >> 4;
-    uint8_t al = a & 0xF;
-    uint8_t diff_lo = cpu->regs.main.flags.h || (al > 9);
-    uint8_t diff_hi = cpu->regs.main.flags.c || (ah > 9)
-                      || (ah > 8 && al > 9);
-    diff_lo *= 0x6;
-    diff_hi *= 0x60;
-    uint8_t diff = diff_lo | diff_hi;
-
-    bool c = cpu->regs.main.flags.c || (ah > (9 - (al > 9)));
-    bool h = (!neg && (al > 9))
-             || (neg && cpu->regs.main.flags.h && (al < 6));
-
-    uint8_t result = neg ? (a - diff) : (a + diff);
-
-    const uint8_t fmask = XF | SF | YF;
-    cpu->regs.main.f &= ~fmask;
-    cpu->regs.main.f |= result & fmask;
-    cpu->regs.main.flags.z = !result;
-    cpu->regs.main.flags.c = c;
-    cpu->regs.main.flags.h = h;
-    cpu->regs.main.flags.pv = get_parity(result);
+    uint8_t f = get_f(cpu);
+    uint16_t index = cpu->regs.main.a | ((f & CF) << 8) | ((f & HF) << 5) | ((f & NF) << 9);
+    cpu->regs.main.af = daa_af[index];
     cpu->regs.q = true;
-
-    cpu->regs.main.a = result;
 }
 
 static void cpl(Z80_t *cpu)
@@ -958,10 +1048,8 @@ static void cpl(Z80_t *cpu)
     cpu->cycles += 4;
     cpu->regs.pc++;
     cpu->regs.main.a ^= 0xFF;
-    cpu->regs.main.f &= ~MASK_FLAG_XY;
-    cpu->regs.main.f |= (cpu->regs.main.a & MASK_FLAG_XY);
-    cpu->regs.main.flags.h = 1;
-    cpu->regs.main.flags.n = 1;
+    cpu->regs.main.f = (get_f(cpu) & (SF | ZF | PF | CF)) 
+                       | (cpu->regs.main.a & MASK_FLAG_XY) | HF | NF;
     cpu->regs.q = true;
 }
 
@@ -969,15 +1057,9 @@ static void neg(Z80_t *cpu)
 {
     cpu->cycles += 4;
     cpu->regs.pc++;
-    uint8_t result = sub8(cpu, 0, cpu->regs.main.a);
-    cpu->regs.main.f &= ~MASK_FLAG_XY;
-    cpu->regs.main.f |= (result & MASK_FLAG_XY);
-    cpu->regs.main.flags.s = result & (1<<7);
-    cpu->regs.main.flags.z = !result;
-    cpu->regs.main.flags.c = !(!cpu->regs.main.a);
-    cpu->regs.main.flags.pv = (cpu->regs.main.a == 0x80);
+    set_f(cpu, flags_sub8(0, cpu->regs.main.a, 0));
+    cpu->regs.main.a = -cpu->regs.main.a;
     cpu->regs.q = true;
-    cpu->regs.main.a = result;
 }
 
 /* CCF/SCF */
@@ -985,11 +1067,10 @@ static void ccf(Z80_t *cpu)
 {
     cpu->cycles += 4;
     cpu->regs.pc++;
-    cpu->regs.main.flags.h = cpu->regs.main.flags.c;
-    cpu->regs.main.flags.n = 0;
-    cpu->regs.main.flags.c ^= 1;
-    if (cpu->regs.q_old) cpu->regs.main.f &= ~MASK_FLAG_XY;
-    cpu->regs.main.f |= cpu->regs.main.a & MASK_FLAG_XY;
+    uint8_t f = get_f(cpu);
+    uint8_t xy = (cpu->regs.q_old ? 0 : f) | cpu->regs.main.a;
+    cpu->regs.main.f = (f & (SF | ZF | PF)) | (xy & MASK_FLAG_XY)
+                       | ((f & CF) << 4) | ((f & CF) ^ CF);
     cpu->regs.q = true;
 }
 
@@ -997,11 +1078,9 @@ static void scf(Z80_t *cpu)
 {
     cpu->cycles += 4;
     cpu->regs.pc++;
-    cpu->regs.main.flags.h = 0;
-    cpu->regs.main.flags.n = 0;
-    cpu->regs.main.flags.c = 1;
-    if (cpu->regs.q_old) cpu->regs.main.f &= ~MASK_FLAG_XY;
-    cpu->regs.main.f |= cpu->regs.main.a & MASK_FLAG_XY;
+    uint8_t f = get_f(cpu);
+    uint8_t xy = (cpu->regs.q_old ? 0 : f) | cpu->regs.main.a;
+    cpu->regs.main.f = (f & (SF | ZF | PF)) | (xy & MASK_FLAG_XY) | CF;
     cpu->regs.q = true;
 }
 
@@ -1040,11 +1119,10 @@ static void add_rr_rr(Z80_t *cpu, uint16_t *dest, uint16_t value)
 {
     cpu->regs.memptr = *dest + 1;
     uint32_t result = (uint32_t)*dest + value;
-    cpu->regs.main.f &= ~MASK_FLAG_XY;
-    cpu->regs.main.f |= (result >> 8) & MASK_FLAG_XY;
-    cpu->regs.main.flags.h = (*dest ^ result ^ value) & 0x1000;
-    cpu->regs.main.flags.n = 0;
-    cpu->regs.main.flags.c = result & (1<<16); // hmm thats kinda stupid
+    cpu->regs.main.f = (get_f(cpu) & (SF | ZF | PF)) 
+                       | ((result >> 8) & MASK_FLAG_XY)
+                       | (((*dest ^ result ^ value) >> 8) & HF)
+                       | ((result >> 16) & CF);
     cpu->regs.q = true;
     *dest = (uint16_t)result;
     cpu->cycles += 4;
@@ -1058,15 +1136,11 @@ static void add_rr_rr(Z80_t *cpu, uint16_t *dest, uint16_t value)
 static void adc_rr_rr(Z80_t *cpu, uint16_t *dest, uint16_t value)
 {
     cpu->regs.memptr = *dest + 1;
-    uint32_t result = (uint32_t)*dest + value + cpu->regs.main.flags.c;
-    cpu->regs.main.f &= ~MASK_FLAG_XY;
-    cpu->regs.main.f |= (result >> 8) & MASK_FLAG_XY;
-    cpu->regs.main.flags.s = result & (1<<15);
-    cpu->regs.main.flags.z = !(result & 0xFFFF);
-    cpu->regs.main.flags.h = (*dest ^ result ^ value) & 0x1000;
-    cpu->regs.main.flags.pv = flag_overflow_16(*dest, value, cpu->regs.main.flags.c, false);
-    cpu->regs.main.flags.n = 0;
-    cpu->regs.main.flags.c = result & (1<<16); // hmm thats kinda stupid
+    uint32_t result = (uint32_t)*dest + value + get_c(cpu);
+    uint8_t lookup = FLAG_LOOKUP(*dest >> 8, value >> 8, result >> 8);
+    set_f(cpu, (sz53[(result >> 8) & 0xFF] & ~ZF) | ((result & 0xFFFF) ? 0 : ZF)
+               | halfcarry_add[lookup & 7] | overflow_add[lookup >> 4]
+               | ((result >> 16) & CF));
     cpu->regs.q = true;
     *dest = (uint16_t)result;
     cpu->cycles += 4;
@@ -1080,15 +1154,11 @@ static void adc_rr_rr(Z80_t *cpu, uint16_t *dest, uint16_t value)
 static void sbc_rr_rr(Z80_t *cpu, uint16_t *dest, uint16_t value)
 {
     cpu->regs.memptr = *dest + 1;
-    uint32_t result = (uint32_t)*dest - value - cpu->regs.main.flags.c;
-    cpu->regs.main.f &= ~MASK_FLAG_XY;
-    cpu->regs.main.f |= (result >> 8) & MASK_FLAG_XY;
-    cpu->regs.main.flags.s = result & (1<<15);
-    cpu->regs.main.flags.z = !(result & 0xFFFF);
-    cpu->regs.main.flags.h = (*dest ^ result ^ value) & 0x1000;
-    cpu->regs.main.flags.pv = flag_overflow_16(*dest, value, cpu->regs.main.flags.c, true);
-    cpu->regs.main.flags.n = 1;
-    cpu->regs.main.flags.c = *dest < ((uint32_t)value + cpu->regs.main.flags.c);
+    uint32_t result = (uint32_t)*dest - value - get_c(cpu);
+    uint8_t lookup = FLAG_LOOKUP(*dest >> 8, value >> 8, result >> 8);
+    set_f(cpu, (sz53[(result >> 8) & 0xFF] & ~ZF) | ((result & 0xFFFF) ? 0 : ZF)
+               | halfcarry_sub[lookup & 7] | overflow_sub[lookup >> 4]
+               | ((result >> 16) & CF) | NF);
     cpu->regs.q = true;
     *dest = (uint16_t)result;
     cpu->cycles += 4;
@@ -1103,52 +1173,45 @@ static void sbc_rr_rr(Z80_t *cpu, uint16_t *dest, uint16_t value)
 
 static inline uint8_t sro(Z80_t *cpu, uint8_t value, uint8_t op)
 {
-    bool c_new;
+    uint8_t c = get_c(cpu);
+    uint8_t c_new;
     switch (op)
     {
     case 0: // rlc
         value = (value<<1) | (value>>7);
-        cpu->regs.main.flags.c = value & 1;
+        c_new = value & 1;
         break;
     case 1: // rrc
-        cpu->regs.main.flags.c = value & 1;
+        c_new = value & 1;
         value = (value>>1) | (value<<7);
         break;
     case 2: // rl
         c_new = (value>>7);
-        value = (value<<1) | cpu->regs.main.flags.c;
-        cpu->regs.main.flags.c = c_new;
+        value = (value<<1) | c;
         break;
     case 3: // rr
         c_new = value & 1;
-        value = (value>>1) | (cpu->regs.main.flags.c<<7);
-        cpu->regs.main.flags.c = c_new;
+        value = (value>>1) | (c<<7);
         break;
     case 4: // sla
-        cpu->regs.main.flags.c = value>>7;
+        c_new = value>>7;
         value = (value<<1);
         break;
     case 5:
-        cpu->regs.main.flags.c = value & 1;
+        c_new = value & 1;
         value = ((value & (1<<7)) | (value>>1));
         break;
     case 6:
-        cpu->regs.main.flags.c = value>>7;
+        c_new = value>>7;
         value = (value<<1) | 1;
         break;
-    case 7:
-        cpu->regs.main.flags.c = value & 1;
+    default:
+        c_new = value & 1;
         value = (value>>1);
         break;
     }
 
-    cpu->regs.main.f &= ~MASK_FLAG_XY;
-    cpu->regs.main.f |= (value & MASK_FLAG_XY);
-    cpu->regs.main.flags.s = value & (1<<7);
-    cpu->regs.main.flags.z = !value;
-    cpu->regs.main.flags.h = 0;
-    cpu->regs.main.flags.pv = get_parity(value);
-    cpu->regs.main.flags.n = 0;
+    set_f(cpu, sz53p[value] | c_new);
     cpu->regs.q = true;
 
     return value;
@@ -1161,13 +1224,10 @@ static void rlca(Z80_t *cpu)
 
     uint8_t value = cpu->regs.main.a;
     value = (value<<1) | (value>>7);
-    cpu->regs.main.flags.c = value & 1;
     cpu->regs.main.a = value;
 
-    cpu->regs.main.f &= ~MASK_FLAG_XY;
-    cpu->regs.main.f |= (value & MASK_FLAG_XY);
-    cpu->regs.main.flags.h = 0;
-    cpu->regs.main.flags.n = 0;
+    cpu->regs.main.f = (get_f(cpu) & (SF | ZF | PF)) 
+                       | (value & MASK_FLAG_XY) | (value & 1);
     cpu->regs.q = true;
 }
 
@@ -1177,14 +1237,11 @@ static void rrca(Z80_t *cpu)
     cpu->regs.pc++;
 
     uint8_t value = cpu->regs.main.a;
-    cpu->regs.main.flags.c = value & 1;
     value = (value>>1) | (value<<7);
     cpu->regs.main.a = value;
 
-    cpu->regs.main.f &= ~MASK_FLAG_XY;
-    cpu->regs.main.f |= (value & MASK_FLAG_XY);
-    cpu->regs.main.flags.h = 0;
-    cpu->regs.main.flags.n = 0;
+    cpu->regs.main.f = (get_f(cpu) & (SF | ZF | PF)) 
+                       | (value & MASK_FLAG_XY) | (value>>7);
     cpu->regs.q = true;
 }
 
@@ -1194,15 +1251,12 @@ static void rla(Z80_t *cpu)
     cpu->regs.pc++;
 
     uint8_t value = cpu->regs.main.a;
-    bool c_new = (value>>7);
-    value = (value<<1) | cpu->regs.main.flags.c;
-    cpu->regs.main.flags.c = c_new;
+    uint8_t c_new = (value>>7);
+    value = (value<<1) | get_c(cpu);
     cpu->regs.main.a = value;
 
-    cpu->regs.main.f &= ~MASK_FLAG_XY;
-    cpu->regs.main.f |= (value & MASK_FLAG_XY);
-    cpu->regs.main.flags.h = 0;
-    cpu->regs.main.flags.n = 0;
+    cpu->regs.main.f = (get_f(cpu) & (SF | ZF | PF)) 
+                       | (value & MASK_FLAG_XY) | c_new;
     cpu->regs.q = true;
 }
 
@@ -1212,15 +1266,12 @@ static void rra(Z80_t *cpu)
     cpu->regs.pc++;
 
     uint8_t value = cpu->regs.main.a;
-    bool c_new = value & 1;
-    value = (value>>1) | (cpu->regs.main.flags.c<<7);
-    cpu->regs.main.flags.c = c_new;
+    uint8_t c_new = value & 1;
+    value = (value>>1) | (get_c(cpu)<<7);
     cpu->regs.main.a = value;
 
-    cpu->regs.main.f &= ~MASK_FLAG_XY;
-    cpu->regs.main.f |= (value & MASK_FLAG_XY);
-    cpu->regs.main.flags.h = 0;
-    cpu->regs.main.flags.n = 0;
+    cpu->regs.main.f = (get_f(cpu) & (SF | ZF | PF)) 
+                       | (value & MASK_FLAG_XY) | c_new;
     cpu->regs.q = true;
 }
 
@@ -1276,13 +1327,7 @@ static void rld(Z80_t *cpu)
     a |= cpu->regs.main.a & 0xF0;
     cpu->regs.main.a = a;
 
-    const uint8_t fmask = XF | SF | YF;
-    cpu->regs.main.f &= ~fmask;
-    cpu->regs.main.f |= a & fmask;
-    cpu->regs.main.flags.z = !a;
-    cpu->regs.main.flags.pv = get_parity(a);
-    cpu->regs.main.flags.h = 0;
-    cpu->regs.main.flags.n = 0;
+    cpu->regs.main.f = (get_f(cpu) & CF) | sz53p[a];
     cpu->regs.q = true;
 
     cpu->regs.memptr = cpu->regs.main.hl + 1;
@@ -1306,13 +1351,7 @@ static void rrd(Z80_t *cpu)
     a |= cpu->regs.main.a & 0xF0;
     cpu->regs.main.a = a;
 
-    const uint8_t fmask = XF | SF | YF;
-    cpu->regs.main.f &= ~fmask;
-    cpu->regs.main.f |= a & fmask;
-    cpu->regs.main.flags.z = !a;
-    cpu->regs.main.flags.pv = get_parity(a);
-    cpu->regs.main.flags.h = 0;
-    cpu->regs.main.flags.n = 0;
+    cpu->regs.main.f = (get_f(cpu) & CF) | sz53p[a];
     cpu->regs.q = true;
 
     cpu->regs.memptr = cpu->regs.main.hl + 1;
@@ -1324,15 +1363,12 @@ static void rrd(Z80_t *cpu)
 
 /* Bit Set, Reset and Test Group */
 
-static inline void bit_(Z80_t *cpu, uint8_t value, uint8_t bit)
+/* undocumented flags are taken from xy */
+static inline void bit_(Z80_t *cpu, uint8_t value, uint8_t bit, uint8_t xy)
 {
-    uint8_t mask = (1<<bit);
-    value &= mask;
-    cpu->regs.main.flags.s = value & (1<<7);
-    cpu->regs.main.flags.z = !value;
-    cpu->regs.main.flags.h = 1;
-    cpu->regs.main.flags.pv = get_parity(value);
-    cpu->regs.main.flags.n = 0;
+    value &= (1<<bit);
+    cpu->regs.main.f = (get_f(cpu) & CF) | (sz53p[value] & ~MASK_FLAG_XY)
+                       | (xy & MASK_FLAG_XY) | HF;
     cpu->regs.q = true;
 }
 
@@ -1340,9 +1376,7 @@ static void bit_r(Z80_t *cpu, uint8_t value, uint8_t bit)
 {
     cpu->cycles += 4;
     cpu->regs.pc++;
-    bit_(cpu, value, bit);
-    cpu->regs.main.f &= ~MASK_FLAG_XY;
-    cpu->regs.main.f |= (value & MASK_FLAG_XY);
+    bit_(cpu, value, bit, value);
 }
 
 static void bit_rra(Z80_t *cpu, uint16_t addr, uint8_t bit)
@@ -1353,9 +1387,7 @@ static void bit_rra(Z80_t *cpu, uint16_t addr, uint8_t bit)
     cpu->cycles += 3;
     cpu_read(cpu, addr); // hl:1
     cpu->cycles += 1;
-    bit_(cpu, value, bit);
-    cpu->regs.main.f &= ~MASK_FLAG_XY;
-    cpu->regs.main.f |= (cpu->regs.w & MASK_FLAG_XY);
+    bit_(cpu, value, bit, cpu->regs.w);
 }
 
 static void bit_iid(Z80_t *cpu, uint16_t addr, uint8_t bit)
@@ -1369,9 +1401,7 @@ static void bit_iid(Z80_t *cpu, uint16_t addr, uint8_t bit)
     cpu->cycles += 3;
     cpu_read(cpu, addr); // ii+d:1
     cpu->cycles += 1;
-    bit_(cpu, value, bit);
-    cpu->regs.main.f &= ~MASK_FLAG_XY;
-    cpu->regs.main.f |= (cpu->regs.w & MASK_FLAG_XY);
+    bit_(cpu, value, bit, cpu->regs.w);
 }
 
 static inline uint8_t res(uint8_t value, uint8_t bit)
@@ -1619,11 +1649,8 @@ static void in_r_c(Z80_t *cpu, uint8_t *dest)
     if (dest) *dest = value; 
     cpu->cycles += 4;
 
-    cpu->regs.main.flags.s = value & (1<<7);
-    cpu->regs.main.flags.z = !value;
-    cpu->regs.main.flags.h = 0;
-    cpu->regs.main.flags.pv = get_parity(value);
-    cpu->regs.main.flags.n = 0;
+    cpu->regs.main.f = (get_f(cpu) & (MASK_FLAG_XY | CF)) 
+                       | (sz53p[value] & ~MASK_FLAG_XY);
     cpu->regs.q = true;
 } 
 
@@ -1687,8 +1714,11 @@ static void ddfd(Z80_t *cpu, bool is_iy)
 
 void cpu_init(Z80_t *cpu)
 {
+    init_flag_tables();
+
     cpu->cycles = 0;
     cpu->prefix_state = STATE_NOPREFIX;
+    cpu->prefix_runs = 0;
 
     cpu->regs.main.af = 0xFFFF;
     cpu->regs.main.bc = 0xFFFF;
@@ -1711,8 +1741,32 @@ void cpu_init(Z80_t *cpu)
     cpu->halted = 0;
     cpu->last_ei = 0;
     cpu->interrupt_pending = false;
+
+    // F is up to date, and nothing decoded from earlier code applies anymore
+    cpu->lazy.op = LAZY_NONE;
+    block_cache_flush(cpu);
+    jit_flush(cpu);
+    profile_reset_stack(cpu);
 }
 
+static void unimplemented(Z80_t *cpu, const char *prefix)
+{
+    print_regs(cpu);
+
+    uint8_t op = memory_bus_peek(cpu->ctx->memory, cpu->regs.pc);
+    dlog(LOG_ERR, "unimplemented opcode %s%02X at %04X", prefix, op, cpu->regs.pc);
+    cpu->error = 1;
+}
+
+/* Switch dispatch.
+ * The opcode lists from z80_ops.h are expanded into plain switch statements,
+ * with bit instructions being partially decoded instead. */
+
+#define DO_CB(cpu)          do_cb(cpu)
+#define DO_ED(cpu)          do_ed(cpu)
+#define DO_DDFD_CB(cpu, ii) do_ddfd_cb(cpu, ii)
+#define X(op, impl)         case op: impl; break;
+
 static void do_ed(Z80_t *cpu)
 {
     cpu->cycles += 4;
@@ -1722,106 +1776,7 @@ static void do_ed(Z80_t *cpu)
 
     switch (op)
     {
-    // sbc hl, rr
-    case 0x42: sbc_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.main.bc); break;
-    case 0x52: sbc_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.main.de); break;
-    case 0x62: sbc_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.main.hl); break;
-    case 0x72: sbc_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.sp); break;
-    // ld (nn), rr
-    case 0x43: ld_nna_rr(cpu, cpu->regs.main.bc); break;
-    case 0x53: ld_nna_rr(cpu, cpu->regs.main.de); break;
-    case 0x63: ld_nna_rr(cpu, cpu->regs.main.hl); break;
-    case 0x73: ld_nna_rr(cpu, cpu->regs.sp); break;
-    // retn/reti
-    case 0x45: retn(cpu); break;
-    case 0x4D: reti(cpu); break;
-    case 0x55: retn(cpu); break;
-    case 0x5D: retn(cpu); break;
-    case 0x65: retn(cpu); break;
-    case 0x6D: retn(cpu); break;
-    case 0x75: retn(cpu); break;
-    case 0x7D: retn(cpu); break;
-    // im 0/1/2
-    case 0x46: im(cpu, 0); break;
-    case 0x4E: im(cpu, 0); break;
-    case 0x56: im(cpu, 1); break;
-    case 0x5E: im(cpu, 2); break;
-    case 0x66: im(cpu, 0); break;
-    case 0x6E: im(cpu, 0); break;
-    case 0x76: im(cpu, 1); break;
-    case 0x7E: im(cpu, 2); break;
-    // adc hl, rr
-    case 0x4A: adc_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.main.bc); break;
-    case 0x5A: adc_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.main.de); break;
-    case 0x6A: adc_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.main.hl); break;
-    case 0x7A: adc_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.sp); break;
-    // ld rr, (nn)
-    case 0x4B: ld_rr_nna(cpu, &cpu->regs.main.bc); break;
-    case 0x5B: ld_rr_nna(cpu, &cpu->regs.main.de); break;
-    case 0x6B: ld_rr_nna(cpu, &cpu->regs.main.hl); break;
-    case 0x7B: ld_rr_nna(cpu, &cpu->regs.sp); break;
-
-    // ldx/ldxr
-    case 0xA0: ldx(cpu,  1); break;
-    case 0xA8: ldx(cpu, -1); break;
-    case 0xB0: ldxr(cpu,  1); break;
-    case 0xB8: ldxr(cpu, -1); break;
-    // cpx/cpxr
-    case 0xA1: cpx(cpu,  1); break;
-    case 0xA9: cpx(cpu, -1); break;
-    case 0xB1: cpxr(cpu,  1); break;
-    case 0xB9: cpxr(cpu, -1); break;
-    // inx/inxr
-    case 0xA2: inx(cpu,  1); break;
-    case 0xAA: inx(cpu, -1); break;
-    case 0xB2: inxr(cpu,  1); break;
-    case 0xBA: inxr(cpu, -1); break;
-    // cpx/cpxr
-    case 0xA3: outx(cpu,  1); break;
-    case 0xAB: outx(cpu, -1); break;
-    case 0xB3: otxr(cpu,  1); break;
-    case 0xBB: otxr(cpu, -1); break;
-
-    // in r, (c)
-    case 0x40: in_r_c(cpu, &cpu->regs.main.b); break;
-    case 0x48: in_r_c(cpu, &cpu->regs.main.c); break;
-    case 0x50: in_r_c(cpu, &cpu->regs.main.d); break;
-    case 0x58: in_r_c(cpu, &cpu->regs.main.e); break;
-    case 0x60: in_r_c(cpu, &cpu->regs.main.h); break;
-    case 0x68: in_r_c(cpu, &cpu->regs.main.l); break;
-    case 0x70: in_r_c(cpu, NULL); break;
-    case 0x78: in_r_c(cpu, &cpu->regs.main.a); break;
-
-    // out (c), r
-    case 0x41: out_c_r(cpu, cpu->regs.main.b); break;
-    case 0x49: out_c_r(cpu, cpu->regs.main.c); break;
-    case 0x51: out_c_r(cpu, cpu->regs.main.d); break;
-    case 0x59: out_c_r(cpu, cpu->regs.main.e); break;
-    case 0x61: out_c_r(cpu, cpu->regs.main.h); break;
-    case 0x69: out_c_r(cpu, cpu->regs.main.l); break;
-    case 0x71: out_c_r(cpu, 0); break;
-    case 0x79: out_c_r(cpu, cpu->regs.main.a); break;
-
-    // neg
-    case 0x44: neg(cpu); break;
-    case 0x4C: neg(cpu); break;
-    case 0x54: neg(cpu); break;
-    case 0x5C: neg(cpu); break;
-    case 0x64: neg(cpu); break;
-    case 0x6C: neg(cpu); break;
-    case 0x74: neg(cpu); break;
-    case 0x7C: neg(cpu); break;
-
-    // ir registers
-    case 0x47: ld_i_a(cpu, &cpu->regs.i); break;
-    case 0x4F: ld_i_a(cpu, &cpu->regs.r); break;
-    case 0x57: ld_a_i(cpu, cpu->regs.i); break;
-    case 0x5F: ld_a_i(cpu, cpu->regs.r); break;
-
-    // rld/rrd
-    case 0x67: rrd(cpu); break;
-    case 0x6F: rld(cpu); break;
-
+    Z80_OPS_ED(X)
     default: nop(cpu); break;
     }
 }
@@ -1929,368 +1884,8 @@ static void do_ddfd(Z80_t *cpu, bool is_iy)
 
     switch (op)
     {
-    // ld ii, nn
-    case 0x21: ld_rr_nn(cpu, ii); break;
-    // inc ii
-    case 0x23: inc_rr(cpu, ii); break;
-    // dec ii
-    case 0x2B: dec_rr(cpu, ii); break;
-    // add ii, rr
-    case 0x09: add_rr_rr(cpu, ii, cpu->regs.main.bc); break;
-    case 0x19: add_rr_rr(cpu, ii, cpu->regs.main.de); break;
-    case 0x29: add_rr_rr(cpu, ii, *ii); break;
-    case 0x39: add_rr_rr(cpu, ii, cpu->regs.sp); break;
-
-    // inc (ii+d)
-    case 0x34: inc_iid(cpu, *ii); break;
-    // dec (ii+d)
-    case 0x35: dec_iid(cpu, *ii); break;
-    // ld (ii+d), n
-    case 0x36: ld_iid_n(cpu, *ii); break;
-
-    // ld (nn), ii
-    case 0x22: ld_nna_rr(cpu, *ii); break;
-    // ld ii, (nn)
-    case 0x2A: ld_rr_nna(cpu, ii); break;
-
-    // ld (ii+d), r
-    case 0x70: ld_iid_r(cpu, *ii, cpu->regs.main.b); break;
-    case 0x71: ld_iid_r(cpu, *ii, cpu->regs.main.c); break;
-    case 0x72: ld_iid_r(cpu, *ii, cpu->regs.main.d); break;
-    case 0x73: ld_iid_r(cpu, *ii, cpu->regs.main.e); break;
-    case 0x74: ld_iid_r(cpu, *ii, cpu->regs.main.h); break;
-    case 0x75: ld_iid_r(cpu, *ii, cpu->regs.main.l); break;
-    case 0x77: ld_iid_r(cpu, *ii, cpu->regs.main.a); break;
-
-    // ld r, (ii+d)
-    case 0x46: ld_r_iid(cpu, &cpu->regs.main.b, *ii); break;
-    case 0x4E: ld_r_iid(cpu, &cpu->regs.main.c, *ii); break;
-    case 0x56: ld_r_iid(cpu, &cpu->regs.main.d, *ii); break;
-    case 0x5E: ld_r_iid(cpu, &cpu->regs.main.e, *ii); break;
-    case 0x66: ld_r_iid(cpu, &cpu->regs.main.h, *ii); break;
-    case 0x6E: ld_r_iid(cpu, &cpu->regs.main.l, *ii); break;
-    case 0x7E: ld_r_iid(cpu, &cpu->regs.main.a, *ii); break;
-
-    // add/adc/sub/sbc/and/xor/or/cp (ii+d)
-    case 0x86: alo_iid(cpu, *ii, 0); break;
-    case 0x8E: alo_iid(cpu, *ii, 1); break;
-    case 0x96: alo_iid(cpu, *ii, 2); break;
-    case 0x9E: alo_iid(cpu, *ii, 3); break;
-    case 0xA6: alo_iid(cpu, *ii, 4); break;
-    case 0xAE: alo_iid(cpu, *ii, 5); break;
-    case 0xB6: alo_iid(cpu, *ii, 6); break;
-    case 0xBE: alo_iid(cpu, *ii, 7); break;
-
-    // non (ii+d) alo
-    // add a
-    case 0x80: alo_r(cpu, cpu->regs.main.b, 0); break;
-    case 0x81: alo_r(cpu, cpu->regs.main.c, 0); break;
-    case 0x82: alo_r(cpu, cpu->regs.main.d, 0); break;
-    case 0x83: alo_r(cpu, cpu->regs.main.e, 0); break;
-    case 0x84: alo_r(cpu, *ih, 0); break;
-    case 0x85: alo_r(cpu, *il, 0); break;
-    case 0x87: alo_r(cpu, cpu->regs.main.a, 0); break;
-    // adc a
-    case 0x88: alo_r(cpu, cpu->regs.main.b, 1); break;
-    case 0x89: alo_r(cpu, cpu->regs.main.c, 1); break;
-    case 0x8A: alo_r(cpu, cpu->regs.main.d, 1); break;
-    case 0x8B: alo_r(cpu, cpu->regs.main.e, 1); break;
-    case 0x8C: alo_r(cpu, *ih, 1); break;
-    case 0x8D: alo_r(cpu, *il, 1); break;
-    case 0x8F: alo_r(cpu, cpu->regs.main.a, 1); break;
-    // sub
-    case 0x90: alo_r(cpu, cpu->regs.main.b, 2); break;
-    case 0x91: alo_r(cpu, cpu->regs.main.c, 2); break;
-    case 0x92: alo_r(cpu, cpu->regs.main.d, 2); break;
-    case 0x93: alo_r(cpu, cpu->regs.main.e, 2); break;
-    case 0x94: alo_r(cpu, *ih, 2); break;
-    case 0x95: alo_r(cpu, *il, 2); break;
-    case 0x97: alo_r(cpu, cpu->regs.main.a, 2); break;
-    // sbc a
-    case 0x98: alo_r(cpu, cpu->regs.main.b, 3); break;
-    case 0x99: alo_r(cpu, cpu->regs.main.c, 3); break;
-    case 0x9A: alo_r(cpu, cpu->regs.main.d, 3); break;
-    case 0x9B: alo_r(cpu, cpu->regs.main.e, 3); break;
-    case 0x9C: alo_r(cpu, *ih, 3); break;
-    case 0x9D: alo_r(cpu, *il, 3); break;
-    case 0x9F: alo_r(cpu, cpu->regs.main.a, 3); break;
-    // and
-    case 0xA0: alo_r(cpu, cpu->regs.main.b, 4); break;
-    case 0xA1: alo_r(cpu, cpu->regs.main.c, 4); break;
-    case 0xA2: alo_r(cpu, cpu->regs.main.d, 4); break;
-    case 0xA3: alo_r(cpu, cpu->regs.main.e, 4); break;
-    case 0xA4: alo_r(cpu, *ih, 4); break;
-    case 0xA5: alo_r(cpu, *il, 4); break;
-    case 0xA7: alo_r(cpu, cpu->regs.main.a, 4); break;
-    // xor
-    case 0xA8: alo_r(cpu, cpu->regs.main.b, 5); break;
-    case 0xA9: alo_r(cpu, cpu->regs.main.c, 5); break;
-    case 0xAA: alo_r(cpu, cpu->regs.main.d, 5); break;
-    case 0xAB: alo_r(cpu, cpu->regs.main.e, 5); break;
-    case 0xAC: alo_r(cpu, *ih, 5); break;
-    case 0xAD: alo_r(cpu, *il, 5); break;
-    case 0xAF: alo_r(cpu, cpu->regs.main.a, 5); break;
-    // or
-    case 0xB0: alo_r(cpu, cpu->regs.main.b, 6); break;
-    case 0xB1: alo_r(cpu, cpu->regs.main.c, 6); break;
-    case 0xB2: alo_r(cpu, cpu->regs.main.d, 6); break;
-    case 0xB3: alo_r(cpu, cpu->regs.main.e, 6); break;
-    case 0xB4: alo_r(cpu, *ih, 6); break;
-    case 0xB5: alo_r(cpu, *il, 6); break;
-    case 0xB7: alo_r(cpu, cpu->regs.main.a, 6); break;
-    // cp
-    case 0xB8: alo_r(cpu, cpu->regs.main.b, 7); break;
-    case 0xB9: alo_r(cpu, cpu->regs.main.c, 7); break;
-    case 0xBA: alo_r(cpu, cpu->regs.main.d, 7); break;
-    case 0xBB: alo_r(cpu, cpu->regs.main.e, 7); break;
-    case 0xBC: alo_r(cpu, *ih, 7); break;
-    case 0xBD: alo_r(cpu, *il, 7); break;
-    case 0xBF: alo_r(cpu, cpu->regs.main.a, 7); break;
-
-    // inc r
-    case 0x04: inc_r(cpu, &cpu->regs.main.b); break;
-    case 0x0C: inc_r(cpu, &cpu->regs.main.c); break;
-    case 0x14: inc_r(cpu, &cpu->regs.main.d); break;
-    case 0x1C: inc_r(cpu, &cpu->regs.main.e); break;
-    case 0x24: inc_r(cpu, ih); break;
-    case 0x2C: inc_r(cpu, il); break;
-    case 0x3C: inc_r(cpu, &cpu->regs.main.a); break;
-    // dec r
-    case 0x05: dec_r(cpu, &cpu->regs.main.b); break;
-    case 0x0D: dec_r(cpu, &cpu->regs.main.c); break;
-    case 0x15: dec_r(cpu, &cpu->regs.main.d); break;
-    case 0x1D: dec_r(cpu, &cpu->regs.main.e); break;
-    case 0x25: dec_r(cpu, ih); break;
-    case 0x2D: dec_r(cpu, il); break;
-    case 0x3D: dec_r(cpu, &cpu->regs.main.a); break;
-
-    // ld b, r
-    case 0x40: ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.b); break;
-    case 0x41: ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.c); break;
-    case 0x42: ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.d); break;
-    case 0x43: ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.e); break;
-    case 0x44: ld_r_r(cpu, &cpu->regs.main.b, *ih); break;
-    case 0x45: ld_r_r(cpu, &cpu->regs.main.b, *il); break;
-    case 0x47: ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.a); break;
-    // ld c, r
-    case 0x48: ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.b); break;
-    case 0x49: ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.c); break;
-    case 0x4A: ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.d); break;
-    case 0x4B: ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.e); break;
-    case 0x4C: ld_r_r(cpu, &cpu->regs.main.c, *ih); break;
-    case 0x4D: ld_r_r(cpu, &cpu->regs.main.c, *il); break;
-    case 0x4F: ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.a); break;
-    // ld d, r
-    case 0x50: ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.b); break;
-    case 0x51: ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.c); break;
-    case 0x52: ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.d); break;
-    case 0x53: ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.e); break;
-    case 0x54: ld_r_r(cpu, &cpu->regs.main.d, *ih); break;
-    case 0x55: ld_r_r(cpu, &cpu->regs.main.d, *il); break;
-    case 0x57: ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.a); break;
-    // ld e, r
-    case 0x58: ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.b); break;
-    case 0x59: ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.c); break;
-    case 0x5A: ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.d); break;
-    case 0x5B: ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.e); break;
-    case 0x5C: ld_r_r(cpu, &cpu->regs.main.e, *ih); break;
-    case 0x5D: ld_r_r(cpu, &cpu->regs.main.e, *il); break;
-    case 0x5F: ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.a); break;
-    // ld ih, r
-    case 0x60: ld_r_r(cpu, ih, cpu->regs.main.b); break;
-    case 0x61: ld_r_r(cpu, ih, cpu->regs.main.c); break;
-    case 0x62: ld_r_r(cpu, ih, cpu->regs.main.d); break;
-    case 0x63: ld_r_r(cpu, ih, cpu->regs.main.e); break;
-    case 0x64: ld_r_r(cpu, ih, *ih); break;
-    case 0x65: ld_r_r(cpu, ih, *il); break;
-    case 0x67: ld_r_r(cpu, ih, cpu->regs.main.a); break;
-    // ld il, r
-    case 0x68: ld_r_r(cpu, il, cpu->regs.main.b); break;
-    case 0x69: ld_r_r(cpu, il, cpu->regs.main.c); break;
-    case 0x6A: ld_r_r(cpu, il, cpu->regs.main.d); break;
-    case 0x6B: ld_r_r(cpu, il, cpu->regs.main.e); break;
-    case 0x6C: ld_r_r(cpu, il, *ih); break;
-    case 0x6D: ld_r_r(cpu, il, *il); break;
-    case 0x6F: ld_r_r(cpu, il, cpu->regs.main.a); break;
-    // ld a, r
-    case 0x78: ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.b); break;
-    case 0x79: ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.c); break;
-    case 0x7A: ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.d); break;
-    case 0x7B: ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.e); break;
-    case 0x7C: ld_r_r(cpu, &cpu->regs.main.a, *ih); break;
-    case 0x7D: ld_r_r(cpu, &cpu->regs.main.a, *il); break;
-    case 0x7F: ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.a); break;
-
-    // ld r, n
-    case 0x06: ld_r_n(cpu, &cpu->regs.main.b); break;
-    case 0x0E: ld_r_n(cpu, &cpu->regs.main.c); break;
-    case 0x16: ld_r_n(cpu, &cpu->regs.main.d); break;
-    case 0x1E: ld_r_n(cpu, &cpu->regs.main.e); break;
-    case 0x26: ld_r_n(cpu, ih); break;
-    case 0x2E: ld_r_n(cpu, il); break;
-    case 0x3E: ld_r_n(cpu, &cpu->regs.main.a); break;
-
-    // ld sp, ii
-    case 0xF9: ld_sp_rr(cpu, *ii); break;
-
-    // jp ii
-    case 0xE9: jp_rr(cpu, *ii); break;
-
-    // IY/IX prefix
-    case 0xDD: ddfd(cpu, false); break;
-    case 0xFD: ddfd(cpu, true); break;
-
-    // pop/push ii
-    case 0xE1: pop(cpu, ii); break;
-    case 0xE5: push(cpu, *ii); break;
-    // ex (sp), ii
-    case 0xE3: ex_spa_rr(cpu, ii); break;
-
-    // bit instructions
-    case 0xCB: do_ddfd_cb(cpu, ii); break;
-
-    // DUPLICATE OPCODES
-    // ld rr, nn
-    case 0x01: ld_rr_nn(cpu, &cpu->regs.main.bc); break;
-    case 0x11: ld_rr_nn(cpu, &cpu->regs.main.de); break;
-    case 0x31: ld_rr_nn(cpu, &cpu->regs.sp); break;
-
-    // ld (rr), a
-    case 0x02: ld_rra_a(cpu, cpu->regs.main.bc); break;
-    case 0x12: ld_rra_a(cpu, cpu->regs.main.de); break;
-    // ld a, (rr)
-    case 0x0A: ld_a_rra(cpu, cpu->regs.main.bc); break;
-    case 0x1A: ld_a_rra(cpu, cpu->regs.main.de); break;
-    // ld a, (nn)
-    case 0x3A: ld_a_nna(cpu); break;
-    // ld (nn), a
-    case 0x32: ld_nna_a(cpu); break;
-    // inc rr
-    case 0x03: inc_rr(cpu, &cpu->regs.main.bc); break;
-    case 0x13: inc_rr(cpu, &cpu->regs.main.de); break;
-    case 0x33: inc_rr(cpu, &cpu->regs.sp); break;
-    // dec rr
-    case 0x0B: dec_rr(cpu, &cpu->regs.main.bc); break;
-    case 0x1B: dec_rr(cpu, &cpu->regs.main.de); break;
-    case 0x3B: dec_rr(cpu, &cpu->regs.sp); break;
-
-    // rra/rla/rrca/rlca
-    case 0x07: rlca(cpu); break;
-    case 0x0F: rrca(cpu); break;
-    case 0x17: rla(cpu); break;
-    case 0x1F: rra(cpu); break;
-
-    case 0x27: daa(cpu); break;
-    // cpl
-    case 0x2F: cpl(cpu); break;
-    // scf/ccf
-    case 0x37: scf(cpu); break;
-    case 0x3F: ccf(cpu); break;
-
-    // add/adc/sub/sbc/and/xor/or/cp n
-    case 0xC6: alo_n(cpu, 0); break;
-    case 0xCE: alo_n(cpu, 1); break;
-    case 0xD6: alo_n(cpu, 2); break;
-    case 0xDE: alo_n(cpu, 3); break;
-    case 0xE6: alo_n(cpu, 4); break;
-    case 0xEE: alo_n(cpu, 5); break;
-    case 0xF6: alo_n(cpu, 6); break;
-    case 0xFE: alo_n(cpu, 7); break;
-
-    // djnz
-    case 0x10: djnz_d(cpu); break;
-    // jr
-    case 0x18: jr_cc_d(cpu, true); break;
-    // jr cc, d
-    case 0x20: jr_cc_d(cpu, !cpu->regs.main.flags.z); break;
-    case 0x28: jr_cc_d(cpu, cpu->regs.main.flags.z); break;
-    case 0x30: jr_cc_d(cpu, !cpu->regs.main.flags.c); break;
-    case 0x38: jr_cc_d(cpu, cpu->regs.main.flags.c); break;
-    // jp cc, nn
-    case 0xC2: jp_cc_nn(cpu, !cpu->regs.main.flags.z); break;
-    case 0xCA: jp_cc_nn(cpu, cpu->regs.main.flags.z); break;
-    case 0xD2: jp_cc_nn(cpu, !cpu->regs.main.flags.c); break;
-    case 0xDA: jp_cc_nn(cpu, cpu->regs.main.flags.c); break;
-    case 0xE2: jp_cc_nn(cpu, !cpu->regs.main.flags.pv); break;
-    case 0xEA: jp_cc_nn(cpu, cpu->regs.main.flags.pv); break;
-    case 0xF2: jp_cc_nn(cpu, !cpu->regs.main.flags.s); break;
-    case 0xFA: jp_cc_nn(cpu, cpu->regs.main.flags.s); break;
-    // jp nn
-    case 0xC3: jp_cc_nn(cpu, true); break;
-    // call cc, nn
-    case 0xC4: call_cc_nn(cpu, !cpu->regs.main.flags.z); break;
-    case 0xCC: call_cc_nn(cpu, cpu->regs.main.flags.z); break;
-    case 0xD4: call_cc_nn(cpu, !cpu->regs.main.flags.c); break;
-    case 0xDC: call_cc_nn(cpu, cpu->regs.main.flags.c); break;
-    case 0xE4: call_cc_nn(cpu, !cpu->regs.main.flags.pv); break;
-    case 0xEC: call_cc_nn(cpu, cpu->regs.main.flags.pv); break;
-    case 0xF4: call_cc_nn(cpu, !cpu->regs.main.flags.s); break;
-    case 0xFC: call_cc_nn(cpu, cpu->regs.main.flags.s); break;
-    // call nn
-    case 0xCD: call_cc_nn(cpu, true); break;
-    // ret cc
-    case 0xC0: ret_cc(cpu, !cpu->regs.main.flags.z); break;
-    case 0xC8: ret_cc(cpu, cpu->regs.main.flags.z); break;
-    case 0xD0: ret_cc(cpu, !cpu->regs.main.flags.c); break;
-    case 0xD8: ret_cc(cpu, cpu->regs.main.flags.c); break;
-    case 0xE0: ret_cc(cpu, !cpu->regs.main.flags.pv); break;
-    case 0xE8: ret_cc(cpu, cpu->regs.main.flags.pv); break;
-    case 0xF0: ret_cc(cpu, !cpu->regs.main.flags.s); break;
-    case 0xF8: ret_cc(cpu, cpu->regs.main.flags.s); break;
-    // ret (same behavior as imaginary instruction pop pc)
-    case 0xC9: ret(cpu); break;
-
-    // rst
-    case 0xC7: rst(cpu, 0x00); break;
-    case 0xCF: rst(cpu, 0x08); break;
-    case 0xD7: rst(cpu, 0x10); break;
-    case 0xDF: rst(cpu, 0x18); break;
-    case 0xE7: rst(cpu, 0x20); break;
-    case 0xEF: rst(cpu, 0x28); break;
-    case 0xF7: rst(cpu, 0x30); break;
-    case 0xFF: rst(cpu, 0x38); break;
-
-    // pop
-    case 0xC1: pop(cpu, &cpu->regs.main.bc); break;
-    case 0xD1: pop(cpu, &cpu->regs.main.de); break;
-    case 0xF1: pop(cpu, &cpu->regs.main.af); break;
-    // push
-    case 0xC5: push(cpu, cpu->regs.main.bc); break;
-    case 0xD5: push(cpu, cpu->regs.main.de); break;
-    case 0xF5: push(cpu, cpu->regs.main.af); break;
-
-    // out (n), a
-    case 0xD3: out_na_a(cpu); break;
-    // in a, (n)
-    case 0xDB: in_a_na(cpu); break;
-
-    // ex af
-    case 0x08: ex_af(cpu); break;
-    // exx
-    case 0xD9: exx(cpu); break;
-    // XD
-    case 0xEB: ex_de_hl(cpu); break;
-
-    // DI / EI
-    case 0xF3: di(cpu); break;
-    case 0xFB: ei(cpu); break;
-    // halt
-    case 0x76: halt(cpu); break;
-
-    case 0x00: nop(cpu); break;
-
-    // misc instructions
-    case 0xED: do_ed(cpu); break;
-
-    default:
-        print_regs(cpu);
-
-        static const char ix_op[] = "DD";
-        static const char iy_op[] = "FD";
-        const char *prefix = is_iy ? iy_op : ix_op; 
-
-        dlog(LOG_ERR, "unimplemented opcode %s %02X at %04X", prefix, op, cpu->regs.pc);
-        cpu->error = 1;
+    Z80_OPS_DDFD(X)
+    default: unimplemented(cpu, is_iy ? "FD " : "DD "); break;
     }
 }
 
@@ -2302,362 +1897,415 @@ static void do_opcode(Z80_t *cpu)
 
     switch (op)
     {
-    // ld rr, nn
-    case 0x01: ld_rr_nn(cpu, &cpu->regs.main.bc); break;
-    case 0x11: ld_rr_nn(cpu, &cpu->regs.main.de); break;
-    case 0x21: ld_rr_nn(cpu, &cpu->regs.main.hl); break;
-    case 0x31: ld_rr_nn(cpu, &cpu->regs.sp); break;
-
-    // ld (rr), a
-    case 0x02: ld_rra_a(cpu, cpu->regs.main.bc); break;
-    case 0x12: ld_rra_a(cpu, cpu->regs.main.de); break;
-    // ld a, (rr)
-    case 0x0A: ld_a_rra(cpu, cpu->regs.main.bc); break;
-    case 0x1A: ld_a_rra(cpu, cpu->regs.main.de); break;
-    // ld a, (nn)
-    case 0x3A: ld_a_nna(cpu); break;
-
-    // inc rr
-    case 0x03: inc_rr(cpu, &cpu->regs.main.bc); break;
-    case 0x13: inc_rr(cpu, &cpu->regs.main.de); break;
-    case 0x23: inc_rr(cpu, &cpu->regs.main.hl); break;
-    case 0x33: inc_rr(cpu, &cpu->regs.sp); break;
-    // inc r
-    case 0x04: inc_r(cpu, &cpu->regs.main.b); break;
-    case 0x0C: inc_r(cpu, &cpu->regs.main.c); break;
-    case 0x14: inc_r(cpu, &cpu->regs.main.d); break;
-    case 0x1C: inc_r(cpu, &cpu->regs.main.e); break;
-    case 0x24: inc_r(cpu, &cpu->regs.main.h); break;
-    case 0x2C: inc_r(cpu, &cpu->regs.main.l); break;
-    case 0x34: inc_rra(cpu, cpu->regs.main.hl); break;
-    case 0x3C: inc_r(cpu, &cpu->regs.main.a); break;
-    // dec r
-    case 0x05: dec_r(cpu, &cpu->regs.main.b); break;
-    case 0x0D: dec_r(cpu, &cpu->regs.main.c); break;
-    case 0x15: dec_r(cpu, &cpu->regs.main.d); break;
-    case 0x1D: dec_r(cpu, &cpu->regs.main.e); break;
-    case 0x25: dec_r(cpu, &cpu->regs.main.h); break;
-    case 0x2D: dec_r(cpu, &cpu->regs.main.l); break;
-    case 0x35: dec_rra(cpu, cpu->regs.main.hl); break;
-    case 0x3D: dec_r(cpu, &cpu->regs.main.a); break;
-    // dec rr
-    case 0x0B: dec_rr(cpu, &cpu->regs.main.bc); break;
-    case 0x1B: dec_rr(cpu, &cpu->regs.main.de); break;
-    case 0x2B: dec_rr(cpu, &cpu->regs.main.hl); break;
-    case 0x3B: dec_rr(cpu, &cpu->regs.sp); break;
-
-    // ld r, n
-    case 0x06: ld_r_n(cpu, &cpu->regs.main.b); break;
-    case 0x0E: ld_r_n(cpu, &cpu->regs.main.c); break;
-    case 0x16: ld_r_n(cpu, &cpu->regs.main.d); break;
-    case 0x1E: ld_r_n(cpu, &cpu->regs.main.e); break;
-    case 0x26: ld_r_n(cpu, &cpu->regs.main.h); break;
-    case 0x2E: ld_r_n(cpu, &cpu->regs.main.l); break;
-    case 0x36: ld_rra_n(cpu, cpu->regs.main.hl); break;
-    case 0x3E: ld_r_n(cpu, &cpu->regs.main.a); break;
-
-    // add hl, rr
-    case 0x09: add_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.main.bc); break;
-    case 0x19: add_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.main.de); break;
-    case 0x29: add_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.main.hl); break;
-    case 0x39: add_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.sp); break;
-
-    // rra/rla/rrca/rlca
-    case 0x07: rlca(cpu); break;
-    case 0x0F: rrca(cpu); break;
-    case 0x17: rla(cpu); break;
-    case 0x1F: rra(cpu); break;
-
-    // ld (nn), hl
-    case 0x22: ld_nna_rr(cpu, cpu->regs.main.hl); break;
-    // ld hl, (nn)
-    case 0x2A: ld_rr_nna(cpu, &cpu->regs.main.hl); break;
-    // ld (nn), a
-    case 0x32: ld_nna_a(cpu); break;
-    // ld sp, hl
-    case 0xF9: ld_sp_rr(cpu, cpu->regs.main.hl); break;
-
-    case 0x27: daa(cpu); break;
-    // cpl
-    case 0x2F: cpl(cpu); break;
-    // scf/ccf
-    case 0x37: scf(cpu); break;
-    case 0x3F: ccf(cpu); break;
-
-    // ld b, reg
-    case 0x40: ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.b); break;
-    case 0x41: ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.c); break;
-    case 0x42: ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.d); break;
-    case 0x43: ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.e); break;
-    case 0x44: ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.h); break;
-    case 0x45: ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.l); break;
-    case 0x46: ld_r_rra(cpu, &cpu->regs.main.b, cpu->regs.main.hl); break;
-    case 0x47: ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.a); break;
-    // ld c, reg
-    case 0x48: ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.b); break;
-    case 0x49: ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.c); break;
-    case 0x4A: ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.d); break;
-    case 0x4B: ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.e); break;
-    case 0x4C: ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.h); break;
-    case 0x4D: ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.l); break;
-    case 0x4E: ld_r_rra(cpu, &cpu->regs.main.c, cpu->regs.main.hl); break;
-    case 0x4F: ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.a); break;
-    // ld d, reg
-    case 0x50: ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.b); break;
-    case 0x51: ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.c); break;
-    case 0x52: ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.d); break;
-    case 0x53: ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.e); break;
-    case 0x54: ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.h); break;
-    case 0x55: ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.l); break;
-    case 0x56: ld_r_rra(cpu, &cpu->regs.main.d, cpu->regs.main.hl); break;
-    case 0x57: ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.a); break;
-    // ld e, reg
-    case 0x58: ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.b); break;
-    case 0x59: ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.c); break;
-    case 0x5A: ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.d); break;
-    case 0x5B: ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.e); break;
-    case 0x5C: ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.h); break;
-    case 0x5D: ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.l); break;
-    case 0x5E: ld_r_rra(cpu, &cpu->regs.main.e, cpu->regs.main.hl); break;
-    case 0x5F: ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.a); break;
-    // ld h, reg
-    case 0x60: ld_r_r(cpu, &cpu->regs.main.h, cpu->regs.main.b); break;
-    case 0x61: ld_r_r(cpu, &cpu->regs.main.h, cpu->regs.main.c); break;
-    case 0x62: ld_r_r(cpu, &cpu->regs.main.h, cpu->regs.main.d); break;
-    case 0x63: ld_r_r(cpu, &cpu->regs.main.h, cpu->regs.main.e); break;
-    case 0x64: ld_r_r(cpu, &cpu->regs.main.h, cpu->regs.main.h); break;
-    case 0x65: ld_r_r(cpu, &cpu->regs.main.h, cpu->regs.main.l); break;
-    case 0x66: ld_r_rra(cpu, &cpu->regs.main.h, cpu->regs.main.hl); break;
-    case 0x67: ld_r_r(cpu, &cpu->regs.main.h, cpu->regs.main.a); break;
-    // ld l, reg
-    case 0x68: ld_r_r(cpu, &cpu->regs.main.l, cpu->regs.main.b); break;
-    case 0x69: ld_r_r(cpu, &cpu->regs.main.l, cpu->regs.main.c); break;
-    case 0x6A: ld_r_r(cpu, &cpu->regs.main.l, cpu->regs.main.d); break;
-    case 0x6B: ld_r_r(cpu, &cpu->regs.main.l, cpu->regs.main.e); break;
-    case 0x6C: ld_r_r(cpu, &cpu->regs.main.l, cpu->regs.main.h); break;
-    case 0x6D: ld_r_r(cpu, &cpu->regs.main.l, cpu->regs.main.l); break;
-    case 0x6E: ld_r_rra(cpu, &cpu->regs.main.l, cpu->regs.main.hl); break;
-    case 0x6F: ld_r_r(cpu, &cpu->regs.main.l, cpu->regs.main.a); break;
-    // ld a, reg
-    case 0x78: ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.b); break;
-    case 0x79: ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.c); break;
-    case 0x7A: ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.d); break;
-    case 0x7B: ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.e); break;
-    case 0x7C: ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.h); break;
-    case 0x7D: ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.l); break;
-    case 0x7E: ld_r_rra(cpu, &cpu->regs.main.a, cpu->regs.main.hl); break;
-    case 0x7F: ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.a); break;
-
-    // ld (hl), r
-    case 0x70: ld_rra_r(cpu, cpu->regs.main.hl, cpu->regs.main.b); break;
-    case 0x71: ld_rra_r(cpu, cpu->regs.main.hl, cpu->regs.main.c); break;
-    case 0x72: ld_rra_r(cpu, cpu->regs.main.hl, cpu->regs.main.d); break;
-    case 0x73: ld_rra_r(cpu, cpu->regs.main.hl, cpu->regs.main.e); break;
-    case 0x74: ld_rra_r(cpu, cpu->regs.main.hl, cpu->regs.main.h); break;
-    case 0x75: ld_rra_r(cpu, cpu->regs.main.hl, cpu->regs.main.l); break;
-    case 0x77: ld_rra_r(cpu, cpu->regs.main.hl, cpu->regs.main.a); break;
-
-    // add a
-    case 0x80: alo_r(cpu, cpu->regs.main.b, 0); break;
-    case 0x81: alo_r(cpu, cpu->regs.main.c, 0); break;
-    case 0x82: alo_r(cpu, cpu->regs.main.d, 0); break;
-    case 0x83: alo_r(cpu, cpu->regs.main.e, 0); break;
-    case 0x84: alo_r(cpu, cpu->regs.main.h, 0); break;
-    case 0x85: alo_r(cpu, cpu->regs.main.l, 0); break;
-    case 0x86: alo_rra(cpu, cpu->regs.main.hl, 0); break;
-    case 0x87: alo_r(cpu, cpu->regs.main.a, 0); break;
-    // adc a
-    case 0x88: alo_r(cpu, cpu->regs.main.b, 1); break;
-    case 0x89: alo_r(cpu, cpu->regs.main.c, 1); break;
-    case 0x8A: alo_r(cpu, cpu->regs.main.d, 1); break;
-    case 0x8B: alo_r(cpu, cpu->regs.main.e, 1); break;
-    case 0x8C: alo_r(cpu, cpu->regs.main.h, 1); break;
-    case 0x8D: alo_r(cpu, cpu->regs.main.l, 1); break;
-    case 0x8E: alo_rra(cpu, cpu->regs.main.hl, 1); break;
-    case 0x8F: alo_r(cpu, cpu->regs.main.a, 1); break;
-    // sub
-    case 0x90: alo_r(cpu, cpu->regs.main.b, 2); break;
-    case 0x91: alo_r(cpu, cpu->regs.main.c, 2); break;
-    case 0x92: alo_r(cpu, cpu->regs.main.d, 2); break;
-    case 0x93: alo_r(cpu, cpu->regs.main.e, 2); break;
-    case 0x94: alo_r(cpu, cpu->regs.main.h, 2); break;
-    case 0x95: alo_r(cpu, cpu->regs.main.l, 2); break;
-    case 0x96: alo_rra(cpu, cpu->regs.main.hl, 2); break;
-    case 0x97: alo_r(cpu, cpu->regs.main.a, 2); break;
-    // sbc a
-    case 0x98: alo_r(cpu, cpu->regs.main.b, 3); break;
-    case 0x99: alo_r(cpu, cpu->regs.main.c, 3); break;
-    case 0x9A: alo_r(cpu, cpu->regs.main.d, 3); break;
-    case 0x9B: alo_r(cpu, cpu->regs.main.e, 3); break;
-    case 0x9C: alo_r(cpu, cpu->regs.main.h, 3); break;
-    case 0x9D: alo_r(cpu, cpu->regs.main.l, 3); break;
-    case 0x9E: alo_rra(cpu, cpu->regs.main.hl, 3); break;
-    case 0x9F: alo_r(cpu, cpu->regs.main.a, 3); break;
-    // and
-    case 0xA0: alo_r(cpu, cpu->regs.main.b, 4); break;
-    case 0xA1: alo_r(cpu, cpu->regs.main.c, 4); break;
-    case 0xA2: alo_r(cpu, cpu->regs.main.d, 4); break;
-    case 0xA3: alo_r(cpu, cpu->regs.main.e, 4); break;
-    case 0xA4: alo_r(cpu, cpu->regs.main.h, 4); break;
-    case 0xA5: alo_r(cpu, cpu->regs.main.l, 4); break;
-    case 0xA6: alo_rra(cpu, cpu->regs.main.hl, 4); break;
-    case 0xA7: alo_r(cpu, cpu->regs.main.a, 4); break;
-    // xor
-    case 0xA8: alo_r(cpu, cpu->regs.main.b, 5); break;
-    case 0xA9: alo_r(cpu, cpu->regs.main.c, 5); break;
-    case 0xAA: alo_r(cpu, cpu->regs.main.d, 5); break;
-    case 0xAB: alo_r(cpu, cpu->regs.main.e, 5); break;
-    case 0xAC: alo_r(cpu, cpu->regs.main.h, 5); break;
-    case 0xAD: alo_r(cpu, cpu->regs.main.l, 5); break;
-    case 0xAE: alo_rra(cpu, cpu->regs.main.hl, 5); break;
-    case 0xAF: alo_r(cpu, cpu->regs.main.a, 5); break;
-    // or
-    case 0xB0: alo_r(cpu, cpu->regs.main.b, 6); break;
-    case 0xB1: alo_r(cpu, cpu->regs.main.c, 6); break;
-    case 0xB2: alo_r(cpu, cpu->regs.main.d, 6); break;
-    case 0xB3: alo_r(cpu, cpu->regs.main.e, 6); break;
-    case 0xB4: alo_r(cpu, cpu->regs.main.h, 6); break;
-    case 0xB5: alo_r(cpu, cpu->regs.main.l, 6); break;
-    case 0xB6: alo_rra(cpu, cpu->regs.main.hl, 6); break;
-    case 0xB7: alo_r(cpu, cpu->regs.main.a, 6); break;
-    // cp
-    case 0xB8: alo_r(cpu, cpu->regs.main.b, 7); break;
-    case 0xB9: alo_r(cpu, cpu->regs.main.c, 7); break;
-    case 0xBA: alo_r(cpu, cpu->regs.main.d, 7); break;
-    case 0xBB: alo_r(cpu, cpu->regs.main.e, 7); break;
-    case 0xBC: alo_r(cpu, cpu->regs.main.h, 7); break;
-    case 0xBD: alo_r(cpu, cpu->regs.main.l, 7); break;
-    case 0xBE: alo_rra(cpu, cpu->regs.main.hl, 7); break;
-    case 0xBF: alo_r(cpu, cpu->regs.main.a, 7); break;
-
-    // add/adc/sub/sbc/and/xor/or/cp n
-    case 0xC6: alo_n(cpu, 0); break;
-    case 0xCE: alo_n(cpu, 1); break;
-    case 0xD6: alo_n(cpu, 2); break;
-    case 0xDE: alo_n(cpu, 3); break;
-    case 0xE6: alo_n(cpu, 4); break;
-    case 0xEE: alo_n(cpu, 5); break;
-    case 0xF6: alo_n(cpu, 6); break;
-    case 0xFE: alo_n(cpu, 7); break;
-
-    // djnz
-    case 0x10: djnz_d(cpu); break;
-    // jr
-    case 0x18: jr_cc_d(cpu, true); break;
-    // jr cc, d
-    case 0x20: jr_cc_d(cpu, !cpu->regs.main.flags.z); break;
-    case 0x28: jr_cc_d(cpu, cpu->regs.main.flags.z); break;
-    case 0x30: jr_cc_d(cpu, !cpu->regs.main.flags.c); break;
-    case 0x38: jr_cc_d(cpu, cpu->regs.main.flags.c); break;
-    // jp cc, nn
-    case 0xC2: jp_cc_nn(cpu, !cpu->regs.main.flags.z); break;
-    case 0xCA: jp_cc_nn(cpu, cpu->regs.main.flags.z); break;
-    case 0xD2: jp_cc_nn(cpu, !cpu->regs.main.flags.c); break;
-    case 0xDA: jp_cc_nn(cpu, cpu->regs.main.flags.c); break;
-    case 0xE2: jp_cc_nn(cpu, !cpu->regs.main.flags.pv); break;
-    case 0xEA: jp_cc_nn(cpu, cpu->regs.main.flags.pv); break;
-    case 0xF2: jp_cc_nn(cpu, !cpu->regs.main.flags.s); break;
-    case 0xFA: jp_cc_nn(cpu, cpu->regs.main.flags.s); break;
-    // jp nn
-    case 0xC3: jp_cc_nn(cpu, true); break;
-    // jp hl
-    case 0xE9: jp_rr(cpu, cpu->regs.main.hl); break;
-
-    // call cc, nn
-    case 0xC4: call_cc_nn(cpu, !cpu->regs.main.flags.z); break;
-    case 0xCC: call_cc_nn(cpu, cpu->regs.main.flags.z); break;
-    case 0xD4: call_cc_nn(cpu, !cpu->regs.main.flags.c); break;
-    case 0xDC: call_cc_nn(cpu, cpu->regs.main.flags.c); break;
-    case 0xE4: call_cc_nn(cpu, !cpu->regs.main.flags.pv); break;
-    case 0xEC: call_cc_nn(cpu, cpu->regs.main.flags.pv); break;
-    case 0xF4: call_cc_nn(cpu, !cpu->regs.main.flags.s); break;
-    case 0xFC: call_cc_nn(cpu, cpu->regs.main.flags.s); break;
-    // call nn
-    case 0xCD: call_cc_nn(cpu, true); break;
-    // ret cc
-    case 0xC0: ret_cc(cpu, !cpu->regs.main.flags.z); break;
-    case 0xC8: ret_cc(cpu, cpu->regs.main.flags.z); break;
-    case 0xD0: ret_cc(cpu, !cpu->regs.main.flags.c); break;
-    case 0xD8: ret_cc(cpu, cpu->regs.main.flags.c); break;
-    case 0xE0: ret_cc(cpu, !cpu->regs.main.flags.pv); break;
-    case 0xE8: ret_cc(cpu, cpu->regs.main.flags.pv); break;
-    case 0xF0: ret_cc(cpu, !cpu->regs.main.flags.s); break;
-    case 0xF8: ret_cc(cpu, cpu->regs.main.flags.s); break;
-    // ret (same behavior as imaginary instruction pop pc)
-    case 0xC9: ret(cpu); break;
-
-    // rst
-    case 0xC7: rst(cpu, 0x00); break;
-    case 0xCF: rst(cpu, 0x08); break;
-    case 0xD7: rst(cpu, 0x10); break;
-    case 0xDF: rst(cpu, 0x18); break;
-    case 0xE7: rst(cpu, 0x20); break;
-    case 0xEF: rst(cpu, 0x28); break;
-    case 0xF7: rst(cpu, 0x30); break;
-    case 0xFF: rst(cpu, 0x38); break;
-
-    // pop
-    case 0xC1: pop(cpu, &cpu->regs.main.bc); break;
-    case 0xD1: pop(cpu, &cpu->regs.main.de); break;
-    case 0xE1: pop(cpu, &cpu->regs.main.hl); break;
-    case 0xF1: pop(cpu, &cpu->regs.main.af); break;
-    // push
-    case 0xC5: push(cpu, cpu->regs.main.bc); break;
-    case 0xD5: push(cpu, cpu->regs.main.de); break;
-    case 0xE5: push(cpu, cpu->regs.main.hl); break;
-    case 0xF5: push(cpu, cpu->regs.main.af); break;
-
-    // out (n), a
-    case 0xD3: out_na_a(cpu); break;
-    // in a, (n)
-    case 0xDB: in_a_na(cpu); break;
-
-    // ex af
-    case 0x08: ex_af(cpu); break;
-    // exx
-    case 0xD9: exx(cpu); break;
-    // XD
-    case 0xEB: ex_de_hl(cpu); break;
-    // ex (sp), hl
-    case 0xE3: ex_spa_rr(cpu, &cpu->regs.main.hl); break;
-
-    // DI / EI
-    case 0xF3: di(cpu); break;
-    case 0xFB: ei(cpu); break;
-    // halt
-    case 0x76: halt(cpu); break;
-
-    case 0x00: nop(cpu); break;
-
-    // bit instructions
-    case 0xCB: do_cb(cpu); break;
-    // misc instructions
-    case 0xED: do_ed(cpu); break;
-
-    // IY/IX prefix
-    case 0xDD: ddfd(cpu, false); break;
-    case 0xFD: ddfd(cpu, true); break;
+    Z80_OPS_MAIN(X)
+    default: unimplemented(cpu, ""); break;
+    }
+}
+
+static void execute_switch(Z80_t *cpu)
+{
+    switch (cpu->prefix_state) 
+    {
+    case STATE_DD: do_ddfd(cpu, false); break;
+    case STATE_FD: do_ddfd(cpu, true); break;
+    default: do_opcode(cpu); break;
+    }
+}
 
+#undef DO_CB
+#undef DO_ED
+#undef DO_DDFD_CB
+#undef X
+
+/* Table dispatch.
+ * Every opcode gets its own tiny handler with the operands baked in,
+ * so there's no decoding left to do beyond a single indexed call. */
+
+typedef void (*OpHandler)(Z80_t *cpu);
+typedef void (*OpHandlerIndexed)(Z80_t *cpu, uint16_t addr);
+
+static void do_cb_table(Z80_t *cpu);
+static void do_ed_table(Z80_t *cpu);
+static void do_ddfd_cb_table(Z80_t *cpu, uint16_t *ii);
+
+#define DO_CB(cpu)          do_cb_table(cpu)
+#define DO_ED(cpu)          do_ed_table(cpu)
+#define DO_DDFD_CB(cpu, ii) do_ddfd_cb_table(cpu, ii)
+
+#define DDFD_LOCALS(reg)             \
+    uint16_t *ii = &cpu->regs.reg;   \
+    uint8_t *il = (uint8_t *)ii;     \
+    uint8_t *ih = il+1;              \
+    (void)ii; (void)il; (void)ih;
+
+#define X(op, impl) static void op_main_##op(Z80_t *cpu) { impl; }
+Z80_OPS_MAIN(X)
+#undef X
+#define X(op, impl) static void op_ed_##op(Z80_t *cpu) { impl; }
+Z80_OPS_ED(X)
+#undef X
+#define X(op, impl) static void op_cb_##op(Z80_t *cpu) { impl; }
+Z80_OPS_CB(X)
+#undef X
+#define X(op, impl) static void op_dd_##op(Z80_t *cpu) { DDFD_LOCALS(ix) impl; }
+Z80_OPS_DDFD(X)
+#undef X
+#define X(op, impl) static void op_fd_##op(Z80_t *cpu) { DDFD_LOCALS(iy) impl; }
+Z80_OPS_DDFD(X)
+#undef X
+#define X(op, impl) static void op_ddfd_cb_##op(Z80_t *cpu, uint16_t addr) { impl; }
+Z80_OPS_DDFD_CB(X)
+#undef X
+
+/* All the lists except ED cover the full opcode space,
+ * missing ED entries are left NULL and treated as NOPs. */
+#define X(op, impl) [op] = op_main_##op,
+static const OpHandler table_main[256] = { Z80_OPS_MAIN(X) };
+#undef X
+#define X(op, impl) [op] = op_ed_##op,
+static const OpHandler table_ed[256] = { Z80_OPS_ED(X) };
+#undef X
+#define X(op, impl) [op] = op_cb_##op,
+static const OpHandler table_cb[256] = { Z80_OPS_CB(X) };
+#undef X
+#define X(op, impl) [op] = op_dd_##op,
+static const OpHandler table_dd[256] = { Z80_OPS_DDFD(X) };
+#undef X
+#define X(op, impl) [op] = op_fd_##op,
+static const OpHandler table_fd[256] = { Z80_OPS_DDFD(X) };
+#undef X
+#define X(op, impl) [op] = op_ddfd_cb_##op,
+static const OpHandlerIndexed table_ddfd_cb[256] = { Z80_OPS_DDFD_CB(X) };
+#undef X
+
+/* indexed by prefix state */
+static const OpHandler *const tables_prefix[] = {
+    [STATE_NOPREFIX] = table_main,
+    [STATE_DD] = table_dd,
+    [STATE_FD] = table_fd,
+};
+
+static void do_ed_table(Z80_t *cpu)
+{
+    cpu->cycles += 4;
+    cpu->regs.pc++;
+    uint8_t op = cpu_read(cpu, cpu->regs.pc);
+    inc_refresh(cpu);
+
+    OpHandler handler = table_ed[op];
+    if (handler) {
+        handler(cpu);
+    } else {
+        nop(cpu);
+    }
+}
+
+static void do_cb_table(Z80_t *cpu)
+{
+    cpu->cycles += 4;
+    cpu->regs.pc++;
+    uint8_t op = cpu_read(cpu, cpu->regs.pc);
+    inc_refresh(cpu);
+
+    table_cb[op](cpu);
+}
+
+static void do_ddfd_cb_table(Z80_t *cpu, uint16_t *ii)
+{
+    cpu->cycles += 4;
+    cpu->regs.pc++;
+    int8_t d = (int8_t)cpu_read(cpu, cpu->regs.pc);
+    uint16_t addr = *ii + d;
+    cpu->regs.memptr = addr; 
+
+    cpu->cycles += 3;
+    cpu->regs.pc++;
+    uint8_t op = cpu_read(cpu, cpu->regs.pc);
+
+    table_ddfd_cb[op](cpu, addr);
+}
+
+static void execute_table(Z80_t *cpu)
+{
+    const OpHandler *table = tables_prefix[cpu->prefix_state];
+    cpu->prefix_state = STATE_NOPREFIX;
+
+    uint8_t op = cpu_read(cpu, cpu->regs.pc);
+    inc_refresh(cpu);
+
+    table[op](cpu);
+}
+
+/* Block cache dispatch.
+ * Instructions get decoded into records of (pc, handler) the first time
+ * they're executed, recording runs of them that follow each other as
+ * blocks, which are looked up by their starting PC. Replaying a record
+ * skips decoding the opcode and the second level of CB/ED tables,
+ * as well as the opcode fetch itself from pages that memory_read()
+ * has nothing to do for, meaning uncontended, unwatched ones.
+ * 
+ * A block never leaves the 256-byte page it started in, and stores the
+ * generation of that page from memory_write() at the time it was decoded,
+ * so any write to it invalidates the whole block. Every record is also
+ * checked against the current PC, so interrupts, taken or not taken
+ * branches and hooks simply fall back to a lookup.
+ * Prefixed DD/FD instructions always go through the tables. */
+
+#define BLOCK_CACHE_SIZE    2048    // direct-mapped, power of 2
+#define BLOCK_MAX_OPS       16
+
+struct Z80BlockOp {
+    OpHandler handler;
+    uint16_t pc;
+    enum { BLOCK_OP_MAIN, BLOCK_OP_CB, BLOCK_OP_ED } kind;
+};
+
+struct Z80Block {
+    uint16_t pc;
+    uint8_t count;
+    bool valid;
+    uint32_t gen;
+    struct Z80BlockOp ops[BLOCK_MAX_OPS];
+};
+
+struct Z80BlockCache {
+    struct Z80Block *cur;   // block being replayed or recorded
+    uint8_t index;          // next record in cur
+    bool recording;
+    struct Z80Block blocks[BLOCK_CACHE_SIZE];
+};
+
+static void block_cache_flush(Z80_t *cpu)
+{
+    struct Z80BlockCache *bc = cpu->blocks;
+    if (bc == NULL) return;
+
+    for (int i = 0; i < BLOCK_CACHE_SIZE; i++) {
+        bc->blocks[i].valid = false;
+    }
+    bc->cur = NULL;
+    bc->recording = false;
+}
+
+static inline bool block_is_valid(Z80_t *cpu, struct Z80Block *b)
+{
+    return b->valid && b->gen == cpu->ctx->memory->page_gen[b->pc >> 8];
+}
+
+/* Decodes the instruction at pc into a record, without any side effects. */
+static void block_decode(Z80_t *cpu, uint16_t pc, struct Z80BlockOp *op)
+{
+    const Memory_t *mem = cpu->ctx->memory;
+    uint8_t code = memory_bus_peek(mem, pc);
+
+    op->pc = pc;
+    switch (code)
+    {
+    case 0xCB:
+        op->kind = BLOCK_OP_CB;
+        op->handler = table_cb[memory_bus_peek(mem, pc + 1)];
+        break;
+    case 0xED:
+        op->kind = BLOCK_OP_ED;
+        op->handler = table_ed[memory_bus_peek(mem, pc + 1)];
+        if (op->handler == NULL) op->handler = nop;
+        break;
     default:
-        print_regs(cpu);
-        dlog(LOG_ERR, "unimplemented opcode %02X at %04X", op, cpu->regs.pc);
-        cpu->error = 1;
+        op->kind = BLOCK_OP_MAIN;
+        op->handler = table_main[code];
+        break;
     }
 }
 
-void cpu_fire_interrupt(Z80_t *cpu)
+/* Returns the record to execute at the current PC, 
+ * or NULL if the instruction can't be cached. */
+static const struct Z80BlockOp *block_next(Z80_t *cpu)
 {
-    if (cpu->regs.iff1) {
-        cpu->interrupt_pending = 1;
+    struct Z80BlockCache *bc = cpu->blocks;
+    struct Z80Block *b = bc->cur;
+    uint16_t pc = cpu->regs.pc;
+
+    // continue the current block
+    if (b && block_is_valid(cpu, b)) {
+        if (bc->index < b->count && b->ops[bc->index].pc == pc) {
+            return &b->ops[bc->index++];
+        }
     }
+
+    uint8_t code = memory_bus_peek(cpu->ctx->memory, pc);
+    bool cacheable = code != 0xDD && code != 0xFD && (pc & 0xFF) < 0xFF;
+
+    // extend the block being recorded
+    if (bc->recording && b && bc->index == b->count && b->count < BLOCK_MAX_OPS
+        && cacheable && (pc >> 8) == (b->pc >> 8) && block_is_valid(cpu, b)) {
+        block_decode(cpu, pc, &b->ops[b->count]);
+        b->count++;
+        return &b->ops[bc->index++];
+    }
+
+    bc->recording = false;
+    bc->cur = NULL;
+    if (!cacheable) return NULL;
+
+    b = &bc->blocks[pc & (BLOCK_CACHE_SIZE - 1)];
+    if (!(b->pc == pc && block_is_valid(cpu, b))) {
+        // start recording a new one
+        b->pc = pc;
+        b->count = 0;
+        b->valid = true;
+        b->gen = cpu->ctx->memory->page_gen[pc >> 8];
+        block_decode(cpu, pc, &b->ops[b->count++]);
+        bc->recording = true;
+    }
+
+    bc->cur = b;
+    bc->index = 1;
+    return &b->ops[0];
 }
 
-static inline bool cpu_can_process_interrupts(Z80_t *cpu)
+static void execute_block(Z80_t *cpu)
 {
-    if (cpu->prefix_state == STATE_NOPREFIX && !cpu->last_ei)
-        return true;
-    else
-        return false;
+    if (cpu->blocks == NULL) {
+        cpu->blocks = malloc(sizeof(struct Z80BlockCache));
+        if (cpu->blocks) {
+            memset(cpu->blocks, 0, sizeof(struct Z80BlockCache));
+        }
+    }
+
+    if (cpu->blocks == NULL || cpu->prefix_state != STATE_NOPREFIX) {
+        execute_table(cpu);
+        return;
+    }
+
+    const struct Z80BlockOp *op = block_next(cpu);
+    if (op == NULL) {
+        execute_table(cpu);
+        return;
+    }
+
+    // both fetches are on the same page, watches may have changed
+    // since the block was recorded
+    bool fetch = cpu->ctx->memory->read_fast[cpu->regs.pc >> MEMORY_PAGE_SHIFT] == NULL;
+
+    if (fetch) cpu_read(cpu, cpu->regs.pc);
+    inc_refresh(cpu);
+
+    if (op->kind != BLOCK_OP_MAIN) {
+        cpu->cycles += 4;
+        cpu->regs.pc++;
+        if (fetch) cpu_read(cpu, cpu->regs.pc);
+        inc_refresh(cpu);
+    }
+
+    op->handler(cpu);
+}
+
+void cpu_deinit(Z80_t *cpu)
+{
+    free(cpu->blocks);
+    cpu->blocks = NULL;
+    jit_free(cpu);
+}
+
+/* Returns the handler of an unprefixed, CB or ED opcode, 
+ * to be called after the opcode has been fetched. */
+JitOpHandler cpu_get_op_handler(uint8_t prefix, uint8_t op)
+{
+    switch (prefix)
+    {
+    case 0xCB:
+        return table_cb[op];
+    case 0xED:
+        return table_ed[op] ? table_ed[op] : nop;
+    default:
+        return table_main[op];
+    }
+}
+
+#ifdef Z80_COMPUTED_GOTO
+
+/* Computed goto dispatch.
+ * Same as the table dispatch, except the unprefixed and DD/FD opcodes
+ * are all inlined into a single function and jumped to directly,
+ * which saves a call and lets the compiler schedule each of them separately.
+ * CB/ED groups still go through the tables. */
+static void execute_goto(Z80_t *cpu)
+{
+    #define X(op, impl) [op] = &&main_##op,
+    #define X_DD(op, impl) [op] = &&dd_##op,
+    #define X_FD(op, impl) [op] = &&fd_##op,
+    static const void *const labels[][256] = {
+        [STATE_NOPREFIX] = { Z80_OPS_MAIN(X) },
+        [STATE_DD] = { Z80_OPS_DDFD(X_DD) },
+        [STATE_FD] = { Z80_OPS_DDFD(X_FD) },
+    };
+    #undef X
+    #undef X_DD
+    #undef X_FD
+
+    const void *const *table = labels[cpu->prefix_state];
+    cpu->prefix_state = STATE_NOPREFIX;
+
+    uint8_t op = cpu_read(cpu, cpu->regs.pc);
+    inc_refresh(cpu);
+
+    goto *table[op];
+
+    #define X(op, impl) main_##op: impl; return;
+    Z80_OPS_MAIN(X)
+    #undef X
+    #define X(op, impl) dd_##op: { DDFD_LOCALS(ix) impl; } return;
+    Z80_OPS_DDFD(X)
+    #undef X
+    #define X(op, impl) fd_##op: { DDFD_LOCALS(iy) impl; } return;
+    Z80_OPS_DDFD(X)
+    #undef X
+}
+
+#endif
+
+#undef DO_CB
+#undef DO_ED
+#undef DO_DDFD_CB
+#undef DDFD_LOCALS
+
+static const char *dispatch_str[] = {
+    [DISPATCH_AUTO] = "auto",
+    [DISPATCH_SWITCH] = "switch",
+    [DISPATCH_TABLE] = "table",
+    [DISPATCH_GOTO] = "goto",
+    [DISPATCH_BLOCK] = "block",
+};
+
+/* Selects the instruction dispatch engine by name.
+ * Returns zero on success, non-zero otherwise. */
+int cpu_set_dispatch(Z80_t *cpu, const char *name)
+{
+    for (size_t i = 0; i < sizeof(dispatch_str) / sizeof(char *); i++) {
+        if (strcmp(name, dispatch_str[i]) == 0) {
+#ifndef Z80_COMPUTED_GOTO
+            if (i == DISPATCH_GOTO) {
+                dlog(LOG_WARN, "computed goto dispatch unavailable, using tables");
+            }
+#endif
+            cpu->dispatch = i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+const char *cpu_get_dispatch_name(Z80_t *cpu)
+{
+    return dispatch_str[cpu->dispatch];
+}
+
+void cpu_fire_interrupt(Z80_t *cpu)
+{
+    if (cpu->regs.iff1) {
+        cpu->interrupt_pending = 1;
+    }
 }
 
 int cpu_do_cycles(Z80_t *cpu)
@@ -2726,16 +2374,130 @@ int cpu_do_cycles(Z80_t *cpu)
         cpu_read(cpu, cpu->regs.pc+1);
         cpu->cycles += 4;
     } else {
-        cpu->last_ei = false;
-        switch (cpu->prefix_state) 
-        {
-        case STATE_DD: do_ddfd(cpu, false); break;
-        case STATE_FD: do_ddfd(cpu, true); break;
-        default: do_opcode(cpu); break;
+        // a chain of DD/FD prefixes and the instruction they prefix get
+        // executed in one go, as no interrupt can be accepted in between
+        // and nothing else happens there, unless a hook sits in the middle
+        enum PrefixState prefix = cpu->prefix_state;
+        for (;;) {
+            cpu->last_ei = false;
+            switch (cpu->dispatch)
+            {
+            case DISPATCH_SWITCH: execute_switch(cpu); break;
+            case DISPATCH_TABLE: execute_table(cpu); break;
+            case DISPATCH_BLOCK: execute_block(cpu); break;
+            default:
+#ifdef Z80_COMPUTED_GOTO
+                execute_goto(cpu);
+#else
+                execute_table(cpu);
+#endif
+                break;
+            }
+
+            if (cpu->prefix_state == STATE_NOPREFIX) break;
+            if (prefix == STATE_NOPREFIX) {
+                cpu->prefix_runs++;
+                prefix = cpu->prefix_state;
+            }
+            if (cpu->split_prefixes || cpu->error || cpu_has_pc_hook(cpu, cpu->regs.pc)) break;
+
+            cpu->regs.q_old = cpu->regs.q;
+            cpu->regs.q = false;
         }
     }
 
     cpu->interrupt_pending = false;
 
     return cpu->cycles - cyc_old;
-}
\ No newline at end of file
+}
+
+/* Skips ahead to the deadline while halted, with the same result as
+ * stepping through it: every 4 T-states the cpu refreshes and fetches
+ * from PC+1, which may be contended or watched. Always does at least one step. */
+static void halt_skip(Z80_t *cpu, uint64_t deadline)
+{
+    uint16_t addr = cpu->regs.pc + 1;
+    uint64_t target = deadline > cpu->cycles ? deadline : cpu->cycles + 1;
+    uint64_t steps = 0;
+
+    if (cpu->ctx->memory->read_fast[addr >> MEMORY_PAGE_SHIFT] == NULL) {
+        uint8_t value;
+        while (cpu->cycles < target) {
+            cpu->cycles += memory_read(cpu->ctx, addr, &value) + 4;
+            steps++;
+        }
+    } else {
+        steps = (target - cpu->cycles + 3) / 4;
+        cpu->cycles += steps * 4;
+    }
+
+    cpu->regs.q_old = steps == 1 ? cpu->regs.q : false;
+    cpu->regs.q = false;
+    cpu->regs.r = (cpu->regs.r & (1<<7)) | ((cpu->regs.r + steps) & 127);
+}
+
+/* cpu_run_until() while profiling or tracing, which need to see every
+ * instruction: steps one at a time, without HALT and block instruction
+ * fast-forwarding or the recompiler. */
+static int run_observed(Z80_t *cpu, uint64_t deadline)
+{
+    uint64_t cyc_old = cpu->cycles;
+
+    do {
+        if (cpu->profile != NULL) profile_step_begin(cpu);
+        if (cpu->trace != NULL) trace_step_begin(cpu);
+        cpu_do_cycles(cpu);
+        if (cpu->trace != NULL) trace_step_end(cpu);
+        if (cpu->profile != NULL) profile_step_end(cpu);
+    } while (cpu->cycles < deadline && !cpu->error
+             && !cpu_has_pc_hook(cpu, cpu->regs.pc));
+
+    return cpu->cycles - cyc_old;
+}
+
+/* Runs instructions until cycles reach the deadline, the cpu errors or
+ * PC lands on a hooked address. The first instruction is always executed,
+ * so a caller stopped at a hook can simply call this again.
+ * Returns the amount of cycles executed. */
+int cpu_run_until(Z80_t *cpu, uint64_t deadline)
+{
+    if (cpu->profile != NULL || cpu->trace != NULL) {
+        return run_observed(cpu, deadline);
+    }
+
+    uint64_t cyc_old = cpu->cycles;
+    cpu->deadline = deadline;
+
+    do {
+        if (cpu->halted && !cpu->interrupt_pending
+            && !cpu_has_pc_hook(cpu, cpu->regs.pc)) {
+            halt_skip(cpu, deadline);
+        } else if (cpu->jit_mode == JIT_OFF || !jit_run(cpu, deadline)) {
+            cpu_do_cycles(cpu);
+        }
+    } while (cpu->cycles < deadline && !cpu->error
+             && !cpu_has_pc_hook(cpu, cpu->regs.pc));
+
+    cpu->deadline = 0;
+    return cpu->cycles - cyc_old;
+}
+
+void cpu_set_pc_hook(Z80_t *cpu, uint16_t pc, bool enable)
+{
+    if (enable) {
+        cpu->pc_hooks[pc >> 3] |= 1 << (pc & 7);
+    } else {
+        cpu->pc_hooks[pc >> 3] &= ~(1 << (pc & 7));
+    }
+    // translated blocks may run past the address
+    jit_flush(cpu);
+}
+
+/* Replaces every hook at once with the given bitmap, a bit per PC. */
+void cpu_set_pc_hooks(Z80_t *cpu, const uint8_t *map)
+{
+    if (memcmp(cpu->pc_hooks, map, sizeof(cpu->pc_hooks)) == 0) return;
+
+    memcpy(cpu->pc_hooks, map, sizeof(cpu->pc_hooks));
+    jit_flush(cpu);
+}
\ No newline at end of file
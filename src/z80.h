@@ -91,9 +91,10 @@ struct Z80Regs {
 
 struct Machine;
 
+// state touched by every instruction comes first and is packed into
+// the first two cache lines, everything after that is cold
 typedef struct Z80 {
-    struct Z80Regs regs;
-    uint64_t cycles;
+    _Alignas(64) struct Z80Regs regs;
     enum PrefixState {
         STATE_NOPREFIX,
         STATE_DD,
@@ -102,11 +103,71 @@ typedef struct Z80 {
     bool interrupt_pending;
     bool halted;
     bool last_ei;
+    bool lazy_flags;    // left untouched by cpu_init()
+    // run DD/FD prefixes as steps of their own instead of together with
+    // the instruction they prefix, left untouched by cpu_init()
+    bool split_prefixes;
+    uint64_t cycles;
+    uint64_t deadline;  // of the current cpu_run_until(), zero outside of it
 
+    // last flag-affecting operation whose F wasn't computed yet,
+    // only used with lazy_flags
+    struct Z80LazyFlags {
+        enum LazyFlagsOp {
+            LAZY_NONE,  // F is up to date
+            LAZY_ADD,
+            LAZY_SUB,
+            LAZY_CP,
+            LAZY_AND,   // a holds the result
+            LAZY_OR,    // a holds the result, also used for XOR
+            LAZY_INC,   // a holds the result, c the carry to keep
+            LAZY_DEC,   // a holds the result, c the carry to keep
+        } op;
+        uint8_t a;
+        uint8_t b;
+        uint8_t c;
+    } lazy;
     int error;
     struct Machine *ctx;
+    uint64_t prefix_runs;   // instructions executed with DD/FD prefixes
+
+    // left untouched by cpu_init(), so these persist across resets
+    enum CpuDispatch {
+        DISPATCH_AUTO,   // computed goto if supported, tables otherwise
+        DISPATCH_SWITCH,
+        DISPATCH_TABLE,
+        DISPATCH_GOTO,
+        DISPATCH_BLOCK,  // table dispatch through the decoded block cache
+    } dispatch;
+    struct Z80BlockCache *blocks;
+    enum JitMode {
+        JIT_OFF,
+        JIT_ON,
+        JIT_VERIFY,     // rerun every block in the interpreter and compare
+    } jit_mode;
+    struct Z80Jit *jit;
+    struct Z80Profile *profile;     // see z80_profile.c
+    struct Z80Trace *trace;         // see z80_trace.c
+    uint8_t pc_hooks[0x10000 / 8];  // cpu_run_until() stops before these
 } Z80_t;
 
 void cpu_init(Z80_t *cpu);
+void cpu_deinit(Z80_t *cpu);
 void cpu_fire_interrupt(Z80_t *cpu);
 int cpu_do_cycles(Z80_t *cpu);
+int cpu_run_until(Z80_t *cpu, uint64_t deadline);
+void cpu_set_pc_hook(Z80_t *cpu, uint16_t pc, bool enable);
+void cpu_set_pc_hooks(Z80_t *cpu, const uint8_t *map);
+void cpu_sync_flags(Z80_t *cpu);
+int cpu_set_dispatch(Z80_t *cpu, const char *name);
+const char *cpu_get_dispatch_name(Z80_t *cpu);
+
+static inline bool cpu_can_process_interrupts(const Z80_t *cpu)
+{
+    return cpu->prefix_state == STATE_NOPREFIX && !cpu->last_ei;
+}
+
+static inline bool cpu_has_pc_hook(const Z80_t *cpu, uint16_t pc)
+{
+    return cpu->pc_hooks[pc >> 3] & (1 << (pc & 7));
+}
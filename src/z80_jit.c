@@ -0,0 +1,756 @@
+#include "z80_jit.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include "machine.h"
+#include "log.h"
+
+/* x86-64 dynamic recompiler.
+ *
+ * Hot runs of code in 0x8000-0xFFFF get translated into native code which
+ * does the per-instruction bookkeeping of cpu_do_cycles() (Q, last EI,
+ * opcode fetch and R register) inline and calls the interpreter handlers
+ * directly, in the order they'd be dispatched in. The handlers do all memory
+ * accesses through the regular path, so cycle counts and contention stay
+ * exactly the same as in the interpreter.
+ *
+ * Blocks end after any instruction that may jump or before a hooked PC,
+ * and never contain I/O, HALT, DD/FD prefixed instructions or direct
+ * accesses to contended memory. They're only translated from and run on
+ * pages with a read fast path, as the opcode fetches get left out.
+ * After every instruction the native code bails out back to the interpreter
+ * if the cpu errored, the cycle limit was reached, PC isn't where expected
+ * or the pages the block was translated from have been written to.
+ * As code often shares pages with data, a block whose pages were written
+ * to is only dropped if its own bytes actually changed.
+ *
+ * jit_run() is only meant to be called outside of the interrupt window,
+ * and returns the amount of instructions executed. */
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #define JIT_SUPPORTED
+#endif
+
+#ifdef JIT_SUPPORTED
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+#endif
+
+#define JIT_CODE_SIZE       (4 << 20)
+#define JIT_CODE_PAGE       4096
+#define JIT_MAX_BLOCKS      16384
+#define JIT_MAX_OPS         32
+#define JIT_HOT_THRESHOLD   8
+
+typedef int (*JitBlockFunc)(Z80_t *cpu, uint64_t limit);
+
+struct JitOp {
+    JitOpHandler handler;
+    uint16_t pc;
+    uint8_t len;
+    uint8_t prefix;
+};
+
+struct JitBlock {
+    JitBlockFunc code;
+    uint16_t pc;
+    uint8_t page_count;
+    uint8_t pages[2];
+    uint32_t gens[2];
+    uint8_t src_len;
+    uint8_t src[JIT_MAX_OPS * 4];   // the code it was translated from
+};
+
+struct JitVerifyState {
+    struct Z80Regs regs;
+    struct Z80LazyFlags lazy;
+    uint64_t cycles;
+    uint8_t bus[0x10000];
+};
+
+// what running a block does to the rest of the machine, put back after
+// the interpreter ran it again so that it only happens once
+struct JitVerifyEffects {
+    uint32_t page_gen[0x100];
+    int border_pos;
+    int screen_cell;
+    uint32_t line_dirty[192];
+    bool border_clean;
+    bool border_changed;
+    uint64_t draw_ns;
+    uint64_t draw_calls;
+    uint64_t cells_drawn;
+};
+
+struct Z80Jit {
+    uint8_t *code;
+    size_t code_used;
+    bool code_full;
+
+    struct JitBlock *blocks[0x8000];    // indexed by pc - 0x8000
+    struct JitBlock pool[JIT_MAX_BLOCKS];
+    size_t pool_used;
+    uint8_t heat[0x8000];
+
+    struct JitVerifyState before;
+    struct JitVerifyState after;
+    struct JitVerifyEffects effects;
+};
+
+#endif
+
+static const char *mode_str[] = {
+    [JIT_OFF] = "off",
+    [JIT_ON] = "on",
+    [JIT_VERIFY] = "verify",
+};
+
+/* Selects the recompiler mode by name.
+ * Returns zero on success, non-zero otherwise. */
+int jit_set_mode(Z80_t *cpu, const char *name)
+{
+    for (size_t i = 0; i < sizeof(mode_str) / sizeof(char *); i++) {
+        if (strcmp(name, mode_str[i]) == 0) {
+#ifndef JIT_SUPPORTED
+            if (i != JIT_OFF) {
+                dlog(LOG_WARN, "recompiler unsupported on this platform");
+                return 0;
+            }
+#endif
+            cpu->jit_mode = i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+const char *jit_get_mode_name(Z80_t *cpu)
+{
+    return mode_str[cpu->jit_mode];
+}
+
+#ifdef JIT_SUPPORTED
+
+static struct Z80Jit *jit_alloc(Z80_t *cpu)
+{
+    struct Z80Jit *j = calloc(1, sizeof(struct Z80Jit));
+    if (j == NULL) return NULL;
+
+    // never writable and executable at once, see code_set_writable()
+#ifdef _WIN32
+    j->code = VirtualAlloc(NULL, JIT_CODE_SIZE, MEM_COMMIT | MEM_RESERVE,
+                           PAGE_EXECUTE_READ);
+#else
+    j->code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_EXEC,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (j->code == MAP_FAILED) j->code = NULL;
+#endif
+
+    if (j->code == NULL) {
+        dlog(LOG_WARN, "Failed to allocate executable memory, recompiler disabled");
+        free(j);
+        cpu->jit_mode = JIT_OFF;
+        return NULL;
+    }
+
+    return j;
+}
+
+void jit_free(Z80_t *cpu)
+{
+    struct Z80Jit *j = cpu->jit;
+    if (j == NULL) return;
+
+#ifdef _WIN32
+    VirtualFree(j->code, 0, MEM_RELEASE);
+#else
+    munmap(j->code, JIT_CODE_SIZE);
+#endif
+    free(j);
+    cpu->jit = NULL;
+}
+
+/* Drops all translated blocks. */
+void jit_flush(Z80_t *cpu)
+{
+    struct Z80Jit *j = cpu->jit;
+    if (j == NULL) return;
+
+    memset(j->blocks, 0, sizeof(j->blocks));
+    memset(j->heat, 0, sizeof(j->heat));
+    j->pool_used = 0;
+    j->code_used = 0;
+    j->code_full = false;
+}
+
+/* decoding */
+
+enum JitOpClass {
+    OP_PLAIN,
+    OP_END,     // may jump, last instruction of a block
+    OP_STOP,    // can't be translated
+};
+
+static inline bool is_contended(const Memory_t *mem, uint16_t addr)
+{
+    return mem->pages[addr >> MEMORY_PAGE_SHIFT].contention != MEMORY_UNCONTENDED;
+}
+
+// whether reads from the 256-byte page have no side effects
+static inline bool is_plain_code(const Memory_t *mem, uint8_t page)
+{
+    return mem->read_fast[(page << 8) >> MEMORY_PAGE_SHIFT] != NULL;
+}
+
+static inline uint16_t peek16(const Memory_t *mem, uint16_t addr)
+{
+    return memory_bus_peek(mem, addr) | (memory_bus_peek(mem, addr + 1) << 8);
+}
+
+static enum JitOpClass decode_main(const Memory_t *mem, uint16_t pc, uint8_t op, struct JitOp *o)
+{
+    o->prefix = 0;
+    o->handler = cpu_get_op_handler(0, op);
+
+    if ((op & 0xC7) == 0x06 || (op & 0xC7) == 0xC6 || (op & 0xE7) == 0x00
+        || op == 0x18 || (op & 0xE7) == 0x20 || op == 0xD3 || op == 0xDB) {
+        // ld r, n / alu n / djnz / jr / out (n), a / in a, (n)
+        o->len = (op == 0x00 || op == 0x08) ? 1 : 2;
+    } else if ((op & 0xCF) == 0x01 || (op & 0xE7) == 0x22 || (op & 0xC7) == 0xC2
+               || op == 0xC3 || (op & 0xC7) == 0xC4 || op == 0xCD) {
+        // ld rr, nn / ld (nn) / jp / call
+        o->len = 3;
+    } else {
+        o->len = 1;
+    }
+
+    switch (op)
+    {
+    case 0x76: // halt
+    case 0xD3: // out (n), a
+    case 0xDB: // in a, (n)
+    case 0xDD:
+    case 0xFD:
+        return OP_STOP;
+    case 0x22: // ld (nn), hl
+    case 0x2A: // ld hl, (nn)
+    case 0x32: // ld (nn), a
+    case 0x3A: // ld a, (nn)
+        if (is_contended(mem, peek16(mem, pc + 1))) {
+            return OP_STOP;
+        }
+        return OP_PLAIN;
+    case 0x10: // djnz
+    case 0x18: // jr
+    case 0xC3: // jp nn
+    case 0xC9: // ret
+    case 0xCD: // call nn
+    case 0xE9: // jp (hl)
+        return OP_END;
+    }
+
+    if ((op & 0xE7) == 0x20        // jr cc
+        || (op & 0xC7) == 0xC0     // ret cc
+        || (op & 0xC7) == 0xC2     // jp cc
+        || (op & 0xC7) == 0xC4     // call cc
+        || (op & 0xC7) == 0xC7) {  // rst
+        return OP_END;
+    }
+
+    return OP_PLAIN;
+}
+
+static enum JitOpClass decode_ed(const Memory_t *mem, uint16_t pc, uint8_t op, struct JitOp *o)
+{
+    o->prefix = 0xED;
+    o->handler = cpu_get_op_handler(0xED, op);
+    o->len = ((op & 0xC7) == 0x43) ? 4 : 2;
+
+    // in r, (c) / out (c), r / block i/o
+    if ((op >= 0x40 && op < 0x80 && (op & 6) == 0) || (op & 0xE6) == 0xA2) {
+        return OP_STOP;
+    }
+    // ld (nn), rr / ld rr, (nn)
+    if ((op & 0xC7) == 0x43
+        && is_contended(mem, peek16(mem, pc + 2))) {
+        return OP_STOP;
+    }
+    // retn / reti / repeating block instructions
+    if ((op & 0xC7) == 0x45 || (op & 0xF4) == 0xB0) {
+        return OP_END;
+    }
+    return OP_PLAIN;
+}
+
+static enum JitOpClass decode(const Memory_t *mem, uint16_t pc, struct JitOp *o)
+{
+    uint8_t op = memory_bus_peek(mem, pc);
+    o->pc = pc;
+
+    if (op == 0xCB) {
+        o->prefix = 0xCB;
+        o->handler = cpu_get_op_handler(0xCB, memory_bus_peek(mem, pc + 1));
+        o->len = 2;
+        return OP_PLAIN;
+    } else if (op == 0xED) {
+        return decode_ed(mem, pc, memory_bus_peek(mem, pc + 1), o);
+    }
+    return decode_main(mem, pc, op, o);
+}
+
+/* code generation */
+
+struct Emitter {
+    uint8_t *p;
+    uint8_t *end;
+};
+
+static void emit8(struct Emitter *e, uint8_t v)
+{
+    if (e->p < e->end) *e->p = v;
+    e->p++;
+}
+
+static void emit32(struct Emitter *e, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) emit8(e, v >> (i * 8));
+}
+
+static void emit64(struct Emitter *e, uint64_t v)
+{
+    for (int i = 0; i < 8; i++) emit8(e, v >> (i * 8));
+}
+
+static void emit_bytes(struct Emitter *e, const uint8_t *bytes, size_t len)
+{
+    for (size_t i = 0; i < len; i++) emit8(e, bytes[i]);
+}
+
+#define EMIT(e, ...) \
+    emit_bytes(e, (const uint8_t[]){ __VA_ARGS__ }, sizeof((const uint8_t[]){ __VA_ARGS__ }))
+
+#define OFS(field) ((uint32_t)offsetof(Z80_t, field))
+
+/* jcc rel32 to a location patched later, returns the location of rel32 */
+static uint8_t *emit_jcc(struct Emitter *e, uint8_t cc)
+{
+    EMIT(e, 0x0F, cc);
+    uint8_t *rel = e->p;
+    emit32(e, 0);
+    return rel;
+}
+
+static void patch_rel32(uint8_t *rel, uint8_t *target, uint8_t *end)
+{
+    if (rel + 4 > end) return;
+    int32_t d = (int32_t)(target - (rel + 4));
+    memcpy(rel, &d, 4);
+}
+
+/* movzx eax, byte [rbx+ofs] */
+static void emit_load8(struct Emitter *e, uint32_t ofs)
+{
+    EMIT(e, 0x0F, 0xB6, 0x83); emit32(e, ofs);
+}
+
+/* mov byte [rbx+ofs], al */
+static void emit_store8(struct Emitter *e, uint32_t ofs)
+{
+    EMIT(e, 0x88, 0x83); emit32(e, ofs);
+}
+
+/* mov byte [rbx+ofs], imm8 */
+static void emit_store8_imm(struct Emitter *e, uint32_t ofs, uint8_t v)
+{
+    EMIT(e, 0xC6, 0x83); emit32(e, ofs); emit8(e, v);
+}
+
+/* r = (r & 0x80) | ((r + 1) & 0x7F) */
+static void emit_inc_refresh(struct Emitter *e)
+{
+    emit_load8(e, OFS(regs.r));
+    EMIT(e, 0x8D, 0x48, 0x01);                  // lea ecx, [rax+1]
+    EMIT(e, 0x83, 0xE1, 0x7F);                  // and ecx, 0x7F
+    EMIT(e, 0x25, 0x80, 0x00, 0x00, 0x00);      // and eax, 0x80
+    EMIT(e, 0x09, 0xC8);                        // or eax, ecx
+    emit_store8(e, OFS(regs.r));
+}
+
+static void emit_call_handler(struct Emitter *e, JitOpHandler handler)
+{
+#ifdef _WIN32
+    EMIT(e, 0x48, 0x89, 0xD9);                  // mov rcx, rbx
+#else
+    EMIT(e, 0x48, 0x89, 0xDF);                  // mov rdi, rbx
+#endif
+    EMIT(e, 0x48, 0xB8); emit64(e, (uint64_t)(uintptr_t)handler); // mov rax, imm64
+    EMIT(e, 0xFF, 0xD0);                        // call rax
+}
+
+/* Switches the unused code memory, from the page new code goes to onwards,
+ * between writable and executable. Returns zero on success. */
+static int code_set_writable(struct Z80Jit *j, bool writable)
+{
+    size_t from = j->code_used & ~(size_t)(JIT_CODE_PAGE - 1);
+#ifdef _WIN32
+    DWORD old;
+    if (!VirtualProtect(j->code + from, JIT_CODE_SIZE - from,
+                        writable ? PAGE_READWRITE : PAGE_EXECUTE_READ, &old)) {
+        return -1;
+    }
+    if (!writable) {
+        FlushInstructionCache(GetCurrentProcess(), j->code + from, JIT_CODE_SIZE - from);
+    }
+    return 0;
+#else
+    return mprotect(j->code + from, JIT_CODE_SIZE - from,
+                    writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC);
+#endif
+}
+
+/* Translates the given instructions, returns NULL if out of code memory. */
+static JitBlockFunc compile(struct Z80Jit *j, Z80_t *cpu, struct JitOp *ops, int count,
+                            struct JitBlock *b)
+{
+    if (code_set_writable(j, true)) {
+        dlog(LOG_WARN, "Failed to make recompiler code memory writable, recompiler disabled");
+        cpu->jit_mode = JIT_OFF;
+        return NULL;
+    }
+
+    struct Emitter e = { j->code + j->code_used, j->code + JIT_CODE_SIZE };
+    uint8_t *start = e.p;
+    uint8_t *exits[JIT_MAX_OPS][8];
+    int exit_count[JIT_MAX_OPS] = { 0 };
+
+    // prologue, keeps the stack 16-byte aligned for the calls
+    EMIT(&e, 0x53);                             // push rbx
+    EMIT(&e, 0x41, 0x54);                       // push r12
+#ifdef _WIN32
+    EMIT(&e, 0x48, 0x83, 0xEC, 0x28);           // sub rsp, 40
+    EMIT(&e, 0x48, 0x89, 0xCB);                 // mov rbx, rcx
+    EMIT(&e, 0x49, 0x89, 0xD4);                 // mov r12, rdx
+#else
+    EMIT(&e, 0x48, 0x83, 0xEC, 0x08);           // sub rsp, 8
+    EMIT(&e, 0x48, 0x89, 0xFB);                 // mov rbx, rdi
+    EMIT(&e, 0x49, 0x89, 0xF4);                 // mov r12, rsi
+#endif
+
+    for (int i = 0; i < count; i++) {
+        struct JitOp *o = &ops[i];
+
+        // q_old = q, q = false, last_ei = false
+        emit_load8(&e, OFS(regs.q));
+        emit_store8(&e, OFS(regs.q_old));
+        emit_store8_imm(&e, OFS(regs.q), 0);
+        emit_store8_imm(&e, OFS(last_ei), 0);
+
+        // opcode fetches from plain pages have no side effects
+        emit_inc_refresh(&e);
+        if (o->prefix) {
+            EMIT(&e, 0x48, 0x83, 0x83); emit32(&e, OFS(cycles)); emit8(&e, 4);  // add qword [rbx+cycles], 4
+            EMIT(&e, 0x66, 0x83, 0x83); emit32(&e, OFS(regs.pc)); emit8(&e, 1); // add word [rbx+pc], 1
+            emit_inc_refresh(&e);
+        }
+
+        emit_call_handler(&e, o->handler);
+        emit_store8_imm(&e, OFS(interrupt_pending), 0);
+
+        if (i == count - 1) break;
+
+        // cmp dword [rbx+error], 0 / jne exit
+        EMIT(&e, 0x83, 0xBB); emit32(&e, OFS(error)); emit8(&e, 0);
+        exits[i][exit_count[i]++] = emit_jcc(&e, 0x85);
+        // cmp [rbx+cycles], r12 / jae exit
+        EMIT(&e, 0x4C, 0x39, 0xA3); emit32(&e, OFS(cycles));
+        exits[i][exit_count[i]++] = emit_jcc(&e, 0x83);
+        // cmp word [rbx+pc], next / jne exit
+        EMIT(&e, 0x66, 0x81, 0xBB); emit32(&e, OFS(regs.pc));
+        emit8(&e, ops[i + 1].pc); emit8(&e, ops[i + 1].pc >> 8);
+        exits[i][exit_count[i]++] = emit_jcc(&e, 0x85);
+        // page_gen[page] != b->gens[k] -> exit
+        for (int k = 0; k < b->page_count; k++) {
+            EMIT(&e, 0x48, 0xB8);
+            emit64(&e, (uint64_t)(uintptr_t)&cpu->ctx->memory->page_gen[b->pages[k]]);
+            EMIT(&e, 0x8B, 0x08);               // mov ecx, [rax]
+            EMIT(&e, 0x48, 0xB8);
+            emit64(&e, (uint64_t)(uintptr_t)&b->gens[k]);
+            EMIT(&e, 0x3B, 0x08);               // cmp ecx, [rax]
+            exits[i][exit_count[i]++] = emit_jcc(&e, 0x85);
+        }
+    }
+
+    EMIT(&e, 0xB8); emit32(&e, count);          // mov eax, count
+    uint8_t *epilogue = e.p;
+#ifdef _WIN32
+    EMIT(&e, 0x48, 0x83, 0xC4, 0x28);           // add rsp, 40
+#else
+    EMIT(&e, 0x48, 0x83, 0xC4, 0x08);           // add rsp, 8
+#endif
+    EMIT(&e, 0x41, 0x5C);                       // pop r12
+    EMIT(&e, 0x5B);                             // pop rbx
+    EMIT(&e, 0xC3);                             // ret
+
+    // bail-out stubs returning the amount of instructions executed so far
+    for (int i = 0; i < count - 1; i++) {
+        uint8_t *stub = e.p;
+        EMIT(&e, 0xB8); emit32(&e, i + 1);      // mov eax, i + 1
+        EMIT(&e, 0xE9);                         // jmp epilogue
+        uint8_t *rel = e.p;
+        emit32(&e, 0);
+        patch_rel32(rel, epilogue, e.end);
+        for (int k = 0; k < exit_count[i]; k++) {
+            patch_rel32(exits[i][k], stub, e.end);
+        }
+    }
+
+    JitBlockFunc code = NULL;
+    if (e.p > e.end) {
+        j->code_full = true;
+    } else {
+        code = (JitBlockFunc)(void *)start;
+    }
+
+    // before code_used moves on, so it's the pages made writable above
+    if (code_set_writable(j, false)) {
+        dlog(LOG_WARN, "Failed to make recompiler code memory executable, recompiler disabled");
+        cpu->jit_mode = JIT_OFF;
+        return NULL;
+    }
+    if (code) {
+        j->code_used = e.p - j->code;
+    }
+    return code;
+}
+
+static struct JitBlock *translate(struct Z80Jit *j, Z80_t *cpu, uint16_t pc)
+{
+    const Memory_t *mem = cpu->ctx->memory;
+    struct JitOp ops[JIT_MAX_OPS];
+    int count = 0;
+
+    uint8_t first_page = pc >> 8;
+    uint8_t last_page = first_page;
+    uint32_t addr = pc;
+
+    while (count < JIT_MAX_OPS) {
+        // hooked addresses have to be reached through cpu_run_until()
+        if (count > 0 && cpu_has_pc_hook(cpu, addr)) break;
+
+        struct JitOp *o = &ops[count];
+        if (!is_plain_code(mem, addr >> 8)) break;
+        enum JitOpClass c = decode(mem, addr, o);
+        if (c == OP_STOP || addr + o->len > 0x10000) break;
+
+        uint8_t page = (addr + o->len - 1) >> 8;
+        if (page != first_page && page != (uint8_t)(first_page + 1)) break;
+        if (!is_plain_code(mem, page)) break;
+
+        last_page = page > last_page ? page : last_page;
+        addr += o->len;
+        count++;
+        if (c == OP_END) break;
+    }
+
+    if (count == 0 || j->pool_used >= JIT_MAX_BLOCKS) return NULL;
+
+    struct JitBlock *b = &j->pool[j->pool_used];
+    b->pc = pc;
+    b->page_count = (last_page != first_page) ? 2 : 1;
+    b->pages[0] = first_page;
+    b->pages[1] = last_page;
+    for (int k = 0; k < b->page_count; k++) {
+        b->gens[k] = cpu->ctx->memory->page_gen[b->pages[k]];
+    }
+    b->src_len = addr - pc;
+    for (int i = 0; i < b->src_len; i++) {
+        b->src[i] = memory_bus_peek(mem, pc + i);
+    }
+
+    b->code = compile(j, cpu, ops, count, b);
+    if (b->code == NULL) return NULL;
+
+    j->pool_used++;
+    return b;
+}
+
+static bool block_is_valid(Z80_t *cpu, struct JitBlock *b)
+{
+    uint32_t *page_gen = cpu->ctx->memory->page_gen;
+
+    bool written = false;
+    for (int k = 0; k < b->page_count; k++) {
+        written |= page_gen[b->pages[k]] != b->gens[k];
+    }
+    if (!written) return true;
+
+    for (int i = 0; i < b->src_len; i++) {
+        if (memory_bus_peek(cpu->ctx->memory, b->pc + i) != b->src[i]) {
+            return false;
+        }
+    }
+
+    for (int k = 0; k < b->page_count; k++) {
+        b->gens[k] = page_gen[b->pages[k]];
+    }
+    return true;
+}
+
+static void verify_save(Z80_t *cpu, struct JitVerifyState *s)
+{
+    cpu_sync_flags(cpu);
+    memcpy(&s->regs, &cpu->regs, sizeof(struct Z80Regs));
+    s->lazy = cpu->lazy;
+    s->cycles = cpu->cycles;
+    memcpy(s->bus, cpu->ctx->memory->bus, sizeof(s->bus));
+}
+
+static void effects_save(struct Machine *ctx, struct JitVerifyEffects *s)
+{
+    Ula_t *ula = &ctx->ula;
+    memcpy(s->page_gen, ctx->memory->page_gen, sizeof(s->page_gen));
+    s->border_pos = ula->border_pos;
+    s->screen_cell = ula->screen_cell;
+    memcpy(s->line_dirty, ula->line_dirty, sizeof(s->line_dirty));
+    s->border_clean = ula->border_clean;
+    s->border_changed = ula->border_changed;
+    s->draw_ns = ula->draw_ns;
+    s->draw_calls = ula->draw_calls;
+    s->cells_drawn = ula->cells_drawn;
+}
+
+static void effects_restore(struct Machine *ctx, const struct JitVerifyEffects *s)
+{
+    Ula_t *ula = &ctx->ula;
+    memcpy(ctx->memory->page_gen, s->page_gen, sizeof(s->page_gen));
+    ula->border_pos = s->border_pos;
+    ula->screen_cell = s->screen_cell;
+    memcpy(ula->line_dirty, s->line_dirty, sizeof(s->line_dirty));
+    ula->border_clean = s->border_clean;
+    ula->border_changed = s->border_changed;
+    ula->draw_ns = s->draw_ns;
+    ula->draw_calls = s->draw_calls;
+    ula->cells_drawn = s->cells_drawn;
+}
+
+/* Runs the block again in the interpreter from the saved state
+ * and compares the results. The second run is kept from reaching
+ * watch functions and contention traces, and what it does to the
+ * page generations and the ULA's drawing is undone, so everything
+ * outside the cpu and memory only sees the block run once. */
+static void verify_block(Z80_t *cpu, struct Z80Jit *j, struct JitBlock *b, int executed)
+{
+    struct Machine *ctx = cpu->ctx;
+    verify_save(cpu, &j->after);
+    effects_save(ctx, &j->effects);
+    MemoryWatchFunc watch_func = ctx->memory->watch_func;
+    struct UlaContentionTrace *trace = ctx->ula.contention_trace;
+    ctx->memory->watch_func = NULL;
+    ula_trace_contention(&ctx->ula, NULL);
+
+    memcpy(&cpu->regs, &j->before.regs, sizeof(struct Z80Regs));
+    cpu->lazy = j->before.lazy;
+    cpu->cycles = j->before.cycles;
+    memcpy(cpu->ctx->memory->bus, j->before.bus, sizeof(j->before.bus));
+
+    for (int i = 0; i < executed && !cpu->error; i++) {
+        cpu_do_cycles(cpu);
+    }
+    cpu_sync_flags(cpu);
+
+    ctx->memory->watch_func = watch_func;
+    ula_trace_contention(&ctx->ula, trace);
+    effects_restore(ctx, &j->effects);
+
+    bool regs_ok = memcmp(&cpu->regs, &j->after.regs, sizeof(struct Z80Regs)) == 0;
+    bool cycles_ok = cpu->cycles == j->after.cycles;
+    bool memory_ok = memcmp(cpu->ctx->memory->bus, j->after.bus, sizeof(j->after.bus)) == 0;
+
+    if (!(regs_ok && cycles_ok && memory_ok)) {
+        dlog(LOG_ERR, "recompiler mismatch in block at %04X after %d instructions:",
+                      b->pc, executed);
+        dlog(LOG_ERR, "  registers %s, cycles %s (%"PRIu64" vs %"PRIu64"), memory %s",
+                      regs_ok ? "ok" : "DIFFER", cycles_ok ? "ok" : "DIFFER",
+                      j->after.cycles, cpu->cycles, memory_ok ? "ok" : "DIFFER");
+        cpu->error = 1;
+    }
+}
+
+/* Runs a translated block at the current PC, if there is one,
+ * stopping once cycles reach the given limit.
+ * Returns the amount of instructions executed. */
+int jit_run(Z80_t *cpu, uint64_t limit)
+{
+    uint16_t pc = cpu->regs.pc;
+
+    if (cpu->jit_mode == JIT_OFF || pc < 0x8000 || cpu->halted || cpu->error
+        || cpu->interrupt_pending || cpu->prefix_state != STATE_NOPREFIX
+        || cpu->cycles >= limit || !is_plain_code(cpu->ctx->memory, pc >> 8)) {
+        return 0;
+    }
+
+    if (cpu->jit == NULL) {
+        cpu->jit = jit_alloc(cpu);
+        if (cpu->jit == NULL) return 0;
+    }
+
+    struct Z80Jit *j = cpu->jit;
+    struct JitBlock *b = j->blocks[pc - 0x8000];
+
+    // the page a block runs into may have been watched since
+    if (b && b->page_count > 1 && !is_plain_code(cpu->ctx->memory, b->pages[1])) {
+        return 0;
+    }
+
+    if (b && !block_is_valid(cpu, b)) {
+        b = j->blocks[pc - 0x8000] = NULL;
+        j->heat[pc - 0x8000] = 0;
+    }
+
+    if (b == NULL) {
+        if (++j->heat[pc - 0x8000] < JIT_HOT_THRESHOLD) return 0;
+        j->heat[pc - 0x8000] = 0;
+
+        if (j->code_full || j->pool_used >= JIT_MAX_BLOCKS) jit_flush(cpu);
+        b = j->blocks[pc - 0x8000] = translate(j, cpu, pc);
+        if (b == NULL) return 0;
+    }
+
+    if (cpu->jit_mode == JIT_VERIFY) {
+        verify_save(cpu, &j->before);
+    }
+
+    int executed = b->code(cpu, limit);
+
+    if (cpu->jit_mode == JIT_VERIFY) {
+        verify_block(cpu, j, b, executed);
+    }
+
+    return executed;
+}
+
+#else
+
+int jit_run(Z80_t *cpu, uint64_t limit)
+{
+    (void)cpu;
+    (void)limit;
+    return 0;
+}
+
+void jit_flush(Z80_t *cpu)
+{
+    (void)cpu;
+}
+
+void jit_free(Z80_t *cpu)
+{
+    (void)cpu;
+}
+
+#endif
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+#include "z80.h"
+
+typedef void (*JitOpHandler)(Z80_t *cpu);
+
+int jit_set_mode(Z80_t *cpu, const char *name);
+const char *jit_get_mode_name(Z80_t *cpu);
+int jit_run(Z80_t *cpu, uint64_t limit);
+void jit_flush(Z80_t *cpu);
+void jit_free(Z80_t *cpu);
+
+/* provided by z80.c */
+JitOpHandler cpu_get_op_handler(uint8_t prefix, uint8_t op);
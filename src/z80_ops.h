@@ -0,0 +1,1339 @@
+/* Opcode lists of the Z80 core in the "X macro" form.
+ *
+ * Each entry is X(opcode, implementation), with the implementation being
+ * a call operating on `cpu` (and `ii`/`ih`/`il` or `addr` for the DD/FD
+ * groups). z80.c expands these into switch statements, handler tables
+ * and computed goto tables, so all the dispatch engines share a single
+ * source of truth for the instruction decoding.
+ *
+ * Opcodes missing from a list are handled by the default handler
+ * of the given group. */
+
+#pragma once
+
+#define Z80_OPS_MAIN(X) \
+    /* ld rr, nn */                                                             \
+    X(0x01, ld_rr_nn(cpu, &cpu->regs.main.bc))                                  \
+    X(0x11, ld_rr_nn(cpu, &cpu->regs.main.de))                                  \
+    X(0x21, ld_rr_nn(cpu, &cpu->regs.main.hl))                                  \
+    X(0x31, ld_rr_nn(cpu, &cpu->regs.sp))                                       \
+                                                                                \
+    /* ld (rr), a */                                                            \
+    X(0x02, ld_rra_a(cpu, cpu->regs.main.bc))                                   \
+    X(0x12, ld_rra_a(cpu, cpu->regs.main.de))                                   \
+    /* ld a, (rr) */                                                            \
+    X(0x0A, ld_a_rra(cpu, cpu->regs.main.bc))                                   \
+    X(0x1A, ld_a_rra(cpu, cpu->regs.main.de))                                   \
+    /* ld a, (nn) */                                                            \
+    X(0x3A, ld_a_nna(cpu))                                                      \
+                                                                                \
+    /* inc rr */                                                                \
+    X(0x03, inc_rr(cpu, &cpu->regs.main.bc))                                    \
+    X(0x13, inc_rr(cpu, &cpu->regs.main.de))                                    \
+    X(0x23, inc_rr(cpu, &cpu->regs.main.hl))                                    \
+    X(0x33, inc_rr(cpu, &cpu->regs.sp))                                         \
+    /* inc r */                                                                 \
+    X(0x04, inc_r(cpu, &cpu->regs.main.b))                                      \
+    X(0x0C, inc_r(cpu, &cpu->regs.main.c))                                      \
+    X(0x14, inc_r(cpu, &cpu->regs.main.d))                                      \
+    X(0x1C, inc_r(cpu, &cpu->regs.main.e))                                      \
+    X(0x24, inc_r(cpu, &cpu->regs.main.h))                                      \
+    X(0x2C, inc_r(cpu, &cpu->regs.main.l))                                      \
+    X(0x34, inc_rra(cpu, cpu->regs.main.hl))                                    \
+    X(0x3C, inc_r(cpu, &cpu->regs.main.a))                                      \
+    /* dec r */                                                                 \
+    X(0x05, dec_r(cpu, &cpu->regs.main.b))                                      \
+    X(0x0D, dec_r(cpu, &cpu->regs.main.c))                                      \
+    X(0x15, dec_r(cpu, &cpu->regs.main.d))                                      \
+    X(0x1D, dec_r(cpu, &cpu->regs.main.e))                                      \
+    X(0x25, dec_r(cpu, &cpu->regs.main.h))                                      \
+    X(0x2D, dec_r(cpu, &cpu->regs.main.l))                                      \
+    X(0x35, dec_rra(cpu, cpu->regs.main.hl))                                    \
+    X(0x3D, dec_r(cpu, &cpu->regs.main.a))                                      \
+    /* dec rr */                                                                \
+    X(0x0B, dec_rr(cpu, &cpu->regs.main.bc))                                    \
+    X(0x1B, dec_rr(cpu, &cpu->regs.main.de))                                    \
+    X(0x2B, dec_rr(cpu, &cpu->regs.main.hl))                                    \
+    X(0x3B, dec_rr(cpu, &cpu->regs.sp))                                         \
+                                                                                \
+    /* ld r, n */                                                               \
+    X(0x06, ld_r_n(cpu, &cpu->regs.main.b))                                     \
+    X(0x0E, ld_r_n(cpu, &cpu->regs.main.c))                                     \
+    X(0x16, ld_r_n(cpu, &cpu->regs.main.d))                                     \
+    X(0x1E, ld_r_n(cpu, &cpu->regs.main.e))                                     \
+    X(0x26, ld_r_n(cpu, &cpu->regs.main.h))                                     \
+    X(0x2E, ld_r_n(cpu, &cpu->regs.main.l))                                     \
+    X(0x36, ld_rra_n(cpu, cpu->regs.main.hl))                                   \
+    X(0x3E, ld_r_n(cpu, &cpu->regs.main.a))                                     \
+                                                                                \
+    /* add hl, rr */                                                            \
+    X(0x09, add_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.main.bc))              \
+    X(0x19, add_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.main.de))              \
+    X(0x29, add_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.main.hl))              \
+    X(0x39, add_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.sp))                   \
+                                                                                \
+    /* rra/rla/rrca/rlca */                                                     \
+    X(0x07, rlca(cpu))                                                          \
+    X(0x0F, rrca(cpu))                                                          \
+    X(0x17, rla(cpu))                                                           \
+    X(0x1F, rra(cpu))                                                           \
+                                                                                \
+    /* ld (nn), hl */                                                           \
+    X(0x22, ld_nna_rr(cpu, cpu->regs.main.hl))                                  \
+    /* ld hl, (nn) */                                                           \
+    X(0x2A, ld_rr_nna(cpu, &cpu->regs.main.hl))                                 \
+    /* ld (nn), a */                                                            \
+    X(0x32, ld_nna_a(cpu))                                                      \
+    /* ld sp, hl */                                                             \
+    X(0xF9, ld_sp_rr(cpu, cpu->regs.main.hl))                                   \
+                                                                                \
+    X(0x27, daa(cpu))                                                           \
+    /* cpl */                                                                   \
+    X(0x2F, cpl(cpu))                                                           \
+    /* scf/ccf */                                                               \
+    X(0x37, scf(cpu))                                                           \
+    X(0x3F, ccf(cpu))                                                           \
+                                                                                \
+    /* ld b, reg */                                                             \
+    X(0x40, ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.b))                   \
+    X(0x41, ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.c))                   \
+    X(0x42, ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.d))                   \
+    X(0x43, ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.e))                   \
+    X(0x44, ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.h))                   \
+    X(0x45, ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.l))                   \
+    X(0x46, ld_r_rra(cpu, &cpu->regs.main.b, cpu->regs.main.hl))                \
+    X(0x47, ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.a))                   \
+    /* ld c, reg */                                                             \
+    X(0x48, ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.b))                   \
+    X(0x49, ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.c))                   \
+    X(0x4A, ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.d))                   \
+    X(0x4B, ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.e))                   \
+    X(0x4C, ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.h))                   \
+    X(0x4D, ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.l))                   \
+    X(0x4E, ld_r_rra(cpu, &cpu->regs.main.c, cpu->regs.main.hl))                \
+    X(0x4F, ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.a))                   \
+    /* ld d, reg */                                                             \
+    X(0x50, ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.b))                   \
+    X(0x51, ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.c))                   \
+    X(0x52, ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.d))                   \
+    X(0x53, ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.e))                   \
+    X(0x54, ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.h))                   \
+    X(0x55, ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.l))                   \
+    X(0x56, ld_r_rra(cpu, &cpu->regs.main.d, cpu->regs.main.hl))                \
+    X(0x57, ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.a))                   \
+    /* ld e, reg */                                                             \
+    X(0x58, ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.b))                   \
+    X(0x59, ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.c))                   \
+    X(0x5A, ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.d))                   \
+    X(0x5B, ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.e))                   \
+    X(0x5C, ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.h))                   \
+    X(0x5D, ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.l))                   \
+    X(0x5E, ld_r_rra(cpu, &cpu->regs.main.e, cpu->regs.main.hl))                \
+    X(0x5F, ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.a))                   \
+    /* ld h, reg */                                                             \
+    X(0x60, ld_r_r(cpu, &cpu->regs.main.h, cpu->regs.main.b))                   \
+    X(0x61, ld_r_r(cpu, &cpu->regs.main.h, cpu->regs.main.c))                   \
+    X(0x62, ld_r_r(cpu, &cpu->regs.main.h, cpu->regs.main.d))                   \
+    X(0x63, ld_r_r(cpu, &cpu->regs.main.h, cpu->regs.main.e))                   \
+    X(0x64, ld_r_r(cpu, &cpu->regs.main.h, cpu->regs.main.h))                   \
+    X(0x65, ld_r_r(cpu, &cpu->regs.main.h, cpu->regs.main.l))                   \
+    X(0x66, ld_r_rra(cpu, &cpu->regs.main.h, cpu->regs.main.hl))                \
+    X(0x67, ld_r_r(cpu, &cpu->regs.main.h, cpu->regs.main.a))                   \
+    /* ld l, reg */                                                             \
+    X(0x68, ld_r_r(cpu, &cpu->regs.main.l, cpu->regs.main.b))                   \
+    X(0x69, ld_r_r(cpu, &cpu->regs.main.l, cpu->regs.main.c))                   \
+    X(0x6A, ld_r_r(cpu, &cpu->regs.main.l, cpu->regs.main.d))                   \
+    X(0x6B, ld_r_r(cpu, &cpu->regs.main.l, cpu->regs.main.e))                   \
+    X(0x6C, ld_r_r(cpu, &cpu->regs.main.l, cpu->regs.main.h))                   \
+    X(0x6D, ld_r_r(cpu, &cpu->regs.main.l, cpu->regs.main.l))                   \
+    X(0x6E, ld_r_rra(cpu, &cpu->regs.main.l, cpu->regs.main.hl))                \
+    X(0x6F, ld_r_r(cpu, &cpu->regs.main.l, cpu->regs.main.a))                   \
+    /* ld a, reg */                                                             \
+    X(0x78, ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.b))                   \
+    X(0x79, ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.c))                   \
+    X(0x7A, ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.d))                   \
+    X(0x7B, ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.e))                   \
+    X(0x7C, ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.h))                   \
+    X(0x7D, ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.l))                   \
+    X(0x7E, ld_r_rra(cpu, &cpu->regs.main.a, cpu->regs.main.hl))                \
+    X(0x7F, ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.a))                   \
+                                                                                \
+    /* ld (hl), r */                                                            \
+    X(0x70, ld_rra_r(cpu, cpu->regs.main.hl, cpu->regs.main.b))                 \
+    X(0x71, ld_rra_r(cpu, cpu->regs.main.hl, cpu->regs.main.c))                 \
+    X(0x72, ld_rra_r(cpu, cpu->regs.main.hl, cpu->regs.main.d))                 \
+    X(0x73, ld_rra_r(cpu, cpu->regs.main.hl, cpu->regs.main.e))                 \
+    X(0x74, ld_rra_r(cpu, cpu->regs.main.hl, cpu->regs.main.h))                 \
+    X(0x75, ld_rra_r(cpu, cpu->regs.main.hl, cpu->regs.main.l))                 \
+    X(0x77, ld_rra_r(cpu, cpu->regs.main.hl, cpu->regs.main.a))                 \
+                                                                                \
+    /* add a */                                                                 \
+    X(0x80, alo_r(cpu, cpu->regs.main.b, 0))                                    \
+    X(0x81, alo_r(cpu, cpu->regs.main.c, 0))                                    \
+    X(0x82, alo_r(cpu, cpu->regs.main.d, 0))                                    \
+    X(0x83, alo_r(cpu, cpu->regs.main.e, 0))                                    \
+    X(0x84, alo_r(cpu, cpu->regs.main.h, 0))                                    \
+    X(0x85, alo_r(cpu, cpu->regs.main.l, 0))                                    \
+    X(0x86, alo_rra(cpu, cpu->regs.main.hl, 0))                                 \
+    X(0x87, alo_r(cpu, cpu->regs.main.a, 0))                                    \
+    /* adc a */                                                                 \
+    X(0x88, alo_r(cpu, cpu->regs.main.b, 1))                                    \
+    X(0x89, alo_r(cpu, cpu->regs.main.c, 1))                                    \
+    X(0x8A, alo_r(cpu, cpu->regs.main.d, 1))                                    \
+    X(0x8B, alo_r(cpu, cpu->regs.main.e, 1))                                    \
+    X(0x8C, alo_r(cpu, cpu->regs.main.h, 1))                                    \
+    X(0x8D, alo_r(cpu, cpu->regs.main.l, 1))                                    \
+    X(0x8E, alo_rra(cpu, cpu->regs.main.hl, 1))                                 \
+    X(0x8F, alo_r(cpu, cpu->regs.main.a, 1))                                    \
+    /* sub */                                                                   \
+    X(0x90, alo_r(cpu, cpu->regs.main.b, 2))                                    \
+    X(0x91, alo_r(cpu, cpu->regs.main.c, 2))                                    \
+    X(0x92, alo_r(cpu, cpu->regs.main.d, 2))                                    \
+    X(0x93, alo_r(cpu, cpu->regs.main.e, 2))                                    \
+    X(0x94, alo_r(cpu, cpu->regs.main.h, 2))                                    \
+    X(0x95, alo_r(cpu, cpu->regs.main.l, 2))                                    \
+    X(0x96, alo_rra(cpu, cpu->regs.main.hl, 2))                                 \
+    X(0x97, alo_r(cpu, cpu->regs.main.a, 2))                                    \
+    /* sbc a */                                                                 \
+    X(0x98, alo_r(cpu, cpu->regs.main.b, 3))                                    \
+    X(0x99, alo_r(cpu, cpu->regs.main.c, 3))                                    \
+    X(0x9A, alo_r(cpu, cpu->regs.main.d, 3))                                    \
+    X(0x9B, alo_r(cpu, cpu->regs.main.e, 3))                                    \
+    X(0x9C, alo_r(cpu, cpu->regs.main.h, 3))                                    \
+    X(0x9D, alo_r(cpu, cpu->regs.main.l, 3))                                    \
+    X(0x9E, alo_rra(cpu, cpu->regs.main.hl, 3))                                 \
+    X(0x9F, alo_r(cpu, cpu->regs.main.a, 3))                                    \
+    /* and */                                                                   \
+    X(0xA0, alo_r(cpu, cpu->regs.main.b, 4))                                    \
+    X(0xA1, alo_r(cpu, cpu->regs.main.c, 4))                                    \
+    X(0xA2, alo_r(cpu, cpu->regs.main.d, 4))                                    \
+    X(0xA3, alo_r(cpu, cpu->regs.main.e, 4))                                    \
+    X(0xA4, alo_r(cpu, cpu->regs.main.h, 4))                                    \
+    X(0xA5, alo_r(cpu, cpu->regs.main.l, 4))                                    \
+    X(0xA6, alo_rra(cpu, cpu->regs.main.hl, 4))                                 \
+    X(0xA7, alo_r(cpu, cpu->regs.main.a, 4))                                    \
+    /* xor */                                                                   \
+    X(0xA8, alo_r(cpu, cpu->regs.main.b, 5))                                    \
+    X(0xA9, alo_r(cpu, cpu->regs.main.c, 5))                                    \
+    X(0xAA, alo_r(cpu, cpu->regs.main.d, 5))                                    \
+    X(0xAB, alo_r(cpu, cpu->regs.main.e, 5))                                    \
+    X(0xAC, alo_r(cpu, cpu->regs.main.h, 5))                                    \
+    X(0xAD, alo_r(cpu, cpu->regs.main.l, 5))                                    \
+    X(0xAE, alo_rra(cpu, cpu->regs.main.hl, 5))                                 \
+    X(0xAF, alo_r(cpu, cpu->regs.main.a, 5))                                    \
+    /* or */                                                                    \
+    X(0xB0, alo_r(cpu, cpu->regs.main.b, 6))                                    \
+    X(0xB1, alo_r(cpu, cpu->regs.main.c, 6))                                    \
+    X(0xB2, alo_r(cpu, cpu->regs.main.d, 6))                                    \
+    X(0xB3, alo_r(cpu, cpu->regs.main.e, 6))                                    \
+    X(0xB4, alo_r(cpu, cpu->regs.main.h, 6))                                    \
+    X(0xB5, alo_r(cpu, cpu->regs.main.l, 6))                                    \
+    X(0xB6, alo_rra(cpu, cpu->regs.main.hl, 6))                                 \
+    X(0xB7, alo_r(cpu, cpu->regs.main.a, 6))                                    \
+    /* cp */                                                                    \
+    X(0xB8, alo_r(cpu, cpu->regs.main.b, 7))                                    \
+    X(0xB9, alo_r(cpu, cpu->regs.main.c, 7))                                    \
+    X(0xBA, alo_r(cpu, cpu->regs.main.d, 7))                                    \
+    X(0xBB, alo_r(cpu, cpu->regs.main.e, 7))                                    \
+    X(0xBC, alo_r(cpu, cpu->regs.main.h, 7))                                    \
+    X(0xBD, alo_r(cpu, cpu->regs.main.l, 7))                                    \
+    X(0xBE, alo_rra(cpu, cpu->regs.main.hl, 7))                                 \
+    X(0xBF, alo_r(cpu, cpu->regs.main.a, 7))                                    \
+                                                                                \
+    /* add/adc/sub/sbc/and/xor/or/cp n */                                       \
+    X(0xC6, alo_n(cpu, 0))                                                      \
+    X(0xCE, alo_n(cpu, 1))                                                      \
+    X(0xD6, alo_n(cpu, 2))                                                      \
+    X(0xDE, alo_n(cpu, 3))                                                      \
+    X(0xE6, alo_n(cpu, 4))                                                      \
+    X(0xEE, alo_n(cpu, 5))                                                      \
+    X(0xF6, alo_n(cpu, 6))                                                      \
+    X(0xFE, alo_n(cpu, 7))                                                      \
+                                                                                \
+    /* djnz */                                                                  \
+    X(0x10, djnz_d(cpu))                                                        \
+    /* jr */                                                                    \
+    X(0x18, jr_cc_d(cpu, true))                                                 \
+    /* jr cc, d */                                                              \
+    X(0x20, jr_cc_d(cpu, !(get_f(cpu) & ZF)))                                   \
+    X(0x28, jr_cc_d(cpu, get_f(cpu) & ZF))                                      \
+    X(0x30, jr_cc_d(cpu, !(get_f(cpu) & CF)))                                   \
+    X(0x38, jr_cc_d(cpu, get_f(cpu) & CF))                                      \
+    /* jp cc, nn */                                                             \
+    X(0xC2, jp_cc_nn(cpu, !(get_f(cpu) & ZF)))                                  \
+    X(0xCA, jp_cc_nn(cpu, get_f(cpu) & ZF))                                     \
+    X(0xD2, jp_cc_nn(cpu, !(get_f(cpu) & CF)))                                  \
+    X(0xDA, jp_cc_nn(cpu, get_f(cpu) & CF))                                     \
+    X(0xE2, jp_cc_nn(cpu, !(get_f(cpu) & PF)))                                  \
+    X(0xEA, jp_cc_nn(cpu, get_f(cpu) & PF))                                     \
+    X(0xF2, jp_cc_nn(cpu, !(get_f(cpu) & SF)))                                  \
+    X(0xFA, jp_cc_nn(cpu, get_f(cpu) & SF))                                     \
+    /* jp nn */                                                                 \
+    X(0xC3, jp_cc_nn(cpu, true))                                                \
+    /* jp hl */                                                                 \
+    X(0xE9, jp_rr(cpu, cpu->regs.main.hl))                                      \
+                                                                                \
+    /* call cc, nn */                                                           \
+    X(0xC4, call_cc_nn(cpu, !(get_f(cpu) & ZF)))                                \
+    X(0xCC, call_cc_nn(cpu, get_f(cpu) & ZF))                                   \
+    X(0xD4, call_cc_nn(cpu, !(get_f(cpu) & CF)))                                \
+    X(0xDC, call_cc_nn(cpu, get_f(cpu) & CF))                                   \
+    X(0xE4, call_cc_nn(cpu, !(get_f(cpu) & PF)))                                \
+    X(0xEC, call_cc_nn(cpu, get_f(cpu) & PF))                                   \
+    X(0xF4, call_cc_nn(cpu, !(get_f(cpu) & SF)))                                \
+    X(0xFC, call_cc_nn(cpu, get_f(cpu) & SF))                                   \
+    /* call nn */                                                               \
+    X(0xCD, call_cc_nn(cpu, true))                                              \
+    /* ret cc */                                                                \
+    X(0xC0, ret_cc(cpu, !(get_f(cpu) & ZF)))                                    \
+    X(0xC8, ret_cc(cpu, get_f(cpu) & ZF))                                       \
+    X(0xD0, ret_cc(cpu, !(get_f(cpu) & CF)))                                    \
+    X(0xD8, ret_cc(cpu, get_f(cpu) & CF))                                       \
+    X(0xE0, ret_cc(cpu, !(get_f(cpu) & PF)))                                    \
+    X(0xE8, ret_cc(cpu, get_f(cpu) & PF))                                       \
+    X(0xF0, ret_cc(cpu, !(get_f(cpu) & SF)))                                    \
+    X(0xF8, ret_cc(cpu, get_f(cpu) & SF))                                       \
+    /* ret (same behavior as imaginary instruction pop pc) */                   \
+    X(0xC9, ret(cpu))                                                           \
+                                                                                \
+    /* rst */                                                                   \
+    X(0xC7, rst(cpu, 0x00))                                                     \
+    X(0xCF, rst(cpu, 0x08))                                                     \
+    X(0xD7, rst(cpu, 0x10))                                                     \
+    X(0xDF, rst(cpu, 0x18))                                                     \
+    X(0xE7, rst(cpu, 0x20))                                                     \
+    X(0xEF, rst(cpu, 0x28))                                                     \
+    X(0xF7, rst(cpu, 0x30))                                                     \
+    X(0xFF, rst(cpu, 0x38))                                                     \
+                                                                                \
+    /* pop */                                                                   \
+    X(0xC1, pop(cpu, &cpu->regs.main.bc))                                       \
+    X(0xD1, pop(cpu, &cpu->regs.main.de))                                       \
+    X(0xE1, pop(cpu, &cpu->regs.main.hl))                                       \
+    X(0xF1, pop_af(cpu))                                                        \
+    /* push */                                                                  \
+    X(0xC5, push(cpu, cpu->regs.main.bc))                                       \
+    X(0xD5, push(cpu, cpu->regs.main.de))                                       \
+    X(0xE5, push(cpu, cpu->regs.main.hl))                                       \
+    X(0xF5, push(cpu, get_af(cpu)))                                             \
+                                                                                \
+    /* out (n), a */                                                            \
+    X(0xD3, out_na_a(cpu))                                                      \
+    /* in a, (n) */                                                             \
+    X(0xDB, in_a_na(cpu))                                                       \
+                                                                                \
+    /* ex af */                                                                 \
+    X(0x08, ex_af(cpu))                                                         \
+    /* exx */                                                                   \
+    X(0xD9, exx(cpu))                                                           \
+    /* XD */                                                                    \
+    X(0xEB, ex_de_hl(cpu))                                                      \
+    /* ex (sp), hl */                                                           \
+    X(0xE3, ex_spa_rr(cpu, &cpu->regs.main.hl))                                 \
+                                                                                \
+    /* DI / EI */                                                               \
+    X(0xF3, di(cpu))                                                            \
+    X(0xFB, ei(cpu))                                                            \
+    /* halt */                                                                  \
+    X(0x76, halt(cpu))                                                          \
+                                                                                \
+    X(0x00, nop(cpu))                                                           \
+                                                                                \
+    /* bit instructions */                                                      \
+    X(0xCB, DO_CB(cpu))                                                         \
+    /* misc instructions */                                                     \
+    X(0xED, DO_ED(cpu))                                                         \
+                                                                                \
+    /* IY/IX prefix */                                                          \
+    X(0xDD, ddfd(cpu, false))                                                   \
+    X(0xFD, ddfd(cpu, true))
+
+#define Z80_OPS_ED(X) \
+    /* sbc hl, rr */                                                            \
+    X(0x42, sbc_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.main.bc))              \
+    X(0x52, sbc_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.main.de))              \
+    X(0x62, sbc_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.main.hl))              \
+    X(0x72, sbc_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.sp))                   \
+    /* ld (nn), rr */                                                           \
+    X(0x43, ld_nna_rr(cpu, cpu->regs.main.bc))                                  \
+    X(0x53, ld_nna_rr(cpu, cpu->regs.main.de))                                  \
+    X(0x63, ld_nna_rr(cpu, cpu->regs.main.hl))                                  \
+    X(0x73, ld_nna_rr(cpu, cpu->regs.sp))                                       \
+    /* retn/reti */                                                             \
+    X(0x45, retn(cpu))                                                          \
+    X(0x4D, reti(cpu))                                                          \
+    X(0x55, retn(cpu))                                                          \
+    X(0x5D, retn(cpu))                                                          \
+    X(0x65, retn(cpu))                                                          \
+    X(0x6D, retn(cpu))                                                          \
+    X(0x75, retn(cpu))                                                          \
+    X(0x7D, retn(cpu))                                                          \
+    /* im 0/1/2 */                                                              \
+    X(0x46, im(cpu, 0))                                                         \
+    X(0x4E, im(cpu, 0))                                                         \
+    X(0x56, im(cpu, 1))                                                         \
+    X(0x5E, im(cpu, 2))                                                         \
+    X(0x66, im(cpu, 0))                                                         \
+    X(0x6E, im(cpu, 0))                                                         \
+    X(0x76, im(cpu, 1))                                                         \
+    X(0x7E, im(cpu, 2))                                                         \
+    /* adc hl, rr */                                                            \
+    X(0x4A, adc_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.main.bc))              \
+    X(0x5A, adc_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.main.de))              \
+    X(0x6A, adc_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.main.hl))              \
+    X(0x7A, adc_rr_rr(cpu, &cpu->regs.main.hl, cpu->regs.sp))                   \
+    /* ld rr, (nn) */                                                           \
+    X(0x4B, ld_rr_nna(cpu, &cpu->regs.main.bc))                                 \
+    X(0x5B, ld_rr_nna(cpu, &cpu->regs.main.de))                                 \
+    X(0x6B, ld_rr_nna(cpu, &cpu->regs.main.hl))                                 \
+    X(0x7B, ld_rr_nna(cpu, &cpu->regs.sp))                                      \
+                                                                                \
+    /* ldx/ldxr */                                                              \
+    X(0xA0, ldx(cpu,  1))                                                       \
+    X(0xA8, ldx(cpu, -1))                                                       \
+    X(0xB0, ldxr(cpu,  1))                                                      \
+    X(0xB8, ldxr(cpu, -1))                                                      \
+    /* cpx/cpxr */                                                              \
+    X(0xA1, cpx(cpu,  1))                                                       \
+    X(0xA9, cpx(cpu, -1))                                                       \
+    X(0xB1, cpxr(cpu,  1))                                                      \
+    X(0xB9, cpxr(cpu, -1))                                                      \
+    /* inx/inxr */                                                              \
+    X(0xA2, inx(cpu,  1))                                                       \
+    X(0xAA, inx(cpu, -1))                                                       \
+    X(0xB2, inxr(cpu,  1))                                                      \
+    X(0xBA, inxr(cpu, -1))                                                      \
+    /* cpx/cpxr */                                                              \
+    X(0xA3, outx(cpu,  1))                                                      \
+    X(0xAB, outx(cpu, -1))                                                      \
+    X(0xB3, otxr(cpu,  1))                                                      \
+    X(0xBB, otxr(cpu, -1))                                                      \
+                                                                                \
+    /* in r, (c) */                                                             \
+    X(0x40, in_r_c(cpu, &cpu->regs.main.b))                                     \
+    X(0x48, in_r_c(cpu, &cpu->regs.main.c))                                     \
+    X(0x50, in_r_c(cpu, &cpu->regs.main.d))                                     \
+    X(0x58, in_r_c(cpu, &cpu->regs.main.e))                                     \
+    X(0x60, in_r_c(cpu, &cpu->regs.main.h))                                     \
+    X(0x68, in_r_c(cpu, &cpu->regs.main.l))                                     \
+    X(0x70, in_r_c(cpu, NULL))                                                  \
+    X(0x78, in_r_c(cpu, &cpu->regs.main.a))                                     \
+                                                                                \
+    /* out (c), r */                                                            \
+    X(0x41, out_c_r(cpu, cpu->regs.main.b))                                     \
+    X(0x49, out_c_r(cpu, cpu->regs.main.c))                                     \
+    X(0x51, out_c_r(cpu, cpu->regs.main.d))                                     \
+    X(0x59, out_c_r(cpu, cpu->regs.main.e))                                     \
+    X(0x61, out_c_r(cpu, cpu->regs.main.h))                                     \
+    X(0x69, out_c_r(cpu, cpu->regs.main.l))                                     \
+    X(0x71, out_c_r(cpu, 0))                                                    \
+    X(0x79, out_c_r(cpu, cpu->regs.main.a))                                     \
+                                                                                \
+    /* neg */                                                                   \
+    X(0x44, neg(cpu))                                                           \
+    X(0x4C, neg(cpu))                                                           \
+    X(0x54, neg(cpu))                                                           \
+    X(0x5C, neg(cpu))                                                           \
+    X(0x64, neg(cpu))                                                           \
+    X(0x6C, neg(cpu))                                                           \
+    X(0x74, neg(cpu))                                                           \
+    X(0x7C, neg(cpu))                                                           \
+                                                                                \
+    /* ir registers */                                                          \
+    X(0x47, ld_i_a(cpu, &cpu->regs.i))                                          \
+    X(0x4F, ld_i_a(cpu, &cpu->regs.r))                                          \
+    X(0x57, ld_a_i(cpu, cpu->regs.i))                                           \
+    X(0x5F, ld_a_i(cpu, cpu->regs.r))                                           \
+                                                                                \
+    /* rld/rrd */                                                               \
+    X(0x67, rrd(cpu))                                                           \
+    X(0x6F, rld(cpu))
+
+/* For bit instructions, the opcode table is fully orthogonal:
+ * bits 6-7 select the operation, bits 3-5 the bit/shift type
+ * and bits 0-2 the register. */
+#define Z80_OPS_CB(X) \
+    /* rlc/rrc/rl/rr/sla/sra/sll/srl */                                         \
+    X(0x00, sro_r(cpu, &cpu->regs.main.b, 0))                                   \
+    X(0x01, sro_r(cpu, &cpu->regs.main.c, 0))                                   \
+    X(0x02, sro_r(cpu, &cpu->regs.main.d, 0))                                   \
+    X(0x03, sro_r(cpu, &cpu->regs.main.e, 0))                                   \
+    X(0x04, sro_r(cpu, &cpu->regs.main.h, 0))                                   \
+    X(0x05, sro_r(cpu, &cpu->regs.main.l, 0))                                   \
+    X(0x06, sro_rra(cpu, cpu->regs.main.hl, 0))                                 \
+    X(0x07, sro_r(cpu, &cpu->regs.main.a, 0))                                   \
+    X(0x08, sro_r(cpu, &cpu->regs.main.b, 1))                                   \
+    X(0x09, sro_r(cpu, &cpu->regs.main.c, 1))                                   \
+    X(0x0A, sro_r(cpu, &cpu->regs.main.d, 1))                                   \
+    X(0x0B, sro_r(cpu, &cpu->regs.main.e, 1))                                   \
+    X(0x0C, sro_r(cpu, &cpu->regs.main.h, 1))                                   \
+    X(0x0D, sro_r(cpu, &cpu->regs.main.l, 1))                                   \
+    X(0x0E, sro_rra(cpu, cpu->regs.main.hl, 1))                                 \
+    X(0x0F, sro_r(cpu, &cpu->regs.main.a, 1))                                   \
+    X(0x10, sro_r(cpu, &cpu->regs.main.b, 2))                                   \
+    X(0x11, sro_r(cpu, &cpu->regs.main.c, 2))                                   \
+    X(0x12, sro_r(cpu, &cpu->regs.main.d, 2))                                   \
+    X(0x13, sro_r(cpu, &cpu->regs.main.e, 2))                                   \
+    X(0x14, sro_r(cpu, &cpu->regs.main.h, 2))                                   \
+    X(0x15, sro_r(cpu, &cpu->regs.main.l, 2))                                   \
+    X(0x16, sro_rra(cpu, cpu->regs.main.hl, 2))                                 \
+    X(0x17, sro_r(cpu, &cpu->regs.main.a, 2))                                   \
+    X(0x18, sro_r(cpu, &cpu->regs.main.b, 3))                                   \
+    X(0x19, sro_r(cpu, &cpu->regs.main.c, 3))                                   \
+    X(0x1A, sro_r(cpu, &cpu->regs.main.d, 3))                                   \
+    X(0x1B, sro_r(cpu, &cpu->regs.main.e, 3))                                   \
+    X(0x1C, sro_r(cpu, &cpu->regs.main.h, 3))                                   \
+    X(0x1D, sro_r(cpu, &cpu->regs.main.l, 3))                                   \
+    X(0x1E, sro_rra(cpu, cpu->regs.main.hl, 3))                                 \
+    X(0x1F, sro_r(cpu, &cpu->regs.main.a, 3))                                   \
+    X(0x20, sro_r(cpu, &cpu->regs.main.b, 4))                                   \
+    X(0x21, sro_r(cpu, &cpu->regs.main.c, 4))                                   \
+    X(0x22, sro_r(cpu, &cpu->regs.main.d, 4))                                   \
+    X(0x23, sro_r(cpu, &cpu->regs.main.e, 4))                                   \
+    X(0x24, sro_r(cpu, &cpu->regs.main.h, 4))                                   \
+    X(0x25, sro_r(cpu, &cpu->regs.main.l, 4))                                   \
+    X(0x26, sro_rra(cpu, cpu->regs.main.hl, 4))                                 \
+    X(0x27, sro_r(cpu, &cpu->regs.main.a, 4))                                   \
+    X(0x28, sro_r(cpu, &cpu->regs.main.b, 5))                                   \
+    X(0x29, sro_r(cpu, &cpu->regs.main.c, 5))                                   \
+    X(0x2A, sro_r(cpu, &cpu->regs.main.d, 5))                                   \
+    X(0x2B, sro_r(cpu, &cpu->regs.main.e, 5))                                   \
+    X(0x2C, sro_r(cpu, &cpu->regs.main.h, 5))                                   \
+    X(0x2D, sro_r(cpu, &cpu->regs.main.l, 5))                                   \
+    X(0x2E, sro_rra(cpu, cpu->regs.main.hl, 5))                                 \
+    X(0x2F, sro_r(cpu, &cpu->regs.main.a, 5))                                   \
+    X(0x30, sro_r(cpu, &cpu->regs.main.b, 6))                                   \
+    X(0x31, sro_r(cpu, &cpu->regs.main.c, 6))                                   \
+    X(0x32, sro_r(cpu, &cpu->regs.main.d, 6))                                   \
+    X(0x33, sro_r(cpu, &cpu->regs.main.e, 6))                                   \
+    X(0x34, sro_r(cpu, &cpu->regs.main.h, 6))                                   \
+    X(0x35, sro_r(cpu, &cpu->regs.main.l, 6))                                   \
+    X(0x36, sro_rra(cpu, cpu->regs.main.hl, 6))                                 \
+    X(0x37, sro_r(cpu, &cpu->regs.main.a, 6))                                   \
+    X(0x38, sro_r(cpu, &cpu->regs.main.b, 7))                                   \
+    X(0x39, sro_r(cpu, &cpu->regs.main.c, 7))                                   \
+    X(0x3A, sro_r(cpu, &cpu->regs.main.d, 7))                                   \
+    X(0x3B, sro_r(cpu, &cpu->regs.main.e, 7))                                   \
+    X(0x3C, sro_r(cpu, &cpu->regs.main.h, 7))                                   \
+    X(0x3D, sro_r(cpu, &cpu->regs.main.l, 7))                                   \
+    X(0x3E, sro_rra(cpu, cpu->regs.main.hl, 7))                                 \
+    X(0x3F, sro_r(cpu, &cpu->regs.main.a, 7))                                   \
+                                                                                \
+    /* bit n, r */                                                              \
+    X(0x40, bit_r(cpu, cpu->regs.main.b, 0))                                    \
+    X(0x41, bit_r(cpu, cpu->regs.main.c, 0))                                    \
+    X(0x42, bit_r(cpu, cpu->regs.main.d, 0))                                    \
+    X(0x43, bit_r(cpu, cpu->regs.main.e, 0))                                    \
+    X(0x44, bit_r(cpu, cpu->regs.main.h, 0))                                    \
+    X(0x45, bit_r(cpu, cpu->regs.main.l, 0))                                    \
+    X(0x46, bit_rra(cpu, cpu->regs.main.hl, 0))                                 \
+    X(0x47, bit_r(cpu, cpu->regs.main.a, 0))                                    \
+    X(0x48, bit_r(cpu, cpu->regs.main.b, 1))                                    \
+    X(0x49, bit_r(cpu, cpu->regs.main.c, 1))                                    \
+    X(0x4A, bit_r(cpu, cpu->regs.main.d, 1))                                    \
+    X(0x4B, bit_r(cpu, cpu->regs.main.e, 1))                                    \
+    X(0x4C, bit_r(cpu, cpu->regs.main.h, 1))                                    \
+    X(0x4D, bit_r(cpu, cpu->regs.main.l, 1))                                    \
+    X(0x4E, bit_rra(cpu, cpu->regs.main.hl, 1))                                 \
+    X(0x4F, bit_r(cpu, cpu->regs.main.a, 1))                                    \
+    X(0x50, bit_r(cpu, cpu->regs.main.b, 2))                                    \
+    X(0x51, bit_r(cpu, cpu->regs.main.c, 2))                                    \
+    X(0x52, bit_r(cpu, cpu->regs.main.d, 2))                                    \
+    X(0x53, bit_r(cpu, cpu->regs.main.e, 2))                                    \
+    X(0x54, bit_r(cpu, cpu->regs.main.h, 2))                                    \
+    X(0x55, bit_r(cpu, cpu->regs.main.l, 2))                                    \
+    X(0x56, bit_rra(cpu, cpu->regs.main.hl, 2))                                 \
+    X(0x57, bit_r(cpu, cpu->regs.main.a, 2))                                    \
+    X(0x58, bit_r(cpu, cpu->regs.main.b, 3))                                    \
+    X(0x59, bit_r(cpu, cpu->regs.main.c, 3))                                    \
+    X(0x5A, bit_r(cpu, cpu->regs.main.d, 3))                                    \
+    X(0x5B, bit_r(cpu, cpu->regs.main.e, 3))                                    \
+    X(0x5C, bit_r(cpu, cpu->regs.main.h, 3))                                    \
+    X(0x5D, bit_r(cpu, cpu->regs.main.l, 3))                                    \
+    X(0x5E, bit_rra(cpu, cpu->regs.main.hl, 3))                                 \
+    X(0x5F, bit_r(cpu, cpu->regs.main.a, 3))                                    \
+    X(0x60, bit_r(cpu, cpu->regs.main.b, 4))                                    \
+    X(0x61, bit_r(cpu, cpu->regs.main.c, 4))                                    \
+    X(0x62, bit_r(cpu, cpu->regs.main.d, 4))                                    \
+    X(0x63, bit_r(cpu, cpu->regs.main.e, 4))                                    \
+    X(0x64, bit_r(cpu, cpu->regs.main.h, 4))                                    \
+    X(0x65, bit_r(cpu, cpu->regs.main.l, 4))                                    \
+    X(0x66, bit_rra(cpu, cpu->regs.main.hl, 4))                                 \
+    X(0x67, bit_r(cpu, cpu->regs.main.a, 4))                                    \
+    X(0x68, bit_r(cpu, cpu->regs.main.b, 5))                                    \
+    X(0x69, bit_r(cpu, cpu->regs.main.c, 5))                                    \
+    X(0x6A, bit_r(cpu, cpu->regs.main.d, 5))                                    \
+    X(0x6B, bit_r(cpu, cpu->regs.main.e, 5))                                    \
+    X(0x6C, bit_r(cpu, cpu->regs.main.h, 5))                                    \
+    X(0x6D, bit_r(cpu, cpu->regs.main.l, 5))                                    \
+    X(0x6E, bit_rra(cpu, cpu->regs.main.hl, 5))                                 \
+    X(0x6F, bit_r(cpu, cpu->regs.main.a, 5))                                    \
+    X(0x70, bit_r(cpu, cpu->regs.main.b, 6))                                    \
+    X(0x71, bit_r(cpu, cpu->regs.main.c, 6))                                    \
+    X(0x72, bit_r(cpu, cpu->regs.main.d, 6))                                    \
+    X(0x73, bit_r(cpu, cpu->regs.main.e, 6))                                    \
+    X(0x74, bit_r(cpu, cpu->regs.main.h, 6))                                    \
+    X(0x75, bit_r(cpu, cpu->regs.main.l, 6))                                    \
+    X(0x76, bit_rra(cpu, cpu->regs.main.hl, 6))                                 \
+    X(0x77, bit_r(cpu, cpu->regs.main.a, 6))                                    \
+    X(0x78, bit_r(cpu, cpu->regs.main.b, 7))                                    \
+    X(0x79, bit_r(cpu, cpu->regs.main.c, 7))                                    \
+    X(0x7A, bit_r(cpu, cpu->regs.main.d, 7))                                    \
+    X(0x7B, bit_r(cpu, cpu->regs.main.e, 7))                                    \
+    X(0x7C, bit_r(cpu, cpu->regs.main.h, 7))                                    \
+    X(0x7D, bit_r(cpu, cpu->regs.main.l, 7))                                    \
+    X(0x7E, bit_rra(cpu, cpu->regs.main.hl, 7))                                 \
+    X(0x7F, bit_r(cpu, cpu->regs.main.a, 7))                                    \
+                                                                                \
+    /* res n, r */                                                              \
+    X(0x80, res_r(cpu, &cpu->regs.main.b, 0))                                   \
+    X(0x81, res_r(cpu, &cpu->regs.main.c, 0))                                   \
+    X(0x82, res_r(cpu, &cpu->regs.main.d, 0))                                   \
+    X(0x83, res_r(cpu, &cpu->regs.main.e, 0))                                   \
+    X(0x84, res_r(cpu, &cpu->regs.main.h, 0))                                   \
+    X(0x85, res_r(cpu, &cpu->regs.main.l, 0))                                   \
+    X(0x86, res_rra(cpu, cpu->regs.main.hl, 0))                                 \
+    X(0x87, res_r(cpu, &cpu->regs.main.a, 0))                                   \
+    X(0x88, res_r(cpu, &cpu->regs.main.b, 1))                                   \
+    X(0x89, res_r(cpu, &cpu->regs.main.c, 1))                                   \
+    X(0x8A, res_r(cpu, &cpu->regs.main.d, 1))                                   \
+    X(0x8B, res_r(cpu, &cpu->regs.main.e, 1))                                   \
+    X(0x8C, res_r(cpu, &cpu->regs.main.h, 1))                                   \
+    X(0x8D, res_r(cpu, &cpu->regs.main.l, 1))                                   \
+    X(0x8E, res_rra(cpu, cpu->regs.main.hl, 1))                                 \
+    X(0x8F, res_r(cpu, &cpu->regs.main.a, 1))                                   \
+    X(0x90, res_r(cpu, &cpu->regs.main.b, 2))                                   \
+    X(0x91, res_r(cpu, &cpu->regs.main.c, 2))                                   \
+    X(0x92, res_r(cpu, &cpu->regs.main.d, 2))                                   \
+    X(0x93, res_r(cpu, &cpu->regs.main.e, 2))                                   \
+    X(0x94, res_r(cpu, &cpu->regs.main.h, 2))                                   \
+    X(0x95, res_r(cpu, &cpu->regs.main.l, 2))                                   \
+    X(0x96, res_rra(cpu, cpu->regs.main.hl, 2))                                 \
+    X(0x97, res_r(cpu, &cpu->regs.main.a, 2))                                   \
+    X(0x98, res_r(cpu, &cpu->regs.main.b, 3))                                   \
+    X(0x99, res_r(cpu, &cpu->regs.main.c, 3))                                   \
+    X(0x9A, res_r(cpu, &cpu->regs.main.d, 3))                                   \
+    X(0x9B, res_r(cpu, &cpu->regs.main.e, 3))                                   \
+    X(0x9C, res_r(cpu, &cpu->regs.main.h, 3))                                   \
+    X(0x9D, res_r(cpu, &cpu->regs.main.l, 3))                                   \
+    X(0x9E, res_rra(cpu, cpu->regs.main.hl, 3))                                 \
+    X(0x9F, res_r(cpu, &cpu->regs.main.a, 3))                                   \
+    X(0xA0, res_r(cpu, &cpu->regs.main.b, 4))                                   \
+    X(0xA1, res_r(cpu, &cpu->regs.main.c, 4))                                   \
+    X(0xA2, res_r(cpu, &cpu->regs.main.d, 4))                                   \
+    X(0xA3, res_r(cpu, &cpu->regs.main.e, 4))                                   \
+    X(0xA4, res_r(cpu, &cpu->regs.main.h, 4))                                   \
+    X(0xA5, res_r(cpu, &cpu->regs.main.l, 4))                                   \
+    X(0xA6, res_rra(cpu, cpu->regs.main.hl, 4))                                 \
+    X(0xA7, res_r(cpu, &cpu->regs.main.a, 4))                                   \
+    X(0xA8, res_r(cpu, &cpu->regs.main.b, 5))                                   \
+    X(0xA9, res_r(cpu, &cpu->regs.main.c, 5))                                   \
+    X(0xAA, res_r(cpu, &cpu->regs.main.d, 5))                                   \
+    X(0xAB, res_r(cpu, &cpu->regs.main.e, 5))                                   \
+    X(0xAC, res_r(cpu, &cpu->regs.main.h, 5))                                   \
+    X(0xAD, res_r(cpu, &cpu->regs.main.l, 5))                                   \
+    X(0xAE, res_rra(cpu, cpu->regs.main.hl, 5))                                 \
+    X(0xAF, res_r(cpu, &cpu->regs.main.a, 5))                                   \
+    X(0xB0, res_r(cpu, &cpu->regs.main.b, 6))                                   \
+    X(0xB1, res_r(cpu, &cpu->regs.main.c, 6))                                   \
+    X(0xB2, res_r(cpu, &cpu->regs.main.d, 6))                                   \
+    X(0xB3, res_r(cpu, &cpu->regs.main.e, 6))                                   \
+    X(0xB4, res_r(cpu, &cpu->regs.main.h, 6))                                   \
+    X(0xB5, res_r(cpu, &cpu->regs.main.l, 6))                                   \
+    X(0xB6, res_rra(cpu, cpu->regs.main.hl, 6))                                 \
+    X(0xB7, res_r(cpu, &cpu->regs.main.a, 6))                                   \
+    X(0xB8, res_r(cpu, &cpu->regs.main.b, 7))                                   \
+    X(0xB9, res_r(cpu, &cpu->regs.main.c, 7))                                   \
+    X(0xBA, res_r(cpu, &cpu->regs.main.d, 7))                                   \
+    X(0xBB, res_r(cpu, &cpu->regs.main.e, 7))                                   \
+    X(0xBC, res_r(cpu, &cpu->regs.main.h, 7))                                   \
+    X(0xBD, res_r(cpu, &cpu->regs.main.l, 7))                                   \
+    X(0xBE, res_rra(cpu, cpu->regs.main.hl, 7))                                 \
+    X(0xBF, res_r(cpu, &cpu->regs.main.a, 7))                                   \
+                                                                                \
+    /* set n, r */                                                              \
+    X(0xC0, set_r(cpu, &cpu->regs.main.b, 0))                                   \
+    X(0xC1, set_r(cpu, &cpu->regs.main.c, 0))                                   \
+    X(0xC2, set_r(cpu, &cpu->regs.main.d, 0))                                   \
+    X(0xC3, set_r(cpu, &cpu->regs.main.e, 0))                                   \
+    X(0xC4, set_r(cpu, &cpu->regs.main.h, 0))                                   \
+    X(0xC5, set_r(cpu, &cpu->regs.main.l, 0))                                   \
+    X(0xC6, set_rra(cpu, cpu->regs.main.hl, 0))                                 \
+    X(0xC7, set_r(cpu, &cpu->regs.main.a, 0))                                   \
+    X(0xC8, set_r(cpu, &cpu->regs.main.b, 1))                                   \
+    X(0xC9, set_r(cpu, &cpu->regs.main.c, 1))                                   \
+    X(0xCA, set_r(cpu, &cpu->regs.main.d, 1))                                   \
+    X(0xCB, set_r(cpu, &cpu->regs.main.e, 1))                                   \
+    X(0xCC, set_r(cpu, &cpu->regs.main.h, 1))                                   \
+    X(0xCD, set_r(cpu, &cpu->regs.main.l, 1))                                   \
+    X(0xCE, set_rra(cpu, cpu->regs.main.hl, 1))                                 \
+    X(0xCF, set_r(cpu, &cpu->regs.main.a, 1))                                   \
+    X(0xD0, set_r(cpu, &cpu->regs.main.b, 2))                                   \
+    X(0xD1, set_r(cpu, &cpu->regs.main.c, 2))                                   \
+    X(0xD2, set_r(cpu, &cpu->regs.main.d, 2))                                   \
+    X(0xD3, set_r(cpu, &cpu->regs.main.e, 2))                                   \
+    X(0xD4, set_r(cpu, &cpu->regs.main.h, 2))                                   \
+    X(0xD5, set_r(cpu, &cpu->regs.main.l, 2))                                   \
+    X(0xD6, set_rra(cpu, cpu->regs.main.hl, 2))                                 \
+    X(0xD7, set_r(cpu, &cpu->regs.main.a, 2))                                   \
+    X(0xD8, set_r(cpu, &cpu->regs.main.b, 3))                                   \
+    X(0xD9, set_r(cpu, &cpu->regs.main.c, 3))                                   \
+    X(0xDA, set_r(cpu, &cpu->regs.main.d, 3))                                   \
+    X(0xDB, set_r(cpu, &cpu->regs.main.e, 3))                                   \
+    X(0xDC, set_r(cpu, &cpu->regs.main.h, 3))                                   \
+    X(0xDD, set_r(cpu, &cpu->regs.main.l, 3))                                   \
+    X(0xDE, set_rra(cpu, cpu->regs.main.hl, 3))                                 \
+    X(0xDF, set_r(cpu, &cpu->regs.main.a, 3))                                   \
+    X(0xE0, set_r(cpu, &cpu->regs.main.b, 4))                                   \
+    X(0xE1, set_r(cpu, &cpu->regs.main.c, 4))                                   \
+    X(0xE2, set_r(cpu, &cpu->regs.main.d, 4))                                   \
+    X(0xE3, set_r(cpu, &cpu->regs.main.e, 4))                                   \
+    X(0xE4, set_r(cpu, &cpu->regs.main.h, 4))                                   \
+    X(0xE5, set_r(cpu, &cpu->regs.main.l, 4))                                   \
+    X(0xE6, set_rra(cpu, cpu->regs.main.hl, 4))                                 \
+    X(0xE7, set_r(cpu, &cpu->regs.main.a, 4))                                   \
+    X(0xE8, set_r(cpu, &cpu->regs.main.b, 5))                                   \
+    X(0xE9, set_r(cpu, &cpu->regs.main.c, 5))                                   \
+    X(0xEA, set_r(cpu, &cpu->regs.main.d, 5))                                   \
+    X(0xEB, set_r(cpu, &cpu->regs.main.e, 5))                                   \
+    X(0xEC, set_r(cpu, &cpu->regs.main.h, 5))                                   \
+    X(0xED, set_r(cpu, &cpu->regs.main.l, 5))                                   \
+    X(0xEE, set_rra(cpu, cpu->regs.main.hl, 5))                                 \
+    X(0xEF, set_r(cpu, &cpu->regs.main.a, 5))                                   \
+    X(0xF0, set_r(cpu, &cpu->regs.main.b, 6))                                   \
+    X(0xF1, set_r(cpu, &cpu->regs.main.c, 6))                                   \
+    X(0xF2, set_r(cpu, &cpu->regs.main.d, 6))                                   \
+    X(0xF3, set_r(cpu, &cpu->regs.main.e, 6))                                   \
+    X(0xF4, set_r(cpu, &cpu->regs.main.h, 6))                                   \
+    X(0xF5, set_r(cpu, &cpu->regs.main.l, 6))                                   \
+    X(0xF6, set_rra(cpu, cpu->regs.main.hl, 6))                                 \
+    X(0xF7, set_r(cpu, &cpu->regs.main.a, 6))                                   \
+    X(0xF8, set_r(cpu, &cpu->regs.main.b, 7))                                   \
+    X(0xF9, set_r(cpu, &cpu->regs.main.c, 7))                                   \
+    X(0xFA, set_r(cpu, &cpu->regs.main.d, 7))                                   \
+    X(0xFB, set_r(cpu, &cpu->regs.main.e, 7))                                   \
+    X(0xFC, set_r(cpu, &cpu->regs.main.h, 7))                                   \
+    X(0xFD, set_r(cpu, &cpu->regs.main.l, 7))                                   \
+    X(0xFE, set_rra(cpu, cpu->regs.main.hl, 7))                                 \
+    X(0xFF, set_r(cpu, &cpu->regs.main.a, 7))
+
+#define Z80_OPS_DDFD(X) \
+    /* ld ii, nn */                                                             \
+    X(0x21, ld_rr_nn(cpu, ii))                                                  \
+    /* inc ii */                                                                \
+    X(0x23, inc_rr(cpu, ii))                                                    \
+    /* dec ii */                                                                \
+    X(0x2B, dec_rr(cpu, ii))                                                    \
+    /* add ii, rr */                                                            \
+    X(0x09, add_rr_rr(cpu, ii, cpu->regs.main.bc))                              \
+    X(0x19, add_rr_rr(cpu, ii, cpu->regs.main.de))                              \
+    X(0x29, add_rr_rr(cpu, ii, *ii))                                            \
+    X(0x39, add_rr_rr(cpu, ii, cpu->regs.sp))                                   \
+                                                                                \
+    /* inc (ii+d) */                                                            \
+    X(0x34, inc_iid(cpu, *ii))                                                  \
+    /* dec (ii+d) */                                                            \
+    X(0x35, dec_iid(cpu, *ii))                                                  \
+    /* ld (ii+d), n */                                                          \
+    X(0x36, ld_iid_n(cpu, *ii))                                                 \
+                                                                                \
+    /* ld (nn), ii */                                                           \
+    X(0x22, ld_nna_rr(cpu, *ii))                                                \
+    /* ld ii, (nn) */                                                           \
+    X(0x2A, ld_rr_nna(cpu, ii))                                                 \
+                                                                                \
+    /* ld (ii+d), r */                                                          \
+    X(0x70, ld_iid_r(cpu, *ii, cpu->regs.main.b))                               \
+    X(0x71, ld_iid_r(cpu, *ii, cpu->regs.main.c))                               \
+    X(0x72, ld_iid_r(cpu, *ii, cpu->regs.main.d))                               \
+    X(0x73, ld_iid_r(cpu, *ii, cpu->regs.main.e))                               \
+    X(0x74, ld_iid_r(cpu, *ii, cpu->regs.main.h))                               \
+    X(0x75, ld_iid_r(cpu, *ii, cpu->regs.main.l))                               \
+    X(0x77, ld_iid_r(cpu, *ii, cpu->regs.main.a))                               \
+                                                                                \
+    /* ld r, (ii+d) */                                                          \
+    X(0x46, ld_r_iid(cpu, &cpu->regs.main.b, *ii))                              \
+    X(0x4E, ld_r_iid(cpu, &cpu->regs.main.c, *ii))                              \
+    X(0x56, ld_r_iid(cpu, &cpu->regs.main.d, *ii))                              \
+    X(0x5E, ld_r_iid(cpu, &cpu->regs.main.e, *ii))                              \
+    X(0x66, ld_r_iid(cpu, &cpu->regs.main.h, *ii))                              \
+    X(0x6E, ld_r_iid(cpu, &cpu->regs.main.l, *ii))                              \
+    X(0x7E, ld_r_iid(cpu, &cpu->regs.main.a, *ii))                              \
+                                                                                \
+    /* add/adc/sub/sbc/and/xor/or/cp (ii+d) */                                  \
+    X(0x86, alo_iid(cpu, *ii, 0))                                               \
+    X(0x8E, alo_iid(cpu, *ii, 1))                                               \
+    X(0x96, alo_iid(cpu, *ii, 2))                                               \
+    X(0x9E, alo_iid(cpu, *ii, 3))                                               \
+    X(0xA6, alo_iid(cpu, *ii, 4))                                               \
+    X(0xAE, alo_iid(cpu, *ii, 5))                                               \
+    X(0xB6, alo_iid(cpu, *ii, 6))                                               \
+    X(0xBE, alo_iid(cpu, *ii, 7))                                               \
+                                                                                \
+    /* non (ii+d) alo */                                                        \
+    /* add a */                                                                 \
+    X(0x80, alo_r(cpu, cpu->regs.main.b, 0))                                    \
+    X(0x81, alo_r(cpu, cpu->regs.main.c, 0))                                    \
+    X(0x82, alo_r(cpu, cpu->regs.main.d, 0))                                    \
+    X(0x83, alo_r(cpu, cpu->regs.main.e, 0))                                    \
+    X(0x84, alo_r(cpu, *ih, 0))                                                 \
+    X(0x85, alo_r(cpu, *il, 0))                                                 \
+    X(0x87, alo_r(cpu, cpu->regs.main.a, 0))                                    \
+    /* adc a */                                                                 \
+    X(0x88, alo_r(cpu, cpu->regs.main.b, 1))                                    \
+    X(0x89, alo_r(cpu, cpu->regs.main.c, 1))                                    \
+    X(0x8A, alo_r(cpu, cpu->regs.main.d, 1))                                    \
+    X(0x8B, alo_r(cpu, cpu->regs.main.e, 1))                                    \
+    X(0x8C, alo_r(cpu, *ih, 1))                                                 \
+    X(0x8D, alo_r(cpu, *il, 1))                                                 \
+    X(0x8F, alo_r(cpu, cpu->regs.main.a, 1))                                    \
+    /* sub */                                                                   \
+    X(0x90, alo_r(cpu, cpu->regs.main.b, 2))                                    \
+    X(0x91, alo_r(cpu, cpu->regs.main.c, 2))                                    \
+    X(0x92, alo_r(cpu, cpu->regs.main.d, 2))                                    \
+    X(0x93, alo_r(cpu, cpu->regs.main.e, 2))                                    \
+    X(0x94, alo_r(cpu, *ih, 2))                                                 \
+    X(0x95, alo_r(cpu, *il, 2))                                                 \
+    X(0x97, alo_r(cpu, cpu->regs.main.a, 2))                                    \
+    /* sbc a */                                                                 \
+    X(0x98, alo_r(cpu, cpu->regs.main.b, 3))                                    \
+    X(0x99, alo_r(cpu, cpu->regs.main.c, 3))                                    \
+    X(0x9A, alo_r(cpu, cpu->regs.main.d, 3))                                    \
+    X(0x9B, alo_r(cpu, cpu->regs.main.e, 3))                                    \
+    X(0x9C, alo_r(cpu, *ih, 3))                                                 \
+    X(0x9D, alo_r(cpu, *il, 3))                                                 \
+    X(0x9F, alo_r(cpu, cpu->regs.main.a, 3))                                    \
+    /* and */                                                                   \
+    X(0xA0, alo_r(cpu, cpu->regs.main.b, 4))                                    \
+    X(0xA1, alo_r(cpu, cpu->regs.main.c, 4))                                    \
+    X(0xA2, alo_r(cpu, cpu->regs.main.d, 4))                                    \
+    X(0xA3, alo_r(cpu, cpu->regs.main.e, 4))                                    \
+    X(0xA4, alo_r(cpu, *ih, 4))                                                 \
+    X(0xA5, alo_r(cpu, *il, 4))                                                 \
+    X(0xA7, alo_r(cpu, cpu->regs.main.a, 4))                                    \
+    /* xor */                                                                   \
+    X(0xA8, alo_r(cpu, cpu->regs.main.b, 5))                                    \
+    X(0xA9, alo_r(cpu, cpu->regs.main.c, 5))                                    \
+    X(0xAA, alo_r(cpu, cpu->regs.main.d, 5))                                    \
+    X(0xAB, alo_r(cpu, cpu->regs.main.e, 5))                                    \
+    X(0xAC, alo_r(cpu, *ih, 5))                                                 \
+    X(0xAD, alo_r(cpu, *il, 5))                                                 \
+    X(0xAF, alo_r(cpu, cpu->regs.main.a, 5))                                    \
+    /* or */                                                                    \
+    X(0xB0, alo_r(cpu, cpu->regs.main.b, 6))                                    \
+    X(0xB1, alo_r(cpu, cpu->regs.main.c, 6))                                    \
+    X(0xB2, alo_r(cpu, cpu->regs.main.d, 6))                                    \
+    X(0xB3, alo_r(cpu, cpu->regs.main.e, 6))                                    \
+    X(0xB4, alo_r(cpu, *ih, 6))                                                 \
+    X(0xB5, alo_r(cpu, *il, 6))                                                 \
+    X(0xB7, alo_r(cpu, cpu->regs.main.a, 6))                                    \
+    /* cp */                                                                    \
+    X(0xB8, alo_r(cpu, cpu->regs.main.b, 7))                                    \
+    X(0xB9, alo_r(cpu, cpu->regs.main.c, 7))                                    \
+    X(0xBA, alo_r(cpu, cpu->regs.main.d, 7))                                    \
+    X(0xBB, alo_r(cpu, cpu->regs.main.e, 7))                                    \
+    X(0xBC, alo_r(cpu, *ih, 7))                                                 \
+    X(0xBD, alo_r(cpu, *il, 7))                                                 \
+    X(0xBF, alo_r(cpu, cpu->regs.main.a, 7))                                    \
+                                                                                \
+    /* inc r */                                                                 \
+    X(0x04, inc_r(cpu, &cpu->regs.main.b))                                      \
+    X(0x0C, inc_r(cpu, &cpu->regs.main.c))                                      \
+    X(0x14, inc_r(cpu, &cpu->regs.main.d))                                      \
+    X(0x1C, inc_r(cpu, &cpu->regs.main.e))                                      \
+    X(0x24, inc_r(cpu, ih))                                                     \
+    X(0x2C, inc_r(cpu, il))                                                     \
+    X(0x3C, inc_r(cpu, &cpu->regs.main.a))                                      \
+    /* dec r */                                                                 \
+    X(0x05, dec_r(cpu, &cpu->regs.main.b))                                      \
+    X(0x0D, dec_r(cpu, &cpu->regs.main.c))                                      \
+    X(0x15, dec_r(cpu, &cpu->regs.main.d))                                      \
+    X(0x1D, dec_r(cpu, &cpu->regs.main.e))                                      \
+    X(0x25, dec_r(cpu, ih))                                                     \
+    X(0x2D, dec_r(cpu, il))                                                     \
+    X(0x3D, dec_r(cpu, &cpu->regs.main.a))                                      \
+                                                                                \
+    /* ld b, r */                                                               \
+    X(0x40, ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.b))                   \
+    X(0x41, ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.c))                   \
+    X(0x42, ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.d))                   \
+    X(0x43, ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.e))                   \
+    X(0x44, ld_r_r(cpu, &cpu->regs.main.b, *ih))                                \
+    X(0x45, ld_r_r(cpu, &cpu->regs.main.b, *il))                                \
+    X(0x47, ld_r_r(cpu, &cpu->regs.main.b, cpu->regs.main.a))                   \
+    /* ld c, r */                                                               \
+    X(0x48, ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.b))                   \
+    X(0x49, ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.c))                   \
+    X(0x4A, ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.d))                   \
+    X(0x4B, ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.e))                   \
+    X(0x4C, ld_r_r(cpu, &cpu->regs.main.c, *ih))                                \
+    X(0x4D, ld_r_r(cpu, &cpu->regs.main.c, *il))                                \
+    X(0x4F, ld_r_r(cpu, &cpu->regs.main.c, cpu->regs.main.a))                   \
+    /* ld d, r */                                                               \
+    X(0x50, ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.b))                   \
+    X(0x51, ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.c))                   \
+    X(0x52, ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.d))                   \
+    X(0x53, ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.e))                   \
+    X(0x54, ld_r_r(cpu, &cpu->regs.main.d, *ih))                                \
+    X(0x55, ld_r_r(cpu, &cpu->regs.main.d, *il))                                \
+    X(0x57, ld_r_r(cpu, &cpu->regs.main.d, cpu->regs.main.a))                   \
+    /* ld e, r */                                                               \
+    X(0x58, ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.b))                   \
+    X(0x59, ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.c))                   \
+    X(0x5A, ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.d))                   \
+    X(0x5B, ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.e))                   \
+    X(0x5C, ld_r_r(cpu, &cpu->regs.main.e, *ih))                                \
+    X(0x5D, ld_r_r(cpu, &cpu->regs.main.e, *il))                                \
+    X(0x5F, ld_r_r(cpu, &cpu->regs.main.e, cpu->regs.main.a))                   \
+    /* ld ih, r */                                                              \
+    X(0x60, ld_r_r(cpu, ih, cpu->regs.main.b))                                  \
+    X(0x61, ld_r_r(cpu, ih, cpu->regs.main.c))                                  \
+    X(0x62, ld_r_r(cpu, ih, cpu->regs.main.d))                                  \
+    X(0x63, ld_r_r(cpu, ih, cpu->regs.main.e))                                  \
+    X(0x64, ld_r_r(cpu, ih, *ih))                                               \
+    X(0x65, ld_r_r(cpu, ih, *il))                                               \
+    X(0x67, ld_r_r(cpu, ih, cpu->regs.main.a))                                  \
+    /* ld il, r */                                                              \
+    X(0x68, ld_r_r(cpu, il, cpu->regs.main.b))                                  \
+    X(0x69, ld_r_r(cpu, il, cpu->regs.main.c))                                  \
+    X(0x6A, ld_r_r(cpu, il, cpu->regs.main.d))                                  \
+    X(0x6B, ld_r_r(cpu, il, cpu->regs.main.e))                                  \
+    X(0x6C, ld_r_r(cpu, il, *ih))                                               \
+    X(0x6D, ld_r_r(cpu, il, *il))                                               \
+    X(0x6F, ld_r_r(cpu, il, cpu->regs.main.a))                                  \
+    /* ld a, r */                                                               \
+    X(0x78, ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.b))                   \
+    X(0x79, ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.c))                   \
+    X(0x7A, ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.d))                   \
+    X(0x7B, ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.e))                   \
+    X(0x7C, ld_r_r(cpu, &cpu->regs.main.a, *ih))                                \
+    X(0x7D, ld_r_r(cpu, &cpu->regs.main.a, *il))                                \
+    X(0x7F, ld_r_r(cpu, &cpu->regs.main.a, cpu->regs.main.a))                   \
+                                                                                \
+    /* ld r, n */                                                               \
+    X(0x06, ld_r_n(cpu, &cpu->regs.main.b))                                     \
+    X(0x0E, ld_r_n(cpu, &cpu->regs.main.c))                                     \
+    X(0x16, ld_r_n(cpu, &cpu->regs.main.d))                                     \
+    X(0x1E, ld_r_n(cpu, &cpu->regs.main.e))                                     \
+    X(0x26, ld_r_n(cpu, ih))                                                    \
+    X(0x2E, ld_r_n(cpu, il))                                                    \
+    X(0x3E, ld_r_n(cpu, &cpu->regs.main.a))                                     \
+                                                                                \
+    /* ld sp, ii */                                                             \
+    X(0xF9, ld_sp_rr(cpu, *ii))                                                 \
+                                                                                \
+    /* jp ii */                                                                 \
+    X(0xE9, jp_rr(cpu, *ii))                                                    \
+                                                                                \
+    /* IY/IX prefix */                                                          \
+    X(0xDD, ddfd(cpu, false))                                                   \
+    X(0xFD, ddfd(cpu, true))                                                    \
+                                                                                \
+    /* pop/push ii */                                                           \
+    X(0xE1, pop(cpu, ii))                                                       \
+    X(0xE5, push(cpu, *ii))                                                     \
+    /* ex (sp), ii */                                                           \
+    X(0xE3, ex_spa_rr(cpu, ii))                                                 \
+                                                                                \
+    /* bit instructions */                                                      \
+    X(0xCB, DO_DDFD_CB(cpu, ii))                                                \
+                                                                                \
+    /* DUPLICATE OPCODES */                                                     \
+    /* ld rr, nn */                                                             \
+    X(0x01, ld_rr_nn(cpu, &cpu->regs.main.bc))                                  \
+    X(0x11, ld_rr_nn(cpu, &cpu->regs.main.de))                                  \
+    X(0x31, ld_rr_nn(cpu, &cpu->regs.sp))                                       \
+                                                                                \
+    /* ld (rr), a */                                                            \
+    X(0x02, ld_rra_a(cpu, cpu->regs.main.bc))                                   \
+    X(0x12, ld_rra_a(cpu, cpu->regs.main.de))                                   \
+    /* ld a, (rr) */                                                            \
+    X(0x0A, ld_a_rra(cpu, cpu->regs.main.bc))                                   \
+    X(0x1A, ld_a_rra(cpu, cpu->regs.main.de))                                   \
+    /* ld a, (nn) */                                                            \
+    X(0x3A, ld_a_nna(cpu))                                                      \
+    /* ld (nn), a */                                                            \
+    X(0x32, ld_nna_a(cpu))                                                      \
+    /* inc rr */                                                                \
+    X(0x03, inc_rr(cpu, &cpu->regs.main.bc))                                    \
+    X(0x13, inc_rr(cpu, &cpu->regs.main.de))                                    \
+    X(0x33, inc_rr(cpu, &cpu->regs.sp))                                         \
+    /* dec rr */                                                                \
+    X(0x0B, dec_rr(cpu, &cpu->regs.main.bc))                                    \
+    X(0x1B, dec_rr(cpu, &cpu->regs.main.de))                                    \
+    X(0x3B, dec_rr(cpu, &cpu->regs.sp))                                         \
+                                                                                \
+    /* rra/rla/rrca/rlca */                                                     \
+    X(0x07, rlca(cpu))                                                          \
+    X(0x0F, rrca(cpu))                                                          \
+    X(0x17, rla(cpu))                                                           \
+    X(0x1F, rra(cpu))                                                           \
+                                                                                \
+    X(0x27, daa(cpu))                                                           \
+    /* cpl */                                                                   \
+    X(0x2F, cpl(cpu))                                                           \
+    /* scf/ccf */                                                               \
+    X(0x37, scf(cpu))                                                           \
+    X(0x3F, ccf(cpu))                                                           \
+                                                                                \
+    /* add/adc/sub/sbc/and/xor/or/cp n */                                       \
+    X(0xC6, alo_n(cpu, 0))                                                      \
+    X(0xCE, alo_n(cpu, 1))                                                      \
+    X(0xD6, alo_n(cpu, 2))                                                      \
+    X(0xDE, alo_n(cpu, 3))                                                      \
+    X(0xE6, alo_n(cpu, 4))                                                      \
+    X(0xEE, alo_n(cpu, 5))                                                      \
+    X(0xF6, alo_n(cpu, 6))                                                      \
+    X(0xFE, alo_n(cpu, 7))                                                      \
+                                                                                \
+    /* djnz */                                                                  \
+    X(0x10, djnz_d(cpu))                                                        \
+    /* jr */                                                                    \
+    X(0x18, jr_cc_d(cpu, true))                                                 \
+    /* jr cc, d */                                                              \
+    X(0x20, jr_cc_d(cpu, !(get_f(cpu) & ZF)))                                   \
+    X(0x28, jr_cc_d(cpu, get_f(cpu) & ZF))                                      \
+    X(0x30, jr_cc_d(cpu, !(get_f(cpu) & CF)))                                   \
+    X(0x38, jr_cc_d(cpu, get_f(cpu) & CF))                                      \
+    /* jp cc, nn */                                                             \
+    X(0xC2, jp_cc_nn(cpu, !(get_f(cpu) & ZF)))                                  \
+    X(0xCA, jp_cc_nn(cpu, get_f(cpu) & ZF))                                     \
+    X(0xD2, jp_cc_nn(cpu, !(get_f(cpu) & CF)))                                  \
+    X(0xDA, jp_cc_nn(cpu, get_f(cpu) & CF))                                     \
+    X(0xE2, jp_cc_nn(cpu, !(get_f(cpu) & PF)))                                  \
+    X(0xEA, jp_cc_nn(cpu, get_f(cpu) & PF))                                     \
+    X(0xF2, jp_cc_nn(cpu, !(get_f(cpu) & SF)))                                  \
+    X(0xFA, jp_cc_nn(cpu, get_f(cpu) & SF))                                     \
+    /* jp nn */                                                                 \
+    X(0xC3, jp_cc_nn(cpu, true))                                                \
+    /* call cc, nn */                                                           \
+    X(0xC4, call_cc_nn(cpu, !(get_f(cpu) & ZF)))                                \
+    X(0xCC, call_cc_nn(cpu, get_f(cpu) & ZF))                                   \
+    X(0xD4, call_cc_nn(cpu, !(get_f(cpu) & CF)))                                \
+    X(0xDC, call_cc_nn(cpu, get_f(cpu) & CF))                                   \
+    X(0xE4, call_cc_nn(cpu, !(get_f(cpu) & PF)))                                \
+    X(0xEC, call_cc_nn(cpu, get_f(cpu) & PF))                                   \
+    X(0xF4, call_cc_nn(cpu, !(get_f(cpu) & SF)))                                \
+    X(0xFC, call_cc_nn(cpu, get_f(cpu) & SF))                                   \
+    /* call nn */                                                               \
+    X(0xCD, call_cc_nn(cpu, true))                                              \
+    /* ret cc */                                                                \
+    X(0xC0, ret_cc(cpu, !(get_f(cpu) & ZF)))                                    \
+    X(0xC8, ret_cc(cpu, get_f(cpu) & ZF))                                       \
+    X(0xD0, ret_cc(cpu, !(get_f(cpu) & CF)))                                    \
+    X(0xD8, ret_cc(cpu, get_f(cpu) & CF))                                       \
+    X(0xE0, ret_cc(cpu, !(get_f(cpu) & PF)))                                    \
+    X(0xE8, ret_cc(cpu, get_f(cpu) & PF))                                       \
+    X(0xF0, ret_cc(cpu, !(get_f(cpu) & SF)))                                    \
+    X(0xF8, ret_cc(cpu, get_f(cpu) & SF))                                       \
+    /* ret (same behavior as imaginary instruction pop pc) */                   \
+    X(0xC9, ret(cpu))                                                           \
+                                                                                \
+    /* rst */                                                                   \
+    X(0xC7, rst(cpu, 0x00))                                                     \
+    X(0xCF, rst(cpu, 0x08))                                                     \
+    X(0xD7, rst(cpu, 0x10))                                                     \
+    X(0xDF, rst(cpu, 0x18))                                                     \
+    X(0xE7, rst(cpu, 0x20))                                                     \
+    X(0xEF, rst(cpu, 0x28))                                                     \
+    X(0xF7, rst(cpu, 0x30))                                                     \
+    X(0xFF, rst(cpu, 0x38))                                                     \
+                                                                                \
+    /* pop */                                                                   \
+    X(0xC1, pop(cpu, &cpu->regs.main.bc))                                       \
+    X(0xD1, pop(cpu, &cpu->regs.main.de))                                       \
+    X(0xF1, pop_af(cpu))                                                        \
+    /* push */                                                                  \
+    X(0xC5, push(cpu, cpu->regs.main.bc))                                       \
+    X(0xD5, push(cpu, cpu->regs.main.de))                                       \
+    X(0xF5, push(cpu, get_af(cpu)))                                             \
+                                                                                \
+    /* out (n), a */                                                            \
+    X(0xD3, out_na_a(cpu))                                                      \
+    /* in a, (n) */                                                             \
+    X(0xDB, in_a_na(cpu))                                                       \
+                                                                                \
+    /* ex af */                                                                 \
+    X(0x08, ex_af(cpu))                                                         \
+    /* exx */                                                                   \
+    X(0xD9, exx(cpu))                                                           \
+    /* XD */                                                                    \
+    X(0xEB, ex_de_hl(cpu))                                                      \
+                                                                                \
+    /* DI / EI */                                                               \
+    X(0xF3, di(cpu))                                                            \
+    X(0xFB, ei(cpu))                                                            \
+    /* halt */                                                                  \
+    X(0x76, halt(cpu))                                                          \
+                                                                                \
+    X(0x00, nop(cpu))                                                           \
+                                                                                \
+    /* misc instructions */                                                     \
+    X(0xED, DO_ED(cpu))
+
+/* As a side effect of how Z80 works internally, all the instructions
+ * copy their result to a register specified in the last 3 bits. */
+#define Z80_OPS_DDFD_CB(X) \
+    /* rlc/rrc/rl/rr/sla/sra/sll/srl (ii+d), r */                               \
+    X(0x00, sro_iid_r(cpu, addr, &cpu->regs.main.b, 0))                         \
+    X(0x01, sro_iid_r(cpu, addr, &cpu->regs.main.c, 0))                         \
+    X(0x02, sro_iid_r(cpu, addr, &cpu->regs.main.d, 0))                         \
+    X(0x03, sro_iid_r(cpu, addr, &cpu->regs.main.e, 0))                         \
+    X(0x04, sro_iid_r(cpu, addr, &cpu->regs.main.h, 0))                         \
+    X(0x05, sro_iid_r(cpu, addr, &cpu->regs.main.l, 0))                         \
+    X(0x06, sro_iid_r(cpu, addr, NULL, 0))                                      \
+    X(0x07, sro_iid_r(cpu, addr, &cpu->regs.main.a, 0))                         \
+    X(0x08, sro_iid_r(cpu, addr, &cpu->regs.main.b, 1))                         \
+    X(0x09, sro_iid_r(cpu, addr, &cpu->regs.main.c, 1))                         \
+    X(0x0A, sro_iid_r(cpu, addr, &cpu->regs.main.d, 1))                         \
+    X(0x0B, sro_iid_r(cpu, addr, &cpu->regs.main.e, 1))                         \
+    X(0x0C, sro_iid_r(cpu, addr, &cpu->regs.main.h, 1))                         \
+    X(0x0D, sro_iid_r(cpu, addr, &cpu->regs.main.l, 1))                         \
+    X(0x0E, sro_iid_r(cpu, addr, NULL, 1))                                      \
+    X(0x0F, sro_iid_r(cpu, addr, &cpu->regs.main.a, 1))                         \
+    X(0x10, sro_iid_r(cpu, addr, &cpu->regs.main.b, 2))                         \
+    X(0x11, sro_iid_r(cpu, addr, &cpu->regs.main.c, 2))                         \
+    X(0x12, sro_iid_r(cpu, addr, &cpu->regs.main.d, 2))                         \
+    X(0x13, sro_iid_r(cpu, addr, &cpu->regs.main.e, 2))                         \
+    X(0x14, sro_iid_r(cpu, addr, &cpu->regs.main.h, 2))                         \
+    X(0x15, sro_iid_r(cpu, addr, &cpu->regs.main.l, 2))                         \
+    X(0x16, sro_iid_r(cpu, addr, NULL, 2))                                      \
+    X(0x17, sro_iid_r(cpu, addr, &cpu->regs.main.a, 2))                         \
+    X(0x18, sro_iid_r(cpu, addr, &cpu->regs.main.b, 3))                         \
+    X(0x19, sro_iid_r(cpu, addr, &cpu->regs.main.c, 3))                         \
+    X(0x1A, sro_iid_r(cpu, addr, &cpu->regs.main.d, 3))                         \
+    X(0x1B, sro_iid_r(cpu, addr, &cpu->regs.main.e, 3))                         \
+    X(0x1C, sro_iid_r(cpu, addr, &cpu->regs.main.h, 3))                         \
+    X(0x1D, sro_iid_r(cpu, addr, &cpu->regs.main.l, 3))                         \
+    X(0x1E, sro_iid_r(cpu, addr, NULL, 3))                                      \
+    X(0x1F, sro_iid_r(cpu, addr, &cpu->regs.main.a, 3))                         \
+    X(0x20, sro_iid_r(cpu, addr, &cpu->regs.main.b, 4))                         \
+    X(0x21, sro_iid_r(cpu, addr, &cpu->regs.main.c, 4))                         \
+    X(0x22, sro_iid_r(cpu, addr, &cpu->regs.main.d, 4))                         \
+    X(0x23, sro_iid_r(cpu, addr, &cpu->regs.main.e, 4))                         \
+    X(0x24, sro_iid_r(cpu, addr, &cpu->regs.main.h, 4))                         \
+    X(0x25, sro_iid_r(cpu, addr, &cpu->regs.main.l, 4))                         \
+    X(0x26, sro_iid_r(cpu, addr, NULL, 4))                                      \
+    X(0x27, sro_iid_r(cpu, addr, &cpu->regs.main.a, 4))                         \
+    X(0x28, sro_iid_r(cpu, addr, &cpu->regs.main.b, 5))                         \
+    X(0x29, sro_iid_r(cpu, addr, &cpu->regs.main.c, 5))                         \
+    X(0x2A, sro_iid_r(cpu, addr, &cpu->regs.main.d, 5))                         \
+    X(0x2B, sro_iid_r(cpu, addr, &cpu->regs.main.e, 5))                         \
+    X(0x2C, sro_iid_r(cpu, addr, &cpu->regs.main.h, 5))                         \
+    X(0x2D, sro_iid_r(cpu, addr, &cpu->regs.main.l, 5))                         \
+    X(0x2E, sro_iid_r(cpu, addr, NULL, 5))                                      \
+    X(0x2F, sro_iid_r(cpu, addr, &cpu->regs.main.a, 5))                         \
+    X(0x30, sro_iid_r(cpu, addr, &cpu->regs.main.b, 6))                         \
+    X(0x31, sro_iid_r(cpu, addr, &cpu->regs.main.c, 6))                         \
+    X(0x32, sro_iid_r(cpu, addr, &cpu->regs.main.d, 6))                         \
+    X(0x33, sro_iid_r(cpu, addr, &cpu->regs.main.e, 6))                         \
+    X(0x34, sro_iid_r(cpu, addr, &cpu->regs.main.h, 6))                         \
+    X(0x35, sro_iid_r(cpu, addr, &cpu->regs.main.l, 6))                         \
+    X(0x36, sro_iid_r(cpu, addr, NULL, 6))                                      \
+    X(0x37, sro_iid_r(cpu, addr, &cpu->regs.main.a, 6))                         \
+    X(0x38, sro_iid_r(cpu, addr, &cpu->regs.main.b, 7))                         \
+    X(0x39, sro_iid_r(cpu, addr, &cpu->regs.main.c, 7))                         \
+    X(0x3A, sro_iid_r(cpu, addr, &cpu->regs.main.d, 7))                         \
+    X(0x3B, sro_iid_r(cpu, addr, &cpu->regs.main.e, 7))                         \
+    X(0x3C, sro_iid_r(cpu, addr, &cpu->regs.main.h, 7))                         \
+    X(0x3D, sro_iid_r(cpu, addr, &cpu->regs.main.l, 7))                         \
+    X(0x3E, sro_iid_r(cpu, addr, NULL, 7))                                      \
+    X(0x3F, sro_iid_r(cpu, addr, &cpu->regs.main.a, 7))                         \
+                                                                                \
+    /* bit n, (ii+d) */                                                         \
+    X(0x40, bit_iid(cpu, addr, 0))                                              \
+    X(0x41, bit_iid(cpu, addr, 0))                                              \
+    X(0x42, bit_iid(cpu, addr, 0))                                              \
+    X(0x43, bit_iid(cpu, addr, 0))                                              \
+    X(0x44, bit_iid(cpu, addr, 0))                                              \
+    X(0x45, bit_iid(cpu, addr, 0))                                              \
+    X(0x46, bit_iid(cpu, addr, 0))                                              \
+    X(0x47, bit_iid(cpu, addr, 0))                                              \
+    X(0x48, bit_iid(cpu, addr, 1))                                              \
+    X(0x49, bit_iid(cpu, addr, 1))                                              \
+    X(0x4A, bit_iid(cpu, addr, 1))                                              \
+    X(0x4B, bit_iid(cpu, addr, 1))                                              \
+    X(0x4C, bit_iid(cpu, addr, 1))                                              \
+    X(0x4D, bit_iid(cpu, addr, 1))                                              \
+    X(0x4E, bit_iid(cpu, addr, 1))                                              \
+    X(0x4F, bit_iid(cpu, addr, 1))                                              \
+    X(0x50, bit_iid(cpu, addr, 2))                                              \
+    X(0x51, bit_iid(cpu, addr, 2))                                              \
+    X(0x52, bit_iid(cpu, addr, 2))                                              \
+    X(0x53, bit_iid(cpu, addr, 2))                                              \
+    X(0x54, bit_iid(cpu, addr, 2))                                              \
+    X(0x55, bit_iid(cpu, addr, 2))                                              \
+    X(0x56, bit_iid(cpu, addr, 2))                                              \
+    X(0x57, bit_iid(cpu, addr, 2))                                              \
+    X(0x58, bit_iid(cpu, addr, 3))                                              \
+    X(0x59, bit_iid(cpu, addr, 3))                                              \
+    X(0x5A, bit_iid(cpu, addr, 3))                                              \
+    X(0x5B, bit_iid(cpu, addr, 3))                                              \
+    X(0x5C, bit_iid(cpu, addr, 3))                                              \
+    X(0x5D, bit_iid(cpu, addr, 3))                                              \
+    X(0x5E, bit_iid(cpu, addr, 3))                                              \
+    X(0x5F, bit_iid(cpu, addr, 3))                                              \
+    X(0x60, bit_iid(cpu, addr, 4))                                              \
+    X(0x61, bit_iid(cpu, addr, 4))                                              \
+    X(0x62, bit_iid(cpu, addr, 4))                                              \
+    X(0x63, bit_iid(cpu, addr, 4))                                              \
+    X(0x64, bit_iid(cpu, addr, 4))                                              \
+    X(0x65, bit_iid(cpu, addr, 4))                                              \
+    X(0x66, bit_iid(cpu, addr, 4))                                              \
+    X(0x67, bit_iid(cpu, addr, 4))                                              \
+    X(0x68, bit_iid(cpu, addr, 5))                                              \
+    X(0x69, bit_iid(cpu, addr, 5))                                              \
+    X(0x6A, bit_iid(cpu, addr, 5))                                              \
+    X(0x6B, bit_iid(cpu, addr, 5))                                              \
+    X(0x6C, bit_iid(cpu, addr, 5))                                              \
+    X(0x6D, bit_iid(cpu, addr, 5))                                              \
+    X(0x6E, bit_iid(cpu, addr, 5))                                              \
+    X(0x6F, bit_iid(cpu, addr, 5))                                              \
+    X(0x70, bit_iid(cpu, addr, 6))                                              \
+    X(0x71, bit_iid(cpu, addr, 6))                                              \
+    X(0x72, bit_iid(cpu, addr, 6))                                              \
+    X(0x73, bit_iid(cpu, addr, 6))                                              \
+    X(0x74, bit_iid(cpu, addr, 6))                                              \
+    X(0x75, bit_iid(cpu, addr, 6))                                              \
+    X(0x76, bit_iid(cpu, addr, 6))                                              \
+    X(0x77, bit_iid(cpu, addr, 6))                                              \
+    X(0x78, bit_iid(cpu, addr, 7))                                              \
+    X(0x79, bit_iid(cpu, addr, 7))                                              \
+    X(0x7A, bit_iid(cpu, addr, 7))                                              \
+    X(0x7B, bit_iid(cpu, addr, 7))                                              \
+    X(0x7C, bit_iid(cpu, addr, 7))                                              \
+    X(0x7D, bit_iid(cpu, addr, 7))                                              \
+    X(0x7E, bit_iid(cpu, addr, 7))                                              \
+    X(0x7F, bit_iid(cpu, addr, 7))                                              \
+                                                                                \
+    /* res n, (ii+d), r */                                                      \
+    X(0x80, res_iid_r(cpu, addr, &cpu->regs.main.b, 0))                         \
+    X(0x81, res_iid_r(cpu, addr, &cpu->regs.main.c, 0))                         \
+    X(0x82, res_iid_r(cpu, addr, &cpu->regs.main.d, 0))                         \
+    X(0x83, res_iid_r(cpu, addr, &cpu->regs.main.e, 0))                         \
+    X(0x84, res_iid_r(cpu, addr, &cpu->regs.main.h, 0))                         \
+    X(0x85, res_iid_r(cpu, addr, &cpu->regs.main.l, 0))                         \
+    X(0x86, res_iid_r(cpu, addr, NULL, 0))                                      \
+    X(0x87, res_iid_r(cpu, addr, &cpu->regs.main.a, 0))                         \
+    X(0x88, res_iid_r(cpu, addr, &cpu->regs.main.b, 1))                         \
+    X(0x89, res_iid_r(cpu, addr, &cpu->regs.main.c, 1))                         \
+    X(0x8A, res_iid_r(cpu, addr, &cpu->regs.main.d, 1))                         \
+    X(0x8B, res_iid_r(cpu, addr, &cpu->regs.main.e, 1))                         \
+    X(0x8C, res_iid_r(cpu, addr, &cpu->regs.main.h, 1))                         \
+    X(0x8D, res_iid_r(cpu, addr, &cpu->regs.main.l, 1))                         \
+    X(0x8E, res_iid_r(cpu, addr, NULL, 1))                                      \
+    X(0x8F, res_iid_r(cpu, addr, &cpu->regs.main.a, 1))                         \
+    X(0x90, res_iid_r(cpu, addr, &cpu->regs.main.b, 2))                         \
+    X(0x91, res_iid_r(cpu, addr, &cpu->regs.main.c, 2))                         \
+    X(0x92, res_iid_r(cpu, addr, &cpu->regs.main.d, 2))                         \
+    X(0x93, res_iid_r(cpu, addr, &cpu->regs.main.e, 2))                         \
+    X(0x94, res_iid_r(cpu, addr, &cpu->regs.main.h, 2))                         \
+    X(0x95, res_iid_r(cpu, addr, &cpu->regs.main.l, 2))                         \
+    X(0x96, res_iid_r(cpu, addr, NULL, 2))                                      \
+    X(0x97, res_iid_r(cpu, addr, &cpu->regs.main.a, 2))                         \
+    X(0x98, res_iid_r(cpu, addr, &cpu->regs.main.b, 3))                         \
+    X(0x99, res_iid_r(cpu, addr, &cpu->regs.main.c, 3))                         \
+    X(0x9A, res_iid_r(cpu, addr, &cpu->regs.main.d, 3))                         \
+    X(0x9B, res_iid_r(cpu, addr, &cpu->regs.main.e, 3))                         \
+    X(0x9C, res_iid_r(cpu, addr, &cpu->regs.main.h, 3))                         \
+    X(0x9D, res_iid_r(cpu, addr, &cpu->regs.main.l, 3))                         \
+    X(0x9E, res_iid_r(cpu, addr, NULL, 3))                                      \
+    X(0x9F, res_iid_r(cpu, addr, &cpu->regs.main.a, 3))                         \
+    X(0xA0, res_iid_r(cpu, addr, &cpu->regs.main.b, 4))                         \
+    X(0xA1, res_iid_r(cpu, addr, &cpu->regs.main.c, 4))                         \
+    X(0xA2, res_iid_r(cpu, addr, &cpu->regs.main.d, 4))                         \
+    X(0xA3, res_iid_r(cpu, addr, &cpu->regs.main.e, 4))                         \
+    X(0xA4, res_iid_r(cpu, addr, &cpu->regs.main.h, 4))                         \
+    X(0xA5, res_iid_r(cpu, addr, &cpu->regs.main.l, 4))                         \
+    X(0xA6, res_iid_r(cpu, addr, NULL, 4))                                      \
+    X(0xA7, res_iid_r(cpu, addr, &cpu->regs.main.a, 4))                         \
+    X(0xA8, res_iid_r(cpu, addr, &cpu->regs.main.b, 5))                         \
+    X(0xA9, res_iid_r(cpu, addr, &cpu->regs.main.c, 5))                         \
+    X(0xAA, res_iid_r(cpu, addr, &cpu->regs.main.d, 5))                         \
+    X(0xAB, res_iid_r(cpu, addr, &cpu->regs.main.e, 5))                         \
+    X(0xAC, res_iid_r(cpu, addr, &cpu->regs.main.h, 5))                         \
+    X(0xAD, res_iid_r(cpu, addr, &cpu->regs.main.l, 5))                         \
+    X(0xAE, res_iid_r(cpu, addr, NULL, 5))                                      \
+    X(0xAF, res_iid_r(cpu, addr, &cpu->regs.main.a, 5))                         \
+    X(0xB0, res_iid_r(cpu, addr, &cpu->regs.main.b, 6))                         \
+    X(0xB1, res_iid_r(cpu, addr, &cpu->regs.main.c, 6))                         \
+    X(0xB2, res_iid_r(cpu, addr, &cpu->regs.main.d, 6))                         \
+    X(0xB3, res_iid_r(cpu, addr, &cpu->regs.main.e, 6))                         \
+    X(0xB4, res_iid_r(cpu, addr, &cpu->regs.main.h, 6))                         \
+    X(0xB5, res_iid_r(cpu, addr, &cpu->regs.main.l, 6))                         \
+    X(0xB6, res_iid_r(cpu, addr, NULL, 6))                                      \
+    X(0xB7, res_iid_r(cpu, addr, &cpu->regs.main.a, 6))                         \
+    X(0xB8, res_iid_r(cpu, addr, &cpu->regs.main.b, 7))                         \
+    X(0xB9, res_iid_r(cpu, addr, &cpu->regs.main.c, 7))                         \
+    X(0xBA, res_iid_r(cpu, addr, &cpu->regs.main.d, 7))                         \
+    X(0xBB, res_iid_r(cpu, addr, &cpu->regs.main.e, 7))                         \
+    X(0xBC, res_iid_r(cpu, addr, &cpu->regs.main.h, 7))                         \
+    X(0xBD, res_iid_r(cpu, addr, &cpu->regs.main.l, 7))                         \
+    X(0xBE, res_iid_r(cpu, addr, NULL, 7))                                      \
+    X(0xBF, res_iid_r(cpu, addr, &cpu->regs.main.a, 7))                         \
+                                                                                \
+    /* set n, (ii+d), r */                                                      \
+    X(0xC0, set_iid_r(cpu, addr, &cpu->regs.main.b, 0))                         \
+    X(0xC1, set_iid_r(cpu, addr, &cpu->regs.main.c, 0))                         \
+    X(0xC2, set_iid_r(cpu, addr, &cpu->regs.main.d, 0))                         \
+    X(0xC3, set_iid_r(cpu, addr, &cpu->regs.main.e, 0))                         \
+    X(0xC4, set_iid_r(cpu, addr, &cpu->regs.main.h, 0))                         \
+    X(0xC5, set_iid_r(cpu, addr, &cpu->regs.main.l, 0))                         \
+    X(0xC6, set_iid_r(cpu, addr, NULL, 0))                                      \
+    X(0xC7, set_iid_r(cpu, addr, &cpu->regs.main.a, 0))                         \
+    X(0xC8, set_iid_r(cpu, addr, &cpu->regs.main.b, 1))                         \
+    X(0xC9, set_iid_r(cpu, addr, &cpu->regs.main.c, 1))                         \
+    X(0xCA, set_iid_r(cpu, addr, &cpu->regs.main.d, 1))                         \
+    X(0xCB, set_iid_r(cpu, addr, &cpu->regs.main.e, 1))                         \
+    X(0xCC, set_iid_r(cpu, addr, &cpu->regs.main.h, 1))                         \
+    X(0xCD, set_iid_r(cpu, addr, &cpu->regs.main.l, 1))                         \
+    X(0xCE, set_iid_r(cpu, addr, NULL, 1))                                      \
+    X(0xCF, set_iid_r(cpu, addr, &cpu->regs.main.a, 1))                         \
+    X(0xD0, set_iid_r(cpu, addr, &cpu->regs.main.b, 2))                         \
+    X(0xD1, set_iid_r(cpu, addr, &cpu->regs.main.c, 2))                         \
+    X(0xD2, set_iid_r(cpu, addr, &cpu->regs.main.d, 2))                         \
+    X(0xD3, set_iid_r(cpu, addr, &cpu->regs.main.e, 2))                         \
+    X(0xD4, set_iid_r(cpu, addr, &cpu->regs.main.h, 2))                         \
+    X(0xD5, set_iid_r(cpu, addr, &cpu->regs.main.l, 2))                         \
+    X(0xD6, set_iid_r(cpu, addr, NULL, 2))                                      \
+    X(0xD7, set_iid_r(cpu, addr, &cpu->regs.main.a, 2))                         \
+    X(0xD8, set_iid_r(cpu, addr, &cpu->regs.main.b, 3))                         \
+    X(0xD9, set_iid_r(cpu, addr, &cpu->regs.main.c, 3))                         \
+    X(0xDA, set_iid_r(cpu, addr, &cpu->regs.main.d, 3))                         \
+    X(0xDB, set_iid_r(cpu, addr, &cpu->regs.main.e, 3))                         \
+    X(0xDC, set_iid_r(cpu, addr, &cpu->regs.main.h, 3))                         \
+    X(0xDD, set_iid_r(cpu, addr, &cpu->regs.main.l, 3))                         \
+    X(0xDE, set_iid_r(cpu, addr, NULL, 3))                                      \
+    X(0xDF, set_iid_r(cpu, addr, &cpu->regs.main.a, 3))                         \
+    X(0xE0, set_iid_r(cpu, addr, &cpu->regs.main.b, 4))                         \
+    X(0xE1, set_iid_r(cpu, addr, &cpu->regs.main.c, 4))                         \
+    X(0xE2, set_iid_r(cpu, addr, &cpu->regs.main.d, 4))                         \
+    X(0xE3, set_iid_r(cpu, addr, &cpu->regs.main.e, 4))                         \
+    X(0xE4, set_iid_r(cpu, addr, &cpu->regs.main.h, 4))                         \
+    X(0xE5, set_iid_r(cpu, addr, &cpu->regs.main.l, 4))                         \
+    X(0xE6, set_iid_r(cpu, addr, NULL, 4))                                      \
+    X(0xE7, set_iid_r(cpu, addr, &cpu->regs.main.a, 4))                         \
+    X(0xE8, set_iid_r(cpu, addr, &cpu->regs.main.b, 5))                         \
+    X(0xE9, set_iid_r(cpu, addr, &cpu->regs.main.c, 5))                         \
+    X(0xEA, set_iid_r(cpu, addr, &cpu->regs.main.d, 5))                         \
+    X(0xEB, set_iid_r(cpu, addr, &cpu->regs.main.e, 5))                         \
+    X(0xEC, set_iid_r(cpu, addr, &cpu->regs.main.h, 5))                         \
+    X(0xED, set_iid_r(cpu, addr, &cpu->regs.main.l, 5))                         \
+    X(0xEE, set_iid_r(cpu, addr, NULL, 5))                                      \
+    X(0xEF, set_iid_r(cpu, addr, &cpu->regs.main.a, 5))                         \
+    X(0xF0, set_iid_r(cpu, addr, &cpu->regs.main.b, 6))                         \
+    X(0xF1, set_iid_r(cpu, addr, &cpu->regs.main.c, 6))                         \
+    X(0xF2, set_iid_r(cpu, addr, &cpu->regs.main.d, 6))                         \
+    X(0xF3, set_iid_r(cpu, addr, &cpu->regs.main.e, 6))                         \
+    X(0xF4, set_iid_r(cpu, addr, &cpu->regs.main.h, 6))                         \
+    X(0xF5, set_iid_r(cpu, addr, &cpu->regs.main.l, 6))                         \
+    X(0xF6, set_iid_r(cpu, addr, NULL, 6))                                      \
+    X(0xF7, set_iid_r(cpu, addr, &cpu->regs.main.a, 6))                         \
+    X(0xF8, set_iid_r(cpu, addr, &cpu->regs.main.b, 7))                         \
+    X(0xF9, set_iid_r(cpu, addr, &cpu->regs.main.c, 7))                         \
+    X(0xFA, set_iid_r(cpu, addr, &cpu->regs.main.d, 7))                         \
+    X(0xFB, set_iid_r(cpu, addr, &cpu->regs.main.e, 7))                         \
+    X(0xFC, set_iid_r(cpu, addr, &cpu->regs.main.h, 7))                         \
+    X(0xFD, set_iid_r(cpu, addr, &cpu->regs.main.l, 7))                         \
+    X(0xFE, set_iid_r(cpu, addr, NULL, 7))                                      \
+    X(0xFF, set_iid_r(cpu, addr, &cpu->regs.main.a, 7))
@@ -0,0 +1,338 @@
+#include "z80_profile.h"
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include "machine.h"
+#include "file.h"
+#include "log.h"
+
+/* Guest code profiler.
+ *
+ * While a profile is open, cpu_run_until() steps the cpu one instruction
+ * at a time, and profile_step_end() attributes the T-states each one
+ * took, contention included, to its PC. Contention stalls are counted
+ * separately through a ULA contention trace.
+ * HALT and block instruction fast-forwarding and the recompiler are left
+ * out, so every instruction gets seen. Otherwise the cpu runs exactly
+ * the same as it would without the profiler.
+ *
+ * CALLs, RSTs and accepted interrupts push a frame onto a shadow call stack,
+ * frames get popped once SP rises above the return address they pushed,
+ * which covers RET, RETI, RETN and code dropping its stack frames by hand.
+ * Time is recorded per call path in a tree of nodes, giving inclusive time
+ * per routine and collapsed stacks for flamegraph tools. */
+
+#define PROFILE_MAX_DEPTH   64
+#define PROFILE_MAX_NODES   65536
+
+struct ProfileNode {
+    uint16_t addr;
+    bool interrupt;
+    uint32_t parent;
+    uint32_t child;     // first child, 0 if none
+    uint32_t sibling;   // next child of the parent, 0 if none
+    uint64_t calls;
+    uint64_t self;      // T-states spent in the routine itself
+};
+
+struct ProfileFrame {
+    uint32_t node;
+    uint16_t sp;        // where the return address was pushed to
+};
+
+struct Z80Profile {
+    uint64_t count[0x10000];
+    uint64_t tstates[0x10000];
+    uint64_t stalls[0x10000];
+    uint64_t instructions;
+    uint64_t total;
+    uint64_t total_stalls;
+
+    struct ProfileNode nodes[PROFILE_MAX_NODES];    // 0 is the root
+    size_t node_count;
+
+    struct ProfileFrame stack[PROFILE_MAX_DEPTH];
+    unsigned int depth;
+    uint32_t current;
+
+    struct UlaContentionTrace trace;
+
+    // the instruction being profiled
+    struct ProfileStep {
+        uint16_t pc;
+        uint16_t sp;
+        uint64_t start;
+        bool halted;
+        bool interrupt;
+        uint8_t op;
+    } step;
+};
+
+/* Opens a profile, cpu_run_until() profiles from then on.
+ * Returns zero on success, non-zero otherwise. */
+int profile_start(Z80_t *cpu)
+{
+    if (cpu->profile != NULL) return 0;
+
+    struct Z80Profile *p = calloc(1, sizeof(*p));
+    if (p == NULL) {
+        dlog(LOG_ERR, "%s: malloc fail", __func__);
+        return -1;
+    }
+    p->node_count = 1;
+    cpu->profile = p;
+    return 0;
+}
+
+/* Drops the shadow call stack, for when the cpu state gets replaced.
+ * Time recorded so far is kept. */
+void profile_reset_stack(Z80_t *cpu)
+{
+    struct Z80Profile *p = cpu->profile;
+    if (p == NULL) return;
+
+    p->depth = 0;
+    p->current = 0;
+}
+
+void profile_free(Z80_t *cpu)
+{
+    free(cpu->profile);
+    cpu->profile = NULL;
+}
+
+/* Returns the child of the current node for the given routine,
+ * or the current node itself if the tree is full. */
+static uint32_t node_enter(struct Z80Profile *p, uint16_t addr, bool interrupt)
+{
+    struct ProfileNode *cur = &p->nodes[p->current];
+    for (uint32_t i = cur->child; i != 0; i = p->nodes[i].sibling) {
+        if (p->nodes[i].addr == addr && p->nodes[i].interrupt == interrupt) {
+            return i;
+        }
+    }
+
+    if (p->node_count >= PROFILE_MAX_NODES) return p->current;
+
+    uint32_t i = p->node_count++;
+    struct ProfileNode *n = &p->nodes[i];
+    n->addr = addr;
+    n->interrupt = interrupt;
+    n->parent = p->current;
+    n->sibling = cur->child;
+    cur->child = i;
+    return i;
+}
+
+static void stack_push(struct Z80Profile *p, uint16_t addr, uint16_t sp, bool interrupt)
+{
+    if (p->depth >= PROFILE_MAX_DEPTH) return;
+
+    uint32_t node = node_enter(p, addr, interrupt);
+    p->nodes[node].calls++;
+    p->stack[p->depth++] = (struct ProfileFrame){ .node = p->current, .sp = sp };
+    p->current = node;
+}
+
+static void stack_pop(struct Z80Profile *p, uint16_t sp)
+{
+    while (p->depth > 0 && p->stack[p->depth-1].sp < sp) {
+        p->current = p->stack[--p->depth].node;
+    }
+}
+
+static inline bool is_call(uint8_t op)
+{
+    return op == 0xCD               // call nn
+        || (op & 0xC7) == 0xC4      // call cc, nn
+        || (op & 0xC7) == 0xC7;     // rst
+}
+
+/* Called before each instruction while profiling. */
+void profile_step_begin(Z80_t *cpu)
+{
+    struct Z80Profile *p = cpu->profile;
+    struct ProfileStep *st = &p->step;
+
+    st->pc = cpu->regs.pc;
+    st->sp = cpu->regs.sp;
+    st->start = cpu->cycles;
+    st->halted = cpu->halted;
+    st->interrupt = cpu->interrupt_pending && cpu_can_process_interrupts(cpu);
+    st->op = memory_bus_peek(cpu->ctx->memory, st->pc);
+
+    p->trace.base = st->start;
+    p->trace.total = 0;
+    p->trace.len = 0;
+    ula_trace_contention(&cpu->ctx->ula, &p->trace);
+}
+
+/* Called after each instruction while profiling, attributes its T-states. */
+void profile_step_end(Z80_t *cpu)
+{
+    struct Z80Profile *p = cpu->profile;
+    const struct ProfileStep *st = &p->step;
+
+    ula_trace_contention(&cpu->ctx->ula, NULL);
+
+    uint16_t pc = st->pc;
+    uint64_t t = cpu->cycles - st->start;
+    uint64_t stalls = p->trace.total;
+
+    stack_pop(p, cpu->regs.sp);
+    if (st->interrupt) {
+        stack_push(p, cpu->regs.pc, cpu->regs.sp, true);
+    } else {
+        if (!st->halted) {
+            p->count[pc]++;
+            p->instructions++;
+        }
+        p->tstates[pc] += t;
+        p->stalls[pc] += stalls;
+        if (!st->halted && is_call(st->op) && cpu->regs.sp == (uint16_t)(st->sp - 2)) {
+            // the call itself still belongs to the caller
+            p->nodes[p->current].self += t;
+            t = 0;
+            stack_push(p, cpu->regs.pc, cpu->regs.sp, false);
+        }
+    }
+
+    p->nodes[p->current].self += t;
+    p->total += cpu->cycles - st->start;
+    p->total_stalls += stalls;
+}
+
+/* reports */
+
+static void node_name(const struct ProfileNode *n, char *buf, size_t size)
+{
+    snprintf(buf, size, "%s_%04X", n->interrupt ? "int" : "sub", n->addr);
+}
+
+struct RoutineStats {
+    uint64_t inclusive[0x10000];
+    uint64_t self[0x10000];
+    uint64_t calls[0x10000];
+    uint16_t on_path[0x10000];
+};
+
+/* Returns the T-states spent in the node and everything it called.
+ * Recursive routines only count once per path towards their inclusive time. */
+static uint64_t node_total(const struct Z80Profile *p, uint32_t i, struct RoutineStats *rs)
+{
+    const struct ProfileNode *n = &p->nodes[i];
+    uint64_t total = n->self;
+
+    if (i != 0) rs->on_path[n->addr]++;
+    for (uint32_t c = n->child; c != 0; c = p->nodes[c].sibling) {
+        total += node_total(p, c, rs);
+    }
+    if (i != 0) {
+        if (--rs->on_path[n->addr] == 0) rs->inclusive[n->addr] += total;
+        rs->self[n->addr] += n->self;
+        rs->calls[n->addr] += n->calls;
+    }
+
+    return total;
+}
+
+/* Fills top with the indices of up to n largest values, returns their count. */
+static unsigned int top_n(const uint64_t *values, size_t len, uint32_t *top, unsigned int n)
+{
+    unsigned int found = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (values[i] == 0) continue;
+        if (found == n && values[i] <= values[top[n-1]]) continue;
+
+        unsigned int j = found < n ? found++ : n - 1;
+        while (j > 0 && values[top[j-1]] < values[i]) {
+            top[j] = top[j-1];
+            j--;
+        }
+        top[j] = i;
+    }
+    return found;
+}
+
+/* Logs the top PCs by T-states and the top routines by inclusive T-states. */
+void profile_report(Z80_t *cpu, unsigned int top)
+{
+    struct Z80Profile *p = cpu->profile;
+    if (p == NULL || p->total == 0) return;
+
+    struct RoutineStats *rs = calloc(1, sizeof(*rs));
+    uint32_t *idx = malloc(top * sizeof(*idx));
+    if (rs == NULL || idx == NULL) {
+        dlog(LOG_ERR, "%s: malloc fail", __func__);
+        free(rs);
+        free(idx);
+        return;
+    }
+    node_total(p, 0, rs);
+
+    dlog(LOG_INFO, "profile: %"PRIu64" instructions, %"PRIu64" T-states, %"PRIu64" stalled on contention (%.1f%%)",
+                   p->instructions, p->total, p->total_stalls, 100.0 * p->total_stalls / p->total);
+
+    dlog(LOG_INFO, "  top %u PCs by T-states:", top);
+    dlog(LOG_INFO, "    pc         count     T-states      %%      stalls");
+    unsigned int n = top_n(p->tstates, 0x10000, idx, top);
+    for (unsigned int i = 0; i < n; i++) {
+        uint32_t pc = idx[i];
+        dlog(LOG_INFO, "    %04X %12llu %12llu %5.1f%% %11llu",
+                       pc, p->count[pc], p->tstates[pc],
+                       100.0 * p->tstates[pc] / p->total, p->stalls[pc]);
+    }
+
+    dlog(LOG_INFO, "  top %u routines by inclusive T-states:", top);
+    dlog(LOG_INFO, "    routine    calls    inclusive      %%        self");
+    n = top_n(rs->inclusive, 0x10000, idx, top);
+    for (unsigned int i = 0; i < n; i++) {
+        uint32_t a = idx[i];
+        dlog(LOG_INFO, "    %04X %12llu %12llu %5.1f%% %11llu",
+                       a, rs->calls[a], rs->inclusive[a],
+                       100.0 * rs->inclusive[a] / p->total, rs->self[a]);
+    }
+
+    free(rs);
+    free(idx);
+}
+
+static void write_node(const struct Z80Profile *p, uint32_t i, FILE *f, char *path, size_t len)
+{
+    const struct ProfileNode *n = &p->nodes[i];
+
+    if (i != 0) {
+        path[len++] = ';';
+        node_name(n, path + len, 16);
+        len += strlen(path + len);
+    }
+    if (n->self) {
+        fprintf(f, "%.*s %llu\n", (int)len, path, (unsigned long long)n->self);
+    }
+    for (uint32_t c = n->child; c != 0; c = p->nodes[c].sibling) {
+        write_node(p, c, f, path, len);
+    }
+}
+
+/* Writes T-states per call path in the collapsed stack format,
+ * one "root;sub_XXXX;... T-states" line per path.
+ * Returns zero on success, non-zero otherwise. */
+int profile_write(Z80_t *cpu, const char *path)
+{
+    struct Z80Profile *p = cpu->profile;
+    if (p == NULL) return -1;
+
+    FILE *f = fopen_utf8(path, "wb");
+    if (f == NULL) {
+        dlog(LOG_ERR, "Failed to open profile \"%s\" for write", path);
+        return -1;
+    }
+
+    char buf[(PROFILE_MAX_DEPTH + 1) * 16 + 8] = "root";
+    write_node(p, 0, f, buf, strlen(buf));
+    fclose(f);
+
+    dlog(LOG_INFO, "Wrote profile to \"%s\"", path);
+    return 0;
+}
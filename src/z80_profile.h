@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+#include "z80.h"
+
+#define PROFILE_TOP_N 20
+
+int profile_start(Z80_t *cpu);
+void profile_step_begin(Z80_t *cpu);
+void profile_step_end(Z80_t *cpu);
+void profile_reset_stack(Z80_t *cpu);
+void profile_report(Z80_t *cpu, unsigned int top);
+int profile_write(Z80_t *cpu, const char *path);
+void profile_free(Z80_t *cpu);
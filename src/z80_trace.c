@@ -0,0 +1,267 @@
+#include "z80_trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include "machine.h"
+#include "trace_file.h"
+#include "log.h"
+
+/* Instruction tracer.
+ *
+ * While a trace is open, cpu_run_until() steps the cpu one instruction at
+ * a time, the same way it does for the profiler, and every instruction gets
+ * recorded with the cpu state from before it and the memory accesses it did.
+ * Accesses are caught by watching every page of memory, the watch function
+ * machine_breakpoints.c installs passes them on. Contention stalls show up
+ * as reads, as that's what the cpu does on the bus.
+ *
+ * Records either get streamed into a trace file right away, or kept in
+ * a ring buffer of the last N million instructions, which only gets written
+ * out when the trace is stopped. See trace_file.c for the format. */
+
+// accesses kept in the ring buffer per instruction, on average
+#define TRACE_RING_ACCESSES 8
+
+struct RingEntry {
+    uint64_t time;
+    uint64_t access_start;  // index into the access ring
+    uint16_t pc;
+    uint16_t regs[TRACE_REG_COUNT];
+    uint8_t op[4];
+    uint8_t access_count;
+    bool access_overflow;
+};
+
+struct Z80Trace {
+    char *path;
+    TraceWriter_t *writer;      // NULL when recording into the ring
+    int error;
+
+    struct RingEntry *ring;
+    size_t ring_len;
+    size_t ring_pos;
+    uint64_t ring_count;        // entries ever added
+    struct TraceAccess *access_ring;
+    size_t access_ring_len;
+    size_t access_pos;
+    uint64_t access_count;      // accesses ever added
+
+    bool in_step;
+    struct TraceEntry cur;
+    uint64_t instructions;      // recorded into the file
+};
+
+/* Records a memory access, called for every one while tracing. */
+void trace_memory_access(Z80_t *cpu, uint16_t addr, uint8_t value, bool write)
+{
+    struct Z80Trace *t = cpu->trace;
+    if (!t->in_step) return;
+
+    struct TraceEntry *e = &t->cur;
+    if (e->access_count == TRACE_MAX_ACCESSES) {
+        e->access_overflow = true;
+        return;
+    }
+    e->access[e->access_count++] = (struct TraceAccess){
+        .addr = addr,
+        .value = value,
+        .write = write,
+    };
+}
+
+/* Opens a trace, cpu_run_until() records every instruction from then on.
+ * With ring_millions at zero the trace is streamed into the file,
+ * otherwise only that many million last instructions are written out
+ * on trace_stop().
+ * Returns zero on success, non-zero otherwise. */
+int trace_start(Z80_t *cpu, const char *path, unsigned int ring_millions)
+{
+    if (cpu->trace != NULL) return 0;
+
+    struct Z80Trace *t = calloc(1, sizeof(*t));
+    if (t == NULL) {
+        dlog(LOG_ERR, "%s: malloc fail", __func__);
+        return -1;
+    }
+
+    t->path = strdup(path);
+    if (ring_millions) {
+        t->ring_len = (size_t)ring_millions * 1000000;
+        t->access_ring_len = t->ring_len * TRACE_RING_ACCESSES;
+        t->ring = malloc(t->ring_len * sizeof(*t->ring));
+        t->access_ring = malloc(t->access_ring_len * sizeof(*t->access_ring));
+        if (t->path == NULL || t->ring == NULL || t->access_ring == NULL) {
+            dlog(LOG_ERR, "%s: malloc fail", __func__);
+            goto fail;
+        }
+    } else {
+        t->writer = trace_writer_open(path);
+        if (t->path == NULL || t->writer == NULL) {
+            dlog(LOG_ERR, "Failed to open trace \"%s\" for write", path);
+            goto fail;
+        }
+    }
+
+    cpu->trace = t;
+    return 0;
+
+fail:
+    trace_writer_close(t->writer);
+    free(t->path);
+    free(t->ring);
+    free(t->access_ring);
+    free(t);
+    return -1;
+}
+
+/* Called before each instruction while tracing. */
+void trace_step_begin(Z80_t *cpu)
+{
+    struct Z80Trace *t = cpu->trace;
+    Memory_t *mem = cpu->ctx->memory;
+    const struct Z80Regs *r = &cpu->regs;
+    struct TraceEntry *e = &t->cur;
+
+    // memory gets replaced when loading snapshots
+    if (mem->watch_all != (MEMORY_WATCH_READ | MEMORY_WATCH_WRITE)) {
+        memory_set_watch_all(mem, MEMORY_WATCH_READ | MEMORY_WATCH_WRITE);
+    }
+
+    // with lazy flags, F is only up to date once synced
+    cpu_sync_flags(cpu);
+
+    e->time = cpu->cycles;
+    e->pc = r->pc;
+    for (int i = 0; i < 4; i++) {
+        e->op[i] = memory_bus_peek(mem, r->pc + i);
+    }
+    e->regs[TRACE_AF] = r->main.af;
+    e->regs[TRACE_BC] = r->main.bc;
+    e->regs[TRACE_DE] = r->main.de;
+    e->regs[TRACE_HL] = r->main.hl;
+    e->regs[TRACE_AF_] = r->alt.af;
+    e->regs[TRACE_BC_] = r->alt.bc;
+    e->regs[TRACE_DE_] = r->alt.de;
+    e->regs[TRACE_HL_] = r->alt.hl;
+    e->regs[TRACE_IX] = r->ix;
+    e->regs[TRACE_IY] = r->iy;
+    e->regs[TRACE_SP] = r->sp;
+    e->regs[TRACE_IR] = (r->i << 8) | r->r;
+    e->regs[TRACE_MEMPTR] = r->memptr;
+    e->regs[TRACE_STATE] = (r->iff1 ? TRACE_STATE_IFF1 : 0)
+                         | (r->iff2 ? TRACE_STATE_IFF2 : 0)
+                         | TRACE_STATE_IM(r->im & 3)
+                         | (cpu->halted ? TRACE_STATE_HALTED : 0)
+                         | (r->q ? TRACE_STATE_Q : 0);
+    e->access_count = 0;
+    e->access_overflow = false;
+
+    t->in_step = true;
+}
+
+static void ring_add(struct Z80Trace *t, const struct TraceEntry *e)
+{
+    struct RingEntry *re = &t->ring[t->ring_pos];
+    if (++t->ring_pos == t->ring_len) t->ring_pos = 0;
+    t->ring_count++;
+
+    re->time = e->time;
+    re->access_start = t->access_count;
+    re->pc = e->pc;
+    memcpy(re->regs, e->regs, sizeof(re->regs));
+    memcpy(re->op, e->op, sizeof(re->op));
+    re->access_count = e->access_count;
+    re->access_overflow = e->access_overflow;
+
+    for (int i = 0; i < e->access_count; i++) {
+        t->access_ring[t->access_pos] = e->access[i];
+        if (++t->access_pos == t->access_ring_len) t->access_pos = 0;
+    }
+    t->access_count += e->access_count;
+}
+
+/* Called after each instruction while tracing, records it. */
+void trace_step_end(Z80_t *cpu)
+{
+    struct Z80Trace *t = cpu->trace;
+
+    t->in_step = false;
+
+    if (t->ring != NULL) {
+        ring_add(t, &t->cur);
+    } else if (!t->error) {
+        if (trace_writer_add(t->writer, &t->cur)) {
+            dlog(LOG_ERR, "Failed to write trace \"%s\"", t->path);
+            t->error = -1;
+        }
+        t->instructions++;
+    }
+}
+
+/* Writes out the ring buffer, skipping the oldest entries if their
+ * accesses have been overwritten already. */
+static int ring_write(struct Z80Trace *t)
+{
+    TraceWriter_t *w = trace_writer_open(t->path);
+    if (w == NULL) {
+        dlog(LOG_ERR, "Failed to open trace \"%s\" for write", t->path);
+        return -1;
+    }
+
+    uint64_t first = t->ring_count > t->ring_len ? t->ring_count - t->ring_len : 0;
+    uint64_t oldest_access = t->access_count > t->access_ring_len
+                           ? t->access_count - t->access_ring_len : 0;
+    struct TraceEntry e;
+    int err = 0;
+
+    for (uint64_t i = first; i < t->ring_count && !err; i++) {
+        const struct RingEntry *re = &t->ring[i % t->ring_len];
+        if (re->access_start < oldest_access) continue;
+
+        e.time = re->time;
+        e.pc = re->pc;
+        memcpy(e.regs, re->regs, sizeof(e.regs));
+        memcpy(e.op, re->op, sizeof(e.op));
+        e.access_count = re->access_count;
+        e.access_overflow = re->access_overflow;
+        for (int j = 0; j < re->access_count; j++) {
+            e.access[j] = t->access_ring[(re->access_start + j) % t->access_ring_len];
+        }
+        err = trace_writer_add(w, &e);
+        t->instructions++;
+    }
+
+    if (trace_writer_close(w)) err = -1;
+    if (err) dlog(LOG_ERR, "Failed to write trace \"%s\"", t->path);
+    return err;
+}
+
+/* Closes the trace, writing out the ring buffer if there's one.
+ * Returns zero on success, non-zero otherwise. */
+int trace_stop(Z80_t *cpu)
+{
+    struct Z80Trace *t = cpu->trace;
+    if (t == NULL) return 0;
+
+    int err = t->error;
+    if (t->ring != NULL) {
+        if (ring_write(t)) err = -1;
+    } else if (trace_writer_close(t->writer)) {
+        dlog(LOG_ERR, "Failed to write trace \"%s\"", t->path);
+        err = -1;
+    }
+    if (!err) {
+        dlog(LOG_INFO, "Wrote trace of %llu instructions to \"%s\"",
+                       (unsigned long long)t->instructions, t->path);
+    }
+
+    if (cpu->ctx != NULL && cpu->ctx->memory != NULL) {
+        memory_set_watch_all(cpu->ctx->memory, 0);
+    }
+
+    free(t->path);
+    free(t->ring);
+    free(t->access_ring);
+    free(t);
+    cpu->trace = NULL;
+    return err;
+}
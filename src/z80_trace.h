@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdint.h>
+#include "z80.h"
+
+int trace_start(Z80_t *cpu, const char *path, unsigned int ring_millions);
+void trace_step_begin(Z80_t *cpu);
+void trace_step_end(Z80_t *cpu);
+void trace_memory_access(Z80_t *cpu, uint16_t addr, uint8_t value, bool write);
+int trace_stop(Z80_t *cpu);